@@ -111,6 +111,7 @@ mythread_sigmask(int how, const sigset_t *restrict set,
 
 typedef pthread_t mythread;
 typedef pthread_mutex_t mythread_mutex;
+typedef pthread_key_t mythread_key;
 
 typedef struct {
 	pthread_cond_t cond;
@@ -174,6 +175,29 @@ mythread_join(mythread thread)
 }
 
 
+// Creates a key for thread-specific data. The value is NULL in every
+// thread until it is set. Returns zero on success and non-zero on error.
+static inline int
+mythread_key_create(mythread_key *key)
+{
+	return pthread_key_create(key, NULL);
+}
+
+static inline void *
+mythread_key_get(mythread_key key)
+{
+	return pthread_getspecific(key);
+}
+
+static inline void
+mythread_key_set(mythread_key key, void *value)
+{
+	int ret = pthread_setspecific(key, value);
+	assert(ret == 0);
+	(void)ret;
+}
+
+
 // Initiatlizes a mutex. Returns zero on success and non-zero on error.
 static inline int
 mythread_mutex_init(mythread_mutex *mutex)
@@ -322,6 +346,29 @@ mythread_condtime_set(mythread_condtime *condtime, const mythread_cond *cond,
 	}
 }
 
+// Returns the current time in nanoseconds using the same clock as cond.
+// Only differences between two return values are meaningful.
+static inline uint64_t
+mythread_time_ns(const mythread_cond *cond)
+{
+#ifdef HAVE_CLOCK_GETTIME
+	struct timespec now;
+	int ret = clock_gettime(cond->clk_id, &now);
+	assert(ret == 0);
+	(void)ret;
+
+	return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+#else
+	(void)cond;
+
+	struct timeval now;
+	gettimeofday(&now, NULL);
+
+	return (uint64_t)now.tv_sec * 1000000000
+			+ (uint64_t)now.tv_usec * 1000;
+#endif
+}
+
 
 #elif defined(MYTHREAD_WIN95) || defined(MYTHREAD_VISTA)
 
@@ -342,6 +389,7 @@ mythread_condtime_set(mythread_condtime *condtime, const mythread_cond *cond,
 
 typedef HANDLE mythread;
 typedef CRITICAL_SECTION mythread_mutex;
+typedef DWORD mythread_key;
 
 #ifdef MYTHREAD_WIN95
 typedef HANDLE mythread_cond;
@@ -409,6 +457,28 @@ mythread_join(mythread thread)
 }
 
 
+static inline int
+mythread_key_create(mythread_key *key)
+{
+	*key = TlsAlloc();
+	return *key == TLS_OUT_OF_INDEXES ? -1 : 0;
+}
+
+static inline void *
+mythread_key_get(mythread_key key)
+{
+	return TlsGetValue(key);
+}
+
+static inline void
+mythread_key_set(mythread_key key, void *value)
+{
+	BOOL ret = TlsSetValue(key, value);
+	assert(ret);
+	(void)ret;
+}
+
+
 static inline int
 mythread_mutex_init(mythread_mutex *mutex)
 {
@@ -516,6 +586,21 @@ mythread_condtime_set(mythread_condtime *condtime, const mythread_cond *cond,
 	condtime->timeout = timeout;
 }
 
+static inline uint64_t
+mythread_time_ns(const mythread_cond *cond)
+{
+	(void)cond;
+
+	LARGE_INTEGER now;
+	LARGE_INTEGER freq;
+	QueryPerformanceCounter(&now);
+	QueryPerformanceFrequency(&freq);
+
+	const uint64_t n = (uint64_t)now.QuadPart;
+	const uint64_t f = (uint64_t)freq.QuadPart;
+	return n / f * 1000000000 + n % f * 1000000000 / f;
+}
+
 #endif
 
 #endif
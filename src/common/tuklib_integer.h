@@ -343,6 +343,20 @@ read32le(const uint8_t *buf)
 }
 
 
+static inline uint64_t
+read64le(const uint8_t *buf)
+{
+#if !defined(WORDS_BIGENDIAN) || defined(TUKLIB_FAST_UNALIGNED_ACCESS)
+	uint64_t num = read64ne(buf);
+	return conv64le(num);
+#else
+	uint64_t num = (uint64_t)read32le(buf);
+	num |= (uint64_t)read32le(buf + 4) << 32;
+	return num;
+#endif
+}
+
+
 // NOTE: Possible byte swapping must be done in a macro to allow the compiler
 // to optimize byte swapping of constants when using glibc's or *BSD's
 // byte swapping macros. The actual write is done in an inline function
@@ -355,6 +369,7 @@ read32le(const uint8_t *buf)
 #if !defined(WORDS_BIGENDIAN) || defined(TUKLIB_FAST_UNALIGNED_ACCESS)
 #	define write16le(buf, num) write16ne(buf, conv16le(num))
 #	define write32le(buf, num) write32ne(buf, conv32le(num))
+#	define write64le(buf, num) write64ne(buf, conv64le(num))
 #endif
 
 
@@ -406,6 +421,17 @@ write32le(uint8_t *buf, uint32_t num)
 #endif
 
 
+#ifndef write64le
+static inline void
+write64le(uint8_t *buf, uint64_t num)
+{
+	write32le(buf, (uint32_t)num);
+	write32le(buf + 4, (uint32_t)(num >> 32));
+	return;
+}
+#endif
+
+
 //////////////////////////////
 // Aligned reads and writes //
 //////////////////////////////
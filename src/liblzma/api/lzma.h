@@ -300,6 +300,7 @@ extern "C" {
 #include "lzma/filter.h"
 #include "lzma/bcj.h"
 #include "lzma/delta.h"
+#include "lzma/dedup.h"
 #include "lzma/lzma12.h"
 
 /* Container formats */
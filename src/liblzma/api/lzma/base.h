@@ -330,6 +330,12 @@ typedef enum {
 		 * This action is currently supported only by Stream encoder
 		 * and easy encoder (which uses Stream encoder). If there is
 		 * no unfinished Block, no empty Block is created.
+		 *
+		 * Decoder: lzma_stream_decoder() and
+		 * lzma_stream_decoder_resume() stop after the next Block or
+		 * Stream and return LZMA_STREAM_END. Then decoding can be
+		 * continued normally. In contrast to encoding, the amount
+		 * of input may change between the calls to lzma_code().
 		 */
 
 	LZMA_FULL_BARRIER = 4,
@@ -504,6 +510,15 @@ typedef struct lzma_internal_s lzma_internal;
  *    function without calling lzma_end() first. Old allocations are
  *    automatically freed.
  *
+ *    Calling the same initialization function again with options that
+ *    need the same amount of memory (for example, the same dictionary
+ *    size and match finder) resets the coder but keeps its allocations.
+ *    This is like deflateReset() and inflateReset() in zlib and is much
+ *    faster than lzma_end() and a new initialization when compressing or
+ *    decompressing many small inputs. The encoders usually don't need to
+ *    clear the match finder: the entries of the previous input are
+ *    recognized as too distant from the new positions.
+ *
  *  - Finally, use lzma_end() to free the allocated memory. lzma_end() never
  *    frees the lzma_stream structure itself.
  *
@@ -622,6 +637,82 @@ extern LZMA_API(lzma_ret) lzma_code(lzma_stream *strm, lzma_action action)
 extern LZMA_API(void) lzma_end(lzma_stream *strm) lzma_nothrow;
 
 
+/**
+ * \brief       Make a copy of the coder state
+ *
+ * \param       src     Initialized lzma_stream to copy
+ * \param       dest    lzma_stream that is at least initialized with
+ *                      LZMA_STREAM_INIT. If it already has a coder,
+ *                      the coder is freed first like with lzma_end().
+ *
+ * After a successful copy, coding can be continued with both src and
+ * dest, and they will produce identical output from identical input.
+ * This is like deflateCopy() in zlib: for example, an encoder can be
+ * primed with data common to many inputs once and then copied for
+ * each input.
+ *
+ * The memory needed by the copy is allocated with dest->allocator.
+ * next_in, avail_in, total_in, next_out, avail_out, and total_out are
+ * copied from src. Structures that the application gave to the
+ * initialization function, for example lzma_block given to
+ * lzma_block_encoder(), are shared, not copied.
+ *
+ * Copying is supported by raw encoders and decoders using LZMA1, LZMA2,
+ * Delta, or BCJ filters, and by the .xz Block and Stream encoders and
+ * single-threaded decoders using those filters.
+ *
+ * \return     - LZMA_OK: Copying was successful.
+ *              - LZMA_MEM_ERROR
+ *              - LZMA_OPTIONS_ERROR: The coder or its current state
+ *                doesn't support copying. For example, the .xz Stream
+ *                encoder cannot be copied while it is encoding the Index.
+ *              - LZMA_PROG_ERROR
+ *
+ * On error dest is left without a coder like after lzma_end().
+ */
+extern LZMA_API(lzma_ret) lzma_stream_copy(
+		const lzma_stream *src, lzma_stream *dest)
+		lzma_nothrow lzma_attr_warn_unused_result;
+
+
+/**
+ * \brief       Take the memory of the next coder from a single region
+ *
+ * \param       strm    Pointer to lzma_stream that is initialized with
+ *                      LZMA_STREAM_INIT and has no coder, that is,
+ *                      lzma_end() has been called if it had one.
+ * \param       size    Size of the region in bytes
+ *
+ * This allocates a region of size bytes with strm->allocator. The coder
+ * that is initialized next with strm, for example with
+ * lzma_easy_encoder(), takes its memory from this region instead of
+ * allocating each of its many small and large structures separately.
+ * Freeing memory inside the region does nothing. lzma_end() frees the
+ * whole region at once. This avoids malloc() and free() overhead and
+ * memory fragmentation with short-lived streams.
+ *
+ * The size is normally taken from the memory usage function of the
+ * coder, for example, lzma_easy_encoder_memusage(),
+ * lzma_raw_encoder_memusage(), or lzma_stream_encoder_mt_memusage().
+ * If the region turns out to be too small, the rest of the memory is
+ * allocated normally with strm->allocator, so the estimate doesn't need
+ * to be exact.
+ *
+ * The memory freed inside the region isn't reused. Thus coders that
+ * reallocate their structures repeatedly, for example, decoders whose
+ * Blocks use different filter chains, will use the normal allocator
+ * once the region has been used up. A copy made with lzma_stream_copy()
+ * doesn't use the region of the source stream.
+ *
+ * \return      - LZMA_OK: The region was allocated.
+ *              - LZMA_MEM_ERROR
+ *              - LZMA_PROG_ERROR: strm is NULL, strm already has
+ *                a coder, or size is zero or too big.
+ */
+extern LZMA_API(lzma_ret) lzma_stream_arena(lzma_stream *strm, uint64_t size)
+		lzma_nothrow lzma_attr_warn_unused_result;
+
+
 /**
  * \brief       Get progress information
  *
@@ -73,7 +73,8 @@ typedef struct {
 	 *
 	 * Decoder: Bitwise-or of zero or more of the decoder flags:
 	 * LZMA_TELL_NO_CHECK, LZMA_TELL_UNSUPPORTED_CHECK,
-	 * LZMA_TELL_ANY_CHECK, LZMA_CONCATENATED, LZMA_FAIL_FAST
+	 * LZMA_TELL_ANY_CHECK, LZMA_CONCATENATED, LZMA_FAIL_FAST,
+	 * LZMA_VERIFY_ONLY
 	 */
 	uint32_t flags;
 
@@ -310,7 +311,8 @@ extern LZMA_API(lzma_ret) lzma_easy_encoder(
  * \brief       Single-call .xz Stream encoding using a preset number
  *
  * The maximum required output buffer size can be calculated with
- * lzma_stream_buffer_bound().
+ * lzma_stream_buffer_bound(). Like lzma_stream_buffer_encode(), the
+ * dictionary size of the preset is reduced if the input is smaller.
  *
  * \param       preset      Compression preset to use. See the description
  *                          in lzma_easy_encoder().
@@ -459,6 +461,11 @@ extern LZMA_API(size_t) lzma_stream_buffer_bound(size_t uncompressed_size)
 /**
  * \brief       Single-call .xz Stream encoder
  *
+ * If the input is smaller than the LZMA2 dictionary size, a smaller
+ * dictionary (but at least LZMA_DICT_SIZE_MIN) is used. This reduces
+ * the memory usage of both compression and decompression. The filter
+ * options given by the application are not modified.
+ *
  * \param       filters     Array of filters. This must be terminated with
  *                          filters[n].id = LZMA_VLI_UNKNOWN. See filter.h
  *                          for more information.
@@ -638,6 +645,26 @@ extern LZMA_API(lzma_ret) lzma_microlzma_encoder(
 #define LZMA_FAIL_FAST                  UINT32_C(0x20)
 
 
+/**
+ * This flag makes the threaded decoder verify the input without producing
+ * any output. The Blocks are decompressed and their integrity checks and
+ * sizes are verified like in normal decoding, but the uncompressed data
+ * is discarded and nothing is written to strm->next_out. strm->next_out
+ * may be NULL if strm->avail_out is zero. The amount of uncompressed data
+ * that has been verified can be seen with lzma_get_progress().
+ *
+ * Since no output needs to be buffered, each worker thread needs memory
+ * only for the compressed Block and the filter chain. Thus more Blocks
+ * can be verified in parallel within the same memlimit_threading than
+ * can be decompressed. The errors are reported in the same order as
+ * without this flag.
+ *
+ * Only lzma_stream_decoder_mt() supports this flag. Other decoders
+ * return LZMA_OPTIONS_ERROR if it is used.
+ */
+#define LZMA_VERIFY_ONLY                UINT32_C(0x40)
+
+
 /**
  * \brief       Initialize .xz Stream decoder
  *
@@ -674,6 +701,11 @@ extern LZMA_API(lzma_ret) lzma_stream_decoder(
  * A Stream with one Block will only utilize one thread. A Stream with multiple
  * Blocks but without size information in Block Headers will be processed in
  * single-threaded mode in the same way as done by lzma_stream_decoder().
+ * A Block that lacks the size information or that would need more memory
+ * than memlimit_threading allows is decoded in single-threaded mode, and
+ * threaded decoding continues from the next Block that can use it. The
+ * number of Blocks decoded in parallel is limited by memlimit_threading
+ * based on the sizes of the Blocks and thus may vary within a Stream.
  * Concatenated Streams are processed one Stream at a time; no inter-Stream
  * parallelization is done.
  *
@@ -691,6 +723,81 @@ extern LZMA_API(lzma_ret) lzma_stream_decoder_mt(
 		lzma_nothrow lzma_attr_warn_unused_result;
 
 
+/**
+ * \brief       Callback for the uncompressed data from an unordered decoder
+ *
+ * See lzma_stream_decoder_mt_unordered().
+ */
+typedef struct {
+	/**
+	 * \brief       Function to pass uncompressed data to the application
+	 *
+	 * \param       opaque      The opaque member of this structure
+	 * \param       uncompressed_offset
+	 *                          Offset of buf[0] in the uncompressed data.
+	 *                          With concatenated Streams this counts the
+	 *                          uncompressed data of all the earlier
+	 *                          Streams too.
+	 * \param       buf         Uncompressed data
+	 * \param       size        Number of bytes in buf. This is never 0.
+	 */
+	void (LZMA_API_CALL *write)(void *opaque,
+			uint64_t uncompressed_offset,
+			const uint8_t *buf, size_t size);
+
+	/**
+	 * \brief       Pointer passed to .write()
+	 *
+	 * Set this to NULL if you don't need it.
+	 */
+	void *opaque;
+
+} lzma_unordered_output;
+
+
+/**
+ * \brief       Initialize multithreaded .xz Stream decoder with unordered output
+ *
+ * This is like lzma_stream_decoder_mt() with the LZMA_VERIFY_ONLY flag,
+ * but the uncompressed data is passed to output->write() instead of being
+ * discarded. Each worker thread calls output->write() for every piece of
+ * data it decodes, so the data from different Blocks arrives in whatever
+ * order the Blocks get decoded. No Block waits for the earlier Blocks to
+ * be read out, and no uncompressed data is buffered by liblzma.
+ *
+ * output->write() may be called from several threads at the same time,
+ * so it must be thread safe. It may also be called from the thread that
+ * calls lzma_code(), for example, with Blocks that are decoded in
+ * single-threaded mode. All calls have returned when lzma_code() returns
+ * LZMA_STREAM_END or when lzma_end() returns. After an error, calls from
+ * the worker threads may still be in progress until lzma_end().
+ *
+ * The data is passed before the integrity check of its Block has been
+ * verified. If lzma_code() returns an error, any of the data may be bad,
+ * including data from Blocks after the location of the error. Errors are
+ * reported in the same order as by lzma_stream_decoder_mt().
+ *
+ * lzma_code() never writes to strm->next_out. strm->next_out may be NULL
+ * if strm->avail_out is zero.
+ *
+ * \param       strm        Pointer to properly prepared lzma_stream
+ * \param       options     Pointer to multithreaded decompression options.
+ *                          LZMA_VERIFY_ONLY is implied.
+ * \param       output      Callback for the uncompressed data. The
+ *                          structure is copied and doesn't need to stay
+ *                          valid after this function returns.
+ *
+ * \return      - LZMA_OK: Initialization was successful.
+ *              - LZMA_MEM_ERROR: Cannot allocate memory.
+ *              - LZMA_OPTIONS_ERROR: Unsupported flags.
+ *              - LZMA_PROG_ERROR
+ */
+extern LZMA_API(lzma_ret) lzma_stream_decoder_mt_unordered(
+		lzma_stream *strm, const lzma_mt *options,
+		const lzma_unordered_output *output)
+		lzma_nothrow lzma_attr_warn_unused_result;
+
+
 /**
  * \brief       Decode .xz Streams and .lzma files with autodetection
  *
@@ -823,3 +930,107 @@ extern LZMA_API(lzma_ret) lzma_microlzma_decoder(
 		lzma_stream *strm, uint64_t comp_size,
 		uint64_t uncomp_size, lzma_bool uncomp_size_is_exact,
 		uint32_t dict_size);
+
+
+/**************
+ * Statistics *
+ **************/
+
+/**
+ * \brief       Statistics of an .xz encoder or decoder
+ *
+ * The counters are updated by the coders while they run. Updating them
+ * costs only a few additions per Block and, with the threaded coders,
+ * a clock read around each wait and each chunk of work, so they are
+ * always enabled.
+ *
+ * The times are in nanoseconds. They are zero with single-threaded coders.
+ * The counters of a worker thread are added when it finishes a Block, so
+ * the values may lag behind a little while coding is in progress.
+ */
+typedef struct {
+	/**
+	 * \brief       Number of Blocks encoded or decoded
+	 */
+	uint64_t blocks;
+
+	/**
+	 * \brief       Amount of uncompressed data per integrity check type
+	 *
+	 * This is indexed with lzma_check. When decoding, this counts
+	 * only the data whose check was verified, so data decoded with
+	 * LZMA_IGNORE_CHECK isn't counted.
+	 */
+	uint64_t check_bytes[LZMA_CHECK_ID_MAX + 1];
+
+	/**
+	 * \brief       Time the worker threads spent coding
+	 *
+	 * This is the sum over all worker threads.
+	 */
+	uint64_t worker_busy_ns;
+
+	/**
+	 * \brief       Time the worker threads waited for work or input
+	 *
+	 * This is the sum over all worker threads.
+	 */
+	uint64_t worker_idle_ns;
+
+	/**
+	 * \brief       Number of times lzma_code() waited for the workers
+	 *
+	 * The thread calling lzma_code() has to wait when it cannot
+	 * continue until a worker thread finishes: the output queue is
+	 * full or empty, no thread is free, or the memory usage limit
+	 * doesn't allow starting another Block.
+	 */
+	uint64_t stalls;
+
+	/**
+	 * \brief       Total time of the waits counted in stalls
+	 */
+	uint64_t stall_ns;
+
+	/**
+	 * \brief       Highest memory usage seen
+	 *
+	 * This is the highest value seen of what lzma_memusage() would
+	 * return. With coders whose memory usage doesn't change, it is
+	 * the same as lzma_memusage(). The encoders don't support
+	 * lzma_memusage() so this is zero with them.
+	 */
+	uint64_t memusage_peak;
+
+	/*
+	 * Reserved space to allow possible future extensions without
+	 * breaking the ABI. lzma_get_stats() sets these to zero.
+	 */
+	uint64_t reserved_int1;
+	uint64_t reserved_int2;
+	uint64_t reserved_int3;
+	uint64_t reserved_int4;
+	uint64_t reserved_int5;
+	uint64_t reserved_int6;
+	uint64_t reserved_int7;
+	uint64_t reserved_int8;
+
+} lzma_stats;
+
+
+/**
+ * \brief       Get statistics of an .xz encoder or decoder
+ *
+ * This can be called at any time after the coder has been initialized,
+ * also while coding is in progress and after LZMA_STREAM_END.
+ * The statistics are supported by lzma_stream_encoder(),
+ * lzma_stream_encoder_mt(), lzma_easy_encoder(), lzma_stream_decoder(),
+ * lzma_stream_decoder_mt(), lzma_stream_decoder_mt_unordered(), and
+ * lzma_auto_decoder(). With other coders only memusage_peak is set.
+ *
+ * \param       strm        Pointer to lzma_stream that is at least
+ *                          initialized with LZMA_STREAM_INIT.
+ * \param       stats       The statistics are written here.
+ */
+extern LZMA_API(void) lzma_get_stats(lzma_stream *strm, lzma_stats *stats)
+		lzma_nothrow;
@@ -0,0 +1,110 @@
+/**
+ * \file        lzma/dedup.h
+ * \brief       Deduplication filter
+ */
+
+/*
+ * This file has been put into the public domain.
+ * You can do whatever you want with this file.
+ *
+ * See ../lzma.h for information about liblzma as a whole.
+ */
+
+#ifndef LZMA_H_INTERNAL
+#	error Never include this file directly. Use <lzma.h> instead.
+#endif
+
+
+/**
+ * \brief       Filter ID
+ *
+ * Filter ID of the Dedup filter. This is used as lzma_filter.id.
+ *
+ * This is a custom Filter ID (see the .xz file format specification).
+ * It hasn't been assigned officially, so the files that use the Dedup
+ * filter might not be supported by other .xz implementations.
+ *
+ * The Dedup filter splits the data into chunks whose boundaries depend
+ * on the content: a boundary is placed where a rolling hash of the most
+ * recent 64 bytes has a certain value. Inserting or removing bytes thus
+ * moves only the nearby boundaries, and identical data gets split into
+ * identical chunks even when it is at different offsets. A chunk that
+ * is identical to an earlier chunk within the window is replaced with
+ * a reference to it. The other chunks are passed through as is.
+ *
+ * This helps with data that has long repeated parts far apart, for
+ * example, backups of many similar files. LZMA2 can only find repeats
+ * that are within its dictionary and still has to spend time to find
+ * and encode them. The Dedup filter is meant to be used before LZMA2 in
+ * the filter chain. It cannot be the last filter in the chain.
+ *
+ * The encoded data is a sequence of records. Each record begins with
+ * a variable-length integer (see lzma/vli.h) whose lowest bit is the
+ * type of the record and the other bits are the size of the chunk.
+ * If the type is 0, the chunk follows as is. If the type is 1, another
+ * integer follows which is the distance to the earlier chunk from the
+ * beginning of this chunk. The distance is never smaller than the size
+ * of the chunk or bigger than the window.
+ *
+ * Each record adds one to four bytes to the data. The functions that
+ * calculate the worst-case output size, for example,
+ * lzma_stream_buffer_bound(), don't take this into account.
+ */
+#define LZMA_FILTER_DEDUP       LZMA_VLI_C(0x3F37DF5A1FD50001)
+
+
+/**
+ * \brief       Options for the Dedup filter
+ *
+ * The window size is needed by both encoder and decoder. The chunk size
+ * is used only by the encoder. It isn't stored in the Filter Properties
+ * so lzma_properties_decode() sets it to zero.
+ */
+typedef struct {
+	/**
+	 * \brief       Window size in bytes
+	 *
+	 * References can point at most this many bytes back in the
+	 * uncompressed data. The encoder and the decoder keep this much
+	 * uncompressed data in memory. The value is rounded up to the
+	 * next power of two when it is stored in the Filter Properties,
+	 * so the decoder may need up to twice as much memory.
+	 *
+	 * With the multithreaded encoder each Block is deduplicated
+	 * separately. The recommended Block size is made at least as
+	 * big as the window.
+	 */
+	uint32_t window_size;
+#	define LZMA_DEDUP_WINDOW_MIN       (UINT32_C(1) << 20)
+#	define LZMA_DEDUP_WINDOW_MAX       (UINT32_C(1) << 30)
+#	define LZMA_DEDUP_WINDOW_DEFAULT   (UINT32_C(1) << 26)
+
+	/**
+	 * \brief       Average chunk size in bytes
+	 *
+	 * This must be a power of two. The chunks are at least a quarter
+	 * and at most four times this big except that the data is split
+	 * also at the end and at LZMA_SYNC_FLUSH. Smaller chunks find more
+	 * repeats but need more memory in the encoder and add more
+	 * records to the data.
+	 */
+	uint32_t chunk_size;
+#	define LZMA_DEDUP_CHUNK_MIN        (UINT32_C(1) << 12)
+#	define LZMA_DEDUP_CHUNK_MAX        (UINT32_C(1) << 20)
+#	define LZMA_DEDUP_CHUNK_DEFAULT    (UINT32_C(1) << 16)
+
+	/*
+	 * Reserved space to allow possible future extensions without
+	 * breaking the ABI. You should not touch these, because the names
+	 * of these variables may change. These are and will never be used
+	 * with the currently supported options, so it is safe to leave
+	 * these uninitialized.
+	 */
+	uint32_t reserved_int1;
+	uint32_t reserved_int2;
+	uint32_t reserved_int3;
+	uint32_t reserved_int4;
+	void *reserved_ptr1;
+	void *reserved_ptr2;
+
+} lzma_options_dedup;
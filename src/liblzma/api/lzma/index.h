@@ -750,3 +750,113 @@ extern LZMA_API(lzma_ret) lzma_file_info_decoder(
 		lzma_stream *strm, lzma_index **dest_index,
 		uint64_t memlimit, uint64_t file_size)
 		lzma_nothrow;
+
+
+/**
+ * \brief       Calculate the size of the lzma_index_export() output
+ *
+ * \return      Number of bytes that lzma_index_export() will write
+ *              when given the same lzma_index.
+ */
+extern LZMA_API(lzma_vli) lzma_index_export_size(const lzma_index *i)
+		lzma_nothrow lzma_attr_pure;
+
+
+/**
+ * \brief       Export lzma_index to a compact index file
+ *
+ * The output is meant to be stored next to the .xz file so that an
+ * application doing random access can load the Index information of
+ * all Streams with lzma_index_import() without having to seek to every
+ * Stream Footer and Index in the .xz file. Unlike lzma_index_buffer_encode(),
+ * this keeps the Streams separate.
+ *
+ * All fields are fixed-size little endian integers aligned to eight bytes
+ * relative to the beginning of the output, so the file may be mapped into
+ * memory as is:
+ *
+ *   - Header: six magic bytes 0xFD 'X' 'Z' 'I' 'D' 'X', format version
+ *     as two bytes 0x00 0x01, size of the .xz file (8 bytes), number of
+ *     Streams (8 bytes)
+ *
+ *   - For each Stream: a copy of the Stream Footer (12 bytes) followed by
+ *     four zero bytes, size of the Stream Padding (8 bytes), number of
+ *     Blocks (8 bytes), and for each Block the Uncompressed Sizes and
+ *     the Unpadded Sizes of the Blocks so far in the Stream (8 + 8 bytes).
+ *     The Unpadded Sizes are summed by rounding the sum so far up to
+ *     a multiple of four before adding the next size.
+ *
+ *   - CRC32 of everything above (4 bytes) followed by four zero bytes
+ *
+ * The Stream Flags of every Stream must have been set with
+ * lzma_index_stream_flags(). lzma_file_info_decoder() does this.
+ *
+ * \param       i         lzma_index to be exported
+ * \param       out       Beginning of the output buffer
+ * \param       out_pos   The next byte will be written to out[*out_pos].
+ *                        *out_pos is updated only if exporting succeeds.
+ * \param       out_size  Size of the out buffer; the first byte into
+ *                        which no data is written to is out[out_size].
+ *
+ * \return      - LZMA_OK
+ *              - LZMA_BUF_ERROR: Output buffer is too small. Use
+ *                lzma_index_export_size() to find out how much output
+ *                space is needed.
+ *              - LZMA_OPTIONS_ERROR: The Stream Flags of some Stream
+ *                aren't supported by this liblzma version.
+ *              - LZMA_PROG_ERROR: Invalid arguments or the Stream Flags
+ *                of some Stream haven't been set.
+ */
+extern LZMA_API(lzma_ret) lzma_index_export(const lzma_index *i,
+		uint8_t *out, size_t *out_pos, size_t out_size)
+		lzma_nothrow lzma_attr_warn_unused_result;
+
+
+/**
+ * \brief       Import lzma_index from an index file
+ *
+ * This reads the output of lzma_index_export(). Everything is validated
+ * like when decoding the Indexes from a .xz file: the Stream Footers and
+ * their Backward Size fields must match the Blocks, the sizes must be
+ * within the limits of the .xz format, and the CRC32 must match.
+ *
+ * The index file is a separate file, so it might not belong to the .xz
+ * file or be out of date. The size of the .xz file is compared to the one
+ * stored in the index file. To be sure, the application may compare the
+ * Stream Footers in the .xz file to the ones in the index file, for
+ * example when it accesses the Stream the first time. lzma_index_iter
+ * gives the location of each Stream Footer.
+ *
+ * \param       i           If importing succeeds, *i will point to a new
+ *                          lzma_index, which the application has to
+ *                          later free with lzma_index_end(). If an error
+ *                          occurs, *i will be NULL.
+ * \param       memlimit    Pointer to how much memory the resulting
+ *                          lzma_index is allowed to require. The value
+ *                          pointed by this pointer is modified if and only
+ *                          if LZMA_MEMLIMIT_ERROR is returned.
+ * \param       allocator   Pointer to lzma_allocator, or NULL to use malloc()
+ * \param       in          Beginning of the input buffer
+ * \param       in_pos      The next byte will be read from in[*in_pos].
+ *                          *in_pos is updated only if importing succeeds.
+ * \param       in_size     Size of the input buffer; the first byte that
+ *                          won't be read is in[in_size].
+ * \param       file_size   Size of the .xz file, or LZMA_VLI_UNKNOWN
+ *                          to skip this check.
+ *
+ * \return      - LZMA_OK
+ *              - LZMA_FORMAT_ERROR: The input isn't an index file.
+ *              - LZMA_OPTIONS_ERROR: Unsupported format version or
+ *                Stream Flags.
+ *              - LZMA_DATA_ERROR: The index file is corrupt, truncated,
+ *                or doesn't match file_size.
+ *              - LZMA_MEM_ERROR
+ *              - LZMA_MEMLIMIT_ERROR: Memory usage limit was reached.
+ *                The minimum required memlimit value was stored to *memlimit.
+ *              - LZMA_PROG_ERROR
+ */
+extern LZMA_API(lzma_ret) lzma_index_import(lzma_index **i,
+		uint64_t *memlimit, const lzma_allocator *allocator,
+		const uint8_t *in, size_t *in_pos, size_t in_size,
+		lzma_vli file_size)
+		lzma_nothrow lzma_attr_warn_unused_result;
@@ -98,7 +98,7 @@ typedef enum {
 		 *  - dict_size > 16 MiB: dict_size * 9.5 + 64 MiB
 		 */
 
-	LZMA_MF_BT4     = 0x14
+	LZMA_MF_BT4     = 0x14,
 		/**<
 		 * \brief       Binary Tree with 2-, 3-, and 4-byte hashing
 		 *
@@ -108,9 +108,63 @@ typedef enum {
 		 *  - dict_size <= 32 MiB: dict_size * 11.5
 		 *  - dict_size > 32 MiB: dict_size * 10.5
 		 */
+
+	LZMA_MF_HS4     = 0x24,
+		/**<
+		 * \brief       Single-probe hash with 4-byte hashing
+		 *
+		 * Each hash bucket remembers only the most recent position,
+		 * so at most one match candidate is checked per byte. This
+		 * is much faster than the hash chains but finds fewer and
+		 * shorter matches. It is meant to be used together with
+		 * LZMA_MODE_ULTRA_FAST. The depth option is ignored.
+		 *
+		 * Minimum nice_len: 4
+		 *
+		 * Memory usage:
+		 *  - dict_size <= 32 MiB: dict_size * 3.5
+		 *  - dict_size > 32 MiB: dict_size * 2.5
+		 */
+
+	LZMA_MF_HB4     = 0x44
+		/**<
+		 * \brief       Hash buckets with 4-byte hashing
+		 *
+		 * Each hash bucket holds the eight most recent positions
+		 * with that hash next to each other in memory.
+		 * Unlike with a hash chain, all candidates are known
+		 * before any of them is read, so the memory accesses
+		 * can overlap. depth limits how many of the eight
+		 * candidates are checked; the default is all of them.
+		 *
+		 * Minimum nice_len: 4
+		 *
+		 * Memory usage:
+		 *  - dict_size <= 32 MiB: dict_size * 5.5
+		 *  - dict_size > 32 MiB: dict_size * 3.5
+		 */
 } lzma_match_finder;
 
 
+/**
+ * \brief       Long-range matching flag for lzma_options_lzma.mf
+ *
+ * This can be bitwise-ORed to any match finder ID to enable an additional
+ * long-range match finder. It adds every 64th position or so, chosen by
+ * a rolling hash of the data, to a small hash table. When the same data
+ * is seen again, a long match is given to the encoder even if the normal
+ * match finder didn't find it. This helps with long repeated sections
+ * that are far apart in a big dictionary, especially with the fast match
+ * finders that only look at the most recent candidates.
+ *
+ * The distances never exceed the dictionary size, so the output can be
+ * decoded with any LZMA1 or LZMA2 decoder using the same dict_size.
+ *
+ * Additional memory usage: about dict_size / 16.
+ */
+#define LZMA_MF_LONG_RANGE UINT32_C(0x100)
+
+
 /**
  * \brief       Test if given match finder is supported
  *
@@ -144,7 +198,7 @@ typedef enum {
 		 * a hash chain match finder.
 		 */
 
-	LZMA_MODE_NORMAL = 2
+	LZMA_MODE_NORMAL = 2,
 		/**<
 		 * \brief       Normal compression
 		 *
@@ -152,6 +206,20 @@ typedef enum {
 		 * together with binary tree match finders to expose the
 		 * full potential of the LZMA1 or LZMA2 encoder.
 		 */
+
+	LZMA_MODE_ULTRA_FAST = 3
+		/**<
+		 * \brief       Ultra fast compression
+		 *
+		 * Greedy parsing: the longest of the repeated matches and
+		 * the match from the match finder is encoded as is, without
+		 * looking at the next byte for a possibly better match.
+		 * The output is a normal LZMA1 or LZMA2 stream but the
+		 * compression ratio is worse than with LZMA_MODE_FAST.
+		 *
+		 * Ultra fast mode is at its best when combined with
+		 * LZMA_MF_HS4.
+		 */
 } lzma_mode;
 
 
@@ -341,7 +409,11 @@ typedef struct {
 	 */
 	uint32_t nice_len;
 
-	/** Match finder ID */
+	/**
+	 * \brief       Match finder ID
+	 *
+	 * This may be bitwise-ORed with LZMA_MF_LONG_RANGE.
+	 */
 	lzma_match_finder mf;
 
 	/**
@@ -418,3 +490,45 @@ typedef struct {
  */
 extern LZMA_API(lzma_bool) lzma_lzma_preset(
 		lzma_options_lzma *options, uint32_t preset) lzma_nothrow;
+
+
+/**
+ * \brief       Build a preset dictionary from sample data
+ *
+ * A preset dictionary (see lzma_options_lzma.preset_dict) improves both
+ * the compression ratio and speed a lot when compressing many small
+ * pieces of similar data independently from each other. This function
+ * picks the strings that occur in many of the given samples and puts
+ * them into a dictionary. The most common strings are put near the end
+ * of the dictionary.
+ *
+ * The samples should be typical examples of the data to compress, for
+ * example, a few hundred individual records. If all samples fit into
+ * dict_size_max bytes, they are simply concatenated.
+ *
+ * This function is available only if LZMA1 or LZMA2 encoder has been
+ * enabled when building liblzma.
+ *
+ * \param       allocator       lzma_allocator for temporary memory.
+ *                              Set to NULL to use malloc() and free().
+ * \param       samples         All samples concatenated
+ * \param       sample_sizes    Array of sample_count sizes of the samples
+ * \param       sample_count    Number of samples; must be non-zero
+ * \param       dict            Buffer for the dictionary
+ * \param       dict_size       On success, the size of the dictionary
+ *                              is stored in *dict_size. It may be
+ *                              smaller than dict_size_max if the samples
+ *                              have little in common.
+ * \param       dict_size_max   Size of the dict buffer. This is also
+ *                              the maximum size of the dictionary.
+ *
+ * \return      - LZMA_OK: Dictionary was built successfully.
+ *              - LZMA_MEM_ERROR
+ *              - LZMA_PROG_ERROR
+ */
+extern LZMA_API(lzma_ret) lzma_preset_dict_train(
+		const lzma_allocator *allocator,
+		const uint8_t *samples, const size_t *sample_sizes,
+		size_t sample_count,
+		uint8_t *dict, size_t *dict_size, size_t dict_size_max)
+		lzma_nothrow lzma_attr_warn_unused_result;
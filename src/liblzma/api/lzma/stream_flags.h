@@ -221,3 +221,113 @@ extern LZMA_API(lzma_ret) lzma_stream_footer_decode(
 extern LZMA_API(lzma_ret) lzma_stream_flags_compare(
 		const lzma_stream_flags *a, const lzma_stream_flags *b)
 		lzma_nothrow lzma_attr_pure;
+
+
+/**
+ * \brief       Position of the .xz Stream decoder at a boundary
+ *
+ * lzma_stream_decoder_resume() updates this structure every time it has
+ * decoded a Stream Header, a Block, Stream Footer, or four bytes of Stream
+ * Padding. The application can save a copy of it and later start decoding
+ * from in_offset by giving the copy to lzma_stream_decoder_resume().
+ *
+ * Use LZMA_STREAM_POSITION_INIT to start from the beginning of a file.
+ */
+typedef struct {
+	/**
+	 * \brief       Offset in the compressed input
+	 *
+	 * This is relative to the beginning of the file, or whatever
+	 * offset was used when decoding was started.
+	 */
+	lzma_vli in_offset;
+
+	/**
+	 * \brief       Offset in the uncompressed output
+	 */
+	lzma_vli out_offset;
+
+	/**
+	 * \brief       Number of Blocks decoded from the current Stream
+	 *
+	 * If this is LZMA_VLI_UNKNOWN, in_offset is between Streams and
+	 * a Stream Header or Stream Padding comes next. Otherwise the
+	 * next field is a Block Header or the Index.
+	 */
+	lzma_vli block_count;
+
+	/**
+	 * \brief       Stream Flags of the current Stream
+	 *
+	 * This is valid only if block_count isn't LZMA_VLI_UNKNOWN.
+	 * backward_size is ignored.
+	 */
+	lzma_stream_flags stream_flags;
+
+	/*
+	 * Reserved space to allow possible future extensions without
+	 * breaking the ABI. Set these to zero or use
+	 * LZMA_STREAM_POSITION_INIT.
+	 */
+	lzma_vli reserved_vli1;
+	lzma_vli reserved_vli2;
+	void *reserved_ptr1;
+	void *reserved_ptr2;
+
+} lzma_stream_position;
+
+
+/**
+ * \brief       Initialization for lzma_stream_position
+ *
+ * The decoding starts from a Stream Header at offset zero.
+ */
+#define LZMA_STREAM_POSITION_INIT \
+	{ 0, 0, LZMA_VLI_UNKNOWN, { 0, 0, LZMA_CHECK_NONE, \
+	LZMA_RESERVED_ENUM, LZMA_RESERVED_ENUM, LZMA_RESERVED_ENUM, \
+	LZMA_RESERVED_ENUM, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }, \
+	0, 0, NULL, NULL }
+
+
+/**
+ * \brief       Initialize .xz Stream decoder that starts at a boundary
+ *
+ * This is like lzma_stream_decoder() but decoding starts at the boundary
+ * described by *position, and *position is updated as the decoder passes
+ * the later boundaries. The input given to lzma_code() must begin at
+ * position->in_offset.
+ *
+ * If position->block_count is LZMA_VLI_UNKNOWN, the input begins with
+ * a Stream Header (or Stream Padding if LZMA_CONCATENATED is used and
+ * in_offset isn't zero). Otherwise it begins with the Block Header of
+ * the Block number block_count in a Stream that uses the given
+ * Stream Flags, or with the Index if there are no more Blocks.
+ *
+ * When decoding starts in the middle of a Stream, the Blocks before
+ * the starting point cannot be compared against the Index. Their
+ * number and Index Size are still verified.
+ *
+ * Using LZMA_FULL_FLUSH with lzma_code() makes it return LZMA_STREAM_END
+ * after every Block and after every Stream Footer. *position is also
+ * updated after a Stream Header and after every four bytes of Stream
+ * Padding, but LZMA_STREAM_END isn't returned there. A copy made with
+ * lzma_stream_copy() doesn't update *position.
+ *
+ * \param       strm        Pointer to properly prepared lzma_stream
+ * \param       memlimit    Memory usage limit as bytes. Use UINT64_MAX
+ *                          to effectively disable the limiter.
+ * \param       flags       Bitwise-or of zero or more of the decoder flags
+ *                          supported by lzma_stream_decoder()
+ * \param       position    Where the input begins. The structure must
+ *                          stay valid until lzma_end() is called.
+ *
+ * \return      - LZMA_OK: Initialization was successful.
+ *              - LZMA_MEM_ERROR: Cannot allocate memory.
+ *              - LZMA_OPTIONS_ERROR: Unsupported flags or
+ *                Stream Flags version
+ *              - LZMA_PROG_ERROR
+ */
+extern LZMA_API(lzma_ret) lzma_stream_decoder_resume(
+		lzma_stream *strm, uint64_t memlimit, uint32_t flags,
+		lzma_stream_position *position)
+		lzma_nothrow lzma_attr_warn_unused_result;
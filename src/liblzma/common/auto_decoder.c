@@ -122,6 +122,18 @@ auto_decoder_get_check(const void *coder_ptr)
 }
 
 
+static void
+auto_decoder_get_stats(void *coder_ptr, lzma_stats *stats)
+{
+	const lzma_auto_coder *coder = coder_ptr;
+
+	if (coder->next.get_stats != NULL)
+		coder->next.get_stats(coder->next.coder, stats);
+
+	return;
+}
+
+
 static lzma_ret
 auto_decoder_memconfig(void *coder_ptr, uint64_t *memusage,
 		uint64_t *old_memlimit, uint64_t new_memlimit)
@@ -171,6 +183,7 @@ auto_decoder_init(lzma_next_coder *next, const lzma_allocator *allocator,
 		next->code = &auto_decode;
 		next->end = &auto_decoder_end;
 		next->get_check = &auto_decoder_get_check;
+		next->get_stats = &auto_decoder_get_stats;
 		next->memconfig = &auto_decoder_memconfig;
 		coder->next = LZMA_NEXT_CODER_INIT;
 	}
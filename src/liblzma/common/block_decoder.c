@@ -164,8 +164,12 @@ block_decode(void *coder_ptr, const lzma_allocator *allocator,
 				return LZMA_DATA_ERROR;
 		}
 
-		if (coder->block->check == LZMA_CHECK_NONE)
+		if (coder->block->check == LZMA_CHECK_NONE) {
+			lzma_probe3(block_decode_end, coder,
+					coder->block->uncompressed_size,
+					coder->block->compressed_size);
 			return LZMA_STREAM_END;
+		}
 
 		if (!coder->ignore_check)
 			lzma_check_finish(&coder->check, coder->block->check);
@@ -191,6 +195,9 @@ block_decode(void *coder_ptr, const lzma_allocator *allocator,
 					check_size) != 0)
 			return LZMA_DATA_ERROR;
 
+		lzma_probe3(block_decode_end, coder,
+				coder->block->uncompressed_size,
+				coder->block->compressed_size);
 		return LZMA_STREAM_END;
 	}
 	}
@@ -209,6 +216,40 @@ block_decoder_end(void *coder_ptr, const lzma_allocator *allocator)
 }
 
 
+static lzma_ret
+block_decoder_copy(const void *coder_ptr, void **dest_ptr,
+		const lzma_allocator *allocator)
+{
+	const lzma_block_coder *coder = coder_ptr;
+
+	lzma_block_coder *dest = lzma_alloc(sizeof(lzma_block_coder),
+			allocator);
+	if (dest == NULL)
+		return LZMA_MEM_ERROR;
+
+	*dest = *coder;
+
+	const lzma_ret ret = lzma_next_copy(&dest->next, allocator,
+			&coder->next);
+	if (ret != LZMA_OK) {
+		lzma_free(dest, allocator);
+		return ret;
+	}
+
+	*dest_ptr = dest;
+	return LZMA_OK;
+}
+
+
+extern void
+lzma_block_decoder_set_block(lzma_next_coder *next, lzma_block *block)
+{
+	lzma_block_coder *coder = next->coder;
+	coder->block = block;
+	return;
+}
+
+
 extern lzma_ret
 lzma_block_decoder_init(lzma_next_coder *next, const lzma_allocator *allocator,
 		lzma_block *block)
@@ -232,6 +273,7 @@ lzma_block_decoder_init(lzma_next_coder *next, const lzma_allocator *allocator,
 		next->coder = coder;
 		next->code = &block_decode;
 		next->end = &block_decoder_end;
+		next->copy = &block_decoder_copy;
 		coder->next = LZMA_NEXT_CODER_INIT;
 	}
 
@@ -268,6 +310,10 @@ lzma_block_decoder_init(lzma_next_coder *next, const lzma_allocator *allocator,
 	coder->ignore_check = block->version >= 1
 			? block->ignore_check : false;
 
+	// The sizes are LZMA_VLI_UNKNOWN if they aren't in the Block Header.
+	lzma_probe3(block_decode_start, coder, block->compressed_size,
+			block->uncompressed_size);
+
 	// Initialize the filter chain.
 	return lzma_raw_decoder_init(&coder->next, allocator,
 			block->filters);
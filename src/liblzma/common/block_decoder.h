@@ -19,4 +19,9 @@
 extern lzma_ret lzma_block_decoder_init(lzma_next_coder *next,
 		const lzma_allocator *allocator, lzma_block *block);
 
+/// Make a Block decoder copied with lzma_next_copy() use *block instead of
+/// the lzma_block of the original. next must be initialized.
+extern void lzma_block_decoder_set_block(lzma_next_coder *next,
+		lzma_block *block);
+
 #endif
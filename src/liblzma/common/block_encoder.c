@@ -109,8 +109,12 @@ block_encode(void *coder_ptr, const lzma_allocator *allocator,
 			++coder->compressed_size;
 		}
 
-		if (coder->block->check == LZMA_CHECK_NONE)
+		if (coder->block->check == LZMA_CHECK_NONE) {
+			lzma_probe3(block_encode_end, coder,
+					coder->block->uncompressed_size,
+					coder->block->compressed_size);
 			return LZMA_STREAM_END;
+		}
 
 		lzma_check_finish(&coder->check, coder->block->check);
 
@@ -127,6 +131,9 @@ block_encode(void *coder_ptr, const lzma_allocator *allocator,
 
 		memcpy(coder->block->raw_check, coder->check.buffer.u8,
 				check_size);
+		lzma_probe3(block_encode_end, coder,
+				coder->block->uncompressed_size,
+				coder->block->compressed_size);
 		return LZMA_STREAM_END;
 	}
 	}
@@ -160,6 +167,40 @@ block_encoder_update(void *coder_ptr, const lzma_allocator *allocator,
 }
 
 
+static lzma_ret
+block_encoder_copy(const void *coder_ptr, void **dest_ptr,
+		const lzma_allocator *allocator)
+{
+	const lzma_block_coder *coder = coder_ptr;
+
+	lzma_block_coder *dest = lzma_alloc(sizeof(lzma_block_coder),
+			allocator);
+	if (dest == NULL)
+		return LZMA_MEM_ERROR;
+
+	*dest = *coder;
+
+	const lzma_ret ret = lzma_next_copy(&dest->next, allocator,
+			&coder->next);
+	if (ret != LZMA_OK) {
+		lzma_free(dest, allocator);
+		return ret;
+	}
+
+	*dest_ptr = dest;
+	return LZMA_OK;
+}
+
+
+extern void
+lzma_block_encoder_set_block(lzma_next_coder *next, lzma_block *block)
+{
+	lzma_block_coder *coder = next->coder;
+	coder->block = block;
+	return;
+}
+
+
 extern lzma_ret
 lzma_block_encoder_init(lzma_next_coder *next, const lzma_allocator *allocator,
 		lzma_block *block)
@@ -192,6 +233,7 @@ lzma_block_encoder_init(lzma_next_coder *next, const lzma_allocator *allocator,
 		next->coder = coder;
 		next->code = &block_encode;
 		next->end = &block_encoder_end;
+		next->copy = &block_encoder_copy;
 		next->update = &block_encoder_update;
 		coder->next = LZMA_NEXT_CODER_INIT;
 	}
@@ -203,6 +245,8 @@ lzma_block_encoder_init(lzma_next_coder *next, const lzma_allocator *allocator,
 	coder->uncompressed_size = 0;
 	coder->pos = 0;
 
+	lzma_probe2(block_encode_start, coder, block->check);
+
 	// Initialize the check
 	lzma_check_init(&coder->check, block->check);
 
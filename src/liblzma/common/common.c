@@ -86,6 +86,98 @@ lzma_free(void *ptr, const lzma_allocator *allocator)
 }
 
 
+///////////
+// Arena //
+///////////
+
+/// Alignment of the allocations from the arena
+#define ARENA_ALIGN 16
+
+
+static void *
+arena_alloc(void *opaque, size_t nmemb, size_t size)
+{
+	// lzma_alloc() always uses nmemb == 1.
+	assert(nmemb == 1);
+	(void)nmemb;
+
+	lzma_arena *arena = opaque;
+	void *ptr = NULL;
+
+#ifdef MYTHREAD_ENABLED
+	mythread_sync(arena->mutex)
+#endif
+	{
+		if (size <= arena->size - arena->pos) {
+			ptr = arena->buf + arena->pos;
+			arena->pos += my_min(arena->size - arena->pos,
+					(size + ARENA_ALIGN - 1)
+					& ~(size_t)(ARENA_ALIGN - 1));
+		}
+	}
+
+	// Use the normal allocator when the region has been used up.
+	if (ptr == NULL)
+		ptr = lzma_alloc(size, arena->parent);
+
+	return ptr;
+}
+
+
+static void
+arena_free(void *opaque, void *ptr)
+{
+	lzma_arena *arena = opaque;
+
+	// The memory inside the region is freed only by lzma_end().
+	if ((uint8_t *)(ptr) >= arena->buf
+			&& (uint8_t *)(ptr) < arena->buf + arena->size)
+		return;
+
+	lzma_free(ptr, arena->parent);
+	return;
+}
+
+
+extern LZMA_API(lzma_ret)
+lzma_stream_arena(lzma_stream *strm, uint64_t size)
+{
+	if (strm == NULL || strm->internal != NULL || size == 0
+			|| size > SIZE_MAX - ARENA_ALIGN)
+		return LZMA_PROG_ERROR;
+
+	return_if_error(lzma_strm_init(strm));
+
+	lzma_arena *arena = &strm->internal->arena;
+
+#ifdef MYTHREAD_ENABLED
+	if (mythread_mutex_init(&arena->mutex)) {
+		lzma_end(strm);
+		return LZMA_MEM_ERROR;
+	}
+#endif
+
+	arena->buf = lzma_alloc((size_t)(size), strm->allocator);
+	if (arena->buf == NULL) {
+#ifdef MYTHREAD_ENABLED
+		mythread_mutex_destroy(&arena->mutex);
+#endif
+		lzma_end(strm);
+		return LZMA_MEM_ERROR;
+	}
+
+	arena->size = (size_t)(size);
+	arena->pos = 0;
+	arena->parent = strm->allocator;
+
+	strm->internal->arena_allocator.alloc = &arena_alloc;
+	strm->internal->arena_allocator.free = &arena_free;
+	strm->internal->arena_allocator.opaque = arena;
+
+	return LZMA_OK;
+}
+
+
 //////////
 // Misc //
 //////////
@@ -112,6 +204,43 @@ lzma_bufcpy(const uint8_t *restrict in, size_t *restrict in_pos,
 }
 
 
+extern void
+lzma_gear_init(uint64_t gear[256])
+{
+	// The values only need to look random. Use a fixed sequence
+	// (SplitMix64) so that the output of the encoders using this
+	// doesn't vary between runs or platforms.
+	uint64_t x = 0;
+	for (size_t i = 0; i < 256; ++i) {
+		x += UINT64_C(0x9E3779B97F4A7C15);
+		uint64_t z = x;
+		z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+		z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+		gear[i] = z ^ (z >> 31);
+	}
+
+	return;
+}
+
+
+extern void
+lzma_stats_add(lzma_stats *dest, const lzma_stats *src)
+{
+	dest->blocks += src->blocks;
+
+	for (size_t i = 0; i <= LZMA_CHECK_ID_MAX; ++i)
+		dest->check_bytes[i] += src->check_bytes[i];
+
+	dest->worker_busy_ns += src->worker_busy_ns;
+	dest->worker_idle_ns += src->worker_idle_ns;
+	dest->stalls += src->stalls;
+	dest->stall_ns += src->stall_ns;
+	dest->memusage_peak = my_max(dest->memusage_peak,
+			src->memusage_peak);
+	return;
+}
+
+
 extern lzma_ret
 lzma_next_filter_init(lzma_next_coder *next, const lzma_allocator *allocator,
 		const lzma_filter_info *filters)
@@ -162,6 +291,28 @@ lzma_next_end(lzma_next_coder *next, const lzma_allocator *allocator)
 }
 
 
+extern lzma_ret
+lzma_next_copy(lzma_next_coder *dest, const lzma_allocator *allocator,
+		const lzma_next_coder *src)
+{
+	*dest = LZMA_NEXT_CODER_INIT;
+
+	// Nothing to copy if src isn't initialized.
+	if (src->init == (uintptr_t)(NULL) || src->coder == NULL)
+		return LZMA_OK;
+
+	if (src->copy == NULL)
+		return LZMA_OPTIONS_ERROR;
+
+	void *coder = NULL;
+	return_if_error(src->copy(src->coder, &coder, allocator));
+
+	*dest = *src;
+	dest->coder = coder;
+	return LZMA_OK;
+}
+
+
 //////////////////////////////////////
 // External to internal API wrapper //
 //////////////////////////////////////
@@ -179,12 +330,14 @@ lzma_strm_init(lzma_stream *strm)
 			return LZMA_MEM_ERROR;
 
 		strm->internal->next = LZMA_NEXT_CODER_INIT;
+		strm->internal->arena.buf = NULL;
 	}
 
 	memzero(strm->internal->supported_actions,
 			sizeof(strm->internal->supported_actions));
 	strm->internal->sequence = ISEQ_RUN;
 	strm->internal->allow_buf_error = false;
+	strm->internal->flush_input_may_change = false;
 
 	strm->total_in = 0;
 	strm->total_out = 0;
@@ -254,7 +407,8 @@ lzma_code(lzma_stream *strm, lzma_action action)
 
 	case ISEQ_FULL_FLUSH:
 		if (action != LZMA_FULL_FLUSH
-				|| strm->internal->avail_in != strm->avail_in)
+				|| (strm->internal->avail_in != strm->avail_in
+				&& !strm->internal->flush_input_may_change))
 			return LZMA_PROG_ERROR;
 
 		break;
@@ -284,7 +438,7 @@ lzma_code(lzma_stream *strm, lzma_action action)
 	size_t in_pos = 0;
 	size_t out_pos = 0;
 	lzma_ret ret = strm->internal->next.code(
-			strm->internal->next.coder, strm->allocator,
+			strm->internal->next.coder, lzma_strm_allocator(strm),
 			strm->next_in, &in_pos, strm->avail_in,
 			strm->next_out, &out_pos, strm->avail_out, action);
 
@@ -330,6 +484,14 @@ lzma_code(lzma_stream *strm, lzma_action action)
 
 		break;
 
+	case LZMA_MEMLIMIT_ERROR:
+		lzma_probe2(memlimit_error, lzma_memusage(strm),
+				lzma_memlimit_get(strm));
+
+		// Coding may be continued after raising the limit.
+		strm->internal->allow_buf_error = false;
+		break;
+
 	case LZMA_STREAM_END:
 		if (strm->internal->sequence == ISEQ_SYNC_FLUSH
 				|| strm->internal->sequence == ISEQ_FULL_FLUSH
@@ -344,7 +506,6 @@ lzma_code(lzma_stream *strm, lzma_action action)
 	case LZMA_NO_CHECK:
 	case LZMA_UNSUPPORTED_CHECK:
 	case LZMA_GET_CHECK:
-	case LZMA_MEMLIMIT_ERROR:
 		// Something else than LZMA_OK, but not a fatal error,
 		// that is, coding may be continued (except if ISEQ_END).
 		strm->internal->allow_buf_error = false;
@@ -361,11 +522,62 @@ lzma_code(lzma_stream *strm, lzma_action action)
 }
 
 
+extern LZMA_API(lzma_ret)
+lzma_stream_copy(const lzma_stream *src, lzma_stream *dest)
+{
+	if (src == NULL || dest == NULL || src == dest
+			|| src->internal == NULL)
+		return LZMA_PROG_ERROR;
+
+	// Free the old coder of dest, if any. Its allocator is kept.
+	lzma_end(dest);
+
+	lzma_internal *internal = lzma_alloc(sizeof(lzma_internal),
+			dest->allocator);
+	if (internal == NULL)
+		return LZMA_MEM_ERROR;
+
+	*internal = *src->internal;
+
+	// The copy doesn't use the arena of src.
+	internal->arena.buf = NULL;
+
+	const lzma_ret ret = lzma_next_copy(&internal->next,
+			dest->allocator, &src->internal->next);
+	if (ret != LZMA_OK) {
+		lzma_free(internal, dest->allocator);
+		return ret;
+	}
+
+	dest->internal = internal;
+	dest->next_in = src->next_in;
+	dest->avail_in = src->avail_in;
+	dest->total_in = src->total_in;
+	dest->next_out = src->next_out;
+	dest->avail_out = src->avail_out;
+	dest->total_out = src->total_out;
+
+	return LZMA_OK;
+}
+
+
 extern LZMA_API(void)
 lzma_end(lzma_stream *strm)
 {
 	if (strm != NULL && strm->internal != NULL) {
-		lzma_next_end(&strm->internal->next, strm->allocator);
+		lzma_next_end(&strm->internal->next,
+				lzma_strm_allocator(strm));
+
+		// Free the arena in one go after the coder has returned
+		// the memory it got from outside the arena.
+		lzma_arena *arena = &strm->internal->arena;
+		if (arena->buf != NULL) {
+			lzma_free(arena->buf, strm->allocator);
+#ifdef MYTHREAD_ENABLED
+			mythread_mutex_destroy(&arena->mutex);
+#endif
+		}
+
 		lzma_free(strm->internal, strm->allocator);
 		strm->internal = NULL;
 	}
@@ -390,6 +602,25 @@ lzma_get_progress(lzma_stream *strm,
 }
 
 
+extern LZMA_API(void)
+lzma_get_stats(lzma_stream *strm, lzma_stats *stats)
+{
+	memzero(stats, sizeof(*stats));
+
+	if (strm->internal == NULL)
+		return;
+
+	if (strm->internal->next.get_stats != NULL)
+		strm->internal->next.get_stats(strm->internal->next.coder,
+				stats);
+
+	// Coders that don't track the peak have a constant memory usage.
+	stats->memusage_peak = my_max(stats->memusage_peak,
+			lzma_memusage(strm));
+	return;
+}
+
+
 extern LZMA_API(lzma_check)
 lzma_get_check(const lzma_stream *strm)
 {
@@ -452,6 +683,12 @@ lzma_memlimit_set(lzma_stream *strm, uint64_t new_memlimit)
 	if (new_memlimit == 0)
 		new_memlimit = 1;
 
-	return strm->internal->next.memconfig(strm->internal->next.coder,
+	const lzma_ret ret = strm->internal->next.memconfig(
+			strm->internal->next.coder,
 			&memusage, &old_memlimit, new_memlimit);
+
+	if (ret == LZMA_MEMLIMIT_ERROR)
+		lzma_probe2(memlimit_error, memusage, new_memlimit);
+
+	return ret;
 }
@@ -44,6 +44,22 @@
 #	define unlikely(expr) (expr)
 #endif
 
+// Static probes (USDT) for tracing tools like perf, bpftrace, and SystemTap.
+// The provider name is "liblzma". When HAVE_PROBES isn't defined
+// (--enable-probes or ENABLE_PROBES wasn't used), these expand to nothing
+// and the arguments aren't evaluated. Each probe is a single no-op
+// instruction until a tracer attaches to it.
+#ifdef HAVE_PROBES
+#	include <sys/sdt.h>
+#	define lzma_probe2(name, a, b) \
+		DTRACE_PROBE2(liblzma, name, a, b)
+#	define lzma_probe3(name, a, b, c) \
+		DTRACE_PROBE3(liblzma, name, a, b, c)
+#else
+#	define lzma_probe2(name, a, b) do { } while (0)
+#	define lzma_probe3(name, a, b, c) do { } while (0)
+#endif
+
 
 /// Size of temporary buffers needed in some filters
 #define LZMA_BUFFER_SIZE 4096
@@ -163,6 +179,10 @@ struct lzma_next_coder_s {
 	void (*get_progress)(void *coder,
 			uint64_t *progress_in, uint64_t *progress_out);
 
+	/// Pointer to a function to add the statistics of this coder
+	/// to *stats. This is NULL if the coder has no statistics.
+	void (*get_stats)(void *coder, lzma_stats *stats);
+
 	/// Pointer to function to return the type of the integrity check.
 	/// Most coders won't support this.
 	lzma_check (*get_check)(const void *coder);
@@ -187,6 +207,13 @@ struct lzma_next_coder_s {
 	/// seen, LZMA_OK is allowed too.
 	lzma_ret (*set_out_limit)(void *coder, uint64_t *uncomp_size,
 			uint64_t out_limit);
+
+	/// Allocate an independent copy of the coder-specific data into
+	/// *dest. On error nothing may be left allocated. If this is NULL,
+	/// the coder doesn't support copying and lzma_next_copy() returns
+	/// LZMA_OPTIONS_ERROR.
+	lzma_ret (*copy)(const void *coder, void **dest,
+			const lzma_allocator *allocator);
 };
 
 
@@ -199,13 +226,37 @@ struct lzma_next_coder_s {
 		.code = NULL, \
 		.end = NULL, \
 		.get_progress = NULL, \
+		.get_stats = NULL, \
 		.get_check = NULL, \
 		.memconfig = NULL, \
 		.update = NULL, \
 		.set_out_limit = NULL, \
+		.copy = NULL, \
 	}
 
 
+/// Region from which lzma_stream_arena() makes the coder allocate its memory
+typedef struct {
+	/// The region. This is NULL if lzma_stream_arena() wasn't used.
+	uint8_t *buf;
+
+	/// Size of buf
+	size_t size;
+
+	/// Amount of buf that has already been handed out
+	size_t pos;
+
+	/// Allocator used when the region has been used up. This is
+	/// lzma_stream.allocator.
+	const lzma_allocator *parent;
+
+#ifdef MYTHREAD_ENABLED
+	/// The worker threads of the threaded coders allocate memory too.
+	mythread_mutex mutex;
+#endif
+} lzma_arena;
+
+
 /// Internal data for lzma_strm_init, lzma_code, and lzma_end. A pointer to
 /// this is stored in lzma_stream.
 struct lzma_internal_s {
@@ -237,9 +288,32 @@ struct lzma_internal_s {
 	/// If true, lzma_code will return LZMA_BUF_ERROR if no progress was
 	/// made (no input consumed and no output produced by next.code).
 	bool allow_buf_error;
+
+	/// If true, the amount of input may change while LZMA_FULL_FLUSH
+	/// is in progress. Decoders use LZMA_FULL_FLUSH only to stop at
+	/// the next boundary, which may be far beyond the current input.
+	bool flush_input_may_change;
+
+	/// Region set up by lzma_stream_arena()
+	lzma_arena arena;
+
+	/// Allocator that takes memory from the arena. This is given to
+	/// the coders instead of lzma_stream.allocator when arena.buf
+	/// isn't NULL.
+	lzma_allocator arena_allocator;
 };
 
 
+/// Returns the allocator to pass to the coders of strm. strm->internal
+/// must not be NULL.
+static inline const lzma_allocator *
+lzma_strm_allocator(const lzma_stream *strm)
+{
+	return strm->internal->arena.buf != NULL
+			? &strm->internal->arena_allocator : strm->allocator;
+}
+
+
 /// Allocates memory
 extern void *lzma_alloc(size_t size, const lzma_allocator *allocator)
 		lzma_attribute((__malloc__)) lzma_attr_alloc_size(1);
@@ -277,6 +351,31 @@ extern lzma_ret lzma_next_filter_update(
 extern void lzma_next_end(lzma_next_coder *next,
 		const lzma_allocator *allocator);
 
+/// Makes *dest an independent copy of *src including the rest of the
+/// filter chain. *dest must not contain an initialized coder. On error
+/// *dest is left as LZMA_NEXT_CODER_INIT.
+extern lzma_ret lzma_next_copy(lzma_next_coder *dest,
+		const lzma_allocator *allocator, const lzma_next_coder *src);
+
+
+/// Add the counters of *src to *dest. memusage_peak is the larger of the two.
+extern void lzma_stats_add(lzma_stats *dest, const lzma_stats *src);
+
+
+/// Count a finished Block in *stats. The Block's data is added to
+/// check_bytes only if its check was verified or calculated.
+static inline void
+lzma_stats_block(lzma_stats *stats, lzma_check check,
+		lzma_vli uncompressed_size, bool ignore_check)
+{
+	++stats->blocks;
+
+	if (!ignore_check && lzma_check_is_supported(check))
+		stats->check_bytes[check] += uncompressed_size;
+
+	return;
+}
+
 
 /// Copy as much data as possible from in[] to out[] and update *in_pos
 /// and *out_pos accordingly. Returns the number of bytes copied.
@@ -284,6 +383,10 @@ extern size_t lzma_bufcpy(const uint8_t *restrict in, size_t *restrict in_pos,
 		size_t in_size, uint8_t *restrict out,
 		size_t *restrict out_pos, size_t out_size);
 
+/// Fill the table of a gear rolling hash with pseudorandom values.
+/// The values are always the same.
+extern void lzma_gear_init(uint64_t gear[256]);
+
 
 /// \brief      Return if expression doesn't evaluate to LZMA_OK
 ///
@@ -319,7 +422,7 @@ do { \
 do { \
 	return_if_error(lzma_strm_init(strm)); \
 	const lzma_ret ret_ = func(&(strm)->internal->next, \
-			(strm)->allocator, __VA_ARGS__); \
+			lzma_strm_allocator(strm), __VA_ARGS__); \
 	if (ret_ != LZMA_OK) { \
 		lzma_end(strm); \
 		return ret_; \
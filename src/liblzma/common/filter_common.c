@@ -114,6 +114,15 @@ static const struct {
 		.last_ok = false,
 		.changes_size = false,
 	},
+#endif
+#if defined(HAVE_ENCODER_DEDUP) || defined(HAVE_DECODER_DEDUP)
+	{
+		.id = LZMA_FILTER_DEDUP,
+		.options_size = sizeof(lzma_options_dedup),
+		.non_last_ok = true,
+		.last_ok = false,
+		.changes_size = true,
+	},
 #endif
 	{
 		.id = LZMA_VLI_UNKNOWN
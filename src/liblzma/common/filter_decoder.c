@@ -16,6 +16,7 @@
 #include "lzma2_decoder.h"
 #include "simple_decoder.h"
 #include "delta_decoder.h"
+#include "dedup_decoder.h"
 
 
 typedef struct {
@@ -115,6 +116,14 @@ static const lzma_filter_decoder decoders[] = {
 		.props_decode = &lzma_delta_props_decode,
 	},
 #endif
+#ifdef HAVE_DECODER_DEDUP
+	{
+		.id = LZMA_FILTER_DEDUP,
+		.init = &lzma_dedup_decoder_init,
+		.memusage = &lzma_dedup_decoder_memusage,
+		.props_decode = &lzma_dedup_props_decode,
+	},
+#endif
 };
 
 
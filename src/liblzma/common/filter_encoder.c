@@ -16,6 +16,7 @@
 #include "lzma2_encoder.h"
 #include "simple_encoder.h"
 #include "delta_encoder.h"
+#include "dedup_encoder.h"
 
 
 typedef struct {
@@ -147,6 +148,17 @@ static const lzma_filter_encoder encoders[] = {
 		.props_encode = &lzma_delta_props_encode,
 	},
 #endif
+#ifdef HAVE_ENCODER_DEDUP
+	{
+		.id = LZMA_FILTER_DEDUP,
+		.init = &lzma_dedup_encoder_init,
+		.memusage = &lzma_dedup_encoder_memusage,
+		.block_size = &lzma_dedup_block_size,
+		.props_size_get = NULL,
+		.props_size_fixed = LZMA_DEDUP_PROPS_SIZE,
+		.props_encode = &lzma_dedup_props_encode,
+	},
+#endif
 };
 
 
@@ -191,7 +203,8 @@ lzma_filters_update(lzma_stream *strm, const lzma_filter *filters)
 	reversed_filters[count].id = LZMA_VLI_UNKNOWN;
 
 	return strm->internal->next.update(strm->internal->next.coder,
-			strm->allocator, filters, reversed_filters);
+			lzma_strm_allocator(strm), filters,
+			reversed_filters);
 }
 
 
@@ -12,6 +12,7 @@
 
 #include "index.h"
 #include "stream_flags_common.h"
+#include "check.h"
 
 
 /// \brief      How many Records to allocate at once
@@ -21,8 +22,22 @@
 #define INDEX_GROUP_SIZE 512
 
 
+/// \brief      How many Records share one search key
+///
+/// Each group has a compact array of search keys after the Records: the
+/// uncompressed_sum of the last Record of every INDEX_KEY_INTERVAL Records.
+/// lzma_index_iter_locate() does a binary search on the keys first and
+/// then only within the INDEX_KEY_INTERVAL Records. With a huge group,
+/// this touches far fewer cache lines than a binary search on the Records.
+/// The keys can be filled in as the Records are appended.
+#define INDEX_KEY_INTERVAL 32
+
+
 /// \brief      How many Records can be allocated at once at maximum
-#define PREALLOC_MAX ((SIZE_MAX - sizeof(index_group)) / sizeof(index_record))
+///
+/// This leaves room for the search keys too.
+#define PREALLOC_MAX ((SIZE_MAX - sizeof(index_group)) \
+		/ (sizeof(index_record) + sizeof(lzma_vli)))
 
 
 /// \brief      Base structure for index_stream and index_group structures
@@ -99,11 +114,47 @@ typedef struct {
 	/// This is a flexible array, because it makes easy to optimize
 	/// memory usage in case someone concatenates many Streams that
 	/// have only one or few Blocks.
+	///
+	/// The search keys are stored after records[allocated - 1].
+	/// See INDEX_KEY_INTERVAL and group_keys().
 	index_record records[];
 
 } index_group;
 
 
+/// Get the size of an index_group that can hold the given number of Records
+/// and their search keys.
+static inline size_t
+index_group_size(size_t allocated)
+{
+	return sizeof(index_group) + allocated * sizeof(index_record)
+			+ allocated / INDEX_KEY_INTERVAL * sizeof(lzma_vli);
+}
+
+
+/// Get the search keys of the group. Only every complete run of
+/// INDEX_KEY_INTERVAL Records has a key, so there are
+/// (g->last + 1) / INDEX_KEY_INTERVAL keys in use.
+static inline lzma_vli *
+group_keys(const index_group *g)
+{
+	return (lzma_vli *)(g->records + g->allocated);
+}
+
+
+/// Set the search key if the Record at the given position is the last one
+/// of its INDEX_KEY_INTERVAL Records.
+static inline void
+group_set_key(index_group *g, size_t record)
+{
+	if ((record + 1) % INDEX_KEY_INTERVAL == 0)
+		group_keys(g)[record / INDEX_KEY_INTERVAL]
+				= g->records[record].uncompressed_sum;
+
+	return;
+}
+
+
 typedef struct {
 	/// Every index_stream is a node in the tree of Streams.
 	index_tree_node node;
@@ -457,8 +508,7 @@ lzma_index_memusage(lzma_vli streams, lzma_vli blocks)
 			+ sizeof(index_group) + 2 * alloc_overhead;
 
 	// Amount of memory needed per group.
-	const size_t group_base = sizeof(index_group)
-			+ INDEX_GROUP_SIZE * sizeof(index_record)
+	const size_t group_base = index_group_size(INDEX_GROUP_SIZE)
 			+ alloc_overhead;
 
 	// Number of groups. There may actually be more, but that overhead
@@ -675,9 +725,7 @@ lzma_index_append(lzma_index *i, const lzma_allocator *allocator,
 		++g->last;
 	} else {
 		// We need to allocate a new group.
-		g = lzma_alloc(sizeof(index_group)
-				+ i->prealloc * sizeof(index_record),
-				allocator);
+		g = lzma_alloc(index_group_size(i->prealloc), allocator);
 		if (g == NULL)
 			return LZMA_MEM_ERROR;
 
@@ -702,6 +750,7 @@ lzma_index_append(lzma_index *i, const lzma_allocator *allocator,
 			= uncompressed_base + uncompressed_size;
 	g->records[g->last].unpadded_sum
 			= compressed_base + unpadded_size;
+	group_set_key(g, g->last);
 
 	// Update the totals.
 	++s->record_count;
@@ -799,9 +848,8 @@ lzma_index_cat(lzma_index *restrict dest, lzma_index *restrict src,
 			assert(g->node.left == NULL);
 			assert(g->node.right == NULL);
 
-			index_group *newg = lzma_alloc(sizeof(index_group)
-					+ (g->last + 1)
-					* sizeof(index_record),
+			index_group *newg = lzma_alloc(
+					index_group_size(g->last + 1),
 					allocator);
 			if (newg == NULL)
 				return LZMA_MEM_ERROR;
@@ -813,6 +861,9 @@ lzma_index_cat(lzma_index *restrict dest, lzma_index *restrict src,
 
 			memcpy(newg->records, g->records, newg->allocated
 					* sizeof(index_record));
+			memcpy(group_keys(newg), group_keys(g),
+					newg->allocated / INDEX_KEY_INTERVAL
+					* sizeof(lzma_vli));
 
 			if (g->node.parent != NULL) {
 				assert(g->node.parent->right == &g->node);
@@ -888,9 +939,8 @@ index_dup_stream(const index_stream *src, const lzma_allocator *allocator)
 	// Allocate memory for the Records. We put all the Records into
 	// a single group. It's simplest and also tends to make
 	// lzma_index_locate() a little bit faster with very big Indexes.
-	index_group *destg = lzma_alloc(sizeof(index_group)
-			+ src->record_count * sizeof(index_record),
-			allocator);
+	index_group *destg = lzma_alloc(
+			index_group_size(src->record_count), allocator);
 	if (destg == NULL) {
 		index_stream_end(dest, allocator);
 		return NULL;
@@ -915,6 +965,12 @@ index_dup_stream(const index_stream *src, const lzma_allocator *allocator)
 
 	assert(i == destg->allocated);
 
+	// The search keys of the source groups cannot be copied because
+	// the groups don't need to be full.
+	for (i = INDEX_KEY_INTERVAL - 1; i < destg->allocated;
+			i += INDEX_KEY_INTERVAL)
+		group_set_key(destg, i);
+
 	// Add the group to the new Stream.
 	index_tree_append(&dest->groups, &destg->node);
 
@@ -956,6 +1012,263 @@ lzma_index_dup(const lzma_index *src, const lzma_allocator *allocator)
 }
 
 
+/// Magic bytes and format version of lzma_index_export() output
+static const uint8_t export_magic[8] = {
+	0xFD, 'X', 'Z', 'I', 'D', 'X', 0x00, 0x01
+};
+
+/// Sizes of the parts of lzma_index_export() output
+#define EXPORT_HEADER_SIZE 24
+#define EXPORT_STREAM_SIZE 32
+#define EXPORT_RECORD_SIZE 16
+#define EXPORT_CRC_SIZE 8
+
+
+extern LZMA_API(lzma_vli)
+lzma_index_export_size(const lzma_index *i)
+{
+	// This cannot overflow since the number of Records is limited
+	// by LZMA_BACKWARD_SIZE_MAX.
+	return EXPORT_HEADER_SIZE
+			+ (lzma_vli)(i->streams.count) * EXPORT_STREAM_SIZE
+			+ i->record_count * EXPORT_RECORD_SIZE
+			+ EXPORT_CRC_SIZE;
+}
+
+
+extern LZMA_API(lzma_ret)
+lzma_index_export(const lzma_index *i,
+		uint8_t *out, size_t *out_pos, size_t out_size)
+{
+	if (i == NULL || out == NULL || out_pos == NULL
+			|| *out_pos > out_size)
+		return LZMA_PROG_ERROR;
+
+	const lzma_vli size = lzma_index_export_size(i);
+	if (out_size - *out_pos < size)
+		return LZMA_BUF_ERROR;
+
+	out += *out_pos;
+
+	memcpy(out, export_magic, sizeof(export_magic));
+	write64le(out + 8, lzma_index_file_size(i));
+	write64le(out + 16, i->streams.count);
+	size_t pos = EXPORT_HEADER_SIZE;
+
+	const index_stream *s = (const index_stream *)(i->streams.leftmost);
+	do {
+		if (s->stream_flags.version == UINT32_MAX)
+			return LZMA_PROG_ERROR;
+
+		// Reconstruct the Stream Footer. The Backward Size
+		// isn't necessarily set in stream_flags.
+		lzma_stream_flags flags = s->stream_flags;
+		flags.backward_size = index_size(
+				s->record_count, s->index_list_size);
+		return_if_error(lzma_stream_footer_encode(&flags, out + pos));
+
+		write32le(out + pos + 12, 0);
+		write64le(out + pos + 16, s->stream_padding);
+		write64le(out + pos + 24, s->record_count);
+		pos += EXPORT_STREAM_SIZE;
+
+		const index_group *g = (const index_group *)(
+				s->groups.leftmost);
+		for (; g != NULL; g = index_tree_next(&g->node)) {
+			for (size_t j = 0; j <= g->last; ++j) {
+				write64le(out + pos,
+					g->records[j].uncompressed_sum);
+				write64le(out + pos + 8,
+					g->records[j].unpadded_sum);
+				pos += EXPORT_RECORD_SIZE;
+			}
+		}
+
+		s = index_tree_next(&s->node);
+	} while (s != NULL);
+
+	write32le(out + pos, lzma_crc32(out, pos, 0));
+	write32le(out + pos + 4, 0);
+	pos += EXPORT_CRC_SIZE;
+
+	assert(pos == size);
+	*out_pos += pos;
+	return LZMA_OK;
+}
+
+
+/// Build one Stream of lzma_index_import() input into *dest.
+/// in points to the beginning of the Stream in the input.
+static lzma_ret
+index_import_stream(lzma_index **dest, const lzma_allocator *allocator,
+		const uint8_t *in)
+{
+	lzma_stream_flags flags;
+	const lzma_ret ret = lzma_stream_footer_decode(&flags, in);
+	if (ret != LZMA_OK)
+		return ret == LZMA_OPTIONS_ERROR ? ret : LZMA_DATA_ERROR;
+
+	if (read32le(in + 12) != 0)
+		return LZMA_DATA_ERROR;
+
+	const lzma_vli stream_padding = read64le(in + 16);
+	const lzma_vli count = read64le(in + 24);
+	in += EXPORT_STREAM_SIZE;
+
+	lzma_index *i = lzma_index_init(allocator);
+	if (i == NULL)
+		return LZMA_MEM_ERROR;
+
+	// Put all Records into one group like lzma_index_decoder() does.
+	lzma_index_prealloc(i, count);
+
+	// lzma_index_append() validates the sizes. The cumulative sums
+	// must not decrease, and LZMA_PROG_ERROR means invalid sizes.
+	lzma_vli uncompressed_sum = 0;
+	lzma_vli unpadded_sum = 0;
+	for (lzma_vli j = 0; j < count; ++j) {
+		const lzma_vli new_uncompressed_sum = read64le(in);
+		const lzma_vli new_unpadded_sum = read64le(in + 8);
+		in += EXPORT_RECORD_SIZE;
+
+		if (new_uncompressed_sum < uncompressed_sum
+				|| new_unpadded_sum < unpadded_sum)
+			goto data_error;
+
+		unpadded_sum = vli_ceil4(unpadded_sum);
+		if (new_unpadded_sum < unpadded_sum)
+			goto data_error;
+
+		switch (lzma_index_append(i, allocator,
+				new_unpadded_sum - unpadded_sum,
+				new_uncompressed_sum - uncompressed_sum)) {
+		case LZMA_OK:
+			break;
+
+		case LZMA_MEM_ERROR:
+			lzma_index_end(i, allocator);
+			return LZMA_MEM_ERROR;
+
+		default:
+			goto data_error;
+		}
+
+		uncompressed_sum = new_uncompressed_sum;
+		unpadded_sum = new_unpadded_sum;
+	}
+
+	// The Stream Footer must match the Index of the Stream.
+	if (flags.backward_size != lzma_index_size(i)
+			|| lzma_index_stream_flags(i, &flags) != LZMA_OK
+			|| lzma_index_stream_padding(i, stream_padding)
+				!= LZMA_OK)
+		goto data_error;
+
+	if (*dest == NULL) {
+		*dest = i;
+		return LZMA_OK;
+	}
+
+	const lzma_ret cat_ret = lzma_index_cat(*dest, i, allocator);
+	if (cat_ret != LZMA_OK)
+		lzma_index_end(i, allocator);
+
+	return cat_ret;
+
+data_error:
+	lzma_index_end(i, allocator);
+	return LZMA_DATA_ERROR;
+}
+
+
+extern LZMA_API(lzma_ret)
+lzma_index_import(lzma_index **i, uint64_t *memlimit,
+		const lzma_allocator *allocator,
+		const uint8_t *in, size_t *in_pos, size_t in_size,
+		lzma_vli file_size)
+{
+	if (i == NULL || memlimit == NULL
+			|| in == NULL || in_pos == NULL || *in_pos > in_size)
+		return LZMA_PROG_ERROR;
+
+	*i = NULL;
+
+	in += *in_pos;
+	const size_t avail = in_size - *in_pos;
+
+	if (avail < EXPORT_HEADER_SIZE + EXPORT_CRC_SIZE)
+		return avail >= 6 && memcmp(in, export_magic, 6) == 0
+				? LZMA_DATA_ERROR : LZMA_FORMAT_ERROR;
+
+	if (memcmp(in, export_magic, 6) != 0)
+		return LZMA_FORMAT_ERROR;
+
+	if (memcmp(in + 6, export_magic + 6, 2) != 0)
+		return LZMA_OPTIONS_ERROR;
+
+	const lzma_vli stored_file_size = read64le(in + 8);
+	const lzma_vli stream_count = read64le(in + 16);
+	if ((file_size != LZMA_VLI_UNKNOWN && file_size != stored_file_size)
+			|| stream_count == 0 || stream_count > UINT32_MAX)
+		return LZMA_DATA_ERROR;
+
+	// Find the end of the input and count the Records so that the
+	// CRC32 and the memory usage can be checked before doing
+	// anything else. Only the Stream headers need to be read.
+	size_t pos = EXPORT_HEADER_SIZE;
+	lzma_vli record_count = 0;
+	for (lzma_vli j = 0; j < stream_count; ++j) {
+		if (avail - pos < EXPORT_STREAM_SIZE + EXPORT_CRC_SIZE)
+			return LZMA_DATA_ERROR;
+
+		const lzma_vli count = read64le(in + pos + 24);
+		pos += EXPORT_STREAM_SIZE;
+
+		if (count > (avail - pos - EXPORT_CRC_SIZE)
+				/ EXPORT_RECORD_SIZE)
+			return LZMA_DATA_ERROR;
+
+		pos += count * EXPORT_RECORD_SIZE;
+		record_count += count;
+	}
+
+	if (read32le(in + pos) != lzma_crc32(in, pos, 0)
+			|| read32le(in + pos + 4) != 0)
+		return LZMA_DATA_ERROR;
+
+	const uint64_t memusage = lzma_index_memusage(
+			stream_count, record_count);
+	if (memusage > *memlimit) {
+		*memlimit = memusage;
+		return LZMA_MEMLIMIT_ERROR;
+	}
+
+	// Build the Streams.
+	lzma_index *dest = NULL;
+	pos = EXPORT_HEADER_SIZE;
+	for (lzma_vli j = 0; j < stream_count; ++j) {
+		const lzma_ret ret = index_import_stream(
+				&dest, allocator, in + pos);
+		if (ret != LZMA_OK) {
+			lzma_index_end(dest, allocator);
+			return ret;
+		}
+
+		pos += EXPORT_STREAM_SIZE + read64le(in + pos + 24)
+				* EXPORT_RECORD_SIZE;
+	}
+
+	if (lzma_index_file_size(dest) != stored_file_size) {
+		lzma_index_end(dest, allocator);
+		return LZMA_DATA_ERROR;
+	}
+
+	*i = dest;
+	*in_pos += pos + EXPORT_CRC_SIZE;
+	return LZMA_OK;
+}
+
+
 /// Indexing for lzma_index_iter.internal[]
 enum {
 	ITER_INDEX,
@@ -1229,8 +1542,26 @@ lzma_index_iter_locate(lzma_index_iter *iter, lzma_vli target)
 	// This is because we want the rightmost Record that fulfills the
 	// search criterion. It is possible that there are empty Blocks;
 	// we don't want to return them.
+	//
+	// First find the INDEX_KEY_INTERVAL Records that contain it using
+	// the search keys. If no key is greater than target, the Record is
+	// among the last Records that don't have a key yet. Such Record
+	// must exist since the target is inside this group.
+	const lzma_vli *keys = group_keys(group);
 	size_t left = 0;
-	size_t right = group->last;
+	size_t right = (group->last + 1) / INDEX_KEY_INTERVAL;
+
+	while (left < right) {
+		const size_t pos = left + (right - left) / 2;
+		if (keys[pos] <= target)
+			left = pos + 1;
+		else
+			right = pos;
+	}
+
+	left *= INDEX_KEY_INTERVAL;
+	right = my_min(left + INDEX_KEY_INTERVAL - 1, group->last);
+	assert(left <= group->last);
 
 	while (left < right) {
 		const size_t pos = left + (right - left) / 2;
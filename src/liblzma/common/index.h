@@ -70,4 +70,17 @@ index_stream_size(lzma_vli blocks_size,
 			+ LZMA_STREAM_HEADER_SIZE;
 }
 
+
+/// Allocate a copy of lzma_index_hash. Returns NULL if allocation fails.
+extern lzma_index_hash *lzma_index_hash_dup(
+		const lzma_index_hash *index_hash,
+		const lzma_allocator *allocator);
+
+/// Tell that the Index has count Records before the ones of the Blocks
+/// that will be given to lzma_index_hash_append(). The skipped Records
+/// are validated only as far as possible without their Blocks. This must
+/// be called before lzma_index_hash_append().
+extern void lzma_index_hash_skip(lzma_index_hash *index_hash,
+		lzma_vli count);
+
 #endif
@@ -15,6 +15,11 @@
 #include "check.h"
 
 
+/// Size of the buffer where the Records are collected before hashing them.
+/// This must fit at least one Record.
+#define HASH_BUF_SIZE 256
+
+
 typedef struct {
 	/// Sum of the Block sizes (including Block Padding)
 	lzma_vli blocks_size;
@@ -31,6 +36,16 @@ typedef struct {
 	/// Check calculated from Unpadded Sizes and Uncompressed Sizes.
 	lzma_check_state check;
 
+	/// The Records that haven't been hashed yet, encoded like in
+	/// the List of Records. The encoding is unambiguous, so hashing
+	/// it detects differences as well as hashing the integers but
+	/// there are a lot fewer bytes to hash. Hashing many Records
+	/// at once also avoids the overhead of tiny updates.
+	uint8_t buf[HASH_BUF_SIZE];
+
+	/// Number of bytes in buf[]
+	size_t buf_pos;
+
 } lzma_index_hash_info;
 
 
@@ -51,6 +66,13 @@ struct lzma_index_hash_s {
 	/// Information collected from the Index field.
 	lzma_index_hash_info records;
 
+	/// Number of Records at the beginning of the Index that belong to
+	/// Blocks that weren't given to lzma_index_hash_append()
+	lzma_vli skip;
+
+	/// Size of the skipped Records in the List of Records as bytes
+	lzma_vli skip_list_size;
+
 	/// Number of Records not fully decoded
 	lzma_vli remaining;
 
@@ -84,10 +106,14 @@ lzma_index_hash_init(lzma_index_hash *index_hash,
 	index_hash->blocks.uncompressed_size = 0;
 	index_hash->blocks.count = 0;
 	index_hash->blocks.index_list_size = 0;
+	index_hash->blocks.buf_pos = 0;
 	index_hash->records.blocks_size = 0;
 	index_hash->records.uncompressed_size = 0;
 	index_hash->records.count = 0;
 	index_hash->records.index_list_size = 0;
+	index_hash->records.buf_pos = 0;
+	index_hash->skip = 0;
+	index_hash->skip_list_size = 0;
 	index_hash->unpadded_size = 0;
 	index_hash->uncompressed_size = 0;
 	index_hash->pos = 0;
@@ -101,6 +127,31 @@ lzma_index_hash_init(lzma_index_hash *index_hash,
 }
 
 
+extern lzma_index_hash *
+lzma_index_hash_dup(const lzma_index_hash *index_hash,
+		const lzma_allocator *allocator)
+{
+	lzma_index_hash *dest = lzma_alloc(sizeof(lzma_index_hash),
+			allocator);
+	if (dest != NULL)
+		*dest = *index_hash;
+
+	return dest;
+}
+
+
+extern void
+lzma_index_hash_skip(lzma_index_hash *index_hash, lzma_vli count)
+{
+	assert(index_hash->sequence == SEQ_BLOCK);
+	assert(index_hash->blocks.count == 0);
+	assert(count <= LZMA_VLI_MAX);
+
+	index_hash->skip = count;
+	return;
+}
+
+
 extern LZMA_API(void)
 lzma_index_hash_end(lzma_index_hash *index_hash,
 		const lzma_allocator *allocator)
@@ -115,26 +166,47 @@ lzma_index_hash_size(const lzma_index_hash *index_hash)
 {
 	// Get the size of the Index from ->blocks instead of ->records for
 	// cases where application wants to know the Index Size before
-	// decoding the Index.
-	return index_size(index_hash->blocks.count,
-			index_hash->blocks.index_list_size);
+	// decoding the Index. The size of the skipped Records is known
+	// only after they have been decoded.
+	return index_size(index_hash->skip + index_hash->blocks.count,
+			index_hash->skip_list_size
+				+ index_hash->blocks.index_list_size);
+}
+
+
+/// Hashes the Records collected into info->buf.
+static void
+hash_flush(lzma_index_hash_info *info)
+{
+	lzma_check_update(&info->check, LZMA_CHECK_BEST,
+			info->buf, info->buf_pos);
+	info->buf_pos = 0;
+	return;
 }
 
 
 /// Updates the sizes and the hash without any validation.
+/// The sizes must not exceed LZMA_VLI_MAX.
 static void
 hash_append(lzma_index_hash_info *info, lzma_vli unpadded_size,
 		lzma_vli uncompressed_size)
 {
 	info->blocks_size += vli_ceil4(unpadded_size);
 	info->uncompressed_size += uncompressed_size;
-	info->index_list_size += lzma_vli_size(unpadded_size)
-			+ lzma_vli_size(uncompressed_size);
 	++info->count;
 
-	const lzma_vli sizes[2] = { unpadded_size, uncompressed_size };
-	lzma_check_update(&info->check, LZMA_CHECK_BEST,
-			(const uint8_t *)(sizes), sizeof(sizes));
+	if (HASH_BUF_SIZE - info->buf_pos < 2 * LZMA_VLI_BYTES_MAX)
+		hash_flush(info);
+
+	// These cannot fail since the sizes are valid and
+	// there is enough space in info->buf.
+	const size_t buf_start = info->buf_pos;
+	(void)lzma_vli_encode(unpadded_size, NULL,
+			info->buf, &info->buf_pos, HASH_BUF_SIZE);
+	(void)lzma_vli_encode(uncompressed_size, NULL,
+			info->buf, &info->buf_pos, HASH_BUF_SIZE);
+
+	info->index_list_size += info->buf_pos - buf_start;
 
 	return;
 }
@@ -203,7 +275,8 @@ lzma_index_hash_decode(lzma_index_hash *index_hash, const uint8_t *in,
 			goto out;
 
 		// The count must match the count of the Blocks decoded.
-		if (index_hash->remaining != index_hash->blocks.count)
+		if (index_hash->remaining != index_hash->skip
+				+ index_hash->blocks.count)
 			return LZMA_DATA_ERROR;
 
 		ret = LZMA_OK;
@@ -236,6 +309,22 @@ lzma_index_hash_decode(lzma_index_hash *index_hash, const uint8_t *in,
 				return LZMA_DATA_ERROR;
 
 			index_hash->sequence = SEQ_UNCOMPRESSED;
+		} else if (index_hash->remaining
+				> index_hash->blocks.count) {
+			// The Block of this Record wasn't seen, so only
+			// its size in the Index can be used.
+			index_hash->skip_list_size += lzma_vli_size(
+					index_hash->unpadded_size)
+					+ lzma_vli_size(
+					index_hash->uncompressed_size);
+
+			if (index_size(index_hash->skip,
+					index_hash->skip_list_size)
+					> LZMA_BACKWARD_SIZE_MAX)
+				return LZMA_DATA_ERROR;
+
+			index_hash->sequence = --index_hash->remaining == 0
+					? SEQ_PADDING_INIT : SEQ_UNPADDED;
 		} else {
 			// Update the hash.
 			hash_append(&index_hash->records,
@@ -266,8 +355,9 @@ lzma_index_hash_decode(lzma_index_hash *index_hash, const uint8_t *in,
 
 	case SEQ_PADDING_INIT:
 		index_hash->pos = (LZMA_VLI_C(4) - index_size_unpadded(
-				index_hash->records.count,
-				index_hash->records.index_list_size)) & 3;
+				index_hash->skip + index_hash->records.count,
+				index_hash->skip_list_size
+				+ index_hash->records.index_list_size)) & 3;
 		index_hash->sequence = SEQ_PADDING;
 
 	// Fall through
@@ -291,6 +381,8 @@ lzma_index_hash_decode(lzma_index_hash *index_hash, const uint8_t *in,
 			return LZMA_DATA_ERROR;
 
 		// Finish the hashes and compare them.
+		hash_flush(&index_hash->blocks);
+		hash_flush(&index_hash->records);
 		lzma_check_finish(&index_hash->blocks.check, LZMA_CHECK_BEST);
 		lzma_check_finish(&index_hash->records.check, LZMA_CHECK_BEST);
 		if (memcmp(index_hash->blocks.check.buffer.u8,
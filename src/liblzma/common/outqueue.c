@@ -39,17 +39,24 @@ lzma_outq_memusage(uint64_t buf_size_max, uint32_t threads)
 }
 
 
+/// Move buf from the head...tail list to the cache. prev is the buffer
+/// before buf in the list or NULL if buf is the head.
 static void
-move_head_to_cache(lzma_outq *outq, const lzma_allocator *allocator)
+move_to_cache(lzma_outq *outq, const lzma_allocator *allocator,
+		lzma_outbuf *prev, lzma_outbuf *buf)
 {
 	assert(outq->head != NULL);
 	assert(outq->tail != NULL);
 	assert(outq->bufs_in_use > 0);
+	assert(prev == NULL ? buf == outq->head : buf == prev->next);
 
-	lzma_outbuf *buf = outq->head;
-	outq->head = buf->next;
-	if (outq->head == NULL)
-		outq->tail = NULL;
+	if (prev == NULL)
+		outq->head = buf->next;
+	else
+		prev->next = buf->next;
+
+	if (outq->tail == buf)
+		outq->tail = prev;
 
 	if (outq->cache != NULL && outq->cache->allocated != buf->allocated)
 		lzma_outq_clear_cache(outq, allocator);
@@ -60,6 +67,15 @@ move_head_to_cache(lzma_outq *outq, const lzma_allocator *allocator)
 	--outq->bufs_in_use;
 	outq->mem_in_use -= lzma_outq_outbuf_memusage(buf->allocated);
 
+	lzma_probe3(outq_release, outq, buf, outq->bufs_in_use);
+	return;
+}
+
+
+static void
+move_head_to_cache(lzma_outq *outq, const lzma_allocator *allocator)
+{
+	move_to_cache(outq, allocator, NULL, outq->head);
 	return;
 }
 
@@ -213,6 +229,7 @@ lzma_outq_get_buf(lzma_outq *outq, void *worker)
 	++outq->bufs_in_use;
 	outq->mem_in_use += lzma_outq_outbuf_memusage(buf->allocated);
 
+	lzma_probe3(outq_acquire, outq, buf, outq->bufs_in_use);
 	return buf;
 }
 
@@ -271,6 +288,39 @@ lzma_outq_read(lzma_outq *restrict outq,
 }
 
 
+extern void
+lzma_outq_release_finished(lzma_outq *outq,
+		const lzma_allocator *allocator)
+{
+	// Nothing is read from the buffers so read_pos must stay zero.
+	assert(outq->read_pos == 0);
+
+	bool error_kept = false;
+	lzma_outbuf *prev = NULL;
+	lzma_outbuf *buf = outq->head;
+
+	while (buf != NULL) {
+		lzma_outbuf *next = buf->next;
+		assert(buf->pos == 0);
+
+		if (buf->finished && (error_kept
+				|| buf->finish_ret == LZMA_STREAM_END)) {
+			move_to_cache(outq, allocator, prev, buf);
+		} else {
+			// Keep the unfinished buffers and the first error.
+			if (buf->finished)
+				error_kept = true;
+
+			prev = buf;
+		}
+
+		buf = next;
+	}
+
+	return;
+}
+
+
 extern void
 lzma_outq_enable_partial_output(lzma_outq *outq,
 		void (*enable_partial_output)(void *worker))
@@ -210,6 +210,22 @@ extern lzma_ret lzma_outq_read(lzma_outq *restrict outq,
 		lzma_vli *restrict uncompressed_size);
 
 
+/// \brief      Release the finished buffers without reading them
+///
+/// This is for decoders that don't put any data into the buffers and
+/// only use them to track the Blocks in progress. The finished buffers
+/// are moved to the cache even if the buffers before them in the queue
+/// haven't finished yet. Only the first buffer whose finish_ret isn't
+/// LZMA_STREAM_END is kept so that lzma_outq_read() returns the first
+/// error in the order of the queue.
+///
+/// \note       This reads lzma_outbuf.finished variables and thus
+///             calls to this function need to be protected with a mutex.
+///
+extern void lzma_outq_release_finished(lzma_outq *outq,
+		const lzma_allocator *allocator);
+
+
 /// \brief      Enable partial output from a worker thread
 ///
 /// If the buffer at the head of the output queue isn't finished,
@@ -40,6 +40,66 @@ lzma_stream_buffer_bound(size_t uncompressed_size)
 }
 
 
+/// If the LZMA2 dictionary is bigger than the input, make *filters_fit
+/// a copy of the filter chain that uses a smaller dictionary. This saves
+/// both memory and the time needed to clear the match finder hash tables.
+/// The dictionary size is rounded up to 2^n or 2^n + 2^(n-1) bytes which
+/// LZMA2 can store exactly in its properties. A smaller dictionary also
+/// lowers the memory needed to decompress the Stream.
+///
+/// \return     Filter chain to use: either filters or filters_fit.
+static const lzma_filter *
+fit_dict_size(const lzma_filter *filters, lzma_filter *filters_fit,
+		lzma_options_lzma *opt_fit, size_t in_size)
+{
+	// filters_fit[] has room for LZMA_FILTERS_MAX filters and
+	// the terminator. If LZMA2 isn't among them, the chain is left
+	// as is, and the Block encoder rejects it if it is too long.
+	size_t i = 0;
+	while (filters[i].id != LZMA_FILTER_LZMA2) {
+		if (filters[i].id == LZMA_VLI_UNKNOWN
+				|| i + 1 == LZMA_FILTERS_MAX)
+			return filters;
+
+		++i;
+	}
+
+	// Leave invalid chains for the Block encoder to reject.
+	const lzma_options_lzma *opt = filters[i].options;
+	if (opt == NULL || filters[i + 1].id != LZMA_VLI_UNKNOWN)
+		return filters;
+
+	uint64_t size = in_size;
+	if (opt->preset_dict != NULL)
+		size += opt->preset_dict_size;
+
+	if (size >= opt->dict_size)
+		return filters;
+
+	uint32_t d = LZMA_DICT_SIZE_MIN;
+	while (d < size) {
+		if (d / 2 * 3 >= size) {
+			d = d / 2 * 3;
+			break;
+		}
+
+		d <<= 1;
+	}
+
+	if (d >= opt->dict_size)
+		return filters;
+
+	// Copy the chain including the terminating LZMA_VLI_UNKNOWN.
+	memcpy(filters_fit, filters, (i + 2) * sizeof(lzma_filter));
+
+	*opt_fit = *opt;
+	opt_fit->dict_size = d;
+	filters_fit[i].options = opt_fit;
+
+	return filters_fit;
+}
+
+
 extern LZMA_API(lzma_ret)
 lzma_stream_buffer_encode(lzma_filter *filters, lzma_check check,
 		const lzma_allocator *allocator,
@@ -86,10 +146,15 @@ lzma_stream_buffer_encode(lzma_filter *filters, lzma_check check,
 	out_pos += LZMA_STREAM_HEADER_SIZE;
 
 	// Encode a Block but only if there is at least one byte of input.
+	// The size of the input is known so the dictionary doesn't need
+	// to be bigger than that.
+	lzma_filter filters_fit[LZMA_FILTERS_MAX + 1];
+	lzma_options_lzma opt_fit;
 	lzma_block block = {
 		.version = 0,
 		.check = check,
-		.filters = filters,
+		.filters = (lzma_filter *)(fit_dict_size(
+				filters, filters_fit, &opt_fit, in_size)),
 	};
 
 	if (in_size > 0)
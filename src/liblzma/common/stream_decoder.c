@@ -12,6 +12,7 @@
 
 #include "stream_decoder.h"
 #include "block_decoder.h"
+#include "index.h"
 
 
 typedef struct {
@@ -22,6 +23,7 @@ typedef struct {
 		SEQ_INDEX,
 		SEQ_STREAM_FOOTER,
 		SEQ_STREAM_PADDING,
+		SEQ_STREAM_END,
 	} sequence;
 
 	/// Block or Metadata decoder. This takes little memory and the same
@@ -46,6 +48,9 @@ typedef struct {
 	/// Amount of memory actually needed (only an estimate)
 	uint64_t memusage;
 
+	/// Statistics for lzma_get_stats()
+	lzma_stats stats;
+
 	/// If true, LZMA_NO_CHECK is returned if the Stream has
 	/// no integrity check.
 	bool tell_no_check;
@@ -74,6 +79,13 @@ typedef struct {
 	/// bytes.
 	bool first_stream;
 
+	/// Position of the decoder at the latest Block or Stream boundary
+	lzma_stream_position position;
+
+	/// If not NULL, position is copied here at every boundary so that
+	/// the application can use it to resume decoding later.
+	lzma_stream_position *position_dest;
+
 	/// Write position in buffer[] and position in Stream Padding
 	size_t pos;
 
@@ -99,6 +111,17 @@ stream_decoder_reset(lzma_stream_coder *coder, const lzma_allocator *allocator)
 }
 
 
+/// Update the position after a Block or Stream boundary has been passed.
+static void
+position_update(lzma_stream_coder *coder)
+{
+	if (coder->position_dest != NULL)
+		*coder->position_dest = coder->position;
+
+	return;
+}
+
+
 static lzma_ret
 stream_decode(void *coder_ptr, const lzma_allocator *allocator,
 		const uint8_t *restrict in, size_t *restrict in_pos,
@@ -138,6 +161,11 @@ stream_decode(void *coder_ptr, const lzma_allocator *allocator,
 		// decoders see it.
 		coder->block_options.check = coder->stream_flags.check;
 
+		coder->position.stream_flags = coder->stream_flags;
+		coder->position.block_count = 0;
+		coder->position.in_offset += LZMA_STREAM_HEADER_SIZE;
+		position_update(coder);
+
 		// Even if we return LZMA_*_CHECK below, we want
 		// to continue from Block Header decoding.
 		coder->sequence = SEQ_BLOCK_HEADER;
@@ -219,6 +247,8 @@ stream_decode(void *coder_ptr, const lzma_allocator *allocator,
 			// lzma_memusage() to return UINT64_MAX in case of
 			// invalid filter chain.
 			coder->memusage = memusage;
+			coder->stats.memusage_peak = my_max(
+					coder->stats.memusage_peak, memusage);
 
 			if (memusage > coder->memlimit) {
 				// The chain would need too much memory.
@@ -251,10 +281,12 @@ stream_decode(void *coder_ptr, const lzma_allocator *allocator,
 	// Fall through
 
 	case SEQ_BLOCK: {
+		// LZMA_FULL_FLUSH only tells where to stop. The Block
+		// decoder doesn't need to know about it.
 		const lzma_ret ret = coder->block_decoder.code(
 				coder->block_decoder.coder, allocator,
 				in, in_pos, in_size, out, out_pos, out_size,
-				action);
+				action == LZMA_FINISH ? LZMA_FINISH : LZMA_RUN);
 
 		if (ret != LZMA_STREAM_END)
 			return ret;
@@ -266,7 +298,22 @@ stream_decode(void *coder_ptr, const lzma_allocator *allocator,
 					&coder->block_options),
 				coder->block_options.uncompressed_size));
 
+		lzma_stats_block(&coder->stats, coder->block_options.check,
+				coder->block_options.uncompressed_size,
+				coder->ignore_check);
+
+		coder->position.in_offset += lzma_block_total_size(
+				&coder->block_options);
+		coder->position.out_offset
+				+= coder->block_options.uncompressed_size;
+		++coder->position.block_count;
+		position_update(coder);
+
 		coder->sequence = SEQ_BLOCK_HEADER;
+
+		if (action == LZMA_FULL_FLUSH)
+			return LZMA_STREAM_END;
+
 		break;
 	}
 
@@ -321,10 +368,20 @@ stream_decode(void *coder_ptr, const lzma_allocator *allocator,
 		return_if_error(lzma_stream_flags_compare(
 				&coder->stream_flags, &footer_flags));
 
-		if (!coder->concatenated)
+		coder->position.in_offset += footer_flags.backward_size
+				+ LZMA_STREAM_HEADER_SIZE;
+		coder->position.block_count = LZMA_VLI_UNKNOWN;
+		position_update(coder);
+
+		if (!coder->concatenated) {
+			coder->sequence = SEQ_STREAM_END;
 			return LZMA_STREAM_END;
+		}
 
 		coder->sequence = SEQ_STREAM_PADDING;
+
+		if (action == LZMA_FULL_FLUSH)
+			return LZMA_STREAM_END;
 	}
 
 	// Fall through
@@ -354,6 +411,13 @@ stream_decode(void *coder_ptr, const lzma_allocator *allocator,
 
 			++*in_pos;
 			coder->pos = (coder->pos + 1) & 3;
+
+			// Stream Padding is a valid place to resume only
+			// at multiples of four bytes.
+			if (coder->pos == 0) {
+				coder->position.in_offset += 4;
+				position_update(coder);
+			}
 		}
 
 		// Stream Padding must be a multiple of four bytes (empty
@@ -367,6 +431,11 @@ stream_decode(void *coder_ptr, const lzma_allocator *allocator,
 		return_if_error(stream_decoder_reset(coder, allocator));
 		break;
 
+	case SEQ_STREAM_END:
+		// This is reached only if LZMA_FULL_FLUSH was used when
+		// the end of the Stream was reached.
+		return LZMA_STREAM_END;
+
 	default:
 		assert(0);
 		return LZMA_PROG_ERROR;
@@ -387,6 +456,45 @@ stream_decoder_end(void *coder_ptr, const lzma_allocator *allocator)
 }
 
 
+static lzma_ret
+stream_decoder_copy(const void *coder_ptr, void **dest_ptr,
+		const lzma_allocator *allocator)
+{
+	const lzma_stream_coder *coder = coder_ptr;
+
+	lzma_stream_coder *dest = lzma_alloc(sizeof(lzma_stream_coder),
+			allocator);
+	if (dest == NULL)
+		return LZMA_MEM_ERROR;
+
+	*dest = *coder;
+	dest->block_decoder = LZMA_NEXT_CODER_INIT;
+
+	// The application's lzma_stream_position belongs to the original.
+	dest->position_dest = NULL;
+
+	dest->index_hash = lzma_index_hash_dup(coder->index_hash, allocator);
+	if (dest->index_hash == NULL) {
+		lzma_free(dest, allocator);
+		return LZMA_MEM_ERROR;
+	}
+
+	const lzma_ret ret = lzma_next_copy(&dest->block_decoder, allocator,
+			&coder->block_decoder);
+	if (ret != LZMA_OK) {
+		stream_decoder_end(dest, allocator);
+		return ret;
+	}
+
+	if (dest->block_decoder.coder != NULL)
+		lzma_block_decoder_set_block(&dest->block_decoder,
+				&dest->block_options);
+
+	*dest_ptr = dest;
+	return LZMA_OK;
+}
+
+
 static lzma_check
 stream_decoder_get_check(const void *coder_ptr)
 {
@@ -395,6 +503,15 @@ stream_decoder_get_check(const void *coder_ptr)
 }
 
 
+static void
+stream_decoder_get_stats(void *coder_ptr, lzma_stats *stats)
+{
+	const lzma_stream_coder *coder = coder_ptr;
+	lzma_stats_add(stats, &coder->stats);
+	return;
+}
+
+
 static lzma_ret
 stream_decoder_memconfig(void *coder_ptr, uint64_t *memusage,
 		uint64_t *old_memlimit, uint64_t new_memlimit)
@@ -415,16 +532,39 @@ stream_decoder_memconfig(void *coder_ptr, uint64_t *memusage,
 }
 
 
-extern lzma_ret
-lzma_stream_decoder_init(
+static lzma_ret
+stream_decoder_resume_init(
 		lzma_next_coder *next, const lzma_allocator *allocator,
-		uint64_t memlimit, uint32_t flags)
+		uint64_t memlimit, uint32_t flags,
+		lzma_stream_position *position)
 {
 	lzma_next_coder_init(&lzma_stream_decoder_init, next, allocator);
 
 	if (flags & ~LZMA_SUPPORTED_FLAGS)
 		return LZMA_OPTIONS_ERROR;
 
+	// Every boundary in a .xz file is at a multiple of four bytes.
+	if (position != NULL && (position->in_offset > LZMA_VLI_MAX
+			|| (position->in_offset & 3) != 0
+			|| position->out_offset > LZMA_VLI_MAX
+			|| (position->block_count > LZMA_VLI_MAX
+				&& position->block_count
+					!= LZMA_VLI_UNKNOWN)))
+		return LZMA_PROG_ERROR;
+
+	// In the middle of a Stream the Stream Flags are needed because
+	// the Stream Header won't be seen.
+	const bool in_stream = position != NULL
+			&& position->block_count != LZMA_VLI_UNKNOWN;
+	if (in_stream) {
+		if (position->stream_flags.version != 0)
+			return LZMA_OPTIONS_ERROR;
+
+		if ((unsigned int)(position->stream_flags.check)
+				> LZMA_CHECK_ID_MAX)
+			return LZMA_PROG_ERROR;
+	}
+
 	lzma_stream_coder *coder = next->coder;
 	if (coder == NULL) {
 		coder = lzma_alloc(sizeof(lzma_stream_coder), allocator);
@@ -434,7 +574,9 @@ lzma_stream_decoder_init(
 		next->coder = coder;
 		next->code = &stream_decode;
 		next->end = &stream_decoder_end;
+		next->copy = &stream_decoder_copy;
 		next->get_check = &stream_decoder_get_check;
+		next->get_stats = &stream_decoder_get_stats;
 		next->memconfig = &stream_decoder_memconfig;
 
 		coder->block_decoder = LZMA_NEXT_CODER_INIT;
@@ -443,6 +585,7 @@ lzma_stream_decoder_init(
 
 	coder->memlimit = my_max(1, memlimit);
 	coder->memusage = LZMA_MEMUSAGE_BASE;
+	memzero(&coder->stats, sizeof(coder->stats));
 	coder->tell_no_check = (flags & LZMA_TELL_NO_CHECK) != 0;
 	coder->tell_unsupported_check
 			= (flags & LZMA_TELL_UNSUPPORTED_CHECK) != 0;
@@ -450,8 +593,48 @@ lzma_stream_decoder_init(
 	coder->ignore_check = (flags & LZMA_IGNORE_CHECK) != 0;
 	coder->concatenated = (flags & LZMA_CONCATENATED) != 0;
 	coder->first_stream = true;
+	coder->position_dest = position;
+
+	if (position == NULL) {
+		coder->position.in_offset = 0;
+		coder->position.out_offset = 0;
+		coder->position.block_count = LZMA_VLI_UNKNOWN;
+		return stream_decoder_reset(coder, allocator);
+	}
+
+	coder->position = *position;
+	return_if_error(stream_decoder_reset(coder, allocator));
+
+	if (in_stream) {
+		// Continue from the next Block Header or the Index.
+		// Only the Records of the Blocks decoded from here on
+		// can be compared against the Index.
+		coder->stream_flags = position->stream_flags;
+		coder->stream_flags.backward_size = LZMA_VLI_UNKNOWN;
+		coder->block_options.check = coder->stream_flags.check;
+		lzma_index_hash_skip(coder->index_hash,
+				position->block_count);
+		coder->first_stream = false;
+		coder->sequence = SEQ_BLOCK_HEADER;
+
+	} else if (position->in_offset != 0) {
+		// Between Streams there may be Stream Padding.
+		coder->first_stream = false;
+		if (coder->concatenated)
+			coder->sequence = SEQ_STREAM_PADDING;
+	}
 
-	return stream_decoder_reset(coder, allocator);
+	return LZMA_OK;
+}
+
+
+extern lzma_ret
+lzma_stream_decoder_init(
+		lzma_next_coder *next, const lzma_allocator *allocator,
+		uint64_t memlimit, uint32_t flags)
+{
+	return stream_decoder_resume_init(next, allocator, memlimit, flags,
+			NULL);
 }
 
 
@@ -461,7 +644,28 @@ lzma_stream_decoder(lzma_stream *strm, uint64_t memlimit, uint32_t flags)
 	lzma_next_strm_init(lzma_stream_decoder_init, strm, memlimit, flags);
 
 	strm->internal->supported_actions[LZMA_RUN] = true;
+	strm->internal->supported_actions[LZMA_FULL_FLUSH] = true;
+	strm->internal->supported_actions[LZMA_FINISH] = true;
+	strm->internal->flush_input_may_change = true;
+
+	return LZMA_OK;
+}
+
+
+extern LZMA_API(lzma_ret)
+lzma_stream_decoder_resume(lzma_stream *strm, uint64_t memlimit,
+		uint32_t flags, lzma_stream_position *position)
+{
+	if (position == NULL)
+		return LZMA_PROG_ERROR;
+
+	lzma_next_strm_init(stream_decoder_resume_init, strm,
+			memlimit, flags, position);
+
+	strm->internal->supported_actions[LZMA_RUN] = true;
+	strm->internal->supported_actions[LZMA_FULL_FLUSH] = true;
 	strm->internal->supported_actions[LZMA_FINISH] = true;
+	strm->internal->flush_input_may_change = true;
 
 	return LZMA_OK;
 }
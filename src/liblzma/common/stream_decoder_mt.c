@@ -18,6 +18,12 @@
 #include "outqueue.h"
 
 
+/// Size of the buffer into which the uncompressed data is decoded and
+/// then discarded with LZMA_VERIFY_ONLY. This is small enough to stay
+/// in the CPU cache while the Block decoder calculates the check.
+#define VERIFY_BUF_SIZE 16384
+
+
 typedef enum {
 	/// Waiting for work.
 	/// Main thread may change this to THR_RUN or THR_EXIT.
@@ -91,8 +97,17 @@ struct worker_thread {
 	const lzma_allocator *allocator;
 
 	/// Output queue buffer to which the uncompressed data is written.
+	/// With LZMA_VERIFY_ONLY this has no space for data and is
+	/// used only to pass the result of the Block to the main thread.
 	lzma_outbuf *outbuf;
 
+	/// With LZMA_VERIFY_ONLY the uncompressed data is written here
+	/// instead of outbuf. Otherwise this is NULL.
+	uint8_t *verify_buf;
+
+	/// Uncompressed offset of the Block for coder->output.write()
+	uint64_t out_offset;
+
 	/// Amount of compressed data that has already been decompressed.
 	/// This is updated from in_pos when our mutex is locked.
 	/// This is size_t, not uint64_t, because per-thread progress
@@ -102,6 +117,11 @@ struct worker_thread {
 	/// Like progress_in but for uncompressed data.
 	size_t progress_out;
 
+	/// Time spent in the Block decoder and waiting for work or input.
+	/// These are moved to coder->stats when a Block has been finished.
+	uint64_t busy_ns;
+	uint64_t idle_ns;
+
 	/// Updating outbuf->pos requires locking the main mutex
 	/// (coder->mutex). Since the main thread will only read output
 	/// from the oldest outbuf in the queue, only the worker thread
@@ -202,9 +222,11 @@ struct lzma_stream_coder {
 	/// created so far.
 	uint32_t threads_initialized;
 
-	/// Array of allocated thread-specific structures. When no threads
-	/// are in use (direct mode) this is NULL. In threaded mode this
-	/// points to an array of threads_max number of worker_thread structs.
+	/// Array of allocated thread-specific structures. This is NULL until
+	/// the first worker thread is created. After that this points to
+	/// an array of threads_max number of worker_thread structs. The
+	/// threads are kept while Blocks are decoded in direct mode so that
+	/// the threaded mode can continue cheaply after such a Block.
 	struct worker_thread *threads;
 
 	/// Stack of free threads. When a thread finishes, it puts itself
@@ -231,6 +253,23 @@ struct lzma_stream_coder {
 	/// Single-threaded mode can exceed this even by a large amount.
 	uint64_t memlimit_threading;
 
+	/// Buffer for the direct mode decoder with LZMA_VERIFY_ONLY.
+	/// This is allocated when needed for the first time.
+	uint8_t *verify_buf;
+
+	/// Callback of lzma_stream_decoder_mt_unordered(). When it is used,
+	/// verify_only is true and the data decoded into the verify_bufs
+	/// is passed to output.write(). Otherwise output.write is NULL.
+	lzma_unordered_output output;
+
+	/// Uncompressed offset of the next Block for output.write()
+	uint64_t uncompressed_offset;
+
+	/// Statistics for lzma_get_stats()
+	///
+	/// \note       Use mutex.
+	lzma_stats stats;
+
 	/// Memory usage limit that should never be exceeded.
 	/// LZMA_MEMLIMIT_ERROR will be returned if decoding isn't possible
 	/// even in single-threaded mode without exceeding this limit.
@@ -304,6 +343,10 @@ struct lzma_stream_coder {
 	/// producing all output before the location of the error.
 	bool fail_fast;
 
+	/// If true, the uncompressed data is only verified and then
+	/// discarded. No output is produced.
+	bool verify_only;
+
 
 	/// When decoding concatenated Streams, this is true as long as we
 	/// are decoding the first Stream. This is needed to avoid misleading
@@ -382,7 +425,9 @@ next_loop_lock:
 next_loop_unlocked:
 
 	if (thr->state == THR_IDLE) {
+		const uint64_t idle_start = mythread_time_ns(&thr->cond);
 		mythread_cond_wait(&thr->cond, &thr->mutex);
+		thr->idle_ns += mythread_time_ns(&thr->cond) - idle_start;
 		goto next_loop_unlocked;
 	}
 
@@ -390,6 +435,7 @@ next_loop_unlocked:
 		mythread_mutex_unlock(&thr->mutex);
 
 		lzma_free(thr->in, thr->allocator);
+		lzma_free(thr->verify_buf, thr->allocator);
 		lzma_next_end(&thr->block_decoder, thr->allocator);
 
 		mythread_mutex_destroy(&thr->mutex);
@@ -400,6 +446,7 @@ next_loop_unlocked:
 
 	if (thr->state == THR_STOP) {
 		thr->state = THR_IDLE;
+		lzma_probe2(decoder_worker_state, thr, THR_IDLE);
 		mythread_mutex_unlock(&thr->mutex);
 
 		mythread_sync(thr->coder->mutex) {
@@ -424,7 +471,9 @@ next_loop_unlocked:
 	partial_update = thr->partial_update;
 
 	if (in_filled == thr->in_pos && partial_update != PARTIAL_START) {
+		const uint64_t idle_start = mythread_time_ns(&thr->cond);
 		mythread_cond_wait(&thr->cond, &thr->mutex);
+		thr->idle_ns += mythread_time_ns(&thr->cond) - idle_start;
 		goto next_loop_unlocked;
 	}
 
@@ -438,11 +487,42 @@ next_loop_unlocked:
 	if ((in_filled - thr->in_pos) > chunk_size)
 		in_filled = thr->in_pos + chunk_size;
 
-	ret = thr->block_decoder.code(
-			thr->block_decoder.coder, thr->allocator,
-			thr->in, &thr->in_pos, in_filled,
-			thr->outbuf->buf, &thr->out_pos,
-			thr->outbuf->allocated, LZMA_RUN);
+	const uint64_t busy_start = mythread_time_ns(&thr->cond);
+
+	if (thr->verify_buf == NULL) {
+		ret = thr->block_decoder.code(
+				thr->block_decoder.coder, thr->allocator,
+				thr->in, &thr->in_pos, in_filled,
+				thr->outbuf->buf, &thr->out_pos,
+				thr->outbuf->allocated, LZMA_RUN);
+	} else {
+		// With LZMA_VERIFY_ONLY the data is decoded into a small
+		// buffer and thrown away. The Block decoder still verifies
+		// the check and the sizes. Keep decoding until the buffer
+		// isn't filled so that all output possible from this input
+		// has been decoded before we wait for more input.
+		size_t verify_pos;
+		do {
+			verify_pos = 0;
+			ret = thr->block_decoder.code(
+					thr->block_decoder.coder,
+					thr->allocator,
+					thr->in, &thr->in_pos, in_filled,
+					thr->verify_buf, &verify_pos,
+					VERIFY_BUF_SIZE, LZMA_RUN);
+
+			if (verify_pos > 0 && thr->coder->output.write
+					!= NULL)
+				thr->coder->output.write(
+						thr->coder->output.opaque,
+						thr->out_offset + thr->out_pos,
+						thr->verify_buf, verify_pos);
+
+			thr->out_pos += verify_pos;
+		} while (ret == LZMA_OK && verify_pos == VERIFY_BUF_SIZE);
+	}
+
+	thr->busy_ns += mythread_time_ns(&thr->cond) - busy_start;
 
 	if (ret == LZMA_OK) {
 		if (partial_update != PARTIAL_DISABLED) {
@@ -463,7 +543,9 @@ next_loop_unlocked:
 			// it is possible that neither in_pos nor out_pos has
 			// changed.
 			mythread_sync(thr->coder->mutex) {
-				thr->outbuf->pos = thr->out_pos;
+				if (thr->verify_buf == NULL)
+					thr->outbuf->pos = thr->out_pos;
+
 				thr->outbuf->decoder_in_pos = thr->in_pos;
 				mythread_cond_signal(&thr->coder->cond);
 			}
@@ -488,8 +570,10 @@ next_loop_unlocked:
 	thr->in = NULL;
 
 	mythread_sync(thr->mutex) {
-		if (thr->state != THR_EXIT)
+		if (thr->state != THR_EXIT) {
 			thr->state = THR_IDLE;
+			lzma_probe2(decoder_worker_state, thr, THR_IDLE);
+		}
 	}
 
 	mythread_sync(thr->coder->mutex) {
@@ -499,8 +583,22 @@ next_loop_unlocked:
 		thr->progress_in = 0;
 		thr->progress_out = 0;
 
-		// Mark the outbuf as finished.
-		thr->outbuf->pos = thr->out_pos;
+		if (ret == LZMA_STREAM_END)
+			lzma_stats_block(&thr->coder->stats,
+					thr->block_options.check,
+					thr->out_pos,
+					thr->block_options.ignore_check);
+
+		thr->coder->stats.worker_busy_ns += thr->busy_ns;
+		thr->coder->stats.worker_idle_ns += thr->idle_ns;
+		thr->busy_ns = 0;
+		thr->idle_ns = 0;
+
+		// Mark the outbuf as finished. With LZMA_VERIFY_ONLY
+		// there is nothing in it to read.
+		if (thr->verify_buf == NULL)
+			thr->outbuf->pos = thr->out_pos;
+
 		thr->outbuf->decoder_in_pos = thr->in_pos;
 		thr->outbuf->finished = true;
 		thr->outbuf->finish_ret = ret;
@@ -525,6 +623,8 @@ threads_end(struct lzma_stream_coder *coder, const lzma_allocator *allocator)
 	for (uint32_t i = 0; i < coder->threads_initialized; ++i) {
 		mythread_sync(coder->threads[i].mutex) {
 			coder->threads[i].state = THR_EXIT;
+			lzma_probe2(decoder_worker_state, &coder->threads[i],
+					THR_EXIT);
 			mythread_cond_signal(&coder->threads[i].cond);
 		}
 	}
@@ -545,6 +645,30 @@ threads_end(struct lzma_stream_coder *coder, const lzma_allocator *allocator)
 }
 
 
+/// Frees the Block decoders cached in the idle threads if their memory
+/// usage together with mem_needed bytes would exceed memlimit_threading.
+/// The threads themselves are kept.
+static void
+threads_free_cached(struct lzma_stream_coder *coder,
+		const lzma_allocator *allocator, uint64_t mem_needed)
+{
+	mythread_sync(coder->mutex) {
+		if (mem_needed > coder->memlimit_threading
+				|| coder->mem_cached > coder->memlimit_threading
+					- mem_needed) {
+			for (struct worker_thread *thr = coder->threads_free;
+					thr != NULL; thr = thr->next) {
+				lzma_next_end(&thr->block_decoder, allocator);
+				coder->mem_cached -= thr->mem_filters;
+				thr->mem_filters = 0;
+			}
+		}
+	}
+
+	return;
+}
+
+
 static void
 threads_stop(struct lzma_stream_coder *coder)
 {
@@ -554,6 +678,8 @@ threads_stop(struct lzma_stream_coder *coder)
 			// THR_IDLE -> THR_STOP is not a valid state change.
 			if (coder->threads[i].state != THR_IDLE) {
 				coder->threads[i].state = THR_STOP;
+				lzma_probe2(decoder_worker_state,
+						&coder->threads[i], THR_STOP);
 				mythread_cond_signal(&coder->threads[i].cond);
 			}
 		}
@@ -569,9 +695,8 @@ initialize_new_thread(struct lzma_stream_coder *coder,
 		const lzma_allocator *allocator)
 {
 	// Allocate the coder->threads array if needed. It's done here instead
-	// of when initializing the decoder because we don't need this if we
-	// use the direct mode (we may even free coder->threads in the middle
-	// of the file if we switch from threaded to direct mode).
+	// of when initializing the decoder because we don't need this if
+	// only the direct mode is used.
 	if (coder->threads == NULL) {
 		coder->threads = lzma_alloc(
 			coder->threads_max * sizeof(struct worker_thread),
@@ -586,6 +711,13 @@ initialize_new_thread(struct lzma_stream_coder *coder,
 	struct worker_thread *thr
 			= &coder->threads[coder->threads_initialized];
 
+	thr->verify_buf = NULL;
+	if (coder->verify_only) {
+		thr->verify_buf = lzma_alloc(VERIFY_BUF_SIZE, allocator);
+		if (thr->verify_buf == NULL)
+			return LZMA_MEM_ERROR;
+	}
+
 	if (mythread_mutex_init(&thr->mutex))
 		goto error_mutex;
 
@@ -600,6 +732,8 @@ initialize_new_thread(struct lzma_stream_coder *coder,
 	thr->outbuf = NULL;
 	thr->block_decoder = LZMA_NEXT_CODER_INIT;
 	thr->mem_filters = 0;
+	thr->busy_ns = 0;
+	thr->idle_ns = 0;
 
 	if (mythread_create(&thr->thread_id, worker_decoder, thr))
 		goto error_thread;
@@ -616,6 +750,7 @@ error_cond:
 	mythread_mutex_destroy(&thr->mutex);
 
 error_mutex:
+	lzma_free(thr->verify_buf, allocator);
 	return LZMA_MEM_ERROR;
 }
 
@@ -671,6 +806,20 @@ read_output_and_wait(struct lzma_stream_coder *coder,
 
 	mythread_sync(coder->mutex) {
 		do {
+			// With LZMA_VERIFY_ONLY nothing is read from the
+			// output queue. Release the finished Blocks even if
+			// an earlier Block is still being decoded so that
+			// a slow Block doesn't stop new Blocks from being
+			// started. The first error stays in the queue and
+			// is returned by lzma_outq_read() below.
+			if (coder->verify_only) {
+				lzma_outq_release_finished(
+						&coder->outq, allocator);
+				lzma_outq_enable_partial_output(
+						&coder->outq,
+						&worker_enable_partial_update);
+			}
+
 			// Get as much output from the queue as is possible
 			// without blocking.
 			const size_t out_start = *out_pos;
@@ -839,6 +988,10 @@ read_output_and_wait(struct lzma_stream_coder *coder,
 			}
 
 			// Wait for input or output to become possible.
+			const uint64_t stall_start
+					= mythread_time_ns(&coder->cond);
+			bool timed_out = false;
+
 			if (coder->timeout != 0) {
 				// See the comment in stream_encoder_mt.c
 				// about why mythread_condtime_set() is used
@@ -854,16 +1007,22 @@ read_output_and_wait(struct lzma_stream_coder *coder,
 							coder->timeout);
 				}
 
-				if (mythread_cond_timedwait(&coder->cond,
-						&coder->mutex,
-						wait_abs) != 0) {
-					ret = LZMA_TIMED_OUT;
-					break;
-				}
+				timed_out = mythread_cond_timedwait(
+						&coder->cond, &coder->mutex,
+						wait_abs) != 0;
 			} else {
 				mythread_cond_wait(&coder->cond,
 						&coder->mutex);
 			}
+
+			++coder->stats.stalls;
+			coder->stats.stall_ns += mythread_time_ns(
+					&coder->cond) - stall_start;
+
+			if (timed_out) {
+				ret = LZMA_TIMED_OUT;
+				break;
+			}
 		} while (ret == LZMA_OK);
 	}
 
@@ -950,6 +1109,16 @@ comp_blk_size(const struct lzma_stream_coder *coder)
 }
 
 
+/// Get the size of the output queue buffer needed for the Block in
+/// threaded mode. With LZMA_VERIFY_ONLY the buffer doesn't hold any data.
+static size_t
+outbuf_size(const struct lzma_stream_coder *coder)
+{
+	return coder->verify_only
+			? 0 : (size_t)(coder->block_options.uncompressed_size);
+}
+
+
 /// Returns true if the size (compressed or uncompressed) is such that
 /// threaded decompression cannot be used. Sizes that are too big compared
 /// to SIZE_MAX must be rejected to avoid integer overflows and truncations
@@ -1237,7 +1406,7 @@ stream_decode_mt(void *coder_ptr, const lzma_allocator *allocator,
 		coder->mem_next_in = comp_blk_size(coder);
 		const uint64_t mem_buffers = coder->mem_next_in
 				+ lzma_outq_outbuf_memusage(
-				coder->block_options.uncompressed_size);
+					outbuf_size(coder));
 
 		// Add the amount needed by the filters.
 		// Avoid integer overflows.
@@ -1364,7 +1533,7 @@ stream_decode_mt(void *coder_ptr, const lzma_allocator *allocator,
 			// don't free and almost immediately reallocate
 			// an identical buffer.
 			lzma_outq_clear_cache2(&coder->outq, allocator,
-				coder->block_options.uncompressed_size);
+					outbuf_size(coder));
 		}
 
 		// If there is at least one worker_thread in the cache and
@@ -1420,7 +1589,7 @@ stream_decode_mt(void *coder_ptr, const lzma_allocator *allocator,
 		// Allocate memory for the output buffer in the output queue.
 		return_if_error(lzma_outq_prealloc_buf(
 				&coder->outq, allocator,
-				coder->block_options.uncompressed_size));
+				outbuf_size(coder)));
 
 		// Set up coder->thr.
 		return_if_error(get_thread(coder, allocator));
@@ -1458,10 +1627,16 @@ stream_decode_mt(void *coder_ptr, const lzma_allocator *allocator,
 		coder->thr->outbuf = lzma_outq_get_buf(
 				&coder->outq, coder->thr);
 
+		coder->thr->out_offset = coder->uncompressed_offset;
+		coder->uncompressed_offset
+				+= coder->block_options.uncompressed_size;
+
 		// Start the decoder.
 		mythread_sync(coder->thr->mutex) {
 			assert(coder->thr->state == THR_IDLE);
 			coder->thr->state = THR_RUN;
+			lzma_probe2(decoder_worker_state, coder->thr,
+					THR_RUN);
 			mythread_cond_signal(&coder->thr->cond);
 		}
 
@@ -1470,6 +1645,11 @@ stream_decode_mt(void *coder_ptr, const lzma_allocator *allocator,
 		mythread_sync(coder->mutex) {
 			lzma_outq_enable_partial_output(&coder->outq,
 					&worker_enable_partial_update);
+
+			coder->stats.memusage_peak = my_max(
+					coder->stats.memusage_peak,
+					coder->mem_in_use
+						+ coder->outq.mem_in_use);
 		}
 
 		coder->sequence = SEQ_BLOCK_THR_RUN;
@@ -1500,9 +1680,17 @@ stream_decode_mt(void *coder_ptr, const lzma_allocator *allocator,
 		// SEQ_BLOCK_HEADER, we wait to fill the output buffer
 		// only if waiting_allowed was set to true in the beginning
 		// of this function (see the comment there).
+		//
+		// With LZMA_VERIFY_ONLY there is no output to wait for.
+		// Waiting is still needed if the Block needs more input
+		// to avoid a premature LZMA_BUF_ERROR. Otherwise continue
+		// to the next Block right away so that a slow Block
+		// doesn't delay the starting of the next Blocks.
 		return_if_error(read_output_and_wait(coder, allocator,
 				out, out_pos, out_size,
-				NULL, waiting_allowed,
+				NULL, waiting_allowed && (!coder->verify_only
+					|| cur_in_filled
+						< coder->thr->in_size),
 				&wait_abs, &has_blocked));
 
 		if (coder->pending_error != LZMA_OK) {
@@ -1541,9 +1729,14 @@ stream_decode_mt(void *coder_ptr, const lzma_allocator *allocator,
 		// Free the cached output buffers.
 		lzma_outq_clear_cache(&coder->outq, allocator);
 
-		// Get rid of the worker threads, including the coder->threads
-		// array.
-		threads_end(coder, allocator);
+		// All worker threads are idle now. They are kept so that
+		// the threaded mode can continue without creating them
+		// again when a later Block has the sizes in its Block Header
+		// and fits in memlimit_threading. Their cached Block decoders
+		// are kept too if there is room for them next to the
+		// direct mode decoder.
+		threads_free_cached(coder, allocator,
+				coder->mem_next_filters);
 
 		// Initialize the Block decoder.
 		const lzma_ret ret = lzma_block_decoder_init(
@@ -1562,6 +1755,21 @@ stream_decode_mt(void *coder_ptr, const lzma_allocator *allocator,
 		// Make the memory usage visible to _memconfig().
 		coder->mem_direct_mode = coder->mem_next_filters;
 
+		mythread_sync(coder->mutex) {
+			coder->stats.memusage_peak = my_max(
+					coder->stats.memusage_peak,
+					coder->mem_direct_mode
+						+ coder->mem_in_use
+						+ coder->outq.mem_in_use);
+		}
+
+		if (coder->verify_only && coder->verify_buf == NULL) {
+			coder->verify_buf = lzma_alloc(VERIFY_BUF_SIZE,
+					allocator);
+			if (coder->verify_buf == NULL)
+				return LZMA_MEM_ERROR;
+		}
+
 		coder->sequence = SEQ_BLOCK_DIRECT_RUN;
 	}
 
@@ -1569,13 +1777,43 @@ stream_decode_mt(void *coder_ptr, const lzma_allocator *allocator,
 
 	case SEQ_BLOCK_DIRECT_RUN: {
 		const size_t in_old = *in_pos;
-		const size_t out_old = *out_pos;
-		const lzma_ret ret = coder->block_decoder.code(
-				coder->block_decoder.coder, allocator,
-				in, in_pos, in_size, out, out_pos, out_size,
-				action);
+		lzma_ret ret;
+
+		if (coder->verify_only) {
+			// Decode into verify_buf until all input has been
+			// used. See worker_decoder().
+			size_t verify_pos;
+			do {
+				verify_pos = 0;
+				ret = coder->block_decoder.code(
+						coder->block_decoder.coder,
+						allocator,
+						in, in_pos, in_size,
+						coder->verify_buf, &verify_pos,
+						VERIFY_BUF_SIZE, action);
+
+				if (verify_pos > 0 && coder->output.write
+						!= NULL)
+					coder->output.write(
+						coder->output.opaque,
+						coder->uncompressed_offset,
+						coder->verify_buf,
+						verify_pos);
+
+				coder->uncompressed_offset += verify_pos;
+				coder->progress_out += verify_pos;
+			} while (ret == LZMA_OK
+					&& verify_pos == VERIFY_BUF_SIZE);
+		} else {
+			const size_t out_old = *out_pos;
+			ret = coder->block_decoder.code(
+					coder->block_decoder.coder, allocator,
+					in, in_pos, in_size,
+					out, out_pos, out_size, action);
+			coder->progress_out += *out_pos - out_old;
+		}
+
 		coder->progress_in += *in_pos - in_old;
-		coder->progress_out += *out_pos - out_old;
 
 		if (ret != LZMA_STREAM_END)
 			return ret;
@@ -1587,6 +1825,13 @@ stream_decode_mt(void *coder_ptr, const lzma_allocator *allocator,
 					&coder->block_options),
 				coder->block_options.uncompressed_size));
 
+		mythread_sync(coder->mutex) {
+			lzma_stats_block(&coder->stats,
+					coder->block_options.check,
+					coder->block_options.uncompressed_size,
+					coder->ignore_check);
+		}
+
 		coder->sequence = SEQ_BLOCK_HEADER;
 		break;
 	}
@@ -1753,6 +1998,7 @@ stream_decoder_mt_end(void *coder_ptr, const lzma_allocator *allocator)
 	lzma_next_end(&coder->block_decoder, allocator);
 	cleanup_filters(coder->filters, allocator);
 	lzma_index_hash_end(coder->index_hash, allocator);
+	lzma_free(coder->verify_buf, allocator);
 
 	lzma_free(coder, allocator);
 	return;
@@ -1823,16 +2069,30 @@ stream_decoder_mt_get_progress(void *coder_ptr,
 }
 
 
+static void
+stream_decoder_mt_get_stats(void *coder_ptr, lzma_stats *stats)
+{
+	struct lzma_stream_coder *coder = coder_ptr;
+
+	mythread_sync(coder->mutex) {
+		lzma_stats_add(stats, &coder->stats);
+	}
+
+	return;
+}
+
+
 static lzma_ret
 stream_decoder_mt_init(lzma_next_coder *next, const lzma_allocator *allocator,
-		       const lzma_mt *options)
+		       const lzma_mt *options,
+		       const lzma_unordered_output *output)
 {
 	struct lzma_stream_coder *coder;
 
 	if (options->threads == 0 || options->threads > LZMA_THREADS_MAX)
 		return LZMA_OPTIONS_ERROR;
 
-	if (options->flags & ~LZMA_SUPPORTED_FLAGS)
+	if (options->flags & ~(LZMA_SUPPORTED_FLAGS | LZMA_VERIFY_ONLY))
 		return LZMA_OPTIONS_ERROR;
 
 	lzma_next_coder_init(&stream_decoder_mt_init, next, allocator);
@@ -1861,12 +2121,14 @@ stream_decoder_mt_init(lzma_next_coder *next, const lzma_allocator *allocator,
 		next->get_check = &stream_decoder_mt_get_check;
 		next->memconfig = &stream_decoder_mt_memconfig;
 		next->get_progress = &stream_decoder_mt_get_progress;
+		next->get_stats = &stream_decoder_mt_get_stats;
 
 		memzero(coder->filters, sizeof(coder->filters));
 		memzero(&coder->outq, sizeof(coder->outq));
 
 		coder->block_decoder = LZMA_NEXT_CODER_INIT;
 		coder->mem_direct_mode = 0;
+		coder->verify_buf = NULL;
 
 		coder->index_hash = NULL;
 		coder->threads = NULL;
@@ -1902,6 +2164,7 @@ stream_decoder_mt_init(lzma_next_coder *next, const lzma_allocator *allocator,
 	coder->mem_in_use = 0;
 	coder->mem_cached = 0;
 	coder->mem_next_block = 0;
+	memzero(&coder->stats, sizeof(coder->stats));
 
 	coder->progress_in = 0;
 	coder->progress_out = 0;
@@ -1925,6 +2188,20 @@ stream_decoder_mt_init(lzma_next_coder *next, const lzma_allocator *allocator,
 	coder->ignore_check = (options->flags & LZMA_IGNORE_CHECK) != 0;
 	coder->concatenated = (options->flags & LZMA_CONCATENATED) != 0;
 	coder->fail_fast = (options->flags & LZMA_FAIL_FAST) != 0;
+	coder->verify_only = (options->flags & LZMA_VERIFY_ONLY) != 0;
+
+	if (output != NULL) {
+		if (output->write == NULL)
+			return LZMA_PROG_ERROR;
+
+		coder->output = *output;
+		coder->verify_only = true;
+	} else {
+		coder->output.write = NULL;
+		coder->output.opaque = NULL;
+	}
+
+	coder->uncompressed_offset = 0;
 
 	coder->first_stream = true;
 	coder->out_was_filled = false;
@@ -1942,7 +2219,23 @@ stream_decoder_mt_init(lzma_next_coder *next, const lzma_allocator *allocator,
 extern LZMA_API(lzma_ret)
 lzma_stream_decoder_mt(lzma_stream *strm, const lzma_mt *options)
 {
-	lzma_next_strm_init(stream_decoder_mt_init, strm, options);
+	lzma_next_strm_init(stream_decoder_mt_init, strm, options, NULL);
+
+	strm->internal->supported_actions[LZMA_RUN] = true;
+	strm->internal->supported_actions[LZMA_FINISH] = true;
+
+	return LZMA_OK;
+}
+
+
+extern LZMA_API(lzma_ret)
+lzma_stream_decoder_mt_unordered(lzma_stream *strm, const lzma_mt *options,
+		const lzma_unordered_output *output)
+{
+	if (output == NULL)
+		return LZMA_PROG_ERROR;
+
+	lzma_next_strm_init(stream_decoder_mt_init, strm, options, output);
 
 	strm->internal->supported_actions[LZMA_RUN] = true;
 	strm->internal->supported_actions[LZMA_FINISH] = true;
@@ -46,6 +46,9 @@ typedef struct {
 	/// Index to hold sizes of the Blocks
 	lzma_index *index;
 
+	/// Statistics for lzma_get_stats()
+	lzma_stats stats;
+
 	/// Read position in buffer[]
 	size_t buffer_pos;
 
@@ -171,6 +174,9 @@ stream_encode(void *coder_ptr, const lzma_allocator *allocator,
 				unpadded_size,
 				coder->block_options.uncompressed_size));
 
+		lzma_stats_block(&coder->stats, coder->block_options.check,
+				coder->block_options.uncompressed_size, false);
+
 		coder->sequence = SEQ_BLOCK_INIT;
 		break;
 	}
@@ -268,6 +274,70 @@ stream_encoder_update(void *coder_ptr, const lzma_allocator *allocator,
 }
 
 
+static lzma_ret
+stream_encoder_copy(const void *coder_ptr, void **dest_ptr,
+		const lzma_allocator *allocator)
+{
+	const lzma_stream_coder *coder = coder_ptr;
+
+	// The Index encoder has an iterator pointing to coder->index.
+	// It's not worth supporting copying it.
+	if (coder->sequence == SEQ_INDEX_ENCODE)
+		return LZMA_OPTIONS_ERROR;
+
+	lzma_stream_coder *dest = lzma_alloc(sizeof(lzma_stream_coder),
+			allocator);
+	if (dest == NULL)
+		return LZMA_MEM_ERROR;
+
+	*dest = *coder;
+	dest->block_encoder = LZMA_NEXT_CODER_INIT;
+	dest->index_encoder = LZMA_NEXT_CODER_INIT;
+	dest->index = NULL;
+	dest->filters[0].id = LZMA_VLI_UNKNOWN;
+
+	lzma_ret ret = lzma_filters_copy(coder->filters, dest->filters,
+			allocator);
+	if (ret != LZMA_OK) {
+		dest->filters[0].id = LZMA_VLI_UNKNOWN;
+		goto error;
+	}
+
+	dest->block_options.filters = dest->filters;
+
+	dest->index = lzma_index_dup(coder->index, allocator);
+	if (dest->index == NULL) {
+		ret = LZMA_MEM_ERROR;
+		goto error;
+	}
+
+	ret = lzma_next_copy(&dest->block_encoder, allocator,
+			&coder->block_encoder);
+	if (ret != LZMA_OK)
+		goto error;
+
+	if (dest->block_encoder.coder != NULL)
+		lzma_block_encoder_set_block(&dest->block_encoder,
+				&dest->block_options);
+
+	*dest_ptr = dest;
+	return LZMA_OK;
+
+error:
+	stream_encoder_end(dest, allocator);
+	return ret;
+}
+
+
+static void
+stream_encoder_get_stats(void *coder_ptr, lzma_stats *stats)
+{
+	const lzma_stream_coder *coder = coder_ptr;
+	lzma_stats_add(stats, &coder->stats);
+	return;
+}
+
+
 static lzma_ret
 stream_encoder_init(lzma_next_coder *next, const lzma_allocator *allocator,
 		const lzma_filter *filters, lzma_check check)
@@ -288,6 +358,8 @@ stream_encoder_init(lzma_next_coder *next, const lzma_allocator *allocator,
 		next->code = &stream_encode;
 		next->end = &stream_encoder_end;
 		next->update = &stream_encoder_update;
+		next->copy = &stream_encoder_copy;
+		next->get_stats = &stream_encoder_get_stats;
 
 		coder->filters[0].id = LZMA_VLI_UNKNOWN;
 		coder->block_encoder = LZMA_NEXT_CODER_INIT;
@@ -299,6 +371,7 @@ stream_encoder_init(lzma_next_coder *next, const lzma_allocator *allocator,
 	coder->sequence = SEQ_STREAM_HEADER;
 	coder->block_options.version = 0;
 	coder->block_options.check = check;
+	memzero(&coder->stats, sizeof(coder->stats));
 
 	// Initialize the Index
 	lzma_index_end(coder->index, allocator);
@@ -79,6 +79,11 @@ struct worker_thread_s {
 	/// Amount of compressed data that is ready.
 	uint64_t progress_out;
 
+	/// Time spent in the Block encoder and waiting for work or input.
+	/// These are moved to coder->stats when a Block has been finished.
+	uint64_t busy_ns;
+	uint64_t idle_ns;
+
 	/// Block encoder
 	lzma_next_coder block_encoder;
 
@@ -174,6 +179,11 @@ struct lzma_stream_coder_s {
 	/// have already been finished.
 	uint64_t progress_out;
 
+	/// Statistics for lzma_get_stats()
+	///
+	/// \note       Use mutex.
+	lzma_stats stats;
+
 
 	mythread_mutex mutex;
 	mythread_cond cond;
@@ -226,7 +236,11 @@ worker_encode(worker_thread *thr, size_t *out_pos, worker_state state)
 		return THR_STOP;
 	}
 
-	// Initialize the Block encoder.
+	// Initialize the Block encoder. After the first Block this only
+	// resets the encoder of this thread: the filter chain doesn't change
+	// within a Stream, so the LZ encoder keeps its dictionary buffer and
+	// match finder. The old match finder entries don't need to be
+	// cleared either (see lz_encoder_init() in lz_encoder.c).
 	ret = lzma_block_encoder_init(&thr->block_encoder,
 			thr->allocator, &thr->block_options);
 	if (ret != LZMA_OK) {
@@ -252,9 +266,20 @@ worker_encode(worker_thread *thr, size_t *out_pos, worker_state state)
 			thr->progress_in = in_pos;
 			thr->progress_out = *out_pos;
 
-			while (in_size == thr->in_size
-					&& thr->state == THR_RUN)
-				mythread_cond_wait(&thr->cond, &thr->mutex);
+			if (in_size == thr->in_size
+					&& thr->state == THR_RUN) {
+				const uint64_t idle_start
+						= mythread_time_ns(&thr->cond);
+
+				do {
+					mythread_cond_wait(&thr->cond,
+							&thr->mutex);
+				} while (in_size == thr->in_size
+						&& thr->state == THR_RUN);
+
+				thr->idle_ns += mythread_time_ns(&thr->cond)
+						- idle_start;
+			}
 
 			state = thr->state;
 			in_size = thr->in_size;
@@ -277,10 +302,12 @@ worker_encode(worker_thread *thr, size_t *out_pos, worker_state state)
 			action = LZMA_RUN;
 		}
 
+		const uint64_t busy_start = mythread_time_ns(&thr->cond);
 		ret = thr->block_encoder.code(
 				thr->block_encoder.coder, thr->allocator,
 				thr->in, &in_pos, in_limit, thr->outbuf->buf,
 				out_pos, out_size, action);
+		thr->busy_ns += mythread_time_ns(&thr->cond) - busy_start;
 	} while (ret == LZMA_OK && *out_pos < out_size);
 
 	switch (ret) {
@@ -305,9 +332,15 @@ worker_encode(worker_thread *thr, size_t *out_pos, worker_state state)
 		//
 		// First wait that we have gotten all the input.
 		mythread_sync(thr->mutex) {
+			const uint64_t idle_start
+					= mythread_time_ns(&thr->cond);
+
 			while (thr->state == THR_RUN)
 				mythread_cond_wait(&thr->cond, &thr->mutex);
 
+			thr->idle_ns += mythread_time_ns(&thr->cond)
+					- idle_start;
+
 			state = thr->state;
 			in_size = thr->in_size;
 		}
@@ -316,10 +349,12 @@ worker_encode(worker_thread *thr, size_t *out_pos, worker_state state)
 			return state;
 
 		// Do the encoding. This takes care of the Block Header too.
+		const uint64_t busy_start = mythread_time_ns(&thr->cond);
 		*out_pos = 0;
 		ret = lzma_block_uncomp_encode(&thr->block_options,
 				thr->in, in_size, thr->outbuf->buf,
 				out_pos, out_size);
+		thr->busy_ns += mythread_time_ns(&thr->cond) - busy_start;
 
 		// It shouldn't fail.
 		if (ret != LZMA_OK) {
@@ -359,6 +394,8 @@ worker_start(void *thr_ptr)
 				// requested to stop, just set the state.
 				if (thr->state == THR_STOP) {
 					thr->state = THR_IDLE;
+					lzma_probe2(encoder_worker_state,
+							thr, THR_IDLE);
 					mythread_cond_signal(&thr->cond);
 				}
 
@@ -366,7 +403,11 @@ worker_start(void *thr_ptr)
 				if (state != THR_IDLE)
 					break;
 
+				const uint64_t idle_start
+						= mythread_time_ns(&thr->cond);
 				mythread_cond_wait(&thr->cond, &thr->mutex);
+				thr->idle_ns += mythread_time_ns(&thr->cond)
+						- idle_start;
 			}
 		}
 
@@ -387,6 +428,8 @@ worker_start(void *thr_ptr)
 		mythread_sync(thr->mutex) {
 			if (thr->state != THR_EXIT) {
 				thr->state = THR_IDLE;
+				lzma_probe2(encoder_worker_state, thr,
+						THR_IDLE);
 				mythread_cond_signal(&thr->cond);
 			}
 		}
@@ -406,6 +449,17 @@ worker_start(void *thr_ptr)
 			thr->progress_in = 0;
 			thr->progress_out = 0;
 
+			if (state == THR_FINISH)
+				lzma_stats_block(&thr->coder->stats,
+					thr->block_options.check,
+					thr->block_options.uncompressed_size,
+					false);
+
+			thr->coder->stats.worker_busy_ns += thr->busy_ns;
+			thr->coder->stats.worker_idle_ns += thr->idle_ns;
+			thr->busy_ns = 0;
+			thr->idle_ns = 0;
+
 			// Return this thread to the stack of free threads.
 			thr->next = thr->coder->threads_free;
 			thr->coder->threads_free = thr;
@@ -432,6 +486,8 @@ threads_stop(lzma_stream_coder *coder, bool wait_for_threads)
 	for (uint32_t i = 0; i < coder->threads_initialized; ++i) {
 		mythread_sync(coder->threads[i].mutex) {
 			coder->threads[i].state = THR_STOP;
+			lzma_probe2(encoder_worker_state, &coder->threads[i],
+					THR_STOP);
 			mythread_cond_signal(&coder->threads[i].cond);
 		}
 	}
@@ -460,6 +516,8 @@ threads_end(lzma_stream_coder *coder, const lzma_allocator *allocator)
 	for (uint32_t i = 0; i < coder->threads_initialized; ++i) {
 		mythread_sync(coder->threads[i].mutex) {
 			coder->threads[i].state = THR_EXIT;
+			lzma_probe2(encoder_worker_state, &coder->threads[i],
+					THR_EXIT);
 			mythread_cond_signal(&coder->threads[i].cond);
 		}
 	}
@@ -497,6 +555,8 @@ initialize_new_thread(lzma_stream_coder *coder,
 	thr->coder = coder;
 	thr->progress_in = 0;
 	thr->progress_out = 0;
+	thr->busy_ns = 0;
+	thr->idle_ns = 0;
 	thr->block_encoder = LZMA_NEXT_CODER_INIT;
 
 	if (mythread_create(&thr->thread_id, &worker_start, thr))
@@ -553,6 +613,7 @@ get_thread(lzma_stream_coder *coder, const lzma_allocator *allocator)
 	// in the main thread.
 	mythread_sync(coder->thr->mutex) {
 		coder->thr->state = THR_RUN;
+		lzma_probe2(encoder_worker_state, coder->thr, THR_RUN);
 		coder->thr->in_size = 0;
 		coder->thr->outbuf = lzma_outq_get_buf(&coder->outq, NULL);
 		mythread_cond_signal(&coder->thr->cond);
@@ -603,8 +664,12 @@ stream_encode_in(lzma_stream_coder *coder, const lzma_allocator *allocator,
 				// of input and update the state if needed.
 				coder->thr->in_size = thr_in_size;
 
-				if (finish)
+				if (finish) {
 					coder->thr->state = THR_FINISH;
+					lzma_probe2(encoder_worker_state,
+							coder->thr,
+							THR_FINISH);
+				}
 
 				mythread_cond_signal(&coder->thr->cond);
 			}
@@ -666,6 +731,9 @@ wait_for_work(lzma_stream_coder *coder, mythread_condtime *wait_abs,
 				&& !lzma_outq_is_readable(&coder->outq)
 				&& coder->thread_error == LZMA_OK
 				&& !timed_out) {
+			const uint64_t stall_start
+					= mythread_time_ns(&coder->cond);
+
 			if (coder->timeout != 0)
 				timed_out = mythread_cond_timedwait(
 						&coder->cond, &coder->mutex,
@@ -673,6 +741,10 @@ wait_for_work(lzma_stream_coder *coder, mythread_condtime *wait_abs,
 			else
 				mythread_cond_wait(&coder->cond,
 						&coder->mutex);
+
+			++coder->stats.stalls;
+			coder->stats.stall_ns += mythread_time_ns(
+					&coder->cond) - stall_start;
 		}
 	}
 
@@ -956,6 +1028,19 @@ get_progress(void *coder_ptr, uint64_t *progress_in, uint64_t *progress_out)
 }
 
 
+static void
+get_stats(void *coder_ptr, lzma_stats *stats)
+{
+	lzma_stream_coder *coder = coder_ptr;
+
+	mythread_sync(coder->mutex) {
+		lzma_stats_add(stats, &coder->stats);
+	}
+
+	return;
+}
+
+
 static lzma_ret
 stream_encoder_mt_init(lzma_next_coder *next, const lzma_allocator *allocator,
 		const lzma_mt *options)
@@ -1018,6 +1103,7 @@ stream_encoder_mt_init(lzma_next_coder *next, const lzma_allocator *allocator,
 		next->code = &stream_encode_mt;
 		next->end = &stream_encoder_mt_end;
 		next->get_progress = &get_progress;
+		next->get_stats = &get_stats;
 // 		next->update = &stream_encoder_mt_update;
 
 		coder->filters[0].id = LZMA_VLI_UNKNOWN;
@@ -1092,6 +1178,9 @@ stream_encoder_mt_init(lzma_next_coder *next, const lzma_allocator *allocator,
 	coder->progress_in = 0;
 	coder->progress_out = LZMA_STREAM_HEADER_SIZE;
 
+	// The threads have been stopped above so the mutex isn't needed.
+	memzero(&coder->stats, sizeof(coder->stats));
+
 	return LZMA_OK;
 }
 
@@ -0,0 +1,29 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       dedup_common.c
+/// \brief      Common stuff for Dedup encoder and decoder
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dedup_common.h"
+
+
+extern uint32_t
+lzma_dedup_window_size(const void *options)
+{
+	const lzma_options_dedup *opt = options;
+
+	if (opt == NULL || opt->window_size < LZMA_DEDUP_WINDOW_MIN
+			|| opt->window_size > LZMA_DEDUP_WINDOW_MAX)
+		return 0;
+
+	uint32_t size = LZMA_DEDUP_WINDOW_MIN;
+	while (size < opt->window_size)
+		size <<= 1;
+
+	return size;
+}
+
@@ -0,0 +1,24 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       dedup_common.h
+/// \brief      Common stuff for Dedup encoder and decoder
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LZMA_DEDUP_COMMON_H
+#define LZMA_DEDUP_COMMON_H
+
+#include "common.h"
+
+/// Size of the Filter Properties field
+#define LZMA_DEDUP_PROPS_SIZE 1
+
+/// Returns the window size rounded up to a power of two, or zero if
+/// the window size in the options is invalid. This is the window size
+/// that is stored in the Filter Properties.
+extern uint32_t lzma_dedup_window_size(const void *options);
+
+#endif
@@ -0,0 +1,335 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       dedup_decoder.c
+/// \brief      Dedup filter decoder
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dedup_decoder.h"
+
+
+typedef struct {
+	/// Next coder in the chain
+	lzma_next_coder next;
+
+	enum {
+		SEQ_HEADER,
+		SEQ_DISTANCE,
+		SEQ_LITERAL,
+		SEQ_COPY,
+	} sequence;
+
+	/// True if the next coder has returned LZMA_STREAM_END
+	bool end_was_reached;
+
+	/// Integer that is being decoded
+	lzma_vli vli;
+	size_t vli_pos;
+
+	/// Number of bytes left in the current chunk
+	uint64_t size;
+
+	/// Distance of the reference that is being copied
+	uint64_t distance;
+
+	/// Circular buffer that holds the most recent window_size bytes
+	/// of the uncompressed data. window_size is a power of two.
+	uint8_t *window;
+	uint32_t window_size;
+
+	/// Number of bytes decoded so far
+	uint64_t total;
+
+	/// Data from the next coder
+	size_t in_pos;
+	size_t in_size;
+	uint8_t in[LZMA_BUFFER_SIZE];
+} lzma_dedup_coder;
+
+
+/// Copies the bytes that have been written to out[] into the window.
+static void
+window_append(lzma_dedup_coder *coder, const uint8_t *buf, size_t size)
+{
+	while (size > 0) {
+		const size_t pos = (size_t)(coder->total)
+				& (coder->window_size - 1);
+		const size_t len = my_min(size, coder->window_size - pos);
+
+		memcpy(coder->window + pos, buf, len);
+		coder->total += len;
+		buf += len;
+		size -= len;
+	}
+
+	return;
+}
+
+
+static lzma_ret
+dedup_decode(void *coder_ptr, const lzma_allocator *allocator,
+		const uint8_t *restrict in, size_t *restrict in_pos,
+		size_t in_size, uint8_t *restrict out,
+		size_t *restrict out_pos, size_t out_size, lzma_action action)
+{
+	lzma_dedup_coder *coder = coder_ptr;
+
+	assert(coder->next.code != NULL);
+
+	while (true) {
+		if (coder->sequence == SEQ_COPY) {
+			if (*out_pos == out_size)
+				return LZMA_OK;
+
+			// The distance is at least the size of the chunk so
+			// the bytes that are being copied aren't overwritten
+			// before they have been read.
+			const size_t pos = (size_t)(coder->total
+					- coder->distance)
+					& (coder->window_size - 1);
+			size_t len = my_min(coder->size,
+					coder->window_size - pos);
+			len = my_min(len, out_size - *out_pos);
+
+			memcpy(out + *out_pos, coder->window + pos, len);
+			window_append(coder, out + *out_pos, len);
+			*out_pos += len;
+
+			coder->size -= len;
+			if (coder->size == 0)
+				coder->sequence = SEQ_HEADER;
+
+			continue;
+		}
+
+		if (coder->sequence == SEQ_LITERAL && *out_pos == out_size)
+			return LZMA_OK;
+
+		// The rest of the sequences need input.
+		if (coder->in_pos == coder->in_size) {
+			if (coder->end_was_reached) {
+				// The data must end at a record boundary.
+				if (coder->sequence == SEQ_HEADER
+						&& coder->vli_pos == 0)
+					return LZMA_STREAM_END;
+
+				return LZMA_DATA_ERROR;
+			}
+
+			coder->in_pos = 0;
+			coder->in_size = 0;
+
+			const lzma_ret ret = coder->next.code(
+					coder->next.coder, allocator,
+					in, in_pos, in_size,
+					coder->in, &coder->in_size,
+					LZMA_BUFFER_SIZE, action);
+
+			if (ret == LZMA_STREAM_END)
+				coder->end_was_reached = true;
+			else if (ret != LZMA_OK)
+				return ret;
+
+			if (coder->in_size == 0 && !coder->end_was_reached)
+				return LZMA_OK;
+
+			continue;
+		}
+
+		switch (coder->sequence) {
+		case SEQ_HEADER: {
+			const lzma_ret ret = lzma_vli_decode(&coder->vli,
+					&coder->vli_pos, coder->in,
+					&coder->in_pos, coder->in_size);
+			if (ret == LZMA_OK)
+				break;
+
+			if (ret != LZMA_STREAM_END)
+				return ret;
+
+			coder->size = coder->vli >> 1;
+			if (coder->size == 0)
+				return LZMA_DATA_ERROR;
+
+			coder->sequence = (coder->vli & 1)
+					? SEQ_DISTANCE : SEQ_LITERAL;
+			coder->vli_pos = 0;
+			break;
+		}
+
+		case SEQ_DISTANCE: {
+			const lzma_ret ret = lzma_vli_decode(&coder->distance,
+					&coder->vli_pos, coder->in,
+					&coder->in_pos, coder->in_size);
+			if (ret == LZMA_OK)
+				break;
+
+			if (ret != LZMA_STREAM_END)
+				return ret;
+
+			// The reference must point to data that has already
+			// been decoded and is still in the window.
+			if (coder->distance < coder->size
+					|| coder->distance > coder->window_size
+					|| coder->distance > coder->total)
+				return LZMA_DATA_ERROR;
+
+			coder->sequence = SEQ_COPY;
+			coder->vli_pos = 0;
+			break;
+		}
+
+		case SEQ_LITERAL: {
+			size_t len = my_min(coder->size,
+					coder->in_size - coder->in_pos);
+			len = my_min(len, out_size - *out_pos);
+
+			memcpy(out + *out_pos, coder->in + coder->in_pos, len);
+			window_append(coder, out + *out_pos, len);
+			coder->in_pos += len;
+			*out_pos += len;
+
+			coder->size -= len;
+			if (coder->size == 0)
+				coder->sequence = SEQ_HEADER;
+
+			break;
+		}
+
+		default:
+			return LZMA_PROG_ERROR;
+		}
+	}
+}
+
+
+static void
+dedup_decoder_end(void *coder_ptr, const lzma_allocator *allocator)
+{
+	lzma_dedup_coder *coder = coder_ptr;
+	lzma_next_end(&coder->next, allocator);
+	lzma_free(coder->window, allocator);
+	lzma_free(coder, allocator);
+	return;
+}
+
+
+static lzma_ret
+dedup_decoder_copy(const void *coder_ptr, void **dest_ptr,
+		const lzma_allocator *allocator)
+{
+	const lzma_dedup_coder *coder = coder_ptr;
+
+	lzma_dedup_coder *dest = lzma_alloc(sizeof(lzma_dedup_coder),
+			allocator);
+	if (dest == NULL)
+		return LZMA_MEM_ERROR;
+
+	*dest = *coder;
+	dest->next = LZMA_NEXT_CODER_INIT;
+
+	lzma_ret ret = LZMA_MEM_ERROR;
+	dest->window = lzma_alloc(coder->window_size, allocator);
+	if (dest->window != NULL) {
+		memcpy(dest->window, coder->window, coder->window_size);
+		ret = lzma_next_copy(&dest->next, allocator, &coder->next);
+	}
+
+	if (ret != LZMA_OK) {
+		dedup_decoder_end(dest, allocator);
+		return ret;
+	}
+
+	*dest_ptr = dest;
+	return LZMA_OK;
+}
+
+
+extern lzma_ret
+lzma_dedup_decoder_init(lzma_next_coder *next, const lzma_allocator *allocator,
+		const lzma_filter_info *filters)
+{
+	lzma_dedup_coder *coder = next->coder;
+	if (coder == NULL) {
+		coder = lzma_alloc(sizeof(lzma_dedup_coder), allocator);
+		if (coder == NULL)
+			return LZMA_MEM_ERROR;
+
+		next->coder = coder;
+		next->code = &dedup_decode;
+		next->end = &dedup_decoder_end;
+		next->copy = &dedup_decoder_copy;
+
+		coder->next = LZMA_NEXT_CODER_INIT;
+		coder->window = NULL;
+		coder->window_size = 0;
+	}
+
+	const uint32_t window_size = lzma_dedup_window_size(
+			filters[0].options);
+	if (window_size == 0)
+		return LZMA_OPTIONS_ERROR;
+
+	if (coder->window_size != window_size) {
+		lzma_free(coder->window, allocator);
+		coder->window = lzma_alloc(window_size, allocator);
+		if (coder->window == NULL) {
+			coder->window_size = 0;
+			return LZMA_MEM_ERROR;
+		}
+
+		coder->window_size = window_size;
+	}
+
+	coder->sequence = SEQ_HEADER;
+	coder->end_was_reached = false;
+	coder->vli = 0;
+	coder->vli_pos = 0;
+	coder->size = 0;
+	coder->distance = 0;
+	coder->total = 0;
+	coder->in_pos = 0;
+	coder->in_size = 0;
+
+	return lzma_next_filter_init(&coder->next, allocator, filters + 1);
+}
+
+
+extern uint64_t
+lzma_dedup_decoder_memusage(const void *options)
+{
+	const uint32_t window_size = lzma_dedup_window_size(options);
+	if (window_size == 0)
+		return UINT64_MAX;
+
+	return sizeof(lzma_dedup_coder) + window_size;
+}
+
+
+extern lzma_ret
+lzma_dedup_props_decode(void **options, const lzma_allocator *allocator,
+		const uint8_t *props, size_t props_size)
+{
+	if (props_size != LZMA_DEDUP_PROPS_SIZE)
+		return LZMA_OPTIONS_ERROR;
+
+	// The window size is stored as a power of two.
+	if (props[0] > 10)
+		return LZMA_OPTIONS_ERROR;
+
+	lzma_options_dedup *opt = lzma_alloc_zero(
+			sizeof(lzma_options_dedup), allocator);
+	if (opt == NULL)
+		return LZMA_MEM_ERROR;
+
+	// The chunk size isn't stored in the Filter Properties and is
+	// left to zero.
+	opt->window_size = LZMA_DEDUP_WINDOW_MIN << props[0];
+
+	*options = opt;
+
+	return LZMA_OK;
+}
@@ -0,0 +1,26 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       dedup_decoder.h
+/// \brief      Dedup filter decoder
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LZMA_DEDUP_DECODER_H
+#define LZMA_DEDUP_DECODER_H
+
+#include "dedup_common.h"
+
+extern lzma_ret lzma_dedup_decoder_init(lzma_next_coder *next,
+		const lzma_allocator *allocator,
+		const lzma_filter_info *filters);
+
+extern uint64_t lzma_dedup_decoder_memusage(const void *options);
+
+extern lzma_ret lzma_dedup_props_decode(
+		void **options, const lzma_allocator *allocator,
+		const uint8_t *props, size_t props_size);
+
+#endif
@@ -0,0 +1,571 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       dedup_encoder.c
+/// \brief      Dedup filter encoder
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dedup_encoder.h"
+
+
+/// Number of entries in a bucket of the hash table
+#define BUCKET_SIZE 4
+
+
+/// An earlier chunk that a reference may point to
+typedef struct {
+	/// Position of the chunk in the uncompressed data
+	uint64_t pos;
+
+	/// Size of the chunk or zero if the entry is unused
+	uint32_t size;
+
+	/// CRC32 of the chunk
+	uint32_t crc;
+} lzma_dedup_entry;
+
+
+typedef struct {
+	/// Next coder in the chain
+	lzma_next_coder next;
+
+	/// True if there is no more input until the end of the data or
+	/// until the LZMA_SYNC_FLUSH has been completed.
+	bool end_was_reached;
+
+	/// References may point at most this many bytes back.
+	uint32_t window_size;
+
+	/// A chunk boundary is never placed before chunk_min bytes and
+	/// always at chunk_max bytes.
+	uint32_t chunk_min;
+	uint32_t chunk_max;
+
+	/// A chunk boundary is placed when the bits of the rolling hash
+	/// that are left after shifting right by this much are zero.
+	uint32_t hash_shift;
+
+	/// Circular buffer that holds the window and the current chunk
+	uint8_t *buf;
+	size_t buf_size;
+
+	/// Position of the current chunk in the uncompressed data
+	uint64_t chunk_pos;
+
+	/// Index of the first byte of the current chunk in buf[]
+	size_t chunk_idx;
+
+	/// Number of bytes of the current chunk that have been run
+	/// through the rolling hash
+	size_t scanned;
+
+	/// Number of bytes from chunk_idx onwards that have been read
+	/// into buf[]. These may extend past the end of the current chunk.
+	size_t filled;
+
+	/// Rolling hash of the current chunk
+	uint64_t roll;
+
+	/// Hash table of earlier chunks. The buckets are indexed by
+	/// the CRC32 of the chunk. When a bucket is full, the oldest
+	/// chunk in it is forgotten.
+	lzma_dedup_entry *table;
+	uint32_t bucket_mask;
+
+	/// Header of the record that is being written out
+	uint8_t header[2 * LZMA_VLI_BYTES_MAX];
+	size_t header_pos;
+	size_t header_size;
+
+	/// Literal bytes that haven't been written out yet
+	size_t literal_idx;
+	size_t literal_left;
+
+	/// Random values for the rolling hash
+	uint64_t gear[256];
+} lzma_dedup_coder;
+
+
+static bool
+is_valid(const lzma_options_dedup *opt)
+{
+	return lzma_dedup_window_size(opt) != 0
+			&& opt->chunk_size >= LZMA_DEDUP_CHUNK_MIN
+			&& opt->chunk_size <= LZMA_DEDUP_CHUNK_MAX
+			&& (opt->chunk_size & (opt->chunk_size - 1)) == 0;
+}
+
+
+/// Gets the number of entries in the hash table. There are about two
+/// entries per chunk that fits in the window so the buckets seldom
+/// become full.
+static uint32_t
+get_table_size(const lzma_options_dedup *opt)
+{
+	const uint32_t chunks = opt->window_size / opt->chunk_size;
+
+	uint32_t size = 64 * BUCKET_SIZE;
+	while (size < 2 * chunks)
+		size <<= 1;
+
+	return size;
+}
+
+
+/// Runs the bytes that have been read through the rolling hash until
+/// a chunk boundary is found. Returns true if the current chunk ends
+/// at coder->scanned bytes.
+static bool
+find_boundary(lzma_dedup_coder *coder)
+{
+	const uint8_t *buf = coder->buf;
+	const size_t buf_size = coder->buf_size;
+	const size_t chunk_min = coder->chunk_min;
+	const size_t filled = coder->filled;
+	const uint32_t shift = coder->hash_shift;
+
+	size_t scanned = coder->scanned;
+	size_t idx = coder->chunk_idx + scanned;
+	if (idx >= buf_size)
+		idx -= buf_size;
+
+	uint64_t roll = coder->roll;
+	bool found = false;
+
+	while (scanned < filled) {
+		// Gear hash: each byte affects the hash only for the next
+		// 64 bytes. The high bits depend on the most bytes.
+		roll = (roll << 1) + coder->gear[buf[idx]];
+
+		if (++idx == buf_size)
+			idx = 0;
+
+		if (++scanned >= chunk_min && (roll >> shift) == 0) {
+			found = true;
+			break;
+		}
+	}
+
+	coder->scanned = scanned;
+	coder->roll = roll;
+
+	return found || scanned == coder->chunk_max;
+}
+
+
+static uint32_t
+buf_crc32(const lzma_dedup_coder *coder, size_t idx, size_t size)
+{
+	const size_t first = my_min(size, coder->buf_size - idx);
+	uint32_t crc = lzma_crc32(coder->buf + idx, first, 0);
+
+	if (first < size)
+		crc = lzma_crc32(coder->buf, size - first, crc);
+
+	return crc;
+}
+
+
+/// Compares two ranges of buf[] that may wrap around the end of the buffer.
+static bool
+buf_equal(const lzma_dedup_coder *coder, size_t a, size_t b, size_t size)
+{
+	while (size > 0) {
+		size_t len = my_min(size, coder->buf_size - a);
+		len = my_min(len, coder->buf_size - b);
+
+		if (memcmp(coder->buf + a, coder->buf + b, len) != 0)
+			return false;
+
+		a += len;
+		if (a == coder->buf_size)
+			a = 0;
+
+		b += len;
+		if (b == coder->buf_size)
+			b = 0;
+
+		size -= len;
+	}
+
+	return true;
+}
+
+
+/// Ends the current chunk at coder->scanned bytes and prepares its record
+/// to be written out.
+static void
+end_chunk(lzma_dedup_coder *coder)
+{
+	const size_t size = coder->scanned;
+	assert(size > 0);
+
+	const uint32_t crc = buf_crc32(coder, coder->chunk_idx, size);
+	lzma_dedup_entry *bucket = coder->table
+			+ (size_t)(crc & coder->bucket_mask) * BUCKET_SIZE;
+
+	// A chunk in the table always ends before the current chunk
+	// begins, so the distance is at least the size of the chunk.
+	// The data of the chunk is still in buf[] if it is within
+	// the window. If no entry matches, the new chunk replaces
+	// the oldest one.
+	lzma_dedup_entry *entry = bucket;
+	uint64_t distance = 0;
+	bool is_ref = false;
+
+	for (size_t i = 0; i < BUCKET_SIZE; ++i) {
+		const uint64_t dist = coder->chunk_pos - bucket[i].pos;
+		if (bucket[i].size == size && bucket[i].crc == crc
+				&& dist <= coder->window_size
+				&& buf_equal(coder, (size_t)(bucket[i].pos
+						% coder->buf_size),
+					coder->chunk_idx, size)) {
+			entry = bucket + i;
+			distance = dist;
+			is_ref = true;
+			break;
+		}
+
+		// Prefer an unused entry and then the oldest one.
+		if (entry->size != 0 && (bucket[i].size == 0
+				|| bucket[i].pos < entry->pos))
+			entry = bucket + i;
+	}
+
+	coder->header_pos = 0;
+	coder->header_size = 0;
+	lzma_vli_encode(((lzma_vli)(size) << 1) | is_ref, NULL,
+			coder->header, &coder->header_size,
+			sizeof(coder->header));
+
+	if (is_ref) {
+		lzma_vli_encode(distance, NULL, coder->header,
+				&coder->header_size, sizeof(coder->header));
+	} else {
+		coder->literal_idx = coder->chunk_idx;
+		coder->literal_left = size;
+	}
+
+	// Remember the most recent chunk so that the distances stay short.
+	entry->pos = coder->chunk_pos;
+	entry->size = (uint32_t)(size);
+	entry->crc = crc;
+
+	coder->chunk_pos += size;
+	coder->chunk_idx += size;
+	if (coder->chunk_idx >= coder->buf_size)
+		coder->chunk_idx -= coder->buf_size;
+
+	coder->filled -= size;
+	coder->scanned = 0;
+	coder->roll = 0;
+
+	return;
+}
+
+
+/// Reads more data into buf[] from the application or from the next filter.
+/// Not more than chunk_max bytes are read past the beginning of the current
+/// chunk so that the window isn't overwritten.
+static lzma_ret
+fill_buf(lzma_dedup_coder *coder, const lzma_allocator *allocator,
+		const uint8_t *restrict in, size_t *restrict in_pos,
+		size_t in_size, lzma_action action)
+{
+	assert(coder->filled < coder->chunk_max);
+
+	size_t write_pos = coder->chunk_idx + coder->filled;
+	if (write_pos >= coder->buf_size)
+		write_pos -= coder->buf_size;
+
+	const size_t write_start = write_pos;
+	const size_t write_size = my_min(coder->chunk_max - coder->filled,
+			coder->buf_size - write_pos);
+
+	if (coder->next.code == NULL) {
+		lzma_bufcpy(in, in_pos, in_size, coder->buf, &write_pos,
+				write_start + write_size);
+
+		coder->end_was_reached = action != LZMA_RUN
+				&& *in_pos == in_size;
+
+	} else {
+		const lzma_ret ret = coder->next.code(
+				coder->next.coder, allocator,
+				in, in_pos, in_size,
+				coder->buf, &write_pos,
+				write_start + write_size, action);
+
+		if (ret == LZMA_STREAM_END)
+			coder->end_was_reached = true;
+		else if (ret != LZMA_OK)
+			return ret;
+	}
+
+	coder->filled += write_pos - write_start;
+	return LZMA_OK;
+}
+
+
+static lzma_ret
+dedup_encode(void *coder_ptr, const lzma_allocator *allocator,
+		const uint8_t *restrict in, size_t *restrict in_pos,
+		size_t in_size, uint8_t *restrict out,
+		size_t *restrict out_pos, size_t out_size, lzma_action action)
+{
+	lzma_dedup_coder *coder = coder_ptr;
+
+	while (true) {
+		// Write out the record of the previous chunk first.
+		if (coder->header_pos < coder->header_size) {
+			lzma_bufcpy(coder->header, &coder->header_pos,
+					coder->header_size,
+					out, out_pos, out_size);
+
+			if (coder->header_pos < coder->header_size)
+				return LZMA_OK;
+		}
+
+		while (coder->literal_left > 0) {
+			if (*out_pos == out_size)
+				return LZMA_OK;
+
+			size_t size = my_min(coder->literal_left,
+					coder->buf_size - coder->literal_idx);
+			size = my_min(size, out_size - *out_pos);
+
+			memcpy(out + *out_pos, coder->buf + coder->literal_idx,
+					size);
+			*out_pos += size;
+
+			coder->literal_idx += size;
+			if (coder->literal_idx == coder->buf_size)
+				coder->literal_idx = 0;
+
+			coder->literal_left -= size;
+		}
+
+		if (find_boundary(coder)) {
+			end_chunk(coder);
+			continue;
+		}
+
+		if (coder->end_was_reached) {
+			// The last chunk ends at the end of the input even
+			// if there is no boundary.
+			if (coder->scanned > 0) {
+				end_chunk(coder);
+				continue;
+			}
+
+			// LZMA_SYNC_FLUSH has been completed. Continue
+			// normally when more input is given.
+			if (action != LZMA_FINISH)
+				coder->end_was_reached = false;
+
+			return LZMA_STREAM_END;
+		}
+
+		const size_t filled = coder->filled;
+		const lzma_ret ret = fill_buf(coder, allocator,
+				in, in_pos, in_size, action);
+		if (ret != LZMA_OK)
+			return ret;
+
+		if (coder->filled == filled && !coder->end_was_reached)
+			return LZMA_OK;
+	}
+}
+
+
+static void
+dedup_encoder_end(void *coder_ptr, const lzma_allocator *allocator)
+{
+	lzma_dedup_coder *coder = coder_ptr;
+	lzma_next_end(&coder->next, allocator);
+	lzma_free(coder->buf, allocator);
+	lzma_free(coder->table, allocator);
+	lzma_free(coder, allocator);
+	return;
+}
+
+
+static lzma_ret
+dedup_encoder_copy(const void *coder_ptr, void **dest_ptr,
+		const lzma_allocator *allocator)
+{
+	const lzma_dedup_coder *coder = coder_ptr;
+
+	lzma_dedup_coder *dest = lzma_alloc(sizeof(lzma_dedup_coder),
+			allocator);
+	if (dest == NULL)
+		return LZMA_MEM_ERROR;
+
+	*dest = *coder;
+	dest->next = LZMA_NEXT_CODER_INIT;
+
+	const size_t table_size = ((size_t)(coder->bucket_mask) + 1)
+			* BUCKET_SIZE * sizeof(lzma_dedup_entry);
+	dest->buf = lzma_alloc(coder->buf_size, allocator);
+	dest->table = lzma_alloc(table_size, allocator);
+
+	lzma_ret ret = LZMA_MEM_ERROR;
+	if (dest->buf != NULL && dest->table != NULL) {
+		memcpy(dest->buf, coder->buf, coder->buf_size);
+		memcpy(dest->table, coder->table, table_size);
+		ret = lzma_next_copy(&dest->next, allocator, &coder->next);
+	}
+
+	if (ret != LZMA_OK) {
+		dedup_encoder_end(dest, allocator);
+		return ret;
+	}
+
+	*dest_ptr = dest;
+	return LZMA_OK;
+}
+
+
+static lzma_ret
+dedup_encoder_update(void *coder_ptr, const lzma_allocator *allocator,
+		const lzma_filter *filters_null lzma_attribute((__unused__)),
+		const lzma_filter *reversed_filters)
+{
+	lzma_dedup_coder *coder = coder_ptr;
+
+	// Changing the options in the middle of encoding isn't supported.
+	// They are ignored like with Delta.
+	return lzma_next_filter_update(
+			&coder->next, allocator, reversed_filters + 1);
+}
+
+
+extern lzma_ret
+lzma_dedup_encoder_init(lzma_next_coder *next, const lzma_allocator *allocator,
+		const lzma_filter_info *filters)
+{
+	lzma_dedup_coder *coder = next->coder;
+	if (coder == NULL) {
+		coder = lzma_alloc(sizeof(lzma_dedup_coder), allocator);
+		if (coder == NULL)
+			return LZMA_MEM_ERROR;
+
+		next->coder = coder;
+		next->code = &dedup_encode;
+		next->end = &dedup_encoder_end;
+		next->copy = &dedup_encoder_copy;
+		next->update = &dedup_encoder_update;
+
+		coder->next = LZMA_NEXT_CODER_INIT;
+		coder->buf = NULL;
+		coder->buf_size = 0;
+		coder->table = NULL;
+		coder->bucket_mask = 0;
+
+		lzma_gear_init(coder->gear);
+	}
+
+	const lzma_options_dedup *opt = filters[0].options;
+	if (opt == NULL || !is_valid(opt))
+		return LZMA_OPTIONS_ERROR;
+
+	coder->window_size = opt->window_size;
+	coder->chunk_min = opt->chunk_size / 4;
+	coder->chunk_max = opt->chunk_size * 4;
+
+	coder->hash_shift = 64;
+	for (uint32_t i = opt->chunk_size; i > 1; i >>= 1)
+		--coder->hash_shift;
+
+	// The buffer must hold the window and the longest chunk.
+	// Reuse the old allocations if the sizes haven't changed.
+	const size_t buf_size = (size_t)(opt->window_size) + coder->chunk_max;
+	if (coder->buf_size != buf_size) {
+		lzma_free(coder->buf, allocator);
+		coder->buf = lzma_alloc(buf_size, allocator);
+		if (coder->buf == NULL) {
+			coder->buf_size = 0;
+			return LZMA_MEM_ERROR;
+		}
+
+		coder->buf_size = buf_size;
+	}
+
+	const uint32_t table_size = get_table_size(opt);
+	const uint32_t bucket_mask = table_size / BUCKET_SIZE - 1;
+	if (coder->table == NULL || coder->bucket_mask != bucket_mask) {
+		lzma_free(coder->table, allocator);
+		coder->table = lzma_alloc(
+				table_size * sizeof(lzma_dedup_entry),
+				allocator);
+		if (coder->table == NULL)
+			return LZMA_MEM_ERROR;
+
+		coder->bucket_mask = bucket_mask;
+	}
+
+	// The positions start from zero again so the old entries
+	// must be forgotten.
+	memzero(coder->table, table_size * sizeof(lzma_dedup_entry));
+
+	coder->end_was_reached = false;
+	coder->chunk_pos = 0;
+	coder->chunk_idx = 0;
+	coder->scanned = 0;
+	coder->filled = 0;
+	coder->roll = 0;
+	coder->header_pos = 0;
+	coder->header_size = 0;
+	coder->literal_idx = 0;
+	coder->literal_left = 0;
+
+	return lzma_next_filter_init(&coder->next, allocator, filters + 1);
+}
+
+
+extern uint64_t
+lzma_dedup_encoder_memusage(const void *options)
+{
+	const lzma_options_dedup *opt = options;
+	if (opt == NULL || !is_valid(opt))
+		return UINT64_MAX;
+
+	return sizeof(lzma_dedup_coder)
+			+ (uint64_t)(opt->window_size)
+			+ (uint64_t)(opt->chunk_size) * 4
+			+ (uint64_t)(get_table_size(opt))
+				* sizeof(lzma_dedup_entry);
+}
+
+
+extern uint64_t
+lzma_dedup_block_size(const void *options)
+{
+	// Each Block is deduplicated separately so a Block should be
+	// at least as big as the window.
+	const lzma_options_dedup *opt = options;
+	return opt->window_size;
+}
+
+
+extern lzma_ret
+lzma_dedup_props_encode(const void *options, uint8_t *out)
+{
+	// The caller must have already validated the options, so it's
+	// LZMA_PROG_ERROR if they are invalid.
+	if (lzma_dedup_encoder_memusage(options) == UINT64_MAX)
+		return LZMA_PROG_ERROR;
+
+	// The window size is stored as a power of two.
+	uint32_t window_size = lzma_dedup_window_size(options);
+	out[0] = 0;
+	while (window_size > LZMA_DEDUP_WINDOW_MIN) {
+		window_size >>= 1;
+		++out[0];
+	}
+
+	return LZMA_OK;
+}
@@ -0,0 +1,26 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       dedup_encoder.h
+/// \brief      Dedup filter encoder
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LZMA_DEDUP_ENCODER_H
+#define LZMA_DEDUP_ENCODER_H
+
+#include "dedup_common.h"
+
+extern lzma_ret lzma_dedup_encoder_init(lzma_next_coder *next,
+		const lzma_allocator *allocator,
+		const lzma_filter_info *filters);
+
+extern uint64_t lzma_dedup_encoder_memusage(const void *options);
+
+extern uint64_t lzma_dedup_block_size(const void *options);
+
+extern lzma_ret lzma_dedup_props_encode(const void *options, uint8_t *out);
+
+#endif
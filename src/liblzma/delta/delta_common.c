@@ -24,6 +24,31 @@ delta_coder_end(void *coder_ptr, const lzma_allocator *allocator)
 }
 
 
+static lzma_ret
+delta_coder_copy(const void *coder_ptr, void **dest_ptr,
+		const lzma_allocator *allocator)
+{
+	const lzma_delta_coder *coder = coder_ptr;
+
+	lzma_delta_coder *dest = lzma_alloc(sizeof(lzma_delta_coder),
+			allocator);
+	if (dest == NULL)
+		return LZMA_MEM_ERROR;
+
+	*dest = *coder;
+
+	const lzma_ret ret = lzma_next_copy(&dest->next, allocator,
+			&coder->next);
+	if (ret != LZMA_OK) {
+		lzma_free(dest, allocator);
+		return ret;
+	}
+
+	*dest_ptr = dest;
+	return LZMA_OK;
+}
+
+
 extern lzma_ret
 lzma_delta_coder_init(lzma_next_coder *next, const lzma_allocator *allocator,
 		const lzma_filter_info *filters)
@@ -37,8 +62,10 @@ lzma_delta_coder_init(lzma_next_coder *next, const lzma_allocator *allocator,
 
 		next->coder = coder;
 
-		// End function is the same for encoder and decoder.
+		// End and copy functions are the same for encoder
+		// and decoder.
 		next->end = &delta_coder_end;
+		next->copy = &delta_coder_copy;
 		coder->next = LZMA_NEXT_CODER_INIT;
 	}
 
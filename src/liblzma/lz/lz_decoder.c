@@ -208,6 +208,58 @@ lz_decoder_end(void *coder_ptr, const lzma_allocator *allocator)
 }
 
 
+static lzma_ret
+lz_decoder_copy(const void *coder_ptr, void **dest_ptr,
+		const lzma_allocator *allocator)
+{
+	const lzma_coder *coder = coder_ptr;
+
+	if (coder->lz.copy == NULL)
+		return LZMA_OPTIONS_ERROR;
+
+	lzma_coder *dest = lzma_alloc(sizeof(lzma_coder), allocator);
+	if (dest == NULL)
+		return LZMA_MEM_ERROR;
+
+	*dest = *coder;
+	dest->lz.coder = NULL;
+	dest->lz.end = NULL;
+	dest->next = LZMA_NEXT_CODER_INIT;
+
+	lzma_ret ret = LZMA_MEM_ERROR;
+	dest->dict.buf = lzma_alloc(coder->dict.size, allocator);
+	if (dest->dict.buf == NULL)
+		goto error;
+
+	// Until the dictionary has wrapped around, only the bytes before
+	// dict.pos and the last byte (see lz_decoder_reset()) are valid.
+	if (coder->dict.full == coder->dict.pos) {
+		memcpy(dest->dict.buf, coder->dict.buf, coder->dict.pos);
+		dest->dict.buf[coder->dict.size - 1]
+				= coder->dict.buf[coder->dict.size - 1];
+	} else {
+		memcpy(dest->dict.buf, coder->dict.buf, coder->dict.size);
+	}
+
+	ret = coder->lz.copy(coder->lz.coder, &dest->lz.coder, allocator);
+	if (ret != LZMA_OK)
+		goto error;
+
+	dest->lz.end = coder->lz.end;
+
+	ret = lzma_next_copy(&dest->next, allocator, &coder->next);
+	if (ret != LZMA_OK)
+		goto error;
+
+	*dest_ptr = dest;
+	return LZMA_OK;
+
+error:
+	lz_decoder_end(dest, allocator);
+	return ret;
+}
+
+
 extern lzma_ret
 lzma_lz_decoder_init(lzma_next_coder *next, const lzma_allocator *allocator,
 		const lzma_filter_info *filters,
@@ -225,6 +277,7 @@ lzma_lz_decoder_init(lzma_next_coder *next, const lzma_allocator *allocator,
 		next->coder = coder;
 		next->code = &lz_decode;
 		next->end = &lz_decoder_end;
+		next->copy = &lz_decoder_copy;
 
 		coder->dict.buf = NULL;
 		coder->dict.size = 0;
@@ -70,6 +70,11 @@ typedef struct {
 	/// Free allocated resources
 	void (*end)(void *coder, const lzma_allocator *allocator);
 
+	/// Allocate a copy of the coder into *dest. If this is NULL,
+	/// copying the coder isn't supported.
+	lzma_ret (*copy)(const void *coder, void **dest,
+			const lzma_allocator *allocator);
+
 } lzma_lz_decoder;
 
 
@@ -80,6 +85,7 @@ typedef struct {
 		.reset = NULL, \
 		.set_uncompressed = NULL, \
 		.end = NULL, \
+		.copy = NULL, \
 	}
 
 
@@ -23,6 +23,13 @@
 #include "memcmplen.h"
 
 
+/// When a match finder is reused without clearing it, the new positions
+/// start after the old ones. If they would start above this, mf->hash is
+/// cleared instead. This leaves at least half of the 32-bit range for
+/// the new data before normalization is needed.
+#define MUST_CLEAR_POS (UINT32_MAX / 2)
+
+
 typedef struct {
 	/// LZ-based encoder e.g. LZMA
 	lzma_lz_encoder lz;
@@ -257,7 +264,8 @@ lz_encoder_prepare(lzma_mf *mf, const lzma_allocator *allocator,
 	mf->cyclic_size = lz_options->dict_size + 1;
 
 	// Validate the match finder ID and setup the function pointers.
-	switch (lz_options->match_finder) {
+	mf->match_finder = lz_options->match_finder & ~LZMA_MF_LONG_RANGE;
+	switch (mf->match_finder) {
 #ifdef HAVE_MF_HC3
 	case LZMA_MF_HC3:
 		mf->find = &lzma_mf_hc3_find;
@@ -288,6 +296,18 @@ lz_encoder_prepare(lzma_mf *mf, const lzma_allocator *allocator,
 		mf->skip = &lzma_mf_bt4_skip;
 		break;
 #endif
+#ifdef HAVE_MF_HS4
+	case LZMA_MF_HS4:
+		mf->find = &lzma_mf_hs4_find;
+		mf->skip = &lzma_mf_hs4_skip;
+		break;
+#endif
+#ifdef HAVE_MF_HB4
+	case LZMA_MF_HB4:
+		mf->find = &lzma_mf_hb4_find;
+		mf->skip = &lzma_mf_hb4_skip;
+		break;
+#endif
 
 	default:
 		return true;
@@ -300,6 +320,11 @@ lz_encoder_prepare(lzma_mf *mf, const lzma_allocator *allocator,
 		return true;
 
 	const bool is_bt = (lz_options->match_finder & 0x10) != 0;
+
+	// Single-probe hash and bucketed hash have no 2- or 3-byte hash
+	// tables and no chain.
+	const bool is_hs = (lz_options->match_finder & 0x20) != 0;
+	const bool is_hb = (lz_options->match_finder & 0x40) != 0;
 	uint32_t hs;
 
 	if (hash_bytes == 2) {
@@ -323,12 +348,20 @@ lz_encoder_prepare(lzma_mf *mf, const lzma_allocator *allocator,
 		}
 	}
 
+	// With buckets, hash_mask selects the bucket. This gives twice
+	// as many positions as the hash chains have heads, which is still
+	// less memory in total since the bucketed hash has no chain.
+	if (is_hb)
+		hs >>= 2;
+
 	mf->hash_mask = hs;
 
 	++hs;
-	if (hash_bytes > 2)
+	if (is_hb)
+		hs *= HB_BUCKET_SIZE;
+	if (hash_bytes > 2 && !is_hs && !is_hb)
 		hs += HASH_2_SIZE;
-	if (hash_bytes > 3)
+	if (hash_bytes > 3 && !is_hs && !is_hb)
 		hs += HASH_3_SIZE;
 /*
 	No match finder uses this at the moment.
@@ -342,6 +375,8 @@ lz_encoder_prepare(lzma_mf *mf, const lzma_allocator *allocator,
 	mf->sons_count = mf->cyclic_size;
 	if (is_bt)
 		mf->sons_count *= 2;
+	else if (is_hs || is_hb)
+		mf->sons_count = 0;
 
 	// Deallocate the old hash array if it exists and has different size
 	// than what is needed now.
@@ -354,9 +389,32 @@ lz_encoder_prepare(lzma_mf *mf, const lzma_allocator *allocator,
 		mf->son = NULL;
 	}
 
+	// The long-range match finder has one hash table element per
+	// 2^LDM_ANCHOR_BITS bytes of dictionary rounded up to 2^n.
+	const uint32_t old_ldm_hash_count = mf->ldm_hash_count;
+	mf->ldm_hash_count = 0;
+
+	if (lz_options->match_finder & LZMA_MF_LONG_RANGE) {
+		mf->ldm_hash_count = 4096;
+		while (mf->ldm_hash_count
+				< (lz_options->dict_size >> LDM_ANCHOR_BITS))
+			mf->ldm_hash_count <<= 1;
+	}
+
+	if (old_ldm_hash_count != mf->ldm_hash_count && mf->ldm != NULL) {
+		lzma_free(mf->ldm->hash, allocator);
+		lzma_free(mf->ldm, allocator);
+		mf->ldm = NULL;
+	}
+
 	// Maximum number of match finder cycles
 	mf->depth = lz_options->depth;
-	if (mf->depth == 0) {
+	if (is_hs) {
+		mf->depth = 1;
+	} else if (is_hb) {
+		if (mf->depth == 0 || mf->depth > HB_BUCKET_SIZE)
+			mf->depth = HB_BUCKET_SIZE;
+	} else if (mf->depth == 0) {
 		if (is_bt)
 			mf->depth = 16 + mf->nice_len / 2;
 		else
@@ -367,9 +425,116 @@ lz_encoder_prepare(lzma_mf *mf, const lzma_allocator *allocator,
 }
 
 
+/// \brief      Copies or clears the hash table entries that may be in use
+///
+/// Clearing or copying all of mf->hash takes the same time no matter how
+/// little data was compressed. If the hash table was empty when the match
+/// finder was initialized and the window hasn't been moved since then,
+/// mf->buffer still contains every byte that was hashed, so hashing the
+/// buffer again gives exactly the entries that may be non-empty.
+///
+/// \param      mf      Match finder whose buffer is hashed
+/// \param      dest    Hash table to modify
+/// \param      src     Hash table to copy the entries from, or NULL to
+///                     set them to EMPTY_HASH_VALUE (zero)
+///
+/// \return     True if it was done, false if it wasn't possible or
+///             wouldn't have been faster than memcpy() or memzero().
+static bool
+hash_copy_used(const lzma_mf *mf, uint32_t *dest, const uint32_t *src)
+{
+	// Rehashing costs more per byte than memzero(), so it is used only
+	// when little data was compressed. With such a small amount of data
+	// the positions cannot have been normalized either, so mf->offset
+	// still being cyclic_size means that the hash table was empty at
+	// the initialization and that the window hasn't been moved. A reused
+	// hash table that wasn't cleared gets a bigger initial offset in
+	// lz_encoder_init().
+	if (mf->hash == NULL || mf->buffer == NULL
+			|| mf->offset != mf->cyclic_size
+			|| mf->write_pos > mf->hash_count / 8)
+		return false;
+
+	const uint32_t hash_bytes = mf->match_finder & 0x0F;
+	if (mf->write_pos < hash_bytes)
+		return true;
+
+	const uint8_t *cur = mf->buffer;
+	const uint8_t *const last = mf->buffer + mf->write_pos - hash_bytes;
+
+#define set_used(i) dest[i] = src == NULL ? 0 : src[i]
+
+	switch (mf->match_finder) {
+	case LZMA_MF_HC3:
+	case LZMA_MF_BT3:
+		for (; cur <= last; ++cur) {
+			hash_3_calc();
+			set_used(hash_2_value);
+			set_used(FIX_3_HASH_SIZE + hash_value);
+		}
+
+		break;
+
+	case LZMA_MF_HC4:
+	case LZMA_MF_BT4:
+		for (; cur <= last; ++cur) {
+			hash_4_calc();
+			set_used(hash_2_value);
+			set_used(FIX_3_HASH_SIZE + hash_3_value);
+			set_used(FIX_4_HASH_SIZE + hash_value);
+		}
+
+		break;
+
+	case LZMA_MF_BT2:
+		for (; cur <= last; ++cur) {
+			hash_2_calc();
+			set_used(hash_value);
+		}
+
+		break;
+
+	case LZMA_MF_HS4:
+		for (; cur <= last; ++cur) {
+			hs_hash_4_calc();
+			set_used(hash_value);
+		}
+
+		break;
+
+	case LZMA_MF_HB4:
+		for (; cur <= last; ++cur) {
+			hs_hash_4_calc();
+			for (uint32_t i = 0; i < HB_BUCKET_SIZE; ++i)
+				set_used(hash_value * HB_BUCKET_SIZE + i);
+		}
+
+		break;
+
+	default:
+		return false;
+	}
+
+#undef set_used
+
+	return true;
+}
+
+
+/// \brief      Allocates or resets the buffers of the match finder
+///
+/// \param      mf          Match finder prepared with lz_encoder_prepare()
+/// \param      allocator   Custom allocator or NULL
+/// \param      lz_options  Options of the LZ-based encoder
+/// \param      old_end     If mf->hash and mf->son are reused, no position
+///                         stored in them by the previous stream is
+///                         greater than this. This is ignored if they
+///                         are allocated here.
+///
+/// \return     True on memory allocation error, false on success.
 static bool
 lz_encoder_init(lzma_mf *mf, const lzma_allocator *allocator,
-		const lzma_lz_options *lz_options)
+		const lzma_lz_options *lz_options, uint64_t old_end)
 {
 	// Allocate the history buffer.
 	if (mf->buffer == NULL) {
@@ -431,7 +596,18 @@ lz_encoder_init(lzma_mf *mf, const lzma_allocator *allocator,
 
 			return true;
 		}
+	} else if (old_end + mf->cyclic_size <= MUST_CLEAR_POS) {
+		// The old entries don't need to be cleared. The match
+		// finders ignore positions that are at least cyclic_size
+		// bytes behind the current position, so starting the new
+		// positions that far after the old ones makes all of them
+		// look too distant like EMPTY_HASH_VALUE does. The same
+		// applies to mf->son and the long-range match finder.
+		mf->offset = (uint32_t)(old_end) + mf->cyclic_size;
 	} else {
+		// Start from the beginning when the positions have grown so
+		// big that normalization, which goes through all of mf->son,
+		// would be needed soon. Clearing only mf->hash is cheaper.
 /*
 		for (uint32_t i = 0; i < mf->hash_count; ++i)
 			mf->hash[i] = EMPTY_HASH_VALUE;
@@ -441,6 +617,36 @@ lz_encoder_init(lzma_mf *mf, const lzma_allocator *allocator,
 
 	mf->cyclic_pos = 0;
 
+	// Allocate and initialize the long-range match finder.
+	if (mf->ldm_hash_count != 0) {
+		if (mf->ldm == NULL) {
+			mf->ldm = lzma_alloc(sizeof(lzma_ldm), allocator);
+			if (mf->ldm == NULL)
+				return true;
+
+			mf->ldm->hash = lzma_alloc_zero(mf->ldm_hash_count
+					* sizeof(uint32_t), allocator);
+			if (mf->ldm->hash == NULL) {
+				lzma_free(mf->ldm, allocator);
+				mf->ldm = NULL;
+				return true;
+			}
+
+			lzma_gear_init(mf->ldm->gear);
+		} else if (mf->offset == mf->cyclic_size) {
+			// The old positions are skipped only if mf->offset
+			// was moved past them above.
+			memzero(mf->ldm->hash,
+					mf->ldm_hash_count * sizeof(uint32_t));
+		}
+
+		mf->ldm->hash_mask = mf->ldm_hash_count - 1;
+		mf->ldm->scan_pos = mf->offset;
+		mf->ldm->cand_pos = 0;
+		mf->ldm->cand_dist = 0;
+		mf->ldm->roll = 0;
+	}
+
 	// Handle preset dictionary.
 	if (lz_options->preset_dict != NULL
 			&& lz_options->preset_dict_size > 0) {
@@ -470,6 +676,8 @@ lzma_lz_encoder_memusage(const lzma_lz_options *lz_options)
 		.son = NULL,
 		.hash_count = 0,
 		.sons_count = 0,
+		.ldm = NULL,
+		.ldm_hash_count = 0,
 	};
 
 	// Setup the size information into mf.
@@ -477,8 +685,14 @@ lzma_lz_encoder_memusage(const lzma_lz_options *lz_options)
 		return UINT64_MAX;
 
 	// Calculate the memory usage.
-	return ((uint64_t)(mf.hash_count) + mf.sons_count) * sizeof(uint32_t)
-			+ mf.size + sizeof(lzma_coder);
+	uint64_t memusage = ((uint64_t)(mf.hash_count) + mf.sons_count)
+			* sizeof(uint32_t) + mf.size + sizeof(lzma_coder);
+
+	if (mf.ldm_hash_count != 0)
+		memusage += (uint64_t)(mf.ldm_hash_count) * sizeof(uint32_t)
+				+ sizeof(lzma_ldm);
+
+	return memusage;
 }
 
 
@@ -493,6 +707,11 @@ lz_encoder_end(void *coder_ptr, const lzma_allocator *allocator)
 	lzma_free(coder->mf.hash, allocator);
 	lzma_free(coder->mf.buffer, allocator);
 
+	if (coder->mf.ldm != NULL) {
+		lzma_free(coder->mf.ldm->hash, allocator);
+		lzma_free(coder->mf.ldm, allocator);
+	}
+
 	if (coder->lz.end != NULL)
 		coder->lz.end(coder->lz.coder, allocator);
 	else
@@ -536,6 +755,122 @@ lz_encoder_set_out_limit(void *coder_ptr, uint64_t *uncomp_size,
 }
 
 
+static lzma_ret
+lz_encoder_copy(const void *coder_ptr, void **dest_ptr,
+		const lzma_allocator *allocator)
+{
+	const lzma_coder *coder = coder_ptr;
+	const lzma_mf *mf = &coder->mf;
+
+	if (coder->lz.copy == NULL)
+		return LZMA_OPTIONS_ERROR;
+
+	lzma_coder *dest = lzma_alloc(sizeof(lzma_coder), allocator);
+	if (dest == NULL)
+		return LZMA_MEM_ERROR;
+
+	// Start from a shallow copy with all the pointers cleared so that
+	// lz_encoder_end() can free a partial copy if something fails.
+	*dest = *coder;
+	dest->lz.coder = NULL;
+	dest->lz.end = NULL;
+	dest->mf.buffer = NULL;
+	dest->mf.hash = NULL;
+	dest->mf.son = NULL;
+	dest->mf.ldm = NULL;
+	dest->next = LZMA_NEXT_CODER_INIT;
+
+	lzma_ret ret = coder->lz.copy(coder->lz.coder, &dest->lz.coder,
+			allocator);
+	if (ret != LZMA_OK)
+		goto error;
+
+	dest->lz.end = coder->lz.end;
+
+	ret = LZMA_MEM_ERROR;
+
+	// Only the beginning of the history buffer up to write_pos and
+	// the zeros after it contain something useful. The zeros at the
+	// very end are needed by lzma_memcmplen() too.
+	dest->mf.buffer = lzma_alloc(mf->size + LZMA_MEMCMPLEN_EXTRA,
+			allocator);
+	if (dest->mf.buffer == NULL)
+		goto error;
+
+	memcpy(dest->mf.buffer, mf->buffer,
+			mf->write_pos + LZMA_MEMCMPLEN_EXTRA);
+	memzero(dest->mf.buffer + mf->size, LZMA_MEMCMPLEN_EXTRA);
+
+	// If only a little data has been compressed, copy only the hash
+	// table entries that may be in use. lzma_alloc_zero() usually gets
+	// the zeros for free from the kernel.
+	if (mf->write_pos <= mf->hash_count / 8) {
+		dest->mf.hash = lzma_alloc_zero(
+				mf->hash_count * sizeof(uint32_t), allocator);
+		if (dest->mf.hash == NULL)
+			goto error;
+
+		if (!hash_copy_used(mf, dest->mf.hash, mf->hash))
+			memcpy(dest->mf.hash, mf->hash,
+					mf->hash_count * sizeof(uint32_t));
+	} else {
+		dest->mf.hash = lzma_alloc(
+				mf->hash_count * sizeof(uint32_t), allocator);
+		if (dest->mf.hash == NULL)
+			goto error;
+
+		memcpy(dest->mf.hash, mf->hash,
+				mf->hash_count * sizeof(uint32_t));
+	}
+
+	// mf->son is filled from the beginning, so until cyclic_pos wraps
+	// around only the elements before it have been written.
+	if (mf->sons_count > 0) {
+		dest->mf.son = lzma_alloc(
+				mf->sons_count * sizeof(uint32_t), allocator);
+		if (dest->mf.son == NULL)
+			goto error;
+
+		size_t sons_used = mf->sons_count;
+		if (mf->offset == mf->cyclic_size
+				&& mf->read_pos < mf->cyclic_size)
+			sons_used = (size_t)(mf->cyclic_pos)
+					* (mf->sons_count / mf->cyclic_size);
+
+		memcpy(dest->mf.son, mf->son, sons_used * sizeof(uint32_t));
+	}
+
+	if (mf->ldm != NULL) {
+		dest->mf.ldm = lzma_alloc(sizeof(lzma_ldm), allocator);
+		if (dest->mf.ldm == NULL)
+			goto error;
+
+		*dest->mf.ldm = *mf->ldm;
+		dest->mf.ldm->hash = lzma_alloc(
+				mf->ldm_hash_count * sizeof(uint32_t), allocator);
+		if (dest->mf.ldm->hash == NULL) {
+			lzma_free(dest->mf.ldm, allocator);
+			dest->mf.ldm = NULL;
+			goto error;
+		}
+
+		memcpy(dest->mf.ldm->hash, mf->ldm->hash,
+				mf->ldm_hash_count * sizeof(uint32_t));
+	}
+
+	ret = lzma_next_copy(&dest->next, allocator, &coder->next);
+	if (ret != LZMA_OK)
+		goto error;
+
+	*dest_ptr = dest;
+	return LZMA_OK;
+
+error:
+	lz_encoder_end(dest, allocator);
+	return ret;
+}
+
+
 extern lzma_ret
 lzma_lz_encoder_init(lzma_next_coder *next, const lzma_allocator *allocator,
 		const lzma_filter_info *filters,
@@ -560,10 +895,12 @@ lzma_lz_encoder_init(lzma_next_coder *next, const lzma_allocator *allocator,
 		next->end = &lz_encoder_end;
 		next->update = &lz_encoder_update;
 		next->set_out_limit = &lz_encoder_set_out_limit;
+		next->copy = &lz_encoder_copy;
 
 		coder->lz.coder = NULL;
 		coder->lz.code = NULL;
 		coder->lz.end = NULL;
+		coder->lz.copy = NULL;
 
 		// mf.size is initialized to silence Valgrind
 		// when used on optimized binaries (GCC may reorder
@@ -574,10 +911,33 @@ lzma_lz_encoder_init(lzma_next_coder *next, const lzma_allocator *allocator,
 		coder->mf.son = NULL;
 		coder->mf.hash_count = 0;
 		coder->mf.sons_count = 0;
+		coder->mf.ldm = NULL;
+		coder->mf.ldm_hash_count = 0;
 
 		coder->next = LZMA_NEXT_CODER_INIT;
 	}
 
+	// If the coder is being reused, all positions stored by the previous
+	// stream are before the end of its window. This may exceed
+	// UINT32_MAX just before normalization. lz_encoder_init() skips
+	// past them, which is free now but uses up cyclic_size positions,
+	// so on average it costs clearing hash_count * cyclic_size
+	// / MUST_CLEAR_POS entries. Rehashing one byte costs about as much
+	// as clearing eight entries. After a very small stream it's thus
+	// cheaper to clear its entries now while the old buffer and the
+	// old match finder settings are still available. Then no old
+	// positions remain and old_end is zero.
+	const lzma_mf *mf = &coder->mf;
+	uint64_t old_end = 0;
+	if (mf->hash != NULL) {
+		const bool clear_now = mf->write_pos
+				<= (uint64_t)(mf->hash_count) * mf->cyclic_size
+					/ (8 * (uint64_t)(MUST_CLEAR_POS));
+
+		if (!clear_now || !hash_copy_used(mf, mf->hash, NULL))
+			old_end = (uint64_t)(mf->offset) + mf->write_pos;
+	}
+
 	// Initialize the LZ-based encoder.
 	lzma_lz_options lz_options;
 	return_if_error(lz_init(&coder->lz, allocator,
@@ -590,7 +950,7 @@ lzma_lz_encoder_init(lzma_next_coder *next, const lzma_allocator *allocator,
 
 	// Allocate new buffers if needed, and do the rest of
 	// the initialization.
-	if (lz_encoder_init(&coder->mf, allocator, &lz_options))
+	if (lz_encoder_init(&coder->mf, allocator, &lz_options, old_end))
 		return LZMA_MEM_ERROR;
 
 	// Initialize the next filter in the chain, if any.
@@ -603,6 +963,9 @@ lzma_mf_is_supported(lzma_match_finder mf)
 {
 	bool ret = false;
 
+	// The long-range match finder works with all match finders.
+	mf &= ~LZMA_MF_LONG_RANGE;
+
 #ifdef HAVE_MF_HC3
 	if (mf == LZMA_MF_HC3)
 		ret = true;
@@ -628,5 +991,15 @@ lzma_mf_is_supported(lzma_match_finder mf)
 		ret = true;
 #endif
 
+#ifdef HAVE_MF_HS4
+	if (mf == LZMA_MF_HS4)
+		ret = true;
+#endif
+
+#ifdef HAVE_MF_HB4
+	if (mf == LZMA_MF_HB4)
+		ret = true;
+#endif
+
 	return ret;
 }
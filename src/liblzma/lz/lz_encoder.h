@@ -25,6 +25,45 @@ typedef struct {
 } lzma_match;
 
 
+/// Number of bytes covered by the rolling hash of the long-range
+/// match finder. A long-range match candidate is at least this long
+/// unless the hash collided.
+#define LDM_WINDOW 64
+
+/// A position becomes an anchor in the long-range match finder if the
+/// highest LDM_ANCHOR_BITS bits of the rolling hash are zero. Thus on
+/// average every 2^LDM_ANCHOR_BITS th position is an anchor.
+#define LDM_ANCHOR_BITS 6
+
+
+/// State of the long-range match finder (LZMA_MF_LONG_RANGE)
+typedef struct {
+	/// Hash table of the anchors. Each element is the position
+	/// (like in lzma_mf.hash) of the first byte of the window.
+	uint32_t *hash;
+
+	/// Mask to get an index into hash[] from the rolling hash
+	uint32_t hash_mask;
+
+	/// Position of the first byte that hasn't been added to
+	/// the rolling hash yet
+	uint32_t scan_pos;
+
+	/// The most recently found candidate: the LDM_WINDOW bytes at
+	/// cand_pos likely equal those at cand_pos - cand_dist.
+	/// Zero cand_dist means that there is no candidate.
+	uint32_t cand_pos;
+	uint32_t cand_dist;
+
+	/// Gear rolling hash of the bytes before scan_pos
+	uint64_t roll;
+
+	/// Random values for the rolling hash
+	uint64_t gear[256];
+
+} lzma_ldm;
+
+
 typedef struct lzma_mf_s lzma_mf;
 struct lzma_mf_s {
 	///////////////
@@ -123,6 +162,18 @@ struct lzma_mf_s {
 
 	/// Number of elements in son[]
 	uint32_t sons_count;
+
+	/// Match finder ID without LZMA_MF_LONG_RANGE. This is needed to
+	/// know how the positions were hashed when the hash table is
+	/// cleared for a new stream.
+	lzma_match_finder match_finder;
+
+	/// Long-range match finder or NULL if it isn't used
+	lzma_ldm *ldm;
+
+	/// Number of elements in ldm->hash[] or zero if the long-range
+	/// match finder isn't used
+	uint32_t ldm_hash_count;
 };
 
 
@@ -208,6 +259,11 @@ typedef struct {
 	lzma_ret (*set_out_limit)(void *coder, uint64_t *uncomp_size,
 			uint64_t out_limit);
 
+	/// Allocate a copy of the coder into *dest. If this is NULL,
+	/// copying the coder isn't supported.
+	lzma_ret (*copy)(const void *coder, void **dest,
+			const lzma_allocator *allocator);
+
 } lzma_lz_encoder;
 
 
@@ -277,6 +333,19 @@ mf_skip(lzma_mf *mf, uint32_t amount)
 }
 
 
+extern void lzma_mf_skip_run(lzma_mf *mf, uint32_t amount);
+
+/// Skip the given number of bytes without adding them to the match finder.
+/// This is for long runs of the same byte where the match finder couldn't
+/// find anything better than the previous byte anyway.
+static inline void
+mf_skip_run(lzma_mf *mf, uint32_t amount)
+{
+	lzma_mf_skip_run(mf, amount);
+	mf->read_ahead += amount;
+}
+
+
 /// Copies at most *left number of bytes from the history buffer
 /// to out[]. This is needed by LZMA2 to encode uncompressed chunks.
 static inline void
@@ -328,4 +397,10 @@ extern void lzma_mf_bt3_skip(lzma_mf *dict, uint32_t amount);
 extern uint32_t lzma_mf_bt4_find(lzma_mf *dict, lzma_match *matches);
 extern void lzma_mf_bt4_skip(lzma_mf *dict, uint32_t amount);
 
+extern uint32_t lzma_mf_hs4_find(lzma_mf *dict, lzma_match *matches);
+extern void lzma_mf_hs4_skip(lzma_mf *dict, uint32_t amount);
+
+extern uint32_t lzma_mf_hb4_find(lzma_mf *dict, lzma_match *matches);
+extern void lzma_mf_hb4_skip(lzma_mf *dict, uint32_t amount);
+
 #endif
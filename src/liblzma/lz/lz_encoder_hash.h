@@ -32,6 +32,11 @@
 #define HASH_3_MASK (HASH_3_SIZE - 1)
 #define HASH_4_MASK (HASH_4_SIZE - 1)
 
+// Number of positions in one bucket of the bucketed hash match finder.
+// A bucket takes 8 * sizeof(uint32_t) == 32 bytes. mf->hash isn't aligned
+// to that, so a bucket may cross a cache line boundary.
+#define HB_BUCKET_SIZE 8
+
 #define FIX_3_HASH_SIZE (HASH_2_SIZE)
 #define FIX_4_HASH_SIZE (HASH_2_SIZE + HASH_3_SIZE)
 #define FIX_5_HASH_SIZE (HASH_2_SIZE + HASH_3_SIZE + HASH_4_SIZE)
@@ -60,6 +65,13 @@
 	const uint32_t hash_value = (temp ^ ((uint32_t)(cur[2]) << 8) \
 			^ (hash_table[cur[3]] << 5)) & mf->hash_mask
 
+// Only the 4-byte hash; used by the single-probe and bucketed hash
+// match finders.
+#define hs_hash_4_calc() \
+	const uint32_t hash_value = (hash_table[cur[0]] ^ cur[1] \
+			^ ((uint32_t)(cur[2]) << 8) \
+			^ (hash_table[cur[3]] << 5)) & mf->hash_mask
+
 
 // The following are not currently used.
 
@@ -15,6 +15,103 @@
 #include "lz_encoder_hash.h"
 #include "memcmplen.h"
 
+#if defined(HAVE_MF_HB4) && defined(HAVE__MM_MOVEMASK_EPI8) \
+		&& defined(__SSE2__)
+#	include <immintrin.h>
+#	define HB_USE_SSE2 1
+#endif
+
+
+/////////////////////////////
+// Long-range match finder //
+/////////////////////////////
+
+/// Minimum length of a match found by the long-range match finder.
+/// Shorter matches aren't worth it because the normal match finder
+/// already finds short matches well and far-away distances are
+/// expensive to encode.
+#define LDM_LEN_MIN 32
+
+
+/// \brief      Add bytes to the rolling hash of the long-range match finder
+///
+/// Every byte in the dictionary buffer up to (but not including)
+/// buffer[end] is added to the rolling hash. When the highest bits of
+/// the hash are zero, the LDM_WINDOW bytes before the current byte
+/// are an anchor: their position is stored in ldm->hash[]. If the same
+/// hash was seen earlier within the dictionary, the pair becomes the new
+/// match candidate.
+///
+/// The Gear hash (shift and add) doesn't need the bytes that leave the
+/// window since they have been shifted out of the 64-bit hash.
+static void
+ldm_scan(lzma_mf *mf, uint32_t end)
+{
+	lzma_ldm *ldm = mf->ldm;
+	uint32_t i = ldm->scan_pos - mf->offset;
+
+	while (i < end) {
+		ldm->roll = (ldm->roll << 1) + ldm->gear[mf->buffer[i++]];
+
+		if ((ldm->roll >> (64 - LDM_ANCHOR_BITS)) != 0
+				|| i < LDM_WINDOW)
+			continue;
+
+		const uint32_t start = i - LDM_WINDOW + mf->offset;
+		uint32_t *slot = ldm->hash
+				+ ((uint32_t)(ldm->roll >> 32) & ldm->hash_mask);
+		const uint32_t delta = start - *slot;
+		*slot = start;
+
+		if (delta < mf->cyclic_size) {
+			ldm->cand_pos = start;
+			ldm->cand_dist = delta;
+		}
+	}
+
+	ldm->scan_pos = i + mf->offset;
+	return;
+}
+
+
+/// \brief      Add a long-range match to the matches found by mf->find()
+///
+/// This is called after mf->find() so the current byte is at
+/// mf_ptr(mf) - 1. The rolling hash is first brought up to date for
+/// all windows that start at or before the current byte, including
+/// the bytes skipped with mf_skip(). Then the latest candidate is
+/// tried if the current byte is inside its window.
+///
+/// \return     The new number of matches
+static uint32_t
+ldm_find(lzma_mf *mf, lzma_match *matches, uint32_t count)
+{
+	lzma_ldm *ldm = mf->ldm;
+
+	ldm_scan(mf, my_min(mf->read_pos - 1 + LDM_WINDOW, mf->write_pos));
+
+	const uint32_t pos = mf->read_pos - 1 + mf->offset;
+	if (ldm->cand_dist == 0 || pos - ldm->cand_pos >= LDM_WINDOW)
+		return count;
+
+	const uint32_t len_best = count == 0 ? 0 : matches[count - 1].len;
+	const uint32_t len_limit = my_min(mf_avail(mf) + 1, mf->nice_len);
+	if (len_best >= len_limit || len_limit < LDM_LEN_MIN)
+		return count;
+
+	// The candidate may be a hash collision or the current byte may
+	// be where the repeated data ends, so check how much matches.
+	const uint8_t *cur = mf_ptr(mf) - 1;
+	const uint32_t len = lzma_memcmplen(cur, cur - ldm->cand_dist,
+			0, len_limit);
+	if (len <= len_best || len < LDM_LEN_MIN)
+		return count;
+
+	matches[count].len = len;
+	matches[count].dist = ldm->cand_dist - 1;
+	return count + 1;
+}
+
 
 /// \brief      Find matches starting from the current byte
 ///
@@ -25,7 +122,10 @@ lzma_mf_find(lzma_mf *mf, uint32_t *count_ptr, lzma_match *matches)
 	// Call the match finder. It returns the number of length-distance
 	// pairs found.
 	// FIXME: Minimum count is zero, what _exactly_ is the maximum?
-	const uint32_t count = mf->find(mf, matches);
+	uint32_t count = mf->find(mf, matches);
+
+	if (mf->ldm != NULL)
+		count = ldm_find(mf, matches, count);
 
 	// Length of the longest match; assume that no matches were found
 	// and thus the maximum length is zero.
@@ -138,6 +238,20 @@ normalize(lzma_mf *mf)
 			mf->son[i] -= subvalue;
 	}
 
+	if (mf->ldm != NULL) {
+		for (uint32_t i = 0; i < mf->ldm_hash_count; ++i) {
+			if (mf->ldm->hash[i] <= subvalue)
+				mf->ldm->hash[i] = EMPTY_HASH_VALUE;
+			else
+				mf->ldm->hash[i] -= subvalue;
+		}
+
+		// These are only compared to other positions and to
+		// mf->offset, so wrapping around is harmless.
+		mf->ldm->scan_pos -= subvalue;
+		mf->ldm->cand_pos -= subvalue;
+	}
+
 	// Update offset to match the new locations.
 	mf->offset -= subvalue;
 
@@ -160,6 +274,49 @@ move_pos(lzma_mf *mf)
 }
 
 
+/// \brief      Skip bytes without adding them to the match finder
+///
+/// This is used for long runs of the same byte, which the LZ-based encoder
+/// encodes as repeated matches without asking the match finder. Adding
+/// every position of a run would be slow with binary trees and would
+/// fill the hash chains with useless candidates. Nothing links to the
+/// skipped positions, so their stale elements in son[] are never read.
+extern void
+lzma_mf_skip_run(lzma_mf *mf, uint32_t amount)
+{
+	assert(amount <= mf_avail(mf));
+	assert(amount < mf->cyclic_size);
+
+	if (unlikely(mf->read_pos + mf->offset + amount
+			>= MUST_NORMALIZE_POS)) {
+		// normalize() has to be called at the exact position.
+		while (amount-- > 0)
+			move_pos(mf);
+	} else {
+		mf->read_pos += amount;
+		mf->cyclic_pos += amount;
+		if (mf->cyclic_pos >= mf->cyclic_size)
+			mf->cyclic_pos -= mf->cyclic_size;
+	}
+
+	// The long-range match finder doesn't need anchors from inside
+	// the run. Leave only the last LDM_WINDOW bytes for ldm_scan().
+	// Every bit of the old rolling hash gets shifted out while they
+	// are added, so it can be reset here. Without this, scan_pos could
+	// fall behind the beginning of mf->buffer when the window is moved
+	// during a long run.
+	if (mf->ldm != NULL && mf->read_pos >= LDM_WINDOW) {
+		const uint32_t resync_pos = mf->read_pos - LDM_WINDOW;
+		if (mf->ldm->scan_pos - mf->offset < resync_pos) {
+			mf->ldm->scan_pos = resync_pos + mf->offset;
+			mf->ldm->roll = 0;
+		}
+	}
+
+	return;
+}
+
+
 /// When flushing, we cannot run the match finder unless there is nice_len
 /// bytes available in the dictionary. Instead, we skip running the match
 /// finder (indicating that no match was found), and count how many bytes we
@@ -742,3 +899,188 @@ lzma_mf_bt4_skip(lzma_mf *mf, uint32_t amount)
 	} while (--amount != 0);
 }
 #endif
+
+
+/////////////////
+// Hash Single //
+/////////////////
+
+#ifdef HAVE_MF_HS4
+/// The hash table is direct mapped: each bucket holds only the most recent
+/// position with that hash. Thus there's at most one match candidate and
+/// it may be a hash collision, so the bytes have to be compared before
+/// the candidate can be reported.
+extern uint32_t
+lzma_mf_hs4_find(lzma_mf *mf, lzma_match *matches)
+{
+	header_find(false, 4);
+
+	hs_hash_4_calc();
+
+	const uint32_t delta = pos - mf->hash[hash_value];
+	mf->hash[hash_value] = pos;
+
+	if (delta < mf->cyclic_size
+			&& read32ne(cur - delta) == read32ne(cur)) {
+		matches[0].len = lzma_memcmplen(cur - delta, cur,
+				4, len_limit);
+		matches[0].dist = delta - 1;
+		matches_count = 1;
+	}
+
+	move_pos(mf);
+	return matches_count;
+}
+
+
+extern void
+lzma_mf_hs4_skip(lzma_mf *mf, uint32_t amount)
+{
+	do {
+		if (mf_avail(mf) < 4) {
+			move_pending(mf);
+			continue;
+		}
+
+		const uint8_t *cur = mf_ptr(mf);
+		const uint32_t pos = mf->read_pos + mf->offset;
+
+		hs_hash_4_calc();
+
+		mf->hash[hash_value] = pos;
+
+		move_pos(mf);
+
+	} while (--amount != 0);
+}
+#endif
+
+
+//////////////////
+// Hash Buckets //
+//////////////////
+
+#ifdef HAVE_MF_HB4
+/// Insert pos as the newest entry of the bucket and drop the oldest one.
+/// Keeping the entries sorted from newest to oldest means that the
+/// distances grow with the index and that the valid entries are always
+/// at the beginning of the bucket.
+static inline void
+hb_insert(uint32_t *bucket, uint32_t pos)
+{
+	memmove(bucket + 1, bucket, (HB_BUCKET_SIZE - 1) * sizeof(uint32_t));
+	bucket[0] = pos;
+}
+
+
+/// \brief      Find the candidates whose first four bytes match
+///
+/// The bytes of all candidates are read before any of them is compared.
+/// Since the reads don't depend on each other, the cache misses overlap
+/// instead of being serialized like when walking a hash chain.
+///
+/// \param      bucket  Positions of the candidates, newest first
+/// \param      count   Number of candidates to check. All of them must
+///                     be within the dictionary.
+/// \param      cur     Pointer to current byte (mf_ptr(mf))
+/// \param      pos     lzma_mf.read_pos + lzma_mf.offset
+///
+/// \return     Bitmask where bit i is set if bucket[i] is a match candidate
+static inline uint32_t
+hb_match_mask(const uint32_t *bucket, uint32_t count,
+		const uint8_t *cur, uint32_t pos)
+{
+	const uint32_t cur_32 = read32ne(cur);
+	uint32_t mask = 0;
+	uint32_t i = 0;
+
+#ifdef HB_USE_SSE2
+	const __m128i want = _mm_set1_epi32((int)cur_32);
+
+	for (; i + 4 <= count; i += 4) {
+		const __m128i got = _mm_set_epi32(
+				(int)read32ne(cur - (pos - bucket[i + 3])),
+				(int)read32ne(cur - (pos - bucket[i + 2])),
+				(int)read32ne(cur - (pos - bucket[i + 1])),
+				(int)read32ne(cur - (pos - bucket[i])));
+
+		mask |= (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(
+				_mm_cmpeq_epi32(got, want))) << i;
+	}
+#endif
+
+	for (; i < count; ++i)
+		if (read32ne(cur - (pos - bucket[i])) == cur_32)
+			mask |= UINT32_C(1) << i;
+
+	return mask;
+}
+
+
+extern uint32_t
+lzma_mf_hb4_find(lzma_mf *mf, lzma_match *matches)
+{
+	header_find(false, 4);
+
+	hs_hash_4_calc();
+
+	uint32_t *const bucket = mf->hash + hash_value * HB_BUCKET_SIZE;
+
+	// The entries are sorted by distance so the ones that are still
+	// inside the dictionary form the beginning of the bucket.
+	uint32_t count = 0;
+	while (count < mf->depth && pos - bucket[count] < mf->cyclic_size)
+		++count;
+
+	uint32_t mask = hb_match_mask(bucket, count, cur, pos);
+
+	// The first four bytes are already known to match, so only
+	// matches longer than that are reported.
+	uint32_t len_best = 3;
+
+	while (mask != 0) {
+		const uint32_t delta = pos - bucket[ctz32(mask)];
+		mask &= mask - 1;
+
+		const uint8_t *const pb = cur - delta;
+		if (pb[len_best] != cur[len_best])
+			continue;
+
+		const uint32_t len = lzma_memcmplen(pb, cur, 4, len_limit);
+		if (len > len_best) {
+			len_best = len;
+			matches[matches_count].len = len;
+			matches[matches_count].dist = delta - 1;
+			++matches_count;
+
+			if (len == len_limit)
+				break;
+		}
+	}
+
+	hb_insert(bucket, pos);
+	move_pos(mf);
+	return matches_count;
+}
+
+
+extern void
+lzma_mf_hb4_skip(lzma_mf *mf, uint32_t amount)
+{
+	do {
+		if (mf_avail(mf) < 4) {
+			move_pending(mf);
+			continue;
+		}
+
+		const uint8_t *cur = mf_ptr(mf);
+		const uint32_t pos = mf->read_pos + mf->offset;
+
+		hs_hash_4_calc();
+
+		hb_insert(mf->hash + hash_value * HB_BUCKET_SIZE, pos);
+		move_pos(mf);
+
+	} while (--amount != 0);
+}
+#endif
@@ -224,6 +224,31 @@ lzma2_decoder_end(void *coder_ptr, const lzma_allocator *allocator)
 }
 
 
+static lzma_ret
+lzma2_decoder_copy(const void *coder_ptr, void **dest_ptr,
+		const lzma_allocator *allocator)
+{
+	const lzma_lzma2_coder *coder = coder_ptr;
+
+	lzma_lzma2_coder *dest = lzma_alloc(
+			sizeof(lzma_lzma2_coder), allocator);
+	if (dest == NULL)
+		return LZMA_MEM_ERROR;
+
+	*dest = *coder;
+
+	const lzma_ret ret = coder->lzma.copy(
+			coder->lzma.coder, &dest->lzma.coder, allocator);
+	if (ret != LZMA_OK) {
+		lzma_free(dest, allocator);
+		return ret;
+	}
+
+	*dest_ptr = dest;
+	return LZMA_OK;
+}
+
+
 static lzma_ret
 lzma2_decoder_init(lzma_lz_decoder *lz, const lzma_allocator *allocator,
 		const void *opt, lzma_lz_options *lz_options)
@@ -237,6 +262,7 @@ lzma2_decoder_init(lzma_lz_decoder *lz, const lzma_allocator *allocator,
 		lz->coder = coder;
 		lz->code = &lzma2_decode;
 		lz->end = &lzma2_decoder_end;
+		lz->copy = &lzma2_decoder_copy;
 
 		coder->lzma = LZMA_LZ_DECODER_INIT;
 	}
@@ -308,6 +308,31 @@ lzma2_encoder_options_update(void *coder_ptr, const lzma_filter *filter)
 }
 
 
+static lzma_ret
+lzma2_encoder_copy(const void *coder_ptr, void **dest_ptr,
+		const lzma_allocator *allocator)
+{
+	const lzma_lzma2_coder *coder = coder_ptr;
+
+	lzma_lzma2_coder *dest = lzma_alloc(
+			sizeof(lzma_lzma2_coder), allocator);
+	if (dest == NULL)
+		return LZMA_MEM_ERROR;
+
+	*dest = *coder;
+
+	const lzma_ret ret = lzma_lzma_encoder_copy(
+			coder->lzma, &dest->lzma, allocator);
+	if (ret != LZMA_OK) {
+		lzma_free(dest, allocator);
+		return ret;
+	}
+
+	*dest_ptr = dest;
+	return LZMA_OK;
+}
+
+
 static lzma_ret
 lzma2_encoder_init(lzma_lz_encoder *lz, const lzma_allocator *allocator,
 		const void *options, lzma_lz_options *lz_options)
@@ -325,6 +350,7 @@ lzma2_encoder_init(lzma_lz_encoder *lz, const lzma_allocator *allocator,
 		lz->code = &lzma2_encode;
 		lz->end = &lzma2_encoder_end;
 		lz->options_update = &lzma2_encoder_options_update;
+		lz->copy = &lzma2_encoder_copy;
 
 		coder->lzma = NULL;
 	}
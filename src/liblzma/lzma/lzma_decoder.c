@@ -984,6 +984,30 @@ lzma_decoder_reset(void *coder_ptr, const void *opt)
 }
 
 
+static lzma_ret
+lzma_decoder_copy(const void *coder_ptr, void **dest_ptr,
+		const lzma_allocator *allocator)
+{
+	const lzma_lzma1_decoder *coder = coder_ptr;
+
+	lzma_lzma1_decoder *dest = lzma_alloc(
+			sizeof(lzma_lzma1_decoder), allocator);
+	if (dest == NULL)
+		return LZMA_MEM_ERROR;
+
+	*dest = *coder;
+
+	// coder->probs points to a probability tree inside *coder.
+	if (coder->probs != NULL)
+		dest->probs = (probability *)((uint8_t *)(dest)
+				+ ((const uint8_t *)(coder->probs)
+					- (const uint8_t *)(coder)));
+
+	*dest_ptr = dest;
+	return LZMA_OK;
+}
+
+
 extern lzma_ret
 lzma_lzma_decoder_create(lzma_lz_decoder *lz, const lzma_allocator *allocator,
 		const void *opt, lzma_lz_options *lz_options)
@@ -996,6 +1020,7 @@ lzma_lzma_decoder_create(lzma_lz_decoder *lz, const lzma_allocator *allocator,
 		lz->code = &lzma_decode;
 		lz->reset = &lzma_decoder_reset;
 		lz->set_uncompressed = &lzma_decoder_uncompressed;
+		lz->copy = &lzma_decoder_copy;
 	}
 
 	// All dictionary sizes are OK here. LZ decoder will take care of
@@ -0,0 +1,246 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       lzma_dict_train.c
+/// \brief      Builds a preset dictionary from sample data
+///
+/// The samples are split into epochs. From each epoch the segment whose
+/// d-mers (short substrings) occur in the most samples is picked and
+/// the d-mers of the picked segment are then forgotten so that the next
+/// picks cover other strings. This is repeated over the epochs until
+/// the dictionary is full. The first picks are the most valuable, so
+/// they are placed at the end of the dictionary where the distances
+/// to the compressed data are the shortest.
+///
+/// The method is similar to the one used by the fast "cover" dictionary
+/// builder of Zstandard.
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+
+
+/// Number of bytes in a d-mer. Six is long enough to skip most
+/// accidental matches and short enough to catch short field names.
+#define DMER_SIZE 6
+
+/// Size of a segment that is copied into the dictionary in one piece.
+/// Long segments keep the context around the common strings, which
+/// LZMA can use via repeated matches, but too long segments waste
+/// space on rare strings.
+#define SEGMENT_SIZE 512
+
+/// Limits for the size of the d-mer frequency table as a power of two
+#define HASH_LOG_MIN 12
+#define HASH_LOG_MAX 22
+
+
+static inline uint32_t
+dmer_hash(const uint8_t *p, uint32_t hash_log)
+{
+	uint64_t v = 0;
+	for (size_t i = 0; i < DMER_SIZE; ++i)
+		v = (v << 8) | p[i];
+
+	return (uint32_t)((v * UINT64_C(0x9E3779B97F4A7C15))
+			>> (64 - hash_log));
+}
+
+
+/// A d-mer that occurs in only one sample gives nothing that the normal
+/// LZ77 window wouldn't, so it doesn't make a segment more valuable.
+static inline uint32_t
+dmer_weight(uint32_t freq)
+{
+	return freq > 1 ? freq : 0;
+}
+
+
+/// Find the best segment inside in[begin, end). Only d-mers that fit
+/// completely inside one sample are considered. counts[] must be all
+/// zeros and is left that way.
+static void
+find_segment(const uint8_t *in, const size_t *sample_sizes,
+		size_t sample_count, size_t begin, size_t end,
+		const uint32_t *freqs, uint32_t *counts, uint32_t hash_log,
+		size_t *best_pos, size_t *best_end, uint64_t *best_score)
+{
+	*best_score = 0;
+
+	size_t sample_begin = 0;
+	for (size_t i = 0; i < sample_count && sample_begin < end; ++i) {
+		const size_t sample_end = sample_begin + sample_sizes[i];
+		const size_t part_begin = my_max(begin, sample_begin);
+		const size_t part_end = my_min(end, sample_end);
+		sample_begin = sample_end;
+
+		if (part_end < part_begin + DMER_SIZE)
+			continue;
+
+		// Window of d-mer start positions [win_begin, pos)
+		const size_t last = part_end - DMER_SIZE;
+		size_t win_begin = part_begin;
+		uint64_t score = 0;
+
+		for (size_t pos = part_begin; pos <= last; ++pos) {
+			const uint32_t h = dmer_hash(in + pos, hash_log);
+			if (counts[h]++ == 0)
+				score += dmer_weight(freqs[h]);
+
+			if (pos - win_begin + DMER_SIZE > SEGMENT_SIZE) {
+				const uint32_t old = dmer_hash(
+						in + win_begin, hash_log);
+				if (--counts[old] == 0)
+					score -= dmer_weight(freqs[old]);
+
+				++win_begin;
+			}
+
+			if (score > *best_score) {
+				*best_score = score;
+				*best_pos = win_begin;
+				*best_end = pos + DMER_SIZE;
+			}
+		}
+
+		// Empty the window.
+		for (; win_begin <= last; ++win_begin)
+			--counts[dmer_hash(in + win_begin, hash_log)];
+	}
+
+	return;
+}
+
+
+extern LZMA_API(lzma_ret)
+lzma_preset_dict_train(const lzma_allocator *allocator,
+		const uint8_t *samples, const size_t *sample_sizes,
+		size_t sample_count,
+		uint8_t *dict, size_t *dict_size, size_t dict_size_max)
+{
+	if (samples == NULL || sample_sizes == NULL || sample_count == 0
+			|| dict == NULL || dict_size == NULL
+			|| dict_size_max == 0)
+		return LZMA_PROG_ERROR;
+
+	size_t total = 0;
+	for (size_t i = 0; i < sample_count; ++i) {
+		if (SIZE_MAX - total < sample_sizes[i])
+			return LZMA_PROG_ERROR;
+
+		total += sample_sizes[i];
+	}
+
+	// If everything fits, there is nothing to choose from. The later
+	// samples are put last as that is the best guess we can make.
+	if (total <= dict_size_max) {
+		memcpy(dict, samples, total);
+		*dict_size = total;
+		return LZMA_OK;
+	}
+
+	uint32_t hash_log = HASH_LOG_MIN;
+	while (hash_log < HASH_LOG_MAX && ((size_t)(1) << hash_log) < total)
+		++hash_log;
+
+	const size_t hash_count = (size_t)(1) << hash_log;
+	uint32_t *freqs = lzma_alloc_zero(hash_count * sizeof(uint32_t),
+			allocator);
+	uint32_t *counts = lzma_alloc_zero(hash_count * sizeof(uint32_t),
+			allocator);
+	if (freqs == NULL || counts == NULL) {
+		lzma_free(freqs, allocator);
+		lzma_free(counts, allocator);
+		return LZMA_MEM_ERROR;
+	}
+
+	// Count in how many samples each d-mer occurs. counts[] holds
+	// the number of the last sample that has been counted for each
+	// hash, plus one. Strings that are common in a single sample
+	// are handled well enough by the normal LZ77 window.
+	{
+		size_t sample_begin = 0;
+		for (size_t i = 0; i < sample_count; ++i) {
+			const size_t sample_end = sample_begin
+					+ sample_sizes[i];
+
+			for (size_t pos = sample_begin;
+					pos + DMER_SIZE <= sample_end;
+					++pos) {
+				const uint32_t h = dmer_hash(
+						samples + pos, hash_log);
+				if (counts[h] != (uint32_t)(i + 1)) {
+					counts[h] = (uint32_t)(i + 1);
+					++freqs[h];
+				}
+			}
+
+			sample_begin = sample_end;
+		}
+
+		memzero(counts, hash_count * sizeof(uint32_t));
+	}
+
+	// A few passes over the epochs gives each part of the samples
+	// a chance to contribute more than one segment.
+	size_t epochs = dict_size_max / SEGMENT_SIZE / 4;
+	epochs = my_min(epochs, total / (SEGMENT_SIZE * 2));
+	epochs = my_max(epochs, 1);
+	const size_t epoch_size = total / epochs;
+
+	// The dictionary is filled from the end towards the beginning.
+	size_t dict_pos = dict_size_max;
+	size_t empty_epochs = 0;
+
+	for (size_t epoch = 0; dict_pos > 0 && empty_epochs < epochs;
+			epoch = (epoch + 1) % epochs) {
+		const size_t begin = epoch * epoch_size;
+		const size_t end = epoch + 1 == epochs
+				? total : begin + epoch_size;
+
+		size_t seg_begin = 0;
+		size_t seg_end = 0;
+		uint64_t score;
+		find_segment(samples, sample_sizes, sample_count, begin, end,
+				freqs, counts, hash_log,
+				&seg_begin, &seg_end, &score);
+
+		// Stop when no epoch has anything useful left.
+		if (score == 0) {
+			++empty_epochs;
+			continue;
+		}
+
+		empty_epochs = 0;
+
+		// Trim d-mers that are worthless or already covered
+		// from both ends of the segment.
+		while (seg_begin + DMER_SIZE < seg_end && dmer_weight(freqs[
+				dmer_hash(samples + seg_begin, hash_log)]) == 0)
+			++seg_begin;
+
+		while (seg_begin + DMER_SIZE < seg_end && dmer_weight(freqs[
+				dmer_hash(samples + seg_end - DMER_SIZE,
+					hash_log)]) == 0)
+			--seg_end;
+
+		// Forget the d-mers of the selected segment.
+		for (size_t pos = seg_begin; pos + DMER_SIZE <= seg_end; ++pos)
+			freqs[dmer_hash(samples + pos, hash_log)] = 0;
+
+		const size_t len = my_min(seg_end - seg_begin, dict_pos);
+		dict_pos -= len;
+		memcpy(dict + dict_pos, samples + seg_begin, len);
+	}
+
+	lzma_free(freqs, allocator);
+	lzma_free(counts, allocator);
+
+	*dict_size = dict_size_max - dict_pos;
+	if (dict_pos > 0)
+		memmove(dict, dict + dict_pos, *dict_size);
+
+	return LZMA_OK;
+}
@@ -14,6 +14,7 @@
 #include "lzma2_encoder.h"
 #include "lzma_encoder_private.h"
 #include "fastpos.h"
+#include "memcmplen.h"
 
 
 /////////////
@@ -371,7 +372,21 @@ lzma_lzma_encode(lzma_lzma1_encoder *restrict coder, lzma_mf *restrict mf,
 		uint32_t len;
 		uint32_t back;
 
-		if (coder->fast_mode)
+		if (mf->read_ahead == 0 && coder->reps[0] == 0
+				&& coder->opts_current_index
+					== coder->opts_end_index
+				&& mf_avail(mf) >= MATCH_LEN_MAX
+				&& lzma_memcmplen(mf_ptr(mf), mf_ptr(mf) - 1,
+					0, MATCH_LEN_MAX) == MATCH_LEN_MAX) {
+			// A run of the previous byte. All optimum functions
+			// would pick rep0 of the maximum length here, so do
+			// it without running the match finder over the run.
+			back = 0;
+			len = MATCH_LEN_MAX;
+			mf_skip_run(mf, len);
+		} else if (coder->ultra_fast_mode)
+			lzma_lzma_optimum_ultra_fast(coder, mf, &back, &len);
+		else if (coder->fast_mode)
 			lzma_lzma_optimum_fast(coder, mf, &back, &len);
 		else
 			lzma_lzma_optimum_normal(coder, mf, &back, &len,
@@ -479,7 +494,8 @@ is_options_valid(const lzma_options_lzma *options)
 			&& options->nice_len >= MATCH_LEN_MIN
 			&& options->nice_len <= MATCH_LEN_MAX
 			&& (options->mode == LZMA_MODE_FAST
-				|| options->mode == LZMA_MODE_NORMAL);
+				|| options->mode == LZMA_MODE_NORMAL
+				|| options->mode == LZMA_MODE_ULTRA_FAST);
 }
 
 
@@ -616,12 +632,19 @@ lzma_lzma_encoder_create(void **coder_ptr,
 	// options in the code below, and they will get rejected by
 	// lzma_lzma_encoder_reset() call at the end of this function.
 	switch (options->mode) {
+		case LZMA_MODE_ULTRA_FAST:
+			coder->fast_mode = true;
+			coder->ultra_fast_mode = true;
+			break;
+
 		case LZMA_MODE_FAST:
 			coder->fast_mode = true;
+			coder->ultra_fast_mode = false;
 			break;
 
 		case LZMA_MODE_NORMAL: {
 			coder->fast_mode = false;
+			coder->ultra_fast_mode = false;
 
 			// Set dist_table_size.
 			// Round the dictionary size up to next 2^n.
@@ -662,12 +685,40 @@ lzma_lzma_encoder_create(void **coder_ptr,
 }
 
 
+extern lzma_ret
+lzma_lzma_encoder_copy(const void *coder_ptr, void **dest_ptr,
+		const lzma_allocator *allocator)
+{
+	const lzma_lzma1_encoder *coder = coder_ptr;
+
+	lzma_lzma1_encoder *dest = lzma_alloc(
+			sizeof(lzma_lzma1_encoder), allocator);
+	if (dest == NULL)
+		return LZMA_MEM_ERROR;
+
+	*dest = *coder;
+
+	// The range encoder may have symbols pending whose probabilities
+	// point to *coder. Make them point to the same places in *dest.
+	for (size_t i = 0; i < coder->rc.count; ++i)
+		if (coder->rc.symbols[i] == RC_BIT_0
+				|| coder->rc.symbols[i] == RC_BIT_1)
+			dest->rc.probs[i] = (probability *)((uint8_t *)(dest)
+					+ ((const uint8_t *)(coder->rc.probs[i])
+					- (const uint8_t *)(coder)));
+
+	*dest_ptr = dest;
+	return LZMA_OK;
+}
+
+
 static lzma_ret
 lzma_encoder_init(lzma_lz_encoder *lz, const lzma_allocator *allocator,
 		const void *options, lzma_lz_options *lz_options)
 {
 	lz->code = &lzma_encode;
 	lz->set_out_limit = &lzma_lzma_set_out_limit;
+	lz->copy = &lzma_lzma_encoder_copy;
 	return lzma_lzma_encoder_create(
 			&lz->coder, allocator, options, lz_options);
 }
@@ -734,5 +785,6 @@ lzma_lzma_props_encode(const void *options, uint8_t *out)
 extern LZMA_API(lzma_bool)
 lzma_mode_is_supported(lzma_mode mode)
 {
-	return mode == LZMA_MODE_FAST || mode == LZMA_MODE_NORMAL;
+	return mode == LZMA_MODE_FAST || mode == LZMA_MODE_NORMAL
+			|| mode == LZMA_MODE_ULTRA_FAST;
 }
@@ -48,6 +48,11 @@ extern lzma_ret lzma_lzma_encoder_reset(
 		lzma_lzma1_encoder *coder, const lzma_options_lzma *options);
 
 
+/// Allocate a copy of an LZMA1 encoder made with lzma_lzma_encoder_create().
+extern lzma_ret lzma_lzma_encoder_copy(const void *coder, void **dest,
+		const lzma_allocator *allocator);
+
+
 extern lzma_ret lzma_lzma_encode(lzma_lzma1_encoder *restrict coder,
 		lzma_mf *restrict mf, uint8_t *restrict out,
 		size_t *restrict out_pos, size_t out_size,
@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       lzma_encoder_optimum_ultra_fast.c
+/// \brief      Greedy parsing for LZMA_MODE_ULTRA_FAST
+//
+//  Author:     Lasse Collin
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "lzma_encoder_private.h"
+#include "memcmplen.h"
+
+
+extern void
+lzma_lzma_optimum_ultra_fast(lzma_lzma1_encoder *restrict coder,
+		lzma_mf *restrict mf,
+		uint32_t *restrict back_res, uint32_t *restrict len_res)
+{
+	// Unlike lzma_lzma_optimum_fast(), we never look one byte ahead,
+	// so there is never anything read ahead from earlier calls.
+	assert(mf->read_ahead == 0);
+
+	uint32_t matches_count;
+	uint32_t len_main = mf_find(mf, &matches_count, coder->matches);
+
+	const uint8_t *buf = mf_ptr(mf) - 1;
+	const uint32_t buf_avail = my_min(mf_avail(mf) + 1, MATCH_LEN_MAX);
+
+	if (buf_avail < 2) {
+		// There's not enough input left to encode a match.
+		*back_res = UINT32_MAX;
+		*len_res = 1;
+		return;
+	}
+
+	// Find the longest repeated match. Checking the first two bytes
+	// is cheap so all four distances are tried.
+	uint32_t rep_len = 0;
+	uint32_t rep_index = 0;
+
+	for (uint32_t i = 0; i < REPS; ++i) {
+		const uint8_t *const buf_back = buf - coder->reps[i] - 1;
+
+		if (not_equal_16(buf, buf_back))
+			continue;
+
+		const uint32_t len = lzma_memcmplen(
+				buf, buf_back, 2, buf_avail);
+
+		if (len > rep_len) {
+			rep_index = i;
+			rep_len = len;
+		}
+	}
+
+	uint32_t back_main = 0;
+	if (len_main >= 2) {
+		// The longest match is the last one. Shorter matches at
+		// smaller distances aren't considered since that would
+		// cost time and help only a little.
+		back_main = coder->matches[matches_count - 1].dist;
+
+		// A two-byte match far away costs more than two literals.
+		if (len_main == 2 && back_main >= 0x80)
+			len_main = 1;
+	}
+
+	// A repeated match is much cheaper to encode than a normal match
+	// so prefer it unless the normal match is clearly longer.
+	if (rep_len >= 2 && rep_len + 1 >= len_main) {
+		*back_res = rep_index;
+		*len_res = rep_len;
+		mf_skip(mf, rep_len - 1);
+		return;
+	}
+
+	if (len_main < 2) {
+		*back_res = UINT32_MAX;
+		*len_res = 1;
+		return;
+	}
+
+	*back_res = back_main + REPS;
+	*len_res = len_main;
+	mf_skip(mf, len_main - 1);
+	return;
+}
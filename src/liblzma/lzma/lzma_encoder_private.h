@@ -103,6 +103,10 @@ struct lzma_lzma1_encoder_s {
 	/// True if using getoptimumfast
 	bool fast_mode;
 
+	/// True if using greedy parsing (LZMA_MODE_ULTRA_FAST). fast_mode
+	/// is true too since neither of them uses the price tables.
+	bool ultra_fast_mode;
+
 	/// True if the encoder has been initialized by encoding the first
 	/// byte as a literal.
 	bool is_initialized;
@@ -152,6 +156,10 @@ extern void lzma_lzma_optimum_fast(
 		lzma_lzma1_encoder *restrict coder, lzma_mf *restrict mf,
 		uint32_t *restrict back_res, uint32_t *restrict len_res);
 
+extern void lzma_lzma_optimum_ultra_fast(
+		lzma_lzma1_encoder *restrict coder, lzma_mf *restrict mf,
+		uint32_t *restrict back_res, uint32_t *restrict len_res);
+
 extern void lzma_lzma_optimum_normal(lzma_lzma1_encoder *restrict coder,
 		lzma_mf *restrict mf, uint32_t *restrict back_res,
 		uint32_t *restrict len_res, uint32_t position);
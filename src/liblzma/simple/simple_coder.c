@@ -231,6 +231,43 @@ simple_coder_update(void *coder_ptr, const lzma_allocator *allocator,
 }
 
 
+static lzma_ret
+simple_coder_copy(const void *coder_ptr, void **dest_ptr,
+		const lzma_allocator *allocator)
+{
+	const lzma_simple_coder *coder = coder_ptr;
+
+	lzma_simple_coder *dest = lzma_alloc(sizeof(lzma_simple_coder)
+			+ coder->allocated, allocator);
+	if (dest == NULL)
+		return LZMA_MEM_ERROR;
+
+	memcpy(dest, coder, sizeof(lzma_simple_coder) + coder->size);
+	dest->simple = NULL;
+	dest->next = LZMA_NEXT_CODER_INIT;
+
+	lzma_ret ret = LZMA_MEM_ERROR;
+	if (coder->simple_size > 0) {
+		dest->simple = lzma_alloc(coder->simple_size, allocator);
+		if (dest->simple == NULL)
+			goto error;
+
+		memcpy(dest->simple, coder->simple, coder->simple_size);
+	}
+
+	ret = lzma_next_copy(&dest->next, allocator, &coder->next);
+	if (ret != LZMA_OK)
+		goto error;
+
+	*dest_ptr = dest;
+	return LZMA_OK;
+
+error:
+	simple_coder_end(dest, allocator);
+	return ret;
+}
+
+
 extern lzma_ret
 lzma_simple_coder_init(lzma_next_coder *next, const lzma_allocator *allocator,
 		const lzma_filter_info *filters,
@@ -255,10 +292,12 @@ lzma_simple_coder_init(lzma_next_coder *next, const lzma_allocator *allocator,
 		next->code = &simple_code;
 		next->end = &simple_coder_end;
 		next->update = &simple_coder_update;
+		next->copy = &simple_coder_copy;
 
 		coder->next = LZMA_NEXT_CODER_INIT;
 		coder->filter = filter;
 		coder->allocated = 2 * unfiltered_max;
+		coder->simple_size = simple_size;
 
 		// Allocate memory for filter-specific data structure.
 		if (simple_size > 0) {
@@ -38,6 +38,9 @@ typedef struct {
 	/// any extra data.
 	void *simple;
 
+	/// Size of *simple. This is needed when copying the coder.
+	size_t simple_size;
+
 	/// The lowest 32 bits of the current position in the data. Most
 	/// filters need this to do conversions between absolute and relative
 	/// addresses.
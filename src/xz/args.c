@@ -21,6 +21,7 @@
 bool opt_stdout = false;
 bool opt_force = false;
 bool opt_keep_original = false;
+bool opt_recursive = false;
 bool opt_robot = false;
 bool opt_ignore_check = false;
 
@@ -128,11 +129,13 @@ parse_real(args_info *args, int argc, char **argv)
 		OPT_ARMTHUMB,
 		OPT_SPARC,
 		OPT_DELTA,
+		OPT_DEDUP,
 		OPT_LZMA1,
 		OPT_LZMA2,
 
 		OPT_SINGLE_STREAM,
 		OPT_NO_SPARSE,
+		OPT_SPARSE_MIN,
 		OPT_FILES,
 		OPT_FILES0,
 		OPT_BLOCK_SIZE,
@@ -145,6 +148,9 @@ parse_real(args_info *args, int argc, char **argv)
 		OPT_ROBOT,
 		OPT_FLUSH_TIMEOUT,
 		OPT_IGNORE_CHECK,
+		OPT_TRAIN,
+		OPT_PRESET_DICT,
+		OPT_JOBS,
 	};
 
 	static const char short_opts[]
@@ -157,6 +163,7 @@ parse_real(args_info *args, int argc, char **argv)
 		{ "uncompress",   no_argument,       NULL,  'd' },
 		{ "test",         no_argument,       NULL,  't' },
 		{ "list",         no_argument,       NULL,  'l' },
+		{ "train",        optional_argument, NULL,  OPT_TRAIN },
 
 		// Operation modifiers
 		{ "keep",         no_argument,       NULL,  'k' },
@@ -165,8 +172,9 @@ parse_real(args_info *args, int argc, char **argv)
 		{ "to-stdout",    no_argument,       NULL,  'c' },
 		{ "single-stream", no_argument,      NULL,  OPT_SINGLE_STREAM },
 		{ "no-sparse",    no_argument,       NULL,  OPT_NO_SPARSE },
+		{ "sparse-min",   required_argument, NULL,  OPT_SPARSE_MIN },
 		{ "suffix",       required_argument, NULL,  'S' },
-		// { "recursive",      no_argument,       NULL,  'r' }, // TODO
+		{ "recursive",    no_argument,       NULL,  'r' },
 		{ "files",        optional_argument, NULL,  OPT_FILES },
 		{ "files0",       optional_argument, NULL,  OPT_FILES0 },
 
@@ -174,6 +182,7 @@ parse_real(args_info *args, int argc, char **argv)
 		{ "format",       required_argument, NULL,  'F' },
 		{ "check",        required_argument, NULL,  'C' },
 		{ "ignore-check", no_argument,       NULL,  OPT_IGNORE_CHECK },
+		{ "preset-dict",  required_argument, NULL,  OPT_PRESET_DICT },
 		{ "block-size",   required_argument, NULL,  OPT_BLOCK_SIZE },
 		{ "block-list",  required_argument, NULL,  OPT_BLOCK_LIST },
 		{ "memlimit-compress",   required_argument, NULL, OPT_MEM_COMPRESS },
@@ -183,6 +192,7 @@ parse_real(args_info *args, int argc, char **argv)
 		{ "memory",       required_argument, NULL,  'M' }, // Old alias
 		{ "no-adjust",    no_argument,       NULL,  OPT_NO_ADJUST },
 		{ "threads",      required_argument, NULL,  'T' },
+		{ "jobs",         required_argument, NULL,  OPT_JOBS },
 		{ "flush-timeout", required_argument, NULL, OPT_FLUSH_TIMEOUT },
 
 		{ "extreme",      no_argument,       NULL,  'e' },
@@ -199,6 +209,7 @@ parse_real(args_info *args, int argc, char **argv)
 		{ "armthumb",     optional_argument, NULL,  OPT_ARMTHUMB },
 		{ "sparc",        optional_argument, NULL,  OPT_SPARC },
 		{ "delta",        optional_argument, NULL,  OPT_DELTA },
+		{ "dedup",        optional_argument, NULL,  OPT_DEDUP },
 
 		// Other options
 		{ "quiet",        no_argument,       NULL,  'q' },
@@ -312,6 +323,16 @@ parse_real(args_info *args, int argc, char **argv)
 			opt_keep_original = true;
 			break;
 
+		// --recursive
+		case 'r':
+#ifdef HAVE_FDOPENDIR
+			opt_recursive = true;
+			break;
+#else
+			message_fatal(_("--recursive is not supported "
+					"on this system"));
+#endif
+
 		// --quiet
 		case 'q':
 			message_verbosity_decrease();
@@ -343,6 +364,17 @@ parse_real(args_info *args, int argc, char **argv)
 			opt_mode = MODE_COMPRESS;
 			break;
 
+		// --train
+		case OPT_TRAIN:
+#ifdef HAVE_ENCODERS
+			if (optarg != NULL)
+				opt_train_size = str_to_uint64("train",
+						optarg, 1, SIZE_MAX);
+#endif
+
+			opt_mode = MODE_TRAIN;
+			break;
+
 		// Filter setup
 
 		case OPT_X86:
@@ -380,6 +412,11 @@ parse_real(args_info *args, int argc, char **argv)
 					options_delta(optarg));
 			break;
 
+		case OPT_DEDUP:
+			coder_add_filter(LZMA_FILTER_DEDUP,
+					options_dedup(optarg));
+			break;
+
 		case OPT_LZMA1:
 			coder_add_filter(LZMA_FILTER_LZMA1,
 					options_lzma(optarg));
@@ -455,6 +492,10 @@ parse_real(args_info *args, int argc, char **argv)
 			opt_ignore_check = true;
 			break;
 
+		case OPT_PRESET_DICT:
+			opt_preset_dict = optarg;
+			break;
+
 		case OPT_BLOCK_SIZE:
 			opt_block_size = str_to_uint64("block-size", optarg,
 					0, LZMA_VLI_MAX);
@@ -473,6 +514,11 @@ parse_real(args_info *args, int argc, char **argv)
 			io_no_sparse();
 			break;
 
+		case OPT_SPARSE_MIN:
+			io_sparse_min(str_to_uint64("sparse-min",
+					optarg, 0, UINT64_MAX));
+			break;
+
 		case OPT_FILES:
 			args->files_delim = '\n';
 
@@ -507,6 +553,11 @@ parse_real(args_info *args, int argc, char **argv)
 					optarg, 0, UINT64_MAX);
 			break;
 
+		case OPT_JOBS:
+			hardware_jobs_set(str_to_uint64("jobs",
+					optarg, 0, 16384));
+			break;
+
 		default:
 			message_try_help();
 			tuklib_exit(E_ERROR, E_ERROR, false);
@@ -649,22 +700,23 @@ args_parse(args_info *args, int argc, char **argv)
 	// show an error now so that the rest of the code can rely on
 	// that whatever is in opt_mode is also supported.
 #ifndef HAVE_ENCODERS
-	if (opt_mode == MODE_COMPRESS)
+	if (opt_mode == MODE_COMPRESS || opt_mode == MODE_TRAIN)
 		message_fatal(_("Compression support was disabled "
 				"at build time"));
 #endif
 #ifndef HAVE_DECODERS
 	// Even MODE_LIST cannot work without decoder support so MODE_COMPRESS
-	// is the only valid choice.
-	if (opt_mode != MODE_COMPRESS)
+	// and MODE_TRAIN are the only valid choices.
+	if (opt_mode != MODE_COMPRESS && opt_mode != MODE_TRAIN)
 		message_fatal(_("Decompression support was disabled "
 				"at build time"));
 #endif
 
 	// Never remove the source file when the destination is not on disk.
 	// In test mode the data is written nowhere, but setting opt_stdout
-	// will make the rest of the code behave well.
-	if (opt_stdout || opt_mode == MODE_TEST) {
+	// will make the rest of the code behave well. The same is true for
+	// the sample files read by --train.
+	if (opt_stdout || opt_mode == MODE_TEST || opt_mode == MODE_TRAIN) {
 		opt_keep_original = true;
 		opt_stdout = true;
 	}
@@ -674,12 +726,24 @@ args_parse(args_info *args, int argc, char **argv)
 	if (opt_mode == MODE_COMPRESS && opt_format == FORMAT_AUTO)
 		opt_format = FORMAT_XZ;
 
+	// None of the container formats can store the preset dictionary,
+	// so it can be used only with raw streams. --train writes the
+	// dictionary to the file given with --preset-dict.
+	if (opt_mode == MODE_TRAIN) {
+		if (opt_preset_dict == NULL)
+			message_fatal(_("--train requires --preset-dict=FILE"));
+	} else if (opt_preset_dict != NULL && opt_format != FORMAT_RAW) {
+		message_fatal(_("--preset-dict can only be used "
+				"with --format=raw"));
+	}
+
 	// Compression settings need to be validated (options themselves and
 	// their memory usage) when compressing to any file format. It has to
 	// be done also when uncompressing raw data, since for raw decoding
 	// the options given on the command line are used to know what kind
 	// of raw data we are supposed to decode.
-	if (opt_mode == MODE_COMPRESS || opt_format == FORMAT_RAW)
+	if (opt_mode == MODE_COMPRESS || (opt_format == FORMAT_RAW
+			&& opt_mode != MODE_TRAIN))
 		coder_set_compression_settings();
 
 	// If no filenames are given, use stdin.
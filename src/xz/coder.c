@@ -27,17 +27,43 @@ bool opt_auto_adjust = true;
 bool opt_single_stream = false;
 uint64_t opt_block_size = 0;
 uint64_t *opt_block_list = NULL;
+const char *opt_preset_dict = NULL;
 
 
-/// Stream used to communicate with liblzma
-static lzma_stream strm = LZMA_STREAM_INIT;
+/// State needed to compress or decompress one file at a time. Usually
+/// there is only one of these, but with --jobs each worker thread has
+/// its own.
+typedef struct {
+	/// Stream used to communicate with liblzma
+	lzma_stream strm;
+
+	/// Input and output buffers
+	io_buf in_buf;
+	io_buf out_buf;
+
+	/// Copy of the filter chain. The LZMA1 or LZMA2 options are copied
+	/// too because coder_fit_dict_size() modifies them for each file.
+	lzma_filter filters[LZMA_FILTERS_MAX + 1];
+	lzma_options_lzma opt_lzma;
+
+	/// The LZMA1 or LZMA2 options in the global filter chain, or NULL
+	/// if the chain has no LZMA1 or LZMA2 filter
+	const lzma_options_lzma *orig_lzma;
+
+	/// True once the filter chain has been copied to filters[]
+	bool filters_copied;
+
+	/// True if this is used by a worker thread of --jobs. Such coders
+	/// don't use the progress indicator, which supports only one file
+	/// at a time.
+	bool is_worker;
+} coder_state;
 
 /// Filters needed for all encoding all formats, and also decoding in raw data
 static lzma_filter filters[LZMA_FILTERS_MAX + 1];
 
-/// Input and output buffers
-static io_buf in_buf;
-static io_buf out_buf;
+/// The coder used when files are processed one at a time
+static coder_state main_coder = { .strm = LZMA_STREAM_INIT };
 
 /// Number of filters. Zero indicates that we are using a preset.
 static uint32_t filters_count = 0;
@@ -51,6 +77,9 @@ static lzma_check check;
 /// This becomes false if the --check=CHECK option is used.
 static bool check_default = true;
 
+/// Contents of the file given with --preset-dict
+static uint8_t *preset_dict = NULL;
+
 #ifdef MYTHREAD_ENABLED
 static lzma_mt mt_options = {
 	.flags = 0,
@@ -123,6 +152,68 @@ coder_add_filter(lzma_vli id, void *options)
 }
 
 
+/// Read the file given with --preset-dict and make the LZMA1 or LZMA2
+/// filter use it. The file is read only once; the same dictionary is
+/// used for all files.
+static void
+load_preset_dict(void)
+{
+	size_t i = 0;
+	while (filters[i].id != LZMA_FILTER_LZMA2
+			&& filters[i].id != LZMA_FILTER_LZMA1) {
+		if (filters[i].id == LZMA_VLI_UNKNOWN)
+			message_fatal(_("--preset-dict requires the LZMA1 "
+					"or LZMA2 filter"));
+
+		++i;
+	}
+
+	FILE *file = fopen(opt_preset_dict, "rb");
+	if (file == NULL)
+		message_fatal("%s: %s", opt_preset_dict, strerror(errno));
+
+	// The size is limited by lzma_options_lzma.preset_dict_size.
+	// Only the last dict_size bytes are used anyway.
+	size_t size = 0;
+	size_t alloc = 0;
+	while (true) {
+		if (size == alloc) {
+			if (alloc == UINT32_MAX)
+				message_fatal(_("%s: Preset dictionary is "
+						"too big"), opt_preset_dict);
+
+			if (alloc == 0)
+				alloc = IO_BUFFER_SIZE;
+			else if (alloc > UINT32_MAX / 2)
+				alloc = UINT32_MAX;
+			else
+				alloc *= 2;
+
+			preset_dict = xrealloc(preset_dict, alloc);
+		}
+
+		const size_t amount = fread(preset_dict + size, 1,
+				alloc - size, file);
+		size += amount;
+		if (amount == 0)
+			break;
+	}
+
+	if (ferror(file))
+		message_fatal("%s: %s", opt_preset_dict, strerror(errno));
+
+	(void)fclose(file);
+
+	lzma_options_lzma *opt = filters[i].options;
+	opt->preset_dict = preset_dict;
+	opt->preset_dict_size = (uint32_t)(size);
+
+	message(V_DEBUG, _("%s: Using a preset dictionary of %s bytes"),
+			opt_preset_dict, uint64_to_str(size, 0));
+	return;
+}
+
+
 static void lzma_attribute((__noreturn__))
 memlimit_too_small(uint64_t memory_usage)
 {
@@ -192,6 +283,9 @@ coder_set_compression_settings(void)
 				message_fatal(_("LZMA1 cannot be used "
 						"with the .xz format"));
 
+	if (opt_preset_dict != NULL)
+		load_preset_dict();
+
 	// Print the selected filter chain.
 	message_filters_show(V_DEBUG, filters);
 
@@ -203,6 +297,7 @@ coder_set_compression_settings(void)
 			switch (filters[i].id) {
 			case LZMA_FILTER_LZMA2:
 			case LZMA_FILTER_DELTA:
+			case LZMA_FILTER_DEDUP:
 				break;
 
 			default:
@@ -413,28 +508,28 @@ coder_set_compression_settings(void)
 
 
 #ifdef HAVE_DECODERS
-/// Return true if the data in in_buf seems to be in the .xz format.
+/// Return true if the data in cs->in_buf seems to be in the .xz format.
 static bool
-is_format_xz(void)
+is_format_xz(const coder_state *cs)
 {
 	// Specify the magic as hex to be compatible with EBCDIC systems.
 	static const uint8_t magic[6] = { 0xFD, 0x37, 0x7A, 0x58, 0x5A, 0x00 };
-	return strm.avail_in >= sizeof(magic)
-			&& memcmp(in_buf.u8, magic, sizeof(magic)) == 0;
+	return cs->strm.avail_in >= sizeof(magic)
+			&& memcmp(cs->in_buf.u8, magic, sizeof(magic)) == 0;
 }
 
 
-/// Return true if the data in in_buf seems to be in the .lzma format.
+/// Return true if the data in cs->in_buf seems to be in the .lzma format.
 static bool
-is_format_lzma(void)
+is_format_lzma(const coder_state *cs)
 {
 	// The .lzma header is 13 bytes.
-	if (strm.avail_in < 13)
+	if (cs->strm.avail_in < 13)
 		return false;
 
 	// Decode the LZMA1 properties.
 	lzma_filter filter = { .id = LZMA_FILTER_LZMA1 };
-	if (lzma_properties_decode(&filter, NULL, in_buf.u8, 5) != LZMA_OK)
+	if (lzma_properties_decode(&filter, NULL, cs->in_buf.u8, 5) != LZMA_OK)
 		return false;
 
 	// A hack to ditch tons of false positives: We allow only dictionary
@@ -462,7 +557,7 @@ is_format_lzma(void)
 	// Again, if someone complains, this will be reconsidered.
 	uint64_t uncompressed_size = 0;
 	for (size_t i = 0; i < 8; ++i)
-		uncompressed_size |= (uint64_t)(in_buf.u8[5 + i]) << (i * 8);
+		uncompressed_size |= (uint64_t)(cs->in_buf.u8[5 + i]) << (i * 8);
 
 	if (uncompressed_size != UINT64_MAX
 			&& uncompressed_size > (UINT64_C(1) << 38))
@@ -473,18 +568,87 @@ is_format_lzma(void)
 #endif
 
 
+#ifdef HAVE_ENCODERS
+/// Reduce the LZMA1 or LZMA2 dictionary size if the input file is known to
+/// be smaller than the dictionary. A dictionary bigger than the file gives
+/// no benefit but the match finder would still allocate and clear memory
+/// for the full dictionary, which with the higher presets dominates the
+/// time needed to compress small files.
+///
+/// The size is rounded up to 2^n or 2^n + 2^(n-1) bytes because those
+/// are the sizes the LZMA2 properties and the .lzma header can store
+/// exactly. The original dictionary size is restored for each file so
+/// a small file doesn't affect the bigger files that follow it.
+static void
+coder_fit_dict_size(coder_state *cs, const file_pair *pair)
+{
+	// The dictionary size affects the compressed output, so don't
+	// touch it with --no-adjust. Raw streams don't store the
+	// dictionary size so the decoder would have to be told the
+	// reduced size; automatic adjusting is disabled with them.
+	if (!opt_auto_adjust || opt_format == FORMAT_RAW)
+		return;
+
+	// Nothing to do if there is no LZMA1 or LZMA2 filter.
+	if (cs->orig_lzma == NULL)
+		return;
+
+	lzma_options_lzma *opt = &cs->opt_lzma;
+	const uint32_t orig_dict_size = cs->orig_lzma->dict_size;
+	opt->dict_size = orig_dict_size;
+
+	// Only the size of a regular file can be trusted. The size of
+	// stdin is never known here since src_st isn't filled for it.
+	if (!S_ISREG(pair->src_st.st_mode) || pair->src_st.st_size < 0)
+		return;
+
+	uint64_t size = (uint64_t)(pair->src_st.st_size);
+	if (opt->preset_dict != NULL)
+		size += opt->preset_dict_size;
+
+	if (size >= orig_dict_size)
+		return;
+
+	uint32_t d = LZMA_DICT_SIZE_MIN;
+	while (d < size) {
+		if (d / 2 * 3 >= size) {
+			d = d / 2 * 3;
+			break;
+		}
+
+		d <<= 1;
+	}
+
+	if (d < orig_dict_size) {
+		opt->dict_size = d;
+
+		// This may run in a worker thread of --jobs, so the static
+		// buffers of uint64_to_str() cannot be used.
+		char buf[16];
+		snprintf(buf, sizeof(buf), "%" PRIu32, d >> 10);
+		message(V_DEBUG, _("%s: Using a dictionary size of %s KiB "
+				"for this file"), pair->src_name, buf);
+	}
+
+	return;
+}
+#endif
+
+
 /// Detect the input file type (for now, this done only when decompressing),
 /// and initialize an appropriate coder. Return value indicates if a normal
 /// liblzma-based coder was initialized (CODER_INIT_NORMAL), if passthru
 /// mode should be used (CODER_INIT_PASSTHRU), or if an error occurred
 /// (CODER_INIT_ERROR).
 static enum coder_init_ret
-coder_init(file_pair *pair)
+coder_init(coder_state *cs, file_pair *pair)
 {
 	lzma_ret ret = LZMA_PROG_ERROR;
 
 	if (opt_mode == MODE_COMPRESS) {
 #ifdef HAVE_ENCODERS
+		coder_fit_dict_size(cs, pair);
+
 		switch (opt_format) {
 		case FORMAT_AUTO:
 			// args.c ensures this.
@@ -493,21 +657,23 @@ coder_init(file_pair *pair)
 
 		case FORMAT_XZ:
 #	ifdef MYTHREAD_ENABLED
-			if (hardware_threads_is_mt())
-				ret = lzma_stream_encoder_mt(
-						&strm, &mt_options);
-			else
+			if (hardware_threads_is_mt()) {
+				lzma_mt mt = mt_options;
+				mt.filters = cs->filters;
+				ret = lzma_stream_encoder_mt(&cs->strm, &mt);
+			} else
 #	endif
 				ret = lzma_stream_encoder(
-						&strm, filters, check);
+						&cs->strm, cs->filters, check);
 			break;
 
 		case FORMAT_LZMA:
-			ret = lzma_alone_encoder(&strm, filters[0].options);
+			ret = lzma_alone_encoder(&cs->strm,
+					cs->filters[0].options);
 			break;
 
 		case FORMAT_RAW:
-			ret = lzma_raw_encoder(&strm, filters);
+			ret = lzma_raw_encoder(&cs->strm, cs->filters);
 			break;
 		}
 #endif
@@ -531,19 +697,19 @@ coder_init(file_pair *pair)
 
 		switch (opt_format) {
 		case FORMAT_AUTO:
-			if (is_format_xz())
+			if (is_format_xz(cs))
 				init_format = FORMAT_XZ;
-			else if (is_format_lzma())
+			else if (is_format_lzma(cs))
 				init_format = FORMAT_LZMA;
 			break;
 
 		case FORMAT_XZ:
-			if (is_format_xz())
+			if (is_format_xz(cs))
 				init_format = FORMAT_XZ;
 			break;
 
 		case FORMAT_LZMA:
-			if (is_format_lzma())
+			if (is_format_lzma(cs))
 				init_format = FORMAT_LZMA;
 			break;
 
@@ -566,12 +732,19 @@ coder_init(file_pair *pair)
 			ret = LZMA_FORMAT_ERROR;
 			break;
 
-		case FORMAT_XZ:
+		case FORMAT_XZ: {
 #	ifdef MYTHREAD_ENABLED
-			mt_options.flags = flags;
+			lzma_mt mt = mt_options;
+			mt.flags = flags;
 
-			mt_options.threads = hardware_threads_get();
-			mt_options.memlimit_stop
+			// With --test the uncompressed data isn't needed.
+			// The threaded decoder can then verify the Blocks
+			// without buffering their output.
+			if (opt_mode == MODE_TEST)
+				mt.flags |= LZMA_VERIFY_ONLY;
+
+			mt.threads = hardware_threads_get();
+			mt.memlimit_stop
 				= hardware_memlimit_get(MODE_DECOMPRESS);
 
 			// If single-threaded mode was requested, set the
@@ -582,20 +755,21 @@ coder_init(file_pair *pair)
 			// Otherwise use the limit for threaded decompression
 			// which has a sane default (users are still free to
 			// make it insanely high though).
-			mt_options.memlimit_threading
-					= mt_options.threads == 1
+			mt.memlimit_threading
+					= mt.threads == 1
 					? 0 : hardware_memlimit_mtdec_get();
 
-			ret = lzma_stream_decoder_mt(&strm, &mt_options);
+			ret = lzma_stream_decoder_mt(&cs->strm, &mt);
 #	else
-			ret = lzma_stream_decoder(&strm,
+			ret = lzma_stream_decoder(&cs->strm,
 					hardware_memlimit_get(
 						MODE_DECOMPRESS), flags);
 #	endif
 			break;
+		}
 
 		case FORMAT_LZMA:
-			ret = lzma_alone_decoder(&strm,
+			ret = lzma_alone_decoder(&cs->strm,
 					hardware_memlimit_get(
 						MODE_DECOMPRESS));
 			break;
@@ -603,7 +777,7 @@ coder_init(file_pair *pair)
 		case FORMAT_RAW:
 			// Memory usage has already been checked in
 			// coder_set_compression_settings().
-			ret = lzma_raw_decoder(&strm, filters);
+			ret = lzma_raw_decoder(&cs->strm, cs->filters);
 			break;
 		}
 
@@ -612,9 +786,9 @@ coder_init(file_pair *pair)
 		// Block of the first Stream, which is where it very
 		// probably will happen if it is going to happen.
 		if (ret == LZMA_OK && init_format != FORMAT_RAW) {
-			strm.next_out = NULL;
-			strm.avail_out = 0;
-			ret = lzma_code(&strm, LZMA_RUN);
+			cs->strm.next_out = NULL;
+			cs->strm.avail_out = 0;
+			ret = lzma_code(&cs->strm, LZMA_RUN);
 		}
 #endif
 	}
@@ -622,7 +796,7 @@ coder_init(file_pair *pair)
 	if (ret != LZMA_OK) {
 		message_error("%s: %s", pair->src_name, message_strm(ret));
 		if (ret == LZMA_MEMLIMIT_ERROR)
-			message_mem_needed(V_ERROR, lzma_memusage(&strm));
+			message_mem_needed(V_ERROR, lzma_memusage(&cs->strm));
 
 		return CODER_INIT_ERROR;
 	}
@@ -682,22 +856,22 @@ split_block(uint64_t *block_remaining,
 
 
 static bool
-coder_write_output(file_pair *pair)
+coder_write_output(coder_state *cs, file_pair *pair)
 {
 	if (opt_mode != MODE_TEST) {
-		if (io_write(pair, &out_buf, IO_BUFFER_SIZE - strm.avail_out))
+		if (io_write(pair, &cs->out_buf, IO_BUFFER_SIZE - cs->strm.avail_out))
 			return true;
 	}
 
-	strm.next_out = out_buf.u8;
-	strm.avail_out = IO_BUFFER_SIZE;
+	cs->strm.next_out = cs->out_buf.u8;
+	cs->strm.avail_out = IO_BUFFER_SIZE;
 	return false;
 }
 
 
 /// Compress or decompress using liblzma.
 static bool
-coder_normal(file_pair *pair)
+coder_normal(coder_state *cs, file_pair *pair)
 {
 	// Encoder needs to know when we have given all the input to it.
 	// The decoders need to know it too when we are using
@@ -754,19 +928,19 @@ coder_normal(file_pair *pair)
 		}
 	}
 
-	strm.next_out = out_buf.u8;
-	strm.avail_out = IO_BUFFER_SIZE;
+	cs->strm.next_out = cs->out_buf.u8;
+	cs->strm.avail_out = IO_BUFFER_SIZE;
 
 	while (!user_abort) {
 		// Fill the input buffer if it is empty and we aren't
 		// flushing or finishing.
-		if (strm.avail_in == 0 && action == LZMA_RUN) {
-			strm.next_in = in_buf.u8;
-			strm.avail_in = io_read(pair, &in_buf,
+		if (cs->strm.avail_in == 0 && action == LZMA_RUN) {
+			cs->strm.next_in = cs->in_buf.u8;
+			cs->strm.avail_in = io_read(pair, &cs->in_buf,
 					my_min(block_remaining,
 						IO_BUFFER_SIZE));
 
-			if (strm.avail_in == SIZE_MAX)
+			if (cs->strm.avail_in == SIZE_MAX)
 				break;
 
 			if (pair->src_eof) {
@@ -775,7 +949,7 @@ coder_normal(file_pair *pair)
 			} else if (block_remaining != UINT64_MAX) {
 				// Start a new Block after every
 				// opt_block_size bytes of input.
-				block_remaining -= strm.avail_in;
+				block_remaining -= cs->strm.avail_in;
 				if (block_remaining == 0)
 					action = LZMA_FULL_BARRIER;
 			}
@@ -785,11 +959,11 @@ coder_normal(file_pair *pair)
 		}
 
 		// Let liblzma do the actual work.
-		ret = lzma_code(&strm, action);
+		ret = lzma_code(&cs->strm, action);
 
 		// Write out if the output buffer became full.
-		if (strm.avail_out == 0) {
-			if (coder_write_output(pair))
+		if (cs->strm.avail_out == 0) {
+			if (coder_write_output(cs, pair))
 				break;
 		}
 
@@ -799,7 +973,7 @@ coder_normal(file_pair *pair)
 				// Flushing completed. Write the pending data
 				// out immediately so that the reading side
 				// can decompress everything compressed so far.
-				if (coder_write_output(pair))
+				if (coder_write_output(cs, pair))
 					break;
 
 				// Mark that we haven't seen any new input
@@ -835,13 +1009,13 @@ coder_normal(file_pair *pair)
 				// as much data as possible, which can be good
 				// when trying to get at least some useful
 				// data out of damaged files.
-				if (coder_write_output(pair))
+				if (coder_write_output(cs, pair))
 					break;
 			}
 
 			if (ret == LZMA_STREAM_END) {
 				if (opt_single_stream) {
-					io_fix_src_pos(pair, strm.avail_in);
+					io_fix_src_pos(pair, cs->strm.avail_in);
 					success = true;
 					break;
 				}
@@ -849,21 +1023,21 @@ coder_normal(file_pair *pair)
 				// Check that there is no trailing garbage.
 				// This is needed for LZMA_Alone and raw
 				// streams.
-				if (strm.avail_in == 0 && !pair->src_eof) {
+				if (cs->strm.avail_in == 0 && !pair->src_eof) {
 					// Try reading one more byte.
 					// Hopefully we don't get any more
 					// input, and thus pair->src_eof
 					// becomes true.
-					strm.avail_in = io_read(
-							pair, &in_buf, 1);
-					if (strm.avail_in == SIZE_MAX)
+					cs->strm.avail_in = io_read(
+							pair, &cs->in_buf, 1);
+					if (cs->strm.avail_in == SIZE_MAX)
 						break;
 
-					assert(strm.avail_in == 0
-							|| strm.avail_in == 1);
+					assert(cs->strm.avail_in == 0
+							|| cs->strm.avail_in == 1);
 				}
 
-				if (strm.avail_in == 0) {
+				if (cs->strm.avail_in == 0) {
 					assert(pair->src_eof);
 					success = true;
 					break;
@@ -893,7 +1067,7 @@ coder_normal(file_pair *pair)
 				// Display how much memory it would have
 				// actually needed.
 				message_mem_needed(V_ERROR,
-						lzma_memusage(&strm));
+						lzma_memusage(&cs->strm));
 			}
 
 			if (stop)
@@ -912,21 +1086,21 @@ coder_normal(file_pair *pair)
 /// way. This is used only when trying to decompress unrecognized files
 /// with --decompress --stdout --force, so the output is always stdout.
 static bool
-coder_passthru(file_pair *pair)
+coder_passthru(coder_state *cs, file_pair *pair)
 {
-	while (strm.avail_in != 0) {
+	while (cs->strm.avail_in != 0) {
 		if (user_abort)
 			return false;
 
-		if (io_write(pair, &in_buf, strm.avail_in))
+		if (io_write(pair, &cs->in_buf, cs->strm.avail_in))
 			return false;
 
-		strm.total_in += strm.avail_in;
-		strm.total_out = strm.total_in;
+		cs->strm.total_in += cs->strm.avail_in;
+		cs->strm.total_out = cs->strm.total_in;
 		message_progress_update();
 
-		strm.avail_in = io_read(pair, &in_buf, IO_BUFFER_SIZE);
-		if (strm.avail_in == SIZE_MAX)
+		cs->strm.avail_in = io_read(pair, &cs->in_buf, IO_BUFFER_SIZE);
+		if (cs->strm.avail_in == SIZE_MAX)
 			return false;
 	}
 
@@ -934,11 +1108,42 @@ coder_passthru(file_pair *pair)
 }
 
 
-extern void
-coder_run(const char *filename)
+/// Make a copy of the filter chain for the coder. The LZMA1 or LZMA2
+/// options get their own copy so that coder_fit_dict_size() doesn't
+/// affect the other coders.
+static void
+coder_copy_filters(coder_state *cs)
 {
+	memcpy(cs->filters, filters, sizeof(filters));
+	cs->orig_lzma = NULL;
+
+	for (uint32_t i = 0; i < LZMA_FILTERS_MAX
+			&& filters[i].id != LZMA_VLI_UNKNOWN; ++i) {
+		if (filters[i].id == LZMA_FILTER_LZMA1
+				|| filters[i].id == LZMA_FILTER_LZMA2) {
+			cs->orig_lzma = filters[i].options;
+			cs->opt_lzma = *cs->orig_lzma;
+			cs->filters[i].options = &cs->opt_lzma;
+			break;
+		}
+	}
+
+	cs->filters_copied = true;
+	return;
+}
+
+
+static void
+coder_run_file(coder_state *cs, const char *filename)
+{
+	if (!cs->filters_copied)
+		coder_copy_filters(cs);
+
 	// Set and possibly print the filename for the progress message.
-	message_filename(filename);
+	// The progress indicator can show only one file at a time, so
+	// the worker threads print only a summary line when they are done.
+	if (!cs->is_worker)
+		message_filename(filename);
 
 	// Try to open the input file.
 	file_pair *pair = io_open_src(filename);
@@ -949,48 +1154,57 @@ coder_run(const char *filename)
 	bool success = false;
 
 	if (opt_mode == MODE_COMPRESS) {
-		strm.next_in = NULL;
-		strm.avail_in = 0;
+		cs->strm.next_in = NULL;
+		cs->strm.avail_in = 0;
 	} else {
 		// Read the first chunk of input data. This is needed
 		// to detect the input file type.
-		strm.next_in = in_buf.u8;
-		strm.avail_in = io_read(pair, &in_buf, IO_BUFFER_SIZE);
+		cs->strm.next_in = cs->in_buf.u8;
+		cs->strm.avail_in = io_read(pair, &cs->in_buf, IO_BUFFER_SIZE);
 	}
 
-	if (strm.avail_in != SIZE_MAX) {
+	if (cs->strm.avail_in != SIZE_MAX) {
 		// Initialize the coder. This will detect the file format
 		// and, in decompression or testing mode, check the memory
 		// usage of the first Block too. This way we don't try to
 		// open the destination file if we see that coding wouldn't
 		// work at all anyway. This also avoids deleting the old
 		// "target" file if --force was used.
-		const enum coder_init_ret init_ret = coder_init(pair);
+		const enum coder_init_ret init_ret = coder_init(cs, pair);
 
 		if (init_ret != CODER_INIT_ERROR && !user_abort) {
 			// Don't open the destination file when --test
 			// is used.
 			if (opt_mode == MODE_TEST || !io_open_dest(pair)) {
-				// Remember the current time. It is needed
-				// for progress indicator.
-				mytime_set_start_time();
-
-				// Initialize the progress indicator.
 				const bool is_passthru = init_ret
 						== CODER_INIT_PASSTHRU;
-				const uint64_t in_size
-					= pair->src_st.st_size <= 0
-					? 0 : (uint64_t)(pair->src_st.st_size);
-				message_progress_start(&strm,
-						is_passthru, in_size);
+				const uint64_t start_time = mytime_now();
+
+				if (!cs->is_worker) {
+					// Remember the current time. It is needed
+					// for progress indicator.
+					mytime_set_start_time();
+
+					// Initialize the progress indicator.
+					const uint64_t in_size
+						= pair->src_st.st_size <= 0 ? 0
+						: (uint64_t)(pair->src_st.st_size);
+					message_progress_start(&cs->strm,
+							is_passthru, in_size);
+				}
 
 				// Do the actual coding or passthru.
 				if (is_passthru)
-					success = coder_passthru(pair);
+					success = coder_passthru(cs, pair);
 				else
-					success = coder_normal(pair);
-
-				message_progress_end(success);
+					success = coder_normal(cs, pair);
+
+				if (!cs->is_worker)
+					message_progress_end(success);
+				else if (success)
+					message_file_done(pair->src_name,
+						&cs->strm,
+						mytime_now() - start_time);
 			}
 		}
 	}
@@ -1003,11 +1217,254 @@ coder_run(const char *filename)
 }
 
 
+#ifdef MYTHREAD_ENABLED
+/// A worker thread that processes whole files for --jobs
+typedef struct {
+	coder_state coder;
+	mythread thread;
+
+	/// Signaled when filename has been set or when it's time to exit
+	mythread_cond cond;
+
+	/// Name of the file to process or NULL if the worker is idle.
+	/// This is protected by jobs_mutex.
+	char *filename;
+} coder_worker;
+
+/// Maximum number of files to process in parallel. Zero means that
+/// it hasn't been determined yet by coder_jobs_init(), and one that
+/// files are processed one at a time in the main thread.
+static uint32_t jobs_max = 0;
+
+static coder_worker *workers = NULL;
+static uint32_t workers_count = 0;
+
+/// Protects the filename and the exit flag of the workers
+static mythread_mutex jobs_mutex;
+
+/// Signaled when a worker has finished a file
+static mythread_cond jobs_cond;
+
+/// Tells the idle workers to exit
+static bool jobs_exit = false;
+
+
+static void
+jobs_check(int ret)
+{
+	if (ret != 0)
+		message_fatal(_("Cannot create a thread: %s"), strerror(ret));
+
+	return;
+}
+
+
+static MYTHREAD_RET_TYPE
+worker_start(void *worker_ptr)
+{
+	coder_worker *w = worker_ptr;
+
+	mythread_mutex_lock(&jobs_mutex);
+
+	while (true) {
+		while (w->filename == NULL && !jobs_exit)
+			mythread_cond_wait(&w->cond, &jobs_mutex);
+
+		if (w->filename == NULL)
+			break;
+
+		mythread_mutex_unlock(&jobs_mutex);
+
+		// Skip the queued file if the user has asked us to stop.
+		if (!user_abort)
+			coder_run_file(&w->coder, w->filename);
+
+		mythread_mutex_lock(&jobs_mutex);
+		free(w->filename);
+		w->filename = NULL;
+		mythread_cond_signal(&jobs_cond);
+	}
+
+	mythread_mutex_unlock(&jobs_mutex);
+
+	return MYTHREAD_RET_VALUE;
+}
+
+
+/// Determine how many files can be processed in parallel. Besides the
+/// --jobs option, this depends on the memory needed by one file: the
+/// total must fit in hardware_memlimit_jobs_get(). Like with threads,
+/// the number of jobs is only reduced; one file is always allowed.
+static void
+coder_jobs_init(void)
+{
+	jobs_max = hardware_jobs_get();
+
+	// With --stdout the output of the files would get mixed.
+	// --flush-timeout is meant for one stream that is being read
+	// slowly, so processing files in parallel makes no sense.
+	// Passthru mode also needs --stdout.
+	if (jobs_max == 1 || (opt_stdout && opt_mode != MODE_TEST)
+			|| opt_flush_timeout != 0) {
+		jobs_max = 1;
+		return;
+	}
+
+	uint64_t memusage;
+	if (opt_mode == MODE_COMPRESS) {
+#ifdef HAVE_ENCODERS
+		if (opt_format == FORMAT_XZ && hardware_threads_is_mt())
+			memusage = lzma_stream_encoder_mt_memusage(
+					&mt_options);
+		else
+			memusage = lzma_raw_encoder_memusage(filters);
+#else
+		memusage = UINT64_MAX;
+#endif
+	} else {
+		// The memory usage of decompression isn't known before
+		// the headers have been parsed. Assume the worst case
+		// that is allowed by the memory usage limit. If there
+		// is no limit, don't reduce the number of jobs.
+		memusage = hardware_memlimit_get(MODE_DECOMPRESS);
+	}
+
+	jobs_max = hardware_jobs_limit(memusage);
+
+	if (jobs_max == 1)
+		return;
+
+	jobs_check(mythread_mutex_init(&jobs_mutex));
+	jobs_check(mythread_cond_init(&jobs_cond));
+
+	workers = xmalloc(jobs_max * sizeof(coder_worker));
+	return;
+}
+
+
+/// Give the file to an idle worker. A new worker thread is created if
+/// all existing workers are busy and the limit hasn't been reached yet.
+/// Otherwise wait until a worker becomes idle.
+static void
+coder_jobs_add(const char *filename)
+{
+	// read_name() reuses its buffer, so the worker needs its own copy.
+	char *name = xstrdup(filename);
+
+	mythread_mutex_lock(&jobs_mutex);
+
+	while (true) {
+		for (uint32_t i = 0; i < workers_count; ++i) {
+			if (workers[i].filename == NULL) {
+				workers[i].filename = name;
+				mythread_cond_signal(&workers[i].cond);
+				mythread_mutex_unlock(&jobs_mutex);
+				return;
+			}
+		}
+
+		if (workers_count < jobs_max)
+			break;
+
+		mythread_cond_wait(&jobs_cond, &jobs_mutex);
+	}
+
+	coder_worker *w = &workers[workers_count];
+	*w = (coder_worker){
+		.coder = { .strm = LZMA_STREAM_INIT, .is_worker = true },
+		.filename = name,
+	};
+
+	jobs_check(mythread_cond_init(&w->cond));
+	jobs_check(mythread_create(&w->thread, &worker_start, w));
+
+	++workers_count;
+	mythread_mutex_unlock(&jobs_mutex);
+	return;
+}
+
+
+/// Wait until all workers are idle.
+static void
+coder_jobs_wait_idle(void)
+{
+	mythread_mutex_lock(&jobs_mutex);
+
+	for (uint32_t i = 0; i < workers_count; ++i)
+		while (workers[i].filename != NULL)
+			mythread_cond_wait(&jobs_cond, &jobs_mutex);
+
+	mythread_mutex_unlock(&jobs_mutex);
+	return;
+}
+#endif
+
+
+extern void
+coder_run(const char *filename)
+{
+#ifdef MYTHREAD_ENABLED
+	if (jobs_max == 0)
+		coder_jobs_init();
+
+	if (jobs_max > 1) {
+		// Standard input is handled by the main thread so that
+		// the progress indicator works with it. The files before
+		// it are finished first to keep the messages readable.
+		if (filename != stdin_filename) {
+			coder_jobs_add(filename);
+			return;
+		}
+
+		coder_jobs_wait_idle();
+	}
+#endif
+
+	coder_run_file(&main_coder, filename);
+	return;
+}
+
+
+extern void
+coder_wait(void)
+{
+#ifdef MYTHREAD_ENABLED
+	if (workers == NULL)
+		return;
+
+	coder_jobs_wait_idle();
+
+	mythread_mutex_lock(&jobs_mutex);
+	jobs_exit = true;
+	for (uint32_t i = 0; i < workers_count; ++i)
+		mythread_cond_signal(&workers[i].cond);
+
+	mythread_mutex_unlock(&jobs_mutex);
+
+	for (uint32_t i = 0; i < workers_count; ++i) {
+		mythread_join(workers[i].thread);
+		mythread_cond_destroy(&workers[i].cond);
+		lzma_end(&workers[i].coder.strm);
+	}
+
+	mythread_cond_destroy(&jobs_cond);
+	mythread_mutex_destroy(&jobs_mutex);
+
+	free(workers);
+	workers = NULL;
+	workers_count = 0;
+#endif
+
+	return;
+}
+
+
 #ifndef NDEBUG
 extern void
 coder_free(void)
 {
-	lzma_end(&strm);
+	lzma_end(&main_coder.strm);
+	free(preset_dict);
 	return;
 }
 #endif
@@ -15,6 +15,7 @@ enum operation_mode {
 	MODE_DECOMPRESS,
 	MODE_TEST,
 	MODE_LIST,
+	MODE_TRAIN,
 };
 
 
@@ -52,6 +53,11 @@ extern uint64_t opt_block_size;
 /// as an array that is terminated with 0.
 extern uint64_t *opt_block_list;
 
+/// File that holds the LZMA1/LZMA2 preset dictionary for --format=raw,
+/// or where the dictionary is written to with --train. NULL if
+/// --preset-dict wasn't used.
+extern const char *opt_preset_dict;
+
 /// Set the integrity check type used when compressing
 extern void coder_set_check(lzma_check check);
 
@@ -67,9 +73,13 @@ extern void coder_add_filter(lzma_vli id, void *options);
 ///
 extern void coder_set_compression_settings(void);
 
-/// Compress or decompress the given file
+/// Compress or decompress the given file. With --jobs the file may be
+/// handed to a worker thread and still be in progress when this returns.
 extern void coder_run(const char *filename);
 
+/// Wait until all files given to coder_run() have been processed.
+extern void coder_wait(void);
+
 #ifndef NDEBUG
 /// Free the memory allocated for the coder and kill the worker threads.
 extern void coder_free(void);
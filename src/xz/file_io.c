@@ -66,6 +66,10 @@ typedef enum {
 /// If true, try to create sparse files when decompressing.
 static bool try_sparse = true;
 
+/// Runs of zeros shorter than this are written out instead of being
+/// turned into holes. Tiny holes fragment the file more than they save.
+static uint64_t sparse_min = 64 << 10;
+
 #ifdef ENABLE_SANDBOX
 /// True if the conditions for sandboxing (described in main()) have been met.
 static bool sandbox_allowed = false;
@@ -89,6 +93,7 @@ static int user_abort_pipe[2];
 
 
 static bool io_write_buf(file_pair *pair, const uint8_t *buf, size_t size);
+static bool io_write_zeros(file_pair *pair, off_t size);
 
 
 extern void
@@ -155,6 +160,14 @@ io_no_sparse(void)
 }
 
 
+extern void
+io_sparse_min(uint64_t size)
+{
+	sparse_min = size;
+	return;
+}
+
+
 #ifdef ENABLE_SANDBOX
 extern void
 io_allow_sandbox(void)
@@ -727,6 +740,16 @@ io_open_src_real(file_pair *pair)
 	}
 #endif
 
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+	// When compressing, the holes of sparse files are returned as zeros
+	// without reading them. Files with fewer blocks allocated than
+	// their size suggests are the only ones that can have holes.
+	if (opt_mode == MODE_COMPRESS && S_ISREG(pair->src_st.st_mode)
+			&& (uint64_t)(pair->src_st.st_blocks) * 512
+				< (uint64_t)(pair->src_st.st_size))
+		pair->src_try_holes = true;
+#endif
+
 #ifdef HAVE_POSIX_FADVISE
 	// It will fail with some special files like FIFOs but that is fine.
 	(void)posix_fadvise(pair->src_fd, 0, 0,
@@ -751,11 +774,11 @@ io_open_src(const char *src_name)
 	if (is_empty_filename(src_name))
 		return NULL;
 
-	// Since we have only one file open at a time, we can use
-	// a statically allocated structure.
-	static file_pair pair;
+	// With --jobs more than one file can be open at a time, so the
+	// structure is allocated for each file. io_close() frees it.
+	file_pair *pair = xmalloc(sizeof(file_pair));
 
-	pair = (file_pair){
+	*pair = (file_pair){
 		.src_name = src_name,
 		.dest_name = NULL,
 		.src_fd = -1,
@@ -763,6 +786,11 @@ io_open_src(const char *src_name)
 		.src_eof = false,
 		.src_has_seen_input = false,
 		.flush_needed = false,
+		.src_try_holes = false,
+		.src_seek_needed = false,
+		.src_pos = 0,
+		.src_data_start = 0,
+		.src_data_end = 0,
 		.dest_try_sparse = false,
 		.dest_pending_sparse = 0,
 	};
@@ -770,15 +798,19 @@ io_open_src(const char *src_name)
 	// Block the signals, for which we have a custom signal handler, so
 	// that we don't need to worry about EINTR.
 	signals_block();
-	const bool error = io_open_src_real(&pair);
+	const bool error = io_open_src_real(pair);
 	signals_unblock();
 
+	if (error) {
+		free(pair);
+		return NULL;
+	}
+
 #ifdef ENABLE_SANDBOX
-	if (!error)
-		io_sandbox_enter(pair.src_fd);
+	io_sandbox_enter(pair->src_fd);
 #endif
 
-	return error ? NULL : &pair;
+	return pair;
 }
 
 
@@ -1061,6 +1093,13 @@ io_close(file_pair *pair, bool success)
 {
 	// Take care of sparseness at the end of the output file.
 	if (success && pair->dest_try_sparse
+			&& pair->dest_pending_sparse > 0
+			&& (uint64_t)(pair->dest_pending_sparse)
+				< sparse_min) {
+		if (io_write_zeros(pair, pair->dest_pending_sparse))
+			success = false;
+
+	} else if (success && pair->dest_try_sparse
 			&& pair->dest_pending_sparse > 0) {
 		// Seek forward one byte less than the size of the pending
 		// hole, then write one zero-byte. This way the file grows
@@ -1101,6 +1140,7 @@ io_close(file_pair *pair, bool success)
 
 	signals_unblock();
 
+	free(pair);
 	return;
 }
 
@@ -1120,8 +1160,8 @@ io_fix_src_pos(file_pair *pair, size_t rewind_size)
 }
 
 
-extern size_t
-io_read(file_pair *pair, io_buf *buf, size_t size)
+static size_t
+io_read_buf(file_pair *pair, uint8_t *buf, size_t size)
 {
 	// We use small buffers here.
 	assert(size < SSIZE_MAX);
@@ -1130,7 +1170,7 @@ io_read(file_pair *pair, io_buf *buf, size_t size)
 
 	while (pos < size) {
 		const ssize_t amount = read(
-				pair->src_fd, buf->u8 + pos, size - pos);
+				pair->src_fd, buf + pos, size - pos);
 
 		if (amount == 0) {
 			pair->src_eof = true;
@@ -1190,6 +1230,111 @@ io_read(file_pair *pair, io_buf *buf, size_t size)
 }
 
 
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+/// Find the next data region at or after pair->src_pos. If the file
+/// system cannot tell, src_try_holes is disabled.
+static void
+io_find_data(file_pair *pair)
+{
+	off_t data = lseek(pair->src_fd, pair->src_pos, SEEK_DATA);
+	off_t hole;
+
+	if (data == -1 && errno == ENXIO) {
+		// The rest of the file is a hole. Read normally after it
+		// so that the end of the file is detected as usual.
+		data = lseek(pair->src_fd, 0, SEEK_END);
+		hole = data == -1 ? -1 : (off_t)(UINT64_MAX >> 1);
+	} else {
+		hole = data == -1 ? -1
+				: lseek(pair->src_fd, data, SEEK_HOLE);
+	}
+
+	// The lseek() calls above have moved the file offset.
+	pair->src_seek_needed = true;
+
+	if (data == -1 || hole == -1 || data < pair->src_pos) {
+		// Unsupported by the file system, or the file changed
+		// under us. Fall back to plain reading.
+		pair->src_try_holes = false;
+		return;
+	}
+
+	pair->src_data_start = data;
+	pair->src_data_end = hole;
+	return;
+}
+#endif
+
+
+extern size_t
+io_read(file_pair *pair, io_buf *buf, size_t size)
+{
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+	size_t pos = 0;
+
+	while (pair->src_try_holes && pos < size) {
+		if (pair->src_pos >= pair->src_data_end) {
+			io_find_data(pair);
+			continue;
+		}
+
+		if (pair->src_pos < pair->src_data_start) {
+			// Inside a hole: there is nothing to read.
+			const size_t amount = (size_t)my_min(size - pos,
+					(uint64_t)(pair->src_data_start
+						- pair->src_pos));
+			memzero(buf->u8 + pos, amount);
+			pos += amount;
+			pair->src_pos += (off_t)(amount);
+			pair->src_seek_needed = true;
+			continue;
+		}
+
+		if (pair->src_seek_needed) {
+			if (lseek(pair->src_fd, pair->src_pos, SEEK_SET)
+					== -1) {
+				message_error(_("%s: Error seeking the "
+						"file: %s"), pair->src_name,
+						strerror(errno));
+				return SIZE_MAX;
+			}
+
+			pair->src_seek_needed = false;
+		}
+
+		const size_t amount = io_read_buf(pair, buf->u8 + pos,
+				(size_t)my_min(size - pos,
+					(uint64_t)(pair->src_data_end
+						- pair->src_pos)));
+		if (amount == SIZE_MAX)
+			return SIZE_MAX;
+
+		pos += amount;
+		pair->src_pos += (off_t)(amount);
+
+		if (pair->src_eof)
+			return pos;
+	}
+
+	if (pos > 0 || size == 0)
+		return pos;
+
+	if (pair->src_seek_needed) {
+		// io_find_data() gave up after moving the file offset.
+		if (lseek(pair->src_fd, pair->src_pos, SEEK_SET) == -1) {
+			message_error(_("%s: Error seeking the file: %s"),
+					pair->src_name, strerror(errno));
+			return SIZE_MAX;
+		}
+
+		pair->src_seek_needed = false;
+	}
+#endif
+
+	return io_read_buf(pair, buf->u8, size);
+}
+
+
 extern bool
 io_seek_src(file_pair *pair, uint64_t pos)
 {
@@ -1214,14 +1359,14 @@ io_seek_src(file_pair *pair, uint64_t pos)
 
 
 extern bool
-io_pread(file_pair *pair, io_buf *buf, size_t size, uint64_t pos)
+io_pread(file_pair *pair, uint8_t *buf, size_t size, uint64_t pos)
 {
 	// Using lseek() and read() is more portable than pread() and
 	// for us it is as good as real pread().
 	if (io_seek_src(pair, pos))
 		return true;
 
-	const size_t amount = io_read(pair, buf, size);
+	const size_t amount = io_read_buf(pair, buf, size);
 	if (amount == SIZE_MAX)
 		return true;
 
@@ -1299,6 +1444,26 @@ io_write_buf(file_pair *pair, const uint8_t *buf, size_t size)
 }
 
 
+/// Write size zero bytes. This is used for runs of zeros that are too
+/// short to be worth a hole.
+static bool
+io_write_zeros(file_pair *pair, off_t size)
+{
+	static const uint8_t zeros[IO_BUFFER_SIZE];
+
+	while (size > 0) {
+		const size_t amount = (size_t)my_min((uint64_t)(size),
+				sizeof(zeros));
+		if (io_write_buf(pair, zeros, amount))
+			return true;
+
+		size -= (off_t)(amount);
+	}
+
+	return false;
+}
+
+
 extern bool
 io_write(file_pair *pair, const io_buf *buf, size_t size)
 {
@@ -1330,8 +1495,16 @@ io_write(file_pair *pair, const io_buf *buf, size_t size)
 		}
 
 		// This is not a sparse block. If we have a pending hole,
-		// skip it now.
-		if (pair->dest_pending_sparse > 0) {
+		// skip it now unless it is too small to be worth it.
+		if (pair->dest_pending_sparse > 0
+				&& (uint64_t)(pair->dest_pending_sparse)
+					< sparse_min) {
+			if (io_write_zeros(pair, pair->dest_pending_sparse))
+				return true;
+
+			pair->dest_pending_sparse = 0;
+
+		} else if (pair->dest_pending_sparse > 0) {
 			if (lseek(pair->dest_fd, pair->dest_pending_sparse,
 					SEEK_CUR) == -1) {
 				message_error(_("%s: Seeking failed when "
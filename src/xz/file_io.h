@@ -56,6 +56,20 @@ typedef struct {
 	/// For --flush-timeout: True when flushing is needed.
 	bool flush_needed;
 
+	/// If true, the source file is a regular file that may have holes.
+	/// io_read() returns the holes as zeros without reading them.
+	bool src_try_holes;
+
+	/// True if the file offset of src_fd isn't src_pos.
+	bool src_seek_needed;
+
+	/// These are used only if src_try_holes is true. src_pos is
+	/// the offset of the next byte to return. [src_pos, src_data_start)
+	/// is a hole and [src_data_start, src_data_end) has data.
+	off_t src_pos;
+	off_t src_data_start;
+	off_t src_data_end;
+
 	/// If true, we look for long chunks of zeros and try to create
 	/// a sparse file.
 	bool dest_try_sparse;
@@ -90,6 +104,10 @@ extern void io_write_to_user_abort_pipe(void);
 extern void io_no_sparse(void);
 
 
+/// \brief      Set the minimum size of a hole in sparse output files
+extern void io_sparse_min(uint64_t size);
+
+
 #ifdef ENABLE_SANDBOX
 /// \brief      main() calls this if conditions for sandboxing have been met.
 extern void io_allow_sandbox(void);
@@ -159,13 +177,15 @@ extern bool io_seek_src(file_pair *pair, uint64_t pos);
 ///
 /// \param      pair    Seekable source file
 /// \param      buf     Destination buffer
-/// \param      size    Amount of data to read
+/// \param      size    Amount of data to read; assumed be smaller
+///                     than SSIZE_MAX
 /// \param      pos     Offset relative to the beginning of the file,
 ///                     from which the data should be read.
 ///
 /// \return     On success, false is returned. On error, error message
 ///             is printed and true is returned.
-extern bool io_pread(file_pair *pair, io_buf *buf, size_t size, uint64_t pos);
+extern bool io_pread(file_pair *pair, uint8_t *buf, size_t size,
+		uint64_t pos);
 
 
 /// \brief      Writes a buffer to the destination file
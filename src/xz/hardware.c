@@ -21,6 +21,10 @@ static uint32_t threads_max = 1;
 /// on the available hardware threads.
 static bool threads_are_automatic = false;
 
+/// Maximum number of files to process in parallel. This can be set with
+/// the --jobs=NUM command line option.
+static uint32_t jobs_max = 1;
+
 /// Memory usage limit for compression
 static uint64_t memlimit_compress = 0;
 
@@ -99,6 +103,32 @@ hardware_threads_is_mt(void)
 }
 
 
+extern void
+hardware_jobs_set(uint32_t n)
+{
+	// Like with --threads, zero means the number of available CPU
+	// cores. Files cannot be processed in parallel if threading
+	// support was disabled at build time.
+#ifdef MYTHREAD_ENABLED
+	jobs_max = n == 0 ? lzma_cputhreads() : n;
+	if (jobs_max == 0)
+		jobs_max = 1;
+#else
+	(void)n;
+	jobs_max = 1;
+#endif
+
+	return;
+}
+
+
+extern uint32_t
+hardware_jobs_get(void)
+{
+	return jobs_max;
+}
+
+
 extern void
 hardware_memlimit_set(uint64_t new_memlimit,
 		bool set_compress, bool set_decompress, bool set_mtdec,
@@ -207,6 +237,40 @@ hardware_memlimit_mtdec_get(void)
 }
 
 
+extern uint64_t
+hardware_memlimit_jobs_get(void)
+{
+	if (opt_mode == MODE_COMPRESS)
+		return memlimit_compress != 0
+				? memlimit_compress : memlimit_mt_default;
+
+	return hardware_memlimit_mtdec_get();
+}
+
+
+extern uint32_t
+hardware_jobs_limit(uint64_t memusage)
+{
+	uint32_t jobs = jobs_max;
+
+	const uint64_t memlimit = hardware_memlimit_jobs_get();
+	if (memusage != UINT64_MAX && memusage != 0
+			&& memlimit / memusage < jobs) {
+		jobs = memlimit / memusage > 1
+				? (uint32_t)(memlimit / memusage) : 1;
+
+		message(V_DEBUG, _("Reduced the number of parallel files "
+				"from %s to %s to not exceed the memory usage "
+				"limit of %s MiB"),
+				uint64_to_str(jobs_max, 0),
+				uint64_to_str(jobs, 1),
+				uint64_to_str(round_up_to_mib(memlimit), 2));
+	}
+
+	return jobs;
+}
+
+
 /// Helper for hardware_memlimit_show() to print one human-readable info line.
 static void
 memlimit_show(const char *str, size_t str_columns, uint64_t value)
@@ -26,6 +26,14 @@ extern uint32_t hardware_threads_get(void);
 extern bool hardware_threads_is_mt(void);
 
 
+/// Set the maximum number of files to process in parallel. Zero means
+/// the number of available CPU cores.
+extern void hardware_jobs_set(uint32_t jobs);
+
+/// Get the maximum number of files to process in parallel.
+extern uint32_t hardware_jobs_get(void);
+
+
 /// Set the memory usage limit. There are separate limits for compression,
 /// decompression (also includes --list), and multithreaded decompression.
 /// Any combination of these can be set with a single call to this function.
@@ -69,5 +77,19 @@ extern bool hardware_memlimit_mtenc_is_default(void);
 /// from hardware_memlimit_get() will be honored like in single-threaded mode.
 extern uint64_t hardware_memlimit_mtdec_get(void);
 
+/// Get the total memory usage limit for files that are processed in
+/// parallel with --jobs. This is used only to reduce the number of
+/// parallel files, like hardware_memlimit_mtdec_get() reduces the number
+/// of threads. When compressing, this is --memlimit-compress if it was
+/// specified and otherwise the same default as for automatic number of
+/// threads. When decompressing, this is hardware_memlimit_mtdec_get().
+extern uint64_t hardware_memlimit_jobs_get(void);
+
+/// Get the number of files to process in parallel when processing one file
+/// needs memusage bytes of memory. This is hardware_jobs_get() reduced to
+/// fit in hardware_memlimit_jobs_get() but at least one. UINT64_MAX and
+/// zero mean that the memory usage isn't known and the number isn't reduced.
+extern uint32_t hardware_jobs_limit(uint64_t memusage);
+
 /// Display the amount of RAM and memory usage limits and exit.
 extern void hardware_memlimit_show(void) lzma_attribute((__noreturn__));
@@ -32,9 +32,39 @@ typedef struct {
 	/// Oldest XZ Utils version that will decompress the file
 	uint32_t min_version;
 
+	/// Block Headers and Check fields of the first details_count
+	/// Blocks one after another. These are read by read_details()
+	/// before anything is printed so that the reads can be combined.
+	uint8_t *details;
+
+	/// Allocated size of details[]
+	size_t details_alloc;
+
+	/// Amount of data in details[]
+	size_t details_size;
+
+	/// Number of Blocks whose fields are in details[]
+	lzma_vli details_count;
+
+	/// Position of the next Block in details[] when printing
+	size_t details_pos;
+
+	/// If the Indexes couldn't be decoded because of the memory usage
+	/// limit, this is how much memory would have been needed. With
+	/// --jobs, the Indexes are decoded in a worker thread, but only
+	/// the main thread may format numbers, so this is printed later.
+	uint64_t memusage_needed;
+
 } xz_file_info;
 
-#define XZ_FILE_INFO_INIT { NULL, 0, 0, true, 50000002 }
+#define XZ_FILE_INFO_INIT { NULL, 0, 0, true, 50000002, NULL, 0, 0, 0, 0, 0 }
+
+
+/// Maximum amount of data to read at once when collecting the Block Headers
+/// and Check fields. With small Blocks, one read covers many Blocks. The
+/// Compressed Data in between gets read too, but reading it sequentially is
+/// still a lot faster than seeking to every Block Header separately.
+#define DETAILS_READ_MAX (256 << 10)
 
 
 /// Information about a .xz Block
@@ -413,10 +443,10 @@ parse_indexes(xz_file_info *xfi, file_pair *pair)
 					message_strm(ret));
 
 			// If the error was too low memory usage limit,
-			// show also how much memory would have been needed.
+			// list_print() shows also how much memory would
+			// have been needed.
 			if (ret == LZMA_MEMLIMIT_ERROR)
-				message_mem_needed(V_ERROR,
-						lzma_memusage(&strm));
+				xfi->memusage_needed = lzma_memusage(&strm);
 
 			goto error;
 		}
@@ -428,6 +458,138 @@ error:
 }
 
 
+/// Get the amount of data to read for the Block Header. The size of the
+/// Block Header isn't known before its first byte has been read, so this
+/// covers the largest possible Block Header, but not past the end of
+/// the Block (or even its Check field).
+static uint32_t
+block_header_read_size(const lzma_index_iter *iter)
+{
+	return my_min(iter->block.total_size
+				- lzma_check_size(iter->stream.flags->check),
+			LZMA_BLOCK_HEADER_SIZE_MAX);
+}
+
+
+/// Data read from the input file by details_get()
+typedef struct {
+	uint8_t *buf;
+	uint64_t pos;
+	size_t size;
+} details_window;
+
+
+/// \brief      Get a field of the Block at iter
+///
+/// If the field isn't already in the window, the window is moved to start
+/// from the field. The read is extended to cover the Check field of the
+/// same Block and the fields of the following Blocks as long as the total
+/// stays within DETAILS_READ_MAX.
+///
+/// \return     Pointer to the field or NULL on error
+static const uint8_t *
+details_get(details_window *w, file_pair *pair, const lzma_index_iter *iter,
+		uint64_t pos, size_t size)
+{
+	if (pos >= w->pos && pos + size <= w->pos + w->size)
+		return w->buf + (pos - w->pos);
+
+	uint64_t end = pos + size;
+	lzma_index_iter next = *iter;
+	bool at_check = pos != iter->block.compressed_file_offset;
+
+	while (true) {
+		uint64_t field_end;
+		if (!at_check) {
+			field_end = next.block.compressed_file_offset
+					+ next.block.total_size;
+			at_check = true;
+		} else {
+			if (lzma_index_iter_next(&next, LZMA_INDEX_ITER_BLOCK))
+				break;
+
+			field_end = next.block.compressed_file_offset
+					+ block_header_read_size(&next);
+			at_check = false;
+		}
+
+		if (field_end - pos > DETAILS_READ_MAX)
+			break;
+
+		end = field_end;
+	}
+
+	if (io_pread(pair, w->buf, end - pos, pos))
+		return NULL;
+
+	w->pos = pos;
+	w->size = end - pos;
+	return w->buf;
+}
+
+
+/// \brief      Read the Block Headers and Check fields into xfi->details
+///
+/// Only the fields are kept so the memory usage is small even if
+/// the file has a huge number of Blocks. On error, xfi->details_count
+/// tells how many Blocks were read successfully.
+static void
+read_details(xz_file_info *xfi, file_pair *pair)
+{
+	details_window w = { xmalloc(DETAILS_READ_MAX), 0, 0 };
+
+	lzma_index_iter iter;
+	lzma_index_iter_init(&iter, xfi->idx);
+	while (!lzma_index_iter_next(&iter, LZMA_INDEX_ITER_BLOCK)) {
+		const uint32_t read_size = block_header_read_size(&iter);
+		const uint8_t *header = details_get(&w, pair, &iter,
+				iter.block.compressed_file_offset, read_size);
+		if (header == NULL)
+			break;
+
+		// Keep only the Block Header if its size is valid.
+		// Otherwise parse_block_header() will detect the error
+		// from the first byte.
+		const uint32_t header_size = my_min(read_size,
+				lzma_block_header_size_decode(header[0]));
+		const uint32_t check_size = lzma_check_size(
+				iter.stream.flags->check);
+
+		if (xfi->details_alloc - xfi->details_size
+				< header_size + check_size) {
+			xfi->details_alloc = my_max(2 * xfi->details_alloc,
+					xfi->details_size + header_size
+						+ check_size);
+			xfi->details = xrealloc(xfi->details,
+					xfi->details_alloc);
+		}
+
+		// header may point to w.buf which the next call to
+		// details_get() can overwrite, so copy it first.
+		memcpy(xfi->details + xfi->details_size, header, header_size);
+
+		if (check_size > 0) {
+			const uint8_t *check = details_get(&w, pair, &iter,
+					iter.block.compressed_file_offset
+						+ iter.block.total_size
+						- check_size,
+					check_size);
+			if (check == NULL)
+				break;
+
+			memcpy(xfi->details + xfi->details_size + header_size,
+					check, check_size);
+		}
+
+		xfi->details_size += header_size + check_size;
+		++xfi->details_count;
+	}
+
+	free(w.buf);
+	return;
+}
+
+
 /// \brief      Parse the Block Header
 ///
 /// The result is stored into *bhi. The caller takes care of initializing it.
@@ -437,21 +599,20 @@ static bool
 parse_block_header(file_pair *pair, const lzma_index_iter *iter,
 		block_header_info *bhi, xz_file_info *xfi)
 {
-#if IO_BUFFER_SIZE < LZMA_BLOCK_HEADER_SIZE_MAX
-#	error IO_BUFFER_SIZE < LZMA_BLOCK_HEADER_SIZE_MAX
-#endif
-
-	// Get the whole Block Header with one read, but don't read past
-	// the end of the Block (or even its Check field).
-	const uint32_t size = my_min(iter->block.total_size
-				- lzma_check_size(iter->stream.flags->check),
-			LZMA_BLOCK_HEADER_SIZE_MAX);
-	io_buf buf;
-	if (io_pread(pair, &buf, size, iter->block.compressed_file_offset))
+	// read_details() has already reported the error if this Block
+	// couldn't be read.
+	if (iter->block.number_in_file > xfi->details_count)
 		return true;
 
+	// Get the Block Header from xfi->details. Its size is determined
+	// the same way as in read_details().
+	const uint8_t *buf = xfi->details + xfi->details_pos;
+	const uint32_t size = my_min(block_header_read_size(iter),
+			lzma_block_header_size_decode(buf[0]));
+	xfi->details_pos += size;
+
 	// Zero would mean Index Indicator and thus not a valid Block.
-	if (buf.u8[0] == 0)
+	if (buf[0] == 0)
 		goto data_error;
 
 	// Initialize the block structure and decode Block Header Size.
@@ -461,12 +622,12 @@ parse_block_header(file_pair *pair, const lzma_index_iter *iter,
 	block.check = iter->stream.flags->check;
 	block.filters = filters;
 
-	block.header_size = lzma_block_header_size_decode(buf.u8[0]);
+	block.header_size = lzma_block_header_size_decode(buf[0]);
 	if (block.header_size > size)
 		goto data_error;
 
 	// Decode the Block Header.
-	switch (lzma_block_header_decode(&block, NULL, buf.u8)) {
+	switch (lzma_block_header_decode(&block, NULL, buf)) {
 	case LZMA_OK:
 		break;
 
@@ -577,44 +738,40 @@ data_error:
 /// \brief      Parse the Check field and put it into check_value[]
 ///
 /// \return     False on success, true on error.
-static bool
-parse_check_value(file_pair *pair, const lzma_index_iter *iter)
+static void
+parse_check_value(const lzma_index_iter *iter, xz_file_info *xfi)
 {
-	// Don't read anything from the file if there is no integrity Check.
+	// There is nothing in xfi->details if there is no integrity Check.
 	if (iter->stream.flags->check == LZMA_CHECK_NONE) {
 		snprintf(check_value, sizeof(check_value), "---");
-		return false;
+		return;
 	}
 
-	// Locate and read the Check field.
+	// The Check field follows the Block Header in xfi->details.
 	const uint32_t size = lzma_check_size(iter->stream.flags->check);
-	const uint64_t offset = iter->block.compressed_file_offset
-			+ iter->block.total_size - size;
-	io_buf buf;
-	if (io_pread(pair, &buf, size, offset))
-		return true;
+	const uint8_t *buf = xfi->details + xfi->details_pos;
+	xfi->details_pos += size;
 
 	// CRC32 and CRC64 are in little endian. Guess that all the future
 	// 32-bit and 64-bit Check values are little endian too. It shouldn't
 	// be a too big problem if this guess is wrong.
 	if (size == 4)
 		snprintf(check_value, sizeof(check_value),
-				"%08" PRIx32, conv32le(buf.u32[0]));
+				"%08" PRIx32, read32le(buf));
 	else if (size == 8)
 		snprintf(check_value, sizeof(check_value),
-				"%016" PRIx64, conv64le(buf.u64[0]));
+				"%016" PRIx64, read64le(buf));
 	else
 		for (size_t i = 0; i < size; ++i)
-			snprintf(check_value + i * 2, 3, "%02x", buf.u8[i]);
+			snprintf(check_value + i * 2, 3, "%02x", buf[i]);
 
-	return false;
+	return;
 }
 
 
 /// \brief      Parse detailed information about a Block
 ///
-/// Since this requires seek(s), listing information about all Blocks can
-/// be slow.
+/// The fields must have been read with read_details() already.
 ///
 /// \param      pair    Input file
 /// \param      iter    Location of the Block whose Check value should
@@ -632,9 +789,7 @@ parse_details(file_pair *pair, const lzma_index_iter *iter,
 	if (parse_block_header(pair, iter, bhi, xfi))
 		return true;
 
-	if (parse_check_value(pair, iter))
-		return true;
-
+	parse_check_value(iter, xfi);
 	return false;
 }
 
@@ -1220,9 +1375,305 @@ print_totals_robot(void)
 }
 
 
+/// A file being listed. With --jobs, the Indexes and the Block Headers
+/// are read by worker threads and the main thread prints the results
+/// in the original order of the files.
+typedef struct {
+	/// Name of the file. With --jobs this is a copy that is freed
+	/// after the file has been printed.
+	const char *filename;
+
+	/// The opened file or NULL if opening it failed
+	file_pair *pair;
+
+	/// Information read from the file
+	xz_file_info xfi;
+
+	/// True if the file cannot be listed. The error has been
+	/// printed already or is in messages.
+	bool fail;
+
+#ifdef MYTHREAD_ENABLED
+	/// Messages from reading the file in a worker thread. They are
+	/// printed together with the file so that they stay in order.
+	char *messages;
+#endif
+
+	/// True when a worker has finished reading the file
+	bool done;
+
+} list_job;
+
+
+/// Read everything needed to list the file. This does no printing
+/// other than error messages.
+static void
+list_read(list_job *job)
+{
+	if (job->filename == stdin_filename) {
+		message_error(_("--list does not support reading from "
+				"standard input"));
+		job->fail = true;
+		return;
+	}
+
+	job->pair = io_open_src(job->filename);
+	if (job->pair == NULL || parse_indexes(&job->xfi, job->pair)) {
+		job->fail = true;
+		return;
+	}
+
+	// The details of the Blocks are shown only with -vv.
+	if (message_verbosity_get() >= V_DEBUG)
+		read_details(&job->xfi, job->pair);
+
+	return;
+}
+
+
+/// Print the information about the file and free the job.
+static void
+list_print(list_job *job)
+{
+	if (job->xfi.memusage_needed != 0)
+		message_mem_needed(V_ERROR, job->xfi.memusage_needed);
+
+	if (!job->fail) {
+		bool fail;
+
+		// We have three main modes:
+		//  - --robot, which has submodes if --verbose is specified
+		//    once or twice
+		//  - Normal --list without --verbose
+		//  - --list with one or two --verbose
+		if (opt_robot)
+			fail = print_info_robot(&job->xfi, job->pair);
+		else if (message_verbosity_get() <= V_WARNING)
+			fail = print_info_basic(&job->xfi, job->pair);
+		else
+			fail = print_info_adv(&job->xfi, job->pair);
+
+		// Update the totals that are displayed after all
+		// the individual files have been listed. Don't count
+		// broken files.
+		if (!fail)
+			update_totals(&job->xfi);
+	}
+
+	lzma_index_end(job->xfi.idx, NULL);
+	free(job->xfi.details);
+
+	if (job->pair != NULL)
+		io_close(job->pair, false);
+
+	return;
+}
+
+
+/// True once list_file() has done the initializations
+static bool initialized = false;
+
+
+#ifdef MYTHREAD_ENABLED
+/// Maximum number of files to read in parallel
+static uint32_t jobs_max = 1;
+
+/// The files that haven't been printed yet as a ring buffer. There are
+/// twice as many slots as worker threads so that the workers don't need
+/// to wait if the first file in the queue is slow to read.
+static list_job *jobs = NULL;
+static size_t jobs_size;
+
+/// Position of the first file to print, the next file to be read by
+/// a worker, and the next free slot. These only increase; the slot is
+/// the value modulo jobs_size.
+static size_t jobs_first = 0;
+static size_t jobs_next = 0;
+static size_t jobs_end = 0;
+
+static mythread *threads = NULL;
+static uint32_t threads_count = 0;
+
+/// Protects the queue positions and the done flags
+static mythread_mutex jobs_mutex;
+
+/// Signaled when a file is added to the queue
+static mythread_cond jobs_added_cond;
+
+/// Signaled when a worker has finished reading a file
+static mythread_cond jobs_done_cond;
+
+/// Tells the workers to exit when the queue is empty
+static bool jobs_exit = false;
+
+
+static void
+jobs_check(int ret)
+{
+	if (ret != 0)
+		message_fatal(_("Cannot create a thread: %s"), strerror(ret));
+
+	return;
+}
+
+
+static MYTHREAD_RET_TYPE
+worker_start(void *unused lzma_attribute((__unused__)))
+{
+	mythread_mutex_lock(&jobs_mutex);
+
+	while (true) {
+		while (jobs_next == jobs_end && !jobs_exit)
+			mythread_cond_wait(&jobs_added_cond, &jobs_mutex);
+
+		if (jobs_next == jobs_end)
+			break;
+
+		list_job *job = &jobs[jobs_next++ % jobs_size];
+		mythread_mutex_unlock(&jobs_mutex);
+
+		message_defer_begin(&job->messages);
+		list_read(job);
+		message_defer_end();
+
+		mythread_mutex_lock(&jobs_mutex);
+		job->done = true;
+		mythread_cond_signal(&jobs_done_cond);
+	}
+
+	mythread_mutex_unlock(&jobs_mutex);
+
+	return MYTHREAD_RET_VALUE;
+}
+
+
+static void
+list_jobs_init(void)
+{
+	// Reading the Index can need as much memory as the limit allows.
+	// If there is no limit, the number of jobs isn't reduced.
+	jobs_max = hardware_jobs_limit(hardware_memlimit_get(MODE_LIST));
+	if (jobs_max == 1)
+		return;
+
+	jobs_check(mythread_mutex_init(&jobs_mutex));
+	jobs_check(mythread_cond_init(&jobs_added_cond));
+	jobs_check(mythread_cond_init(&jobs_done_cond));
+
+	jobs_size = 2 * (size_t)(jobs_max);
+	jobs = xmalloc(jobs_size * sizeof(list_job));
+	threads = xmalloc(jobs_max * sizeof(mythread));
+	return;
+}
+
+
+/// Print the files from the beginning of the queue that have been read.
+/// If wait is true, wait for the first file even if it isn't ready yet.
+/// jobs_mutex must be locked.
+static void
+list_jobs_print(bool wait)
+{
+	while (jobs_first != jobs_end) {
+		list_job *job = &jobs[jobs_first % jobs_size];
+		if (!job->done) {
+			if (!wait)
+				break;
+
+			mythread_cond_wait(&jobs_done_cond, &jobs_mutex);
+			continue;
+		}
+
+		// The workers don't touch finished jobs and only the main
+		// thread adds new ones, so the lock isn't needed here.
+		mythread_mutex_unlock(&jobs_mutex);
+
+		message_filename(job->filename);
+		message_defer_print(job->messages);
+		list_print(job);
+
+		if (job->filename != stdin_filename)
+			free((char *)job->filename);
+
+		mythread_mutex_lock(&jobs_mutex);
+		++jobs_first;
+
+		// Waiting for one file is enough to make room.
+		wait = false;
+	}
+
+	return;
+}
+
+
+/// Add the file to the queue. If the queue is full, print files from
+/// the beginning of the queue first.
+static void
+list_jobs_add(const char *filename)
+{
+	mythread_mutex_lock(&jobs_mutex);
+
+	list_jobs_print(jobs_end - jobs_first == jobs_size);
+
+	// read_name() reuses its buffer, so a copy of the name is needed.
+	// stdin_filename is recognized by its address so it isn't copied.
+	jobs[jobs_end % jobs_size] = (list_job){
+		.filename = filename == stdin_filename
+				? stdin_filename : xstrdup(filename),
+		.xfi = XZ_FILE_INFO_INIT,
+	};
+	++jobs_end;
+	mythread_cond_signal(&jobs_added_cond);
+
+	// The worker threads are created as the files are added.
+	if (threads_count < jobs_max)
+		jobs_check(mythread_create(&threads[threads_count++],
+				&worker_start, NULL));
+
+	mythread_mutex_unlock(&jobs_mutex);
+	return;
+}
+
+
+/// Print all files that are still in the queue and stop the workers.
+static void
+list_jobs_finish(void)
+{
+	mythread_mutex_lock(&jobs_mutex);
+
+	while (jobs_first != jobs_end)
+		list_jobs_print(true);
+
+	jobs_exit = true;
+	for (uint32_t i = 0; i < threads_count; ++i)
+		mythread_cond_signal(&jobs_added_cond);
+
+	mythread_mutex_unlock(&jobs_mutex);
+
+	for (uint32_t i = 0; i < threads_count; ++i)
+		mythread_join(threads[i]);
+
+	mythread_cond_destroy(&jobs_done_cond);
+	mythread_cond_destroy(&jobs_added_cond);
+	mythread_mutex_destroy(&jobs_mutex);
+
+	free(threads);
+	free(jobs);
+	threads = NULL;
+	jobs = NULL;
+	threads_count = 0;
+	return;
+}
+#endif
+
+
 extern void
 list_totals(void)
 {
+#ifdef MYTHREAD_ENABLED
+	if (jobs != NULL)
+		list_jobs_finish();
+#endif
+
 	if (opt_robot) {
 		// Always print totals in --robot mode. It can be convenient
 		// in some cases and doesn't complicate usage of the
@@ -1249,49 +1700,33 @@ list_file(const char *filename)
 		message_fatal(_("--list works only on .xz files "
 				"(--format=xz or --format=auto)"));
 
-	message_filename(filename);
+	if (!initialized) {
+		initialized = true;
+		init_field_widths();
 
-	if (filename == stdin_filename) {
-		message_error(_("--list does not support reading from "
-				"standard input"));
-		return;
-	}
+		// Unset opt_stdout so that io_open_src() won't accept
+		// special files. Set opt_force so that io_open_src() will
+		// follow symlinks. These are set only once because the
+		// worker threads read them.
+		opt_stdout = false;
+		opt_force = true;
 
-	init_field_widths();
+#ifdef MYTHREAD_ENABLED
+		list_jobs_init();
+#endif
+	}
 
-	// Unset opt_stdout so that io_open_src() won't accept special files.
-	// Set opt_force so that io_open_src() will follow symlinks.
-	opt_stdout = false;
-	opt_force = true;
-	file_pair *pair = io_open_src(filename);
-	if (pair == NULL)
+#ifdef MYTHREAD_ENABLED
+	if (jobs_max > 1) {
+		list_jobs_add(filename);
 		return;
-
-	xz_file_info xfi = XZ_FILE_INFO_INIT;
-	if (!parse_indexes(&xfi, pair)) {
-		bool fail;
-
-		// We have three main modes:
-		//  - --robot, which has submodes if --verbose is specified
-		//    once or twice
-		//  - Normal --list without --verbose
-		//  - --list with one or two --verbose
-		if (opt_robot)
-			fail = print_info_robot(&xfi, pair);
-		else if (message_verbosity_get() <= V_WARNING)
-			fail = print_info_basic(&xfi, pair);
-		else
-			fail = print_info_adv(&xfi, pair);
-
-		// Update the totals that are displayed after all
-		// the individual files have been listed. Don't count
-		// broken files.
-		if (!fail)
-			update_totals(&xfi);
-
-		lzma_index_end(xfi.idx, NULL);
 	}
+#endif
+
+	message_filename(filename);
 
-	io_close(pair, false);
+	list_job job = { .filename = filename, .xfi = XZ_FILE_INFO_INIT };
+	list_read(&job);
+	list_print(&job);
 	return;
 }
@@ -20,6 +20,9 @@ static enum exit_status_type exit_status = E_SUCCESS;
 /// exit_status has to be protected with a critical section due to
 /// how "signal handling" is done on Windows. See signals.c for details.
 static CRITICAL_SECTION exit_status_cs;
+#elif defined(MYTHREAD_ENABLED)
+/// The worker threads of --jobs set exit_status too.
+static mythread_mutex exit_status_mutex;
 #endif
 
 /// True if --no-warn is specified. When this is true, we don't set
@@ -34,6 +37,8 @@ set_exit_status(enum exit_status_type new_status)
 
 #if defined(_WIN32) && !defined(__CYGWIN__)
 	EnterCriticalSection(&exit_status_cs);
+#elif defined(MYTHREAD_ENABLED)
+	mythread_mutex_lock(&exit_status_mutex);
 #endif
 
 	if (exit_status != E_ERROR)
@@ -41,6 +46,8 @@ set_exit_status(enum exit_status_type new_status)
 
 #if defined(_WIN32) && !defined(__CYGWIN__)
 	LeaveCriticalSection(&exit_status_cs);
+#elif defined(MYTHREAD_ENABLED)
+	mythread_mutex_unlock(&exit_status_mutex);
 #endif
 
 	return;
@@ -144,6 +151,9 @@ main(int argc, char **argv)
 {
 #if defined(_WIN32) && !defined(__CYGWIN__)
 	InitializeCriticalSection(&exit_status_cs);
+#elif defined(MYTHREAD_ENABLED)
+	if (mythread_mutex_init(&exit_status_mutex))
+		return E_ERROR;
 #endif
 
 	// Set up the progname variable.
@@ -170,10 +180,6 @@ main(int argc, char **argv)
 	args_info args;
 	args_parse(&args, argc, argv);
 
-	if (opt_mode != MODE_LIST && opt_robot)
-		message_fatal(_("Compression and decompression with --robot "
-			"are not supported yet."));
-
 	// Tell the message handling code how many input files there are if
 	// we know it. This way the progress indicator can show it.
 	if (args.files_name != NULL)
@@ -212,12 +218,13 @@ main(int argc, char **argv)
 	//   - We won't create any files: output goes to stdout or --test
 	//     or --list was used. Note that --test implies opt_stdout = true
 	//     but --list doesn't.
+	//   - --recursive wasn't used.
 	//
 	// This is obviously not ideal but it was easy to implement and
 	// it covers the most common use cases.
 	//
 	// TODO: Make sandboxing work for other situations too.
-	if (args.files_name == NULL && args.arg_count == 1
+	if (args.files_name == NULL && args.arg_count == 1 && !opt_recursive
 			&& (opt_stdout || strcmp("-", args.arg_names[0]) == 0
 				|| opt_mode == MODE_LIST))
 		io_allow_sandbox();
@@ -230,6 +237,10 @@ main(int argc, char **argv)
 	if (opt_mode == MODE_LIST)
 		run = &list_file;
 #endif
+#ifdef HAVE_ENCODERS
+	if (opt_mode == MODE_TRAIN)
+		run = &train_file;
+#endif
 
 	// Process the files given on the command line. Note that if no names
 	// were given, args_parse() gave us a fake "-" filename.
@@ -265,7 +276,10 @@ main(int argc, char **argv)
 		}
 
 		// Do the actual compression or decompression.
-		run(args.arg_names[i]);
+		if (opt_recursive)
+			walk_path(args.arg_names[i], run);
+		else
+			run(args.arg_names[i]);
 	}
 
 	// If --files or --files0 was used, process the filenames from the
@@ -281,13 +295,20 @@ main(int argc, char **argv)
 
 			// read_name() doesn't return empty names.
 			assert(name[0] != '\0');
-			run(name);
+
+			if (opt_recursive)
+				walk_path(name, run);
+			else
+				run(name);
 		}
 
 		if (args.files_name != stdin_filename)
 			(void)fclose(args.files_file);
 	}
 
+	// Wait for the files that are still being processed with --jobs.
+	coder_wait();
+
 #ifdef HAVE_DECODERS
 	// All files have now been handled. If in --list mode, display
 	// the totals before exiting. We don't have signal handlers
@@ -298,6 +319,13 @@ main(int argc, char **argv)
 	}
 #endif
 
+#ifdef HAVE_ENCODERS
+	// With --train, all files have been read as samples. Now build
+	// the dictionary from them unless the user interrupted us.
+	if (opt_mode == MODE_TRAIN && !user_abort)
+		train_finish();
+#endif
+
 #ifndef NDEBUG
 	coder_free();
 	args_free();
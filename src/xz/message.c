@@ -109,10 +109,40 @@ static uint64_t progress_next_update;
 
 #endif
 
+#ifdef MYTHREAD_ENABLED
+/// The worker threads of --jobs print messages too. This keeps the lines
+/// from getting mixed and protects the static string buffers used when
+/// formatting the messages.
+static mythread_mutex message_mutex;
+#	define message_lock() mythread_mutex_lock(&message_mutex)
+#	define message_unlock() mythread_mutex_unlock(&message_mutex)
+
+/// In a thread that has called message_defer_begin(), this points to
+/// the string where the messages of the thread are collected.
+static mythread_key message_defer_key;
+#else
+#	define message_lock() do { } while (0)
+#	define message_unlock() do { } while (0)
+#endif
+
 
 extern void
 message_init(void)
 {
+#ifdef MYTHREAD_ENABLED
+	// message_fatal() cannot be used before the mutex has been
+	// initialized.
+	int ret = mythread_mutex_init(&message_mutex);
+	if (ret == 0 && mythread_key_create(&message_defer_key) != 0)
+		ret = EAGAIN;
+
+	if (ret != 0) {
+		fprintf(stderr, _("%s: "), progname);
+		fprintf(stderr, "%s\n", strerror(ret));
+		tuklib_exit(E_ERROR, E_ERROR, false);
+	}
+#endif
+
 	// If --verbose is used, we use a progress indicator if and only
 	// if stderr is a terminal. If stderr is not a terminal, we print
 	// verbose information only after finishing the file. As a special
@@ -265,7 +295,7 @@ message_progress_start(lzma_stream *strm, bool is_passthru, uint64_t in_size)
 
 	// If progress indicator is wanted, print the filename and possibly
 	// the file count now.
-	if (verbosity >= V_VERBOSE && progress_automatic) {
+	if (verbosity >= V_VERBOSE && progress_automatic && !opt_robot) {
 		// Start the timer to display the first progress message
 		// after one second. An alternative would be to show the
 		// first message almost immediately, but delaying by one
@@ -509,25 +539,25 @@ progress_remaining(uint64_t in_pos, uint64_t elapsed)
 
 /// Get how much uncompressed and compressed data has been processed.
 static void
-progress_pos(uint64_t *in_pos,
+stream_pos(lzma_stream *strm, bool is_passthru, uint64_t *in_pos,
 		uint64_t *compressed_pos, uint64_t *uncompressed_pos)
 {
 	uint64_t out_pos;
-	if (progress_is_from_passthru) {
+	if (is_passthru) {
 		// In passthru mode the progress info is in total_in/out but
-		// the *progress_strm itself isn't initialized and thus we
+		// the *strm itself isn't initialized and thus we
 		// cannot use lzma_get_progress().
-		*in_pos = progress_strm->total_in;
-		out_pos = progress_strm->total_out;
+		*in_pos = strm->total_in;
+		out_pos = strm->total_out;
 	} else {
-		lzma_get_progress(progress_strm, in_pos, &out_pos);
+		lzma_get_progress(strm, in_pos, &out_pos);
 	}
 
 	// It cannot have processed more input than it has been given.
-	assert(*in_pos <= progress_strm->total_in);
+	assert(*in_pos <= strm->total_in);
 
 	// It cannot have produced more output than it claims to have ready.
-	assert(out_pos >= progress_strm->total_out);
+	assert(out_pos >= strm->total_out);
 
 	if (opt_mode == MODE_COMPRESS) {
 		*compressed_pos = out_pos;
@@ -541,10 +571,74 @@ progress_pos(uint64_t *in_pos,
 }
 
 
+static void
+progress_pos(uint64_t *in_pos,
+		uint64_t *compressed_pos, uint64_t *uncompressed_pos)
+{
+	stream_pos(progress_strm, progress_is_from_passthru, in_pos,
+			compressed_pos, uncompressed_pos);
+	return;
+}
+
+
+/// Print the sizes, and if known, the speed and elapsed time in the format
+/// used for the final statistics when stderr isn't a terminal.
+static void
+print_final_sizes(uint64_t compressed_pos, uint64_t uncompressed_pos,
+		uint64_t elapsed)
+{
+	// Size information is always printed.
+	fprintf(stderr, "%s", progress_sizes(
+			compressed_pos, uncompressed_pos, true));
+
+	// The speed and elapsed time aren't always shown.
+	const char *speed = progress_speed(uncompressed_pos, elapsed);
+	if (speed[0] != '\0')
+		fprintf(stderr, ", %s", speed);
+
+	const char *elapsed_str = progress_time(elapsed);
+	if (elapsed_str[0] != '\0')
+		fprintf(stderr, ", %s", elapsed_str);
+
+	fputc('\n', stderr);
+	return;
+}
+
+
+/// Print the statistics of a finished file in robot mode. This is printed
+/// to stderr because the compressed or decompressed data may be going
+/// to stdout.
+static void
+print_stats_robot(const char *src_name, lzma_stream *strm,
+		uint64_t compressed_pos, uint64_t uncompressed_pos,
+		uint64_t elapsed)
+{
+	lzma_stats stats;
+	lzma_get_stats(strm, &stats);
+
+	fprintf(stderr, "stats\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64
+			"\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64
+			"\t%" PRIu64 "\t%" PRIu64
+			"\t%" PRIu64 "\t%" PRIu64
+			"\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%s\n",
+			compressed_pos, uncompressed_pos, elapsed,
+			stats.blocks,
+			stats.check_bytes[LZMA_CHECK_NONE],
+			stats.check_bytes[LZMA_CHECK_CRC32],
+			stats.check_bytes[LZMA_CHECK_CRC64],
+			stats.check_bytes[LZMA_CHECK_SHA256],
+			stats.worker_busy_ns, stats.worker_idle_ns,
+			stats.stalls, stats.stall_ns,
+			stats.memusage_peak, src_name);
+	return;
+}
+
+
 extern void
 message_progress_update(void)
 {
-	if (!progress_needs_updating)
+	// The progress indicator isn't available in robot mode.
+	if (!progress_needs_updating || opt_robot)
 		return;
 
 	// Calculate how long we have been processing this file.
@@ -651,10 +745,17 @@ progress_flush(bool finished)
 
 	signals_block();
 
+	// In robot mode only the statistics of a finished file are printed.
 	// When using the auto-updating progress indicator, the final
 	// statistics are printed in the same format as the progress
 	// indicator itself.
-	if (progress_automatic) {
+	if (opt_robot) {
+		if (finished && verbosity >= V_DEBUG
+				&& !progress_is_from_passthru)
+			print_stats_robot(filename, progress_strm,
+					compressed_pos, uncompressed_pos,
+					elapsed);
+	} else if (progress_automatic) {
 		const char *cols[5] = {
 			finished ? "100 %" : progress_percentage(in_pos),
 			progress_sizes(compressed_pos, uncompressed_pos, true),
@@ -681,20 +782,7 @@ progress_flush(bool finished)
 				fprintf(stderr, "%s, ", percentage);
 		}
 
-		// Size information is always printed.
-		fprintf(stderr, "%s", progress_sizes(
-				compressed_pos, uncompressed_pos, true));
-
-		// The speed and elapsed time aren't always shown.
-		const char *speed = progress_speed(uncompressed_pos, elapsed);
-		if (speed[0] != '\0')
-			fprintf(stderr, ", %s", speed);
-
-		const char *elapsed_str = progress_time(elapsed);
-		if (elapsed_str[0] != '\0')
-			fprintf(stderr, ", %s", elapsed_str);
-
-		fputc('\n', stderr);
+		print_final_sizes(compressed_pos, uncompressed_pos, elapsed);
 	}
 
 	signals_unblock();
@@ -713,10 +801,116 @@ message_progress_end(bool success)
 }
 
 
+extern void
+message_file_done(const char *src_name, lzma_stream *strm, uint64_t elapsed)
+{
+	if (verbosity < V_VERBOSE)
+		return;
+
+	uint64_t in_pos;
+	uint64_t compressed_pos;
+	uint64_t uncompressed_pos;
+	stream_pos(strm, false, &in_pos, &compressed_pos, &uncompressed_pos);
+
+	message_lock();
+	signals_block();
+
+	if (opt_robot) {
+		if (verbosity >= V_DEBUG)
+			print_stats_robot(src_name, strm, compressed_pos,
+					uncompressed_pos, elapsed);
+	} else {
+		fprintf(stderr, "%s: ", src_name);
+		print_final_sizes(compressed_pos, uncompressed_pos, elapsed);
+	}
+
+	signals_unblock();
+	message_unlock();
+
+	return;
+}
+
+
+#ifdef MYTHREAD_ENABLED
+/// Append a message in the same format as vmessage_locked() to *buf.
+/// This is called with message_mutex locked so xrealloc() cannot be used:
+/// message_fatal() would try to lock it again. On error, true is returned
+/// and the message is printed normally.
+static bool
+vmessage_defer(char **buf, const char *fmt, va_list ap)
+{
+	va_list ap_copy;
+	va_copy(ap_copy, ap);
+	const int prefix_len = snprintf(NULL, 0, _("%s: "), progname);
+	const int msg_len = vsnprintf(NULL, 0, fmt, ap_copy);
+	va_end(ap_copy);
+
+	if (prefix_len < 0 || msg_len < 0)
+		return true;
+
+	const size_t old_len = *buf == NULL ? 0 : strlen(*buf);
+	const size_t new_len = old_len + (size_t)(prefix_len)
+			+ (size_t)(msg_len) + 1;
+	char *new_buf = realloc(*buf, new_len + 1);
+	if (new_buf == NULL)
+		return true;
+
+	*buf = new_buf;
+
+	char *p = new_buf + old_len;
+	p += snprintf(p, (size_t)(prefix_len) + 1, _("%s: "), progname);
+	p += vsnprintf(p, (size_t)(msg_len) + 1, fmt, ap);
+	p[0] = '\n';
+	p[1] = '\0';
+	return false;
+}
+
+
+extern void
+message_defer_begin(char **buf)
+{
+	mythread_key_set(message_defer_key, buf);
+	return;
+}
+
+
+extern void
+message_defer_end(void)
+{
+	mythread_key_set(message_defer_key, NULL);
+	return;
+}
+
+
+extern void
+message_defer_print(char *buf)
+{
+	if (buf != NULL) {
+		message_lock();
+		signals_block();
+		progress_flush(false);
+		fputs(buf, stderr);
+		signals_unblock();
+		message_unlock();
+		free(buf);
+	}
+
+	return;
+}
+#endif
+
+
+/// Like vmessage() but the caller must hold the message lock.
 static void
-vmessage(enum message_verbosity v, const char *fmt, va_list ap)
+vmessage_locked(enum message_verbosity v, const char *fmt, va_list ap)
 {
 	if (v <= verbosity) {
+#ifdef MYTHREAD_ENABLED
+		char **defer = mythread_key_get(message_defer_key);
+		if (defer != NULL && !vmessage_defer(defer, fmt, ap))
+			return;
+#endif
+
 		signals_block();
 
 		progress_flush(false);
@@ -736,6 +930,27 @@ vmessage(enum message_verbosity v, const char *fmt, va_list ap)
 }
 
 
+static void
+vmessage(enum message_verbosity v, const char *fmt, va_list ap)
+{
+	message_lock();
+	vmessage_locked(v, fmt, ap);
+	message_unlock();
+	return;
+}
+
+
+static void
+message_locked(enum message_verbosity v, const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	vmessage_locked(v, fmt, ap);
+	va_end(ap);
+	return;
+}
+
+
 extern void
 message(enum message_verbosity v, const char *fmt, ...)
 {
@@ -776,6 +991,17 @@ message_error(const char *fmt, ...)
 extern void
 message_fatal(const char *fmt, ...)
 {
+#ifdef MYTHREAD_ENABLED
+	// Print the deferred messages of this thread and then the fatal
+	// message itself since the program won't continue.
+	char **defer = mythread_key_get(message_defer_key);
+	if (defer != NULL) {
+		message_defer_end();
+		message_defer_print(*defer);
+		*defer = NULL;
+	}
+#endif
+
 	va_list ap;
 	va_start(ap, fmt);
 	vmessage(V_ERROR, fmt, ap);
@@ -863,14 +1089,18 @@ message_mem_needed(enum message_verbosity v, uint64_t memusage)
 	// the user might need to +1 MiB to get high enough limit.)
 	memusage = round_up_to_mib(memusage);
 
+	// uint64_to_str() uses static buffers.
+	message_lock();
+
 	uint64_t memlimit = hardware_memlimit_get(opt_mode);
 
 	// Handle the case when there is no memory usage limit.
 	// This way we don't print a weird message with a huge number.
 	if (memlimit == UINT64_MAX) {
-		message(v, _("%s MiB of memory is required. "
+		message_locked(v, _("%s MiB of memory is required. "
 				"The limiter is disabled."),
 				uint64_to_str(memusage, 0));
+		message_unlock();
 		return;
 	}
 
@@ -896,9 +1126,11 @@ message_mem_needed(enum message_verbosity v, uint64_t memusage)
 				uint64_to_str(round_up_to_mib(memlimit), 1));
 	}
 
-	message(v, _("%s MiB of memory is required. The limit is %s."),
+	message_locked(v, _("%s MiB of memory is required. "
+			"The limit is %s."),
 			uint64_to_str(memusage, 0), memlimitstr);
 
+	message_unlock();
 	return;
 }
 
@@ -951,12 +1183,16 @@ message_filters_to_str(char buf[FILTERS_STR_SIZE],
 					mode = "normal";
 					break;
 
+				case LZMA_MODE_ULTRA_FAST:
+					mode = "ultrafast";
+					break;
+
 				default:
 					mode = "UNKNOWN";
 					break;
 				}
 
-				switch (opt->mf) {
+				switch (opt->mf & ~LZMA_MF_LONG_RANGE) {
 				case LZMA_MF_HC3:
 					mf = "hc3";
 					break;
@@ -977,6 +1213,14 @@ message_filters_to_str(char buf[FILTERS_STR_SIZE],
 					mf = "bt4";
 					break;
 
+				case LZMA_MF_HS4:
+					mf = "hs4";
+					break;
+
+				case LZMA_MF_HB4:
+					mf = "hb4";
+					break;
+
 				default:
 					mf = "UNKNOWN";
 					break;
@@ -1003,9 +1247,11 @@ message_filters_to_str(char buf[FILTERS_STR_SIZE],
 					",lc=%" PRIu32 ",lp=%" PRIu32
 					",pb=%" PRIu32
 					",mode=%s,nice=%" PRIu32 ",mf=%s"
-					",depth=%" PRIu32,
+					",depth=%" PRIu32 "%s",
 					opt->lc, opt->lp, opt->pb,
-					mode, opt->nice_len, mf, opt->depth);
+					mode, opt->nice_len, mf, opt->depth,
+					opt->mf & LZMA_MF_LONG_RANGE
+						? ",long=1" : "");
 			break;
 		}
 
@@ -1043,6 +1289,19 @@ message_filters_to_str(char buf[FILTERS_STR_SIZE],
 			break;
 		}
 
+		case LZMA_FILTER_DEDUP: {
+			const lzma_options_dedup *opt = filters[i].options;
+			my_snprintf(&pos, &left, "dedup=window=%s",
+					uint32_to_optstr(opt->window_size));
+
+			// The chunk size is unknown when decompressing.
+			if (opt->chunk_size != 0)
+				my_snprintf(&pos, &left, ",chunk=%s",
+					uint32_to_optstr(opt->chunk_size));
+
+			break;
+		}
+
 		default:
 			// This should be possible only if liblzma is
 			// newer than the xz tool.
@@ -1118,6 +1377,11 @@ message_help(bool long_help)
 "  -t, --test          test compressed file integrity\n"
 "  -l, --list          list information about .xz files"));
 
+	if (long_help)
+		puts(_(
+"      --train[=SIZE]  build a preset dictionary of at most SIZE bytes\n"
+"                      (default 112 KiB) from FILEs; see --preset-dict"));
+
 	if (long_help)
 		puts(_("\n Operation modifiers:\n"));
 
@@ -1132,7 +1396,12 @@ message_help(bool long_help)
 "                      ignore possible remaining input data"));
 		puts(_(
 "      --no-sparse     do not create sparse files when decompressing\n"
+"      --sparse-min=SIZE\n"
+"                      write runs of zeros shorter than SIZE bytes instead of\n"
+"                      making holes of them in sparse files; default is 64KiB\n"
 "  -S, --suffix=.SUF   use the suffix `.SUF' on compressed files\n"
+"  -r, --recursive     operate on the files in the given directories and\n"
+"                      their subdirectories\n"
 "      --files[=FILE]  read filenames to process from FILE; if FILE is\n"
 "                      omitted, filenames are read from the standard input;\n"
 "                      filenames must be terminated with the newline character\n"
@@ -1148,6 +1417,10 @@ message_help(bool long_help)
 "                      `crc32', `crc64' (default), or `sha256'"));
 		puts(_(
 "      --ignore-check  don't verify the integrity check when decompressing"));
+		puts(_(
+"      --preset-dict=FILE\n"
+"                      use FILE as the LZMA1/LZMA2 preset dictionary with\n"
+"                      --format=raw; with --train, write the dictionary to FILE"));
 	}
 
 	puts(_(
@@ -1164,6 +1437,9 @@ message_help(bool long_help)
 
 	if (long_help) {
 		puts(_(
+"      --jobs=NUM      process at most NUM files in parallel; the default is 1;\n"
+"                      set to 0 to use as many as there are processor cores"));
+		puts(_(
 "      --block-size=SIZE\n"
 "                      start a new .xz block after every SIZE bytes of input;\n"
 "                      use this to set the block size for threaded compression"));
@@ -1233,6 +1509,16 @@ message_help(bool long_help)
 "  --delta[=OPTS]      Delta filter; valid OPTS (valid values; default):\n"
 "                        dist=NUM   distance between bytes being subtracted\n"
 "                                   from each other (1-256; 1)"));
+#endif
+
+#if defined(HAVE_ENCODER_DEDUP) || defined(HAVE_DECODER_DEDUP)
+		puts(_(
+"\n"
+"  --dedup[=OPTS]      Dedup filter; valid OPTS (valid values; default):\n"
+"                        window=NUM how far back repeated chunks are\n"
+"                                   looked for (1MiB-1GiB; 64MiB)\n"
+"                        chunk=NUM  average chunk size, a power of two\n"
+"                                   (4KiB-1MiB; 64KiB)"));
 #endif
 	}
 
@@ -139,6 +139,25 @@ extern void message_set_files(unsigned int files);
 extern void message_filename(const char *src_name);
 
 
+#ifdef MYTHREAD_ENABLED
+/// \brief      Collect the messages of the calling thread instead of
+///             printing them
+///
+/// Until message_defer_end() is called, the messages that the calling
+/// thread would print are appended to *buf. *buf must be NULL or a string
+/// from an earlier call. With --list --jobs, this keeps the messages
+/// about each file next to its listing.
+extern void message_defer_begin(char **buf);
+
+/// Print the messages of the calling thread again.
+extern void message_defer_end(void);
+
+/// Print the messages collected by message_defer_begin() and free buf.
+/// buf may be NULL.
+extern void message_defer_print(char *buf);
+#endif
+
+
 /// \brief      Start progress info handling
 ///
 /// message_filename() must be called before this function to set
@@ -166,3 +185,16 @@ extern void message_progress_update(void);
 ///                         and output written to the output stream.
 ///
 extern void message_progress_end(bool finished);
+
+
+/// \brief      Print the final statistics of a file in verbose mode
+///
+/// This is used instead of the progress indicator when files are processed
+/// in parallel with --jobs. It can be called from any thread.
+///
+/// \param      src_name    Name of the source file
+/// \param      strm        The lzma_stream used to code the file
+/// \param      elapsed     Milliseconds it took to code the file
+///
+extern void message_file_done(const char *src_name, lzma_stream *strm,
+		uint64_t elapsed);
@@ -22,10 +22,7 @@ static uint64_t start_time;
 static uint64_t next_flush;
 
 
-/// \brief      Get the current time as milliseconds
-///
-/// It's relative to some point but not necessarily to the UNIX Epoch.
-static uint64_t
+extern uint64_t
 mytime_now(void)
 {
 	// NOTE: HAVE_DECL_CLOCK_MONOTONIC is always defined to 0 or 1.
@@ -65,7 +62,12 @@ mytime_get_elapsed(void)
 extern void
 mytime_set_flush_time(void)
 {
-	next_flush = mytime_now() + opt_flush_timeout;
+	// next_flush isn't used without --flush-timeout. Skipping it also
+	// keeps the worker threads of --jobs, which are used only without
+	// --flush-timeout, from writing to it.
+	if (opt_flush_timeout != 0)
+		next_flush = mytime_now() + opt_flush_timeout;
+
 	return;
 }
 
@@ -21,6 +21,12 @@
 extern uint64_t opt_flush_timeout;
 
 
+/// \brief      Get the current time as milliseconds
+///
+/// It's relative to some point but not necessarily to the UNIX Epoch.
+extern uint64_t mytime_now(void);
+
+
 /// \brief      Store the time when (de)compression was started
 ///
 /// The start time is also stored as the time of the first flush.
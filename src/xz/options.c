@@ -183,6 +183,60 @@ options_delta(const char *str)
 }
 
 
+///////////
+// Dedup //
+///////////
+
+enum {
+	OPT_WINDOW,
+	OPT_CHUNK,
+};
+
+
+static void
+set_dedup(void *options, unsigned key, uint64_t value,
+		const char *valuestr lzma_attribute((__unused__)))
+{
+	lzma_options_dedup *opt = options;
+	switch (key) {
+	case OPT_WINDOW:
+		opt->window_size = value;
+		break;
+
+	case OPT_CHUNK:
+		opt->chunk_size = value;
+		break;
+	}
+}
+
+
+extern lzma_options_dedup *
+options_dedup(const char *str)
+{
+	static const option_map opts[] = {
+		{ "window",   NULL,  LZMA_DEDUP_WINDOW_MIN,
+		                     LZMA_DEDUP_WINDOW_MAX },
+		{ "chunk",    NULL,  LZMA_DEDUP_CHUNK_MIN,
+		                     LZMA_DEDUP_CHUNK_MAX },
+		{ NULL,       NULL,  0, 0 }
+	};
+
+	lzma_options_dedup *options = xmalloc(sizeof(lzma_options_dedup));
+	*options = (lzma_options_dedup){
+		.window_size = LZMA_DEDUP_WINDOW_DEFAULT,
+		.chunk_size = LZMA_DEDUP_CHUNK_DEFAULT,
+	};
+
+	parse_options(str, opts, &set_dedup, options);
+
+	if ((options->chunk_size & (options->chunk_size - 1)) != 0)
+		message_fatal(_("The Dedup chunk size must be "
+				"a power of two"));
+
+	return options;
+}
+
+
 /////////
 // BCJ //
 /////////
@@ -238,6 +292,7 @@ enum {
 	OPT_NICE,
 	OPT_MF,
 	OPT_DEPTH,
+	OPT_LONG,
 };
 
 
@@ -303,12 +358,22 @@ set_lzma(void *options, unsigned key, uint64_t value, const char *valuestr)
 		break;
 
 	case OPT_MF:
-		opt->mf = value;
+		// Keep the long-range flag in case long was given
+		// before mf.
+		opt->mf = value | (opt->mf & LZMA_MF_LONG_RANGE);
 		break;
 
 	case OPT_DEPTH:
 		opt->depth = value;
 		break;
+
+	case OPT_LONG:
+		if (value)
+			opt->mf |= LZMA_MF_LONG_RANGE;
+		else
+			opt->mf &= ~LZMA_MF_LONG_RANGE;
+
+		break;
 	}
 }
 
@@ -319,6 +384,7 @@ options_lzma(const char *str)
 	static const name_id_map modes[] = {
 		{ "fast",   LZMA_MODE_FAST },
 		{ "normal", LZMA_MODE_NORMAL },
+		{ "ultrafast", LZMA_MODE_ULTRA_FAST },
 		{ NULL,     0 }
 	};
 
@@ -328,6 +394,8 @@ options_lzma(const char *str)
 		{ "bt2", LZMA_MF_BT2 },
 		{ "bt3", LZMA_MF_BT3 },
 		{ "bt4", LZMA_MF_BT4 },
+		{ "hs4", LZMA_MF_HS4 },
+		{ "hb4", LZMA_MF_HB4 },
 		{ NULL,  0 }
 	};
 
@@ -342,6 +410,7 @@ options_lzma(const char *str)
 		{ "nice",   NULL,   2, 273 },
 		{ "mf",     mfs,    0, 0 },
 		{ "depth",  NULL,   0, UINT32_MAX },
+		{ "long",   NULL,   0, 1 },
 		{ NULL,     NULL,   0, 0 }
 	};
 
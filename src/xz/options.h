@@ -17,6 +17,13 @@
 extern lzma_options_delta *options_delta(const char *str);
 
 
+/// \brief      Parser for Dedup options
+///
+/// \return     Pointer to allocated options structure.
+///             Doesn't return on error.
+extern lzma_options_dedup *options_dedup(const char *str);
+
+
 /// \brief      Parser for BCJ options
 ///
 /// \return     Pointer to allocated options structure.
@@ -60,7 +60,12 @@
 #include "signals.h"
 #include "suffix.h"
 #include "util.h"
+#include "walk.h"
 
 #ifdef HAVE_DECODERS
 #	include "list.h"
 #endif
+
+#ifdef HAVE_ENCODERS
+#	include "train.h"
+#endif
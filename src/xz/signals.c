@@ -35,6 +35,25 @@ static bool signals_are_initialized = false;
 /// signals_block() and signals_unblock() can be called recursively.
 static size_t signals_block_count = 0;
 
+#ifdef MYTHREAD_POSIX
+/// The thread that called signals_init(). The worker threads of --jobs
+/// have all signals blocked for their whole lifetime, so signals_block()
+/// and signals_unblock() do nothing in them. This also keeps
+/// signals_block_count from being used by more than one thread.
+static pthread_t main_thread;
+#endif
+
+
+static inline bool
+is_main_thread(void)
+{
+#ifdef MYTHREAD_POSIX
+	return pthread_equal(pthread_self(), main_thread);
+#else
+	return true;
+#endif
+}
+
 
 static void
 signal_handler(int sig)
@@ -109,6 +128,10 @@ signals_init(void)
 			message_signal_handler();
 	}
 
+#ifdef MYTHREAD_POSIX
+	main_thread = pthread_self();
+#endif
+
 	signals_are_initialized = true;
 
 	return;
@@ -119,7 +142,7 @@ signals_init(void)
 extern void
 signals_block(void)
 {
-	if (signals_are_initialized) {
+	if (signals_are_initialized && is_main_thread()) {
 		if (signals_block_count++ == 0) {
 			const int saved_errno = errno;
 			mythread_sigmask(SIG_BLOCK, &hooked_signals, NULL);
@@ -134,7 +157,7 @@ signals_block(void)
 extern void
 signals_unblock(void)
 {
-	if (signals_are_initialized) {
+	if (signals_are_initialized && is_main_thread()) {
 		assert(signals_block_count > 0);
 
 		if (--signals_block_count == 0) {
@@ -102,6 +102,24 @@ test_suffix(const char *suffix, const char *src_name, size_t src_len)
 }
 
 
+/// Suffixes of compressed files and what they are replaced with when
+/// decompressing
+static const struct {
+	const char *compressed;
+	const char *uncompressed;
+} known_suffixes[] = {
+	{ ".xz",    "" },
+	{ ".txz",   ".tar" }, // .txz abbreviation for .txt.gz is rare.
+	{ ".lzma",  "" },
+#ifdef __DJGPP__
+	{ ".lzm",   "" },
+#endif
+	{ ".tlz",   ".tar" },
+	// { ".gz",    "" },
+	// { ".tgz",   ".tar" },
+};
+
+
 /// \brief      Removes the filename suffix of the compressed file
 ///
 /// \return     Name of the uncompressed file, or NULL if file has unknown
@@ -109,21 +127,6 @@ test_suffix(const char *suffix, const char *src_name, size_t src_len)
 static char *
 uncompressed_name(const char *src_name, const size_t src_len)
 {
-	static const struct {
-		const char *compressed;
-		const char *uncompressed;
-	} suffixes[] = {
-		{ ".xz",    "" },
-		{ ".txz",   ".tar" }, // .txz abbreviation for .txt.gz is rare.
-		{ ".lzma",  "" },
-#ifdef __DJGPP__
-		{ ".lzm",   "" },
-#endif
-		{ ".tlz",   ".tar" },
-		// { ".gz",    "" },
-		// { ".tgz",   ".tar" },
-	};
-
 	const char *new_suffix = "";
 	size_t new_len = 0;
 
@@ -136,11 +139,11 @@ uncompressed_name(const char *src_name, const size_t src_len)
 			return NULL;
 		}
 	} else {
-		for (size_t i = 0; i < ARRAY_SIZE(suffixes); ++i) {
-			new_len = test_suffix(suffixes[i].compressed,
+		for (size_t i = 0; i < ARRAY_SIZE(known_suffixes); ++i) {
+			new_len = test_suffix(known_suffixes[i].compressed,
 					src_name, src_len);
 			if (new_len != 0) {
-				new_suffix = suffixes[i].uncompressed;
+				new_suffix = known_suffixes[i].uncompressed;
 				break;
 			}
 		}
@@ -384,6 +387,28 @@ suffix_get_dest_name(const char *src_name)
 }
 
 
+extern bool
+suffix_is_compressed(const char *src_name)
+{
+	const size_t src_len = strlen(src_name);
+
+	if (custom_suffix != NULL
+			&& test_suffix(custom_suffix, src_name, src_len) != 0)
+		return true;
+
+	// With --format=raw only the custom suffix is used.
+	if (opt_format == FORMAT_RAW)
+		return false;
+
+	for (size_t i = 0; i < ARRAY_SIZE(known_suffixes); ++i)
+		if (test_suffix(known_suffixes[i].compressed,
+				src_name, src_len) != 0)
+			return true;
+
+	return false;
+}
+
+
 extern void
 suffix_set(const char *suffix)
 {
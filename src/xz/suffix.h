@@ -19,6 +19,14 @@
 extern char *suffix_get_dest_name(const char *src_name);
 
 
+/// \brief      Check if the filename has a suffix of a compressed file
+///
+/// This is like the suffix check of suffix_get_dest_name() when
+/// decompressing but it doesn't print anything. --recursive uses this
+/// to silently skip the files that don't need to be processed.
+extern bool suffix_is_compressed(const char *src_name);
+
+
 /// \brief      Set a custom filename suffix
 ///
 /// This function calls xstrdup() for the given suffix, thus the caller
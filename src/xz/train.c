@@ -0,0 +1,178 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       train.c
+/// \brief      Build a preset dictionary from sample files
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "private.h"
+#include <fcntl.h>
+
+#ifndef O_BINARY
+#	define O_BINARY 0
+#endif
+
+#ifndef O_NOCTTY
+#	define O_NOCTTY 0
+#endif
+
+// Windows doesn't have group and other permissions.
+#ifndef S_IRGRP
+#	define S_IRGRP 0
+#endif
+
+#ifndef S_IROTH
+#	define S_IROTH 0
+#endif
+
+
+uint64_t opt_train_size = 112 << 10;
+
+/// All samples concatenated
+static uint8_t *samples = NULL;
+static size_t samples_size = 0;
+static size_t samples_alloc = 0;
+
+/// Sizes of the individual samples
+static size_t *sample_sizes = NULL;
+static size_t sample_count = 0;
+static size_t sample_sizes_alloc = 0;
+
+
+extern void
+train_file(const char *filename)
+{
+	message_filename(filename);
+
+	file_pair *pair = io_open_src(filename);
+	if (pair == NULL)
+		return;
+
+	const size_t sample_begin = samples_size;
+	io_buf buf;
+
+	while (!pair->src_eof) {
+		const size_t amount = io_read(pair, &buf, IO_BUFFER_SIZE);
+		if (amount == SIZE_MAX) {
+			// Forget the partially read sample.
+			samples_size = sample_begin;
+			io_close(pair, false);
+			return;
+		}
+
+		if (samples_alloc - samples_size < amount) {
+			if (SIZE_MAX - samples_size < amount
+					|| samples_alloc > SIZE_MAX / 2)
+				message_fatal(_("%s: Too much sample data"),
+						filename);
+
+			samples_alloc = my_max(samples_alloc * 2,
+					samples_size + amount);
+			samples = xrealloc(samples, samples_alloc);
+		}
+
+		memcpy(samples + samples_size, buf.u8, amount);
+		samples_size += amount;
+	}
+
+	io_close(pair, false);
+
+	// Empty files are allowed but they are useless as samples.
+	if (samples_size == sample_begin)
+		return;
+
+	if (sample_count == sample_sizes_alloc) {
+		if (sample_sizes_alloc > SIZE_MAX / 2 / sizeof(size_t))
+			message_fatal(_("%s: Too many samples"), filename);
+
+		sample_sizes_alloc = sample_sizes_alloc == 0
+				? 256 : sample_sizes_alloc * 2;
+		sample_sizes = xrealloc(sample_sizes,
+				sample_sizes_alloc * sizeof(size_t));
+	}
+
+	sample_sizes[sample_count++] = samples_size - sample_begin;
+	return;
+}
+
+
+/// Write the dictionary to opt_preset_dict. An existing file is
+/// overwritten only with --force.
+static bool
+write_dict(const uint8_t *dict, size_t dict_size)
+{
+	const int flags = O_WRONLY | O_BINARY | O_NOCTTY | O_CREAT
+			| (opt_force ? O_TRUNC : O_EXCL);
+	const int fd = open(opt_preset_dict, flags,
+			S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (fd == -1) {
+		message_error("%s: %s", opt_preset_dict, strerror(errno));
+		return true;
+	}
+
+	size_t pos = 0;
+	while (pos < dict_size) {
+		const ssize_t amount = write(fd, dict + pos,
+				my_min(dict_size - pos, IO_BUFFER_SIZE));
+		if (amount == -1) {
+			if (errno == EINTR && !user_abort)
+				continue;
+
+			message_error("%s: %s", opt_preset_dict,
+					strerror(errno));
+			(void)close(fd);
+			return true;
+		}
+
+		pos += (size_t)(amount);
+	}
+
+	if (close(fd)) {
+		message_error("%s: %s", opt_preset_dict, strerror(errno));
+		return true;
+	}
+
+	return false;
+}
+
+
+extern void
+train_finish(void)
+{
+	if (sample_count == 0) {
+		message_error(_("No sample data to build "
+				"a preset dictionary from"));
+		return;
+	}
+
+	const size_t dict_size_max = (size_t)my_min(
+			opt_train_size, samples_size);
+	uint8_t *dict = xmalloc(dict_size_max);
+	size_t dict_size;
+
+	const lzma_ret ret = lzma_preset_dict_train(NULL, samples,
+			sample_sizes, sample_count,
+			dict, &dict_size, dict_size_max);
+	if (ret != LZMA_OK)
+		message_fatal("%s", message_strm(ret));
+
+	if (!write_dict(dict, dict_size))
+		message(V_VERBOSE, _("%s: Built a preset dictionary of "
+				"%s bytes from %s samples (%s bytes)"),
+				opt_preset_dict,
+				uint64_to_str(dict_size, 0),
+				uint64_to_str(sample_count, 1),
+				uint64_to_str(samples_size, 2));
+
+	free(dict);
+
+#ifndef NDEBUG
+	free(samples);
+	free(sample_sizes);
+#endif
+
+	return;
+}
@@ -0,0 +1,20 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       train.h
+/// \brief      Build a preset dictionary from sample files
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+/// Maximum size of the dictionary built with --train
+extern uint64_t opt_train_size;
+
+/// \brief      Read the given file as a sample for --train
+extern void train_file(const char *filename);
+
+
+/// \brief      Build the dictionary from the samples and write it to
+///             the file given with --preset-dict
+extern void train_finish(void);
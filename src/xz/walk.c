@@ -0,0 +1,209 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       walk.c
+/// \brief      Find the files in directory trees for --recursive
+///
+/// The directories are read with openat(), fstatat(), and fdopendir()
+/// relative to the file descriptor of the parent directory, so the kernel
+/// doesn't need to resolve the whole path again for every file. The files
+/// are given to coder_run() or list_file() as soon as they are found. With
+/// --jobs the first files get compressed while the rest of the tree is
+/// still being read.
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "private.h"
+
+#ifdef HAVE_FDOPENDIR
+#	include <fcntl.h>
+#	include <dirent.h>
+
+#	ifndef O_NOFOLLOW
+#		define O_NOFOLLOW 0
+#	endif
+
+#	ifndef O_CLOEXEC
+#		define O_CLOEXEC 0
+#	endif
+
+
+/// Pathname of the current file. The names are appended to and removed
+/// from the end as the tree is walked, so the buffer is allocated only
+/// when a longer path is needed.
+static char *path = NULL;
+static size_t path_size = 0;
+
+
+/// Make sure that path[] can hold at least size bytes.
+static void
+path_reserve(size_t size)
+{
+	if (size > path_size) {
+		path_size = my_max(size, 2 * path_size);
+		path = xrealloc(path, path_size);
+	}
+
+	return;
+}
+
+
+/// Return true if a regular file found from a directory should be
+/// processed. Files whose names don't fit the operation mode are skipped
+/// without a warning. Otherwise every compressed file in the tree would
+/// cause a warning when compressing and every uncompressed file when
+/// decompressing.
+static bool
+is_wanted(const char *filename)
+{
+	switch (opt_mode) {
+	case MODE_COMPRESS:
+		return !suffix_is_compressed(filename);
+
+	case MODE_TRAIN:
+		return true;
+
+	default:
+		return suffix_is_compressed(filename);
+	}
+}
+
+
+/// Process the directory that is open as dir_fd. Its name is in
+/// path[0, path_len). dir_fd is closed before returning.
+static void
+walk_dir(int dir_fd, size_t path_len, void (*run)(const char *filename))
+{
+	DIR *dir = fdopendir(dir_fd);
+	if (dir == NULL) {
+		message_error("%s: %s", path, strerror(errno));
+		(void)close(dir_fd);
+		return;
+	}
+
+	while (!user_abort) {
+		// Block the signals, for which we have a custom signal
+		// handler, so that we don't need to worry about EINTR.
+		// They are unblocked again before processing a file so
+		// that the user can interrupt a long operation.
+		signals_block();
+
+		errno = 0;
+		const struct dirent *ent = readdir(dir);
+		if (ent == NULL) {
+			if (errno != 0)
+				message_error("%s: %s", path,
+						strerror(errno));
+
+			signals_unblock();
+			break;
+		}
+
+		const char *name = ent->d_name;
+		if (name[0] == '.' && (name[1] == '\0'
+				|| (name[1] == '.' && name[2] == '\0'))) {
+			signals_unblock();
+			continue;
+		}
+
+		// Append the name to the path. Don't double the slash
+		// if the directory was given as "foo/" or "/".
+		const size_t name_len = strlen(name);
+		path_reserve(path_len + 1 + name_len + 1);
+
+		size_t len = path_len;
+		if (len == 0 || path[len - 1] != '/')
+			path[len++] = '/';
+
+		memcpy(path + len, name, name_len + 1);
+
+		// Symbolic links are never followed inside the tree.
+		// With file systems that fill in d_type, fstatat() is
+		// needed only to check the file type when d_type is
+		// unknown. io_open_src() checks the file again anyway.
+		bool is_dir = false;
+		bool is_reg = false;
+#ifdef DT_UNKNOWN
+		if (ent->d_type != DT_UNKNOWN) {
+			is_dir = ent->d_type == DT_DIR;
+			is_reg = ent->d_type == DT_REG;
+		} else
+#endif
+		{
+			struct stat st;
+			if (fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW)) {
+				message_error("%s: %s", path,
+						strerror(errno));
+				signals_unblock();
+				continue;
+			}
+
+			is_dir = S_ISDIR(st.st_mode);
+			is_reg = S_ISREG(st.st_mode);
+		}
+
+		int subdir_fd = -1;
+		if (is_dir) {
+			subdir_fd = openat(dir_fd, name, O_RDONLY | O_DIRECTORY
+					| O_NOFOLLOW | O_CLOEXEC);
+			if (subdir_fd == -1)
+				message_error("%s: %s", path,
+						strerror(errno));
+		}
+
+		signals_unblock();
+
+		if (subdir_fd != -1)
+			walk_dir(subdir_fd, len + name_len, run);
+		else if (is_reg && is_wanted(path))
+			run(path);
+	}
+
+	(void)closedir(dir);
+	return;
+}
+#endif
+
+
+extern void
+walk_path(const char *filename, void (*run)(const char *filename))
+{
+#ifdef HAVE_FDOPENDIR
+	// Only directories are handled here. Everything else, including
+	// errors, is left to run(). Symbolic links to directories are
+	// followed only when given on the command line.
+	struct stat st;
+	if (filename == stdin_filename || stat(filename, &st)
+			|| !S_ISDIR(st.st_mode)) {
+		run(filename);
+		return;
+	}
+
+	signals_block();
+	const int dir_fd = open(filename, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	signals_unblock();
+
+	if (dir_fd == -1) {
+		message_error("%s: %s", filename, strerror(errno));
+		return;
+	}
+
+	const size_t len = strlen(filename);
+	path_reserve(len + 1);
+	memcpy(path, filename, len + 1);
+
+	walk_dir(dir_fd, len, run);
+
+	free(path);
+	path = NULL;
+	path_size = 0;
+#else
+	// args.c doesn't allow --recursive without fdopendir().
+	assert(0);
+	run(filename);
+#endif
+
+	return;
+}
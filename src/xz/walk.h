@@ -0,0 +1,17 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       walk.h
+/// \brief      Find the files in directory trees for --recursive
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+/// \brief      Process a file or all files in a directory tree
+///
+/// If filename is a directory, run() is called for every regular file
+/// found under it that is relevant in the current operation mode.
+/// Otherwise run() is called for filename itself.
+extern void walk_path(const char *filename,
+		void (*run)(const char *filename));
@@ -0,0 +1,121 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       test_arena.c
+/// \brief      Tests lzma_stream_arena()
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "tests.h"
+
+
+#define DATA_SIZE (100 << 10)
+#define PRESET 1
+
+
+static uint8_t data[DATA_SIZE];
+
+static alloc_counts counts;
+
+
+// Encode the data with lzma_easy_encoder() and decode it back to check
+// that the output is correct.
+static void
+encode_and_check(lzma_stream *strm)
+{
+	assert_lzma_ret(lzma_easy_encoder(strm, PRESET, LZMA_CHECK_CRC32),
+			LZMA_OK);
+
+	const size_t file_max = lzma_stream_buffer_bound(DATA_SIZE);
+	uint8_t *file = tuktest_malloc(file_max);
+	strm->next_in = data;
+	strm->avail_in = DATA_SIZE;
+	strm->next_out = file;
+	strm->avail_out = file_max;
+	assert_lzma_ret(lzma_code(strm, LZMA_FINISH), LZMA_STREAM_END);
+	const size_t file_size = (size_t)strm->total_out;
+
+	lzma_end(strm);
+	assert_true(strm->internal == NULL);
+
+	assert_xz_decodes_to(file, file_size, data, DATA_SIZE);
+	tuktest_free(file);
+}
+
+
+static void
+test_arena(void)
+{
+	fill_letters(data, DATA_SIZE, 8);
+
+	const lzma_allocator allocator = counting_allocator(&counts);
+	lzma_stream strm = LZMA_STREAM_INIT;
+	strm.allocator = &allocator;
+
+	// Without the arena the encoder makes many allocations.
+	counts.allocs = 0;
+	counts.frees = 0;
+	encode_and_check(&strm);
+	assert_uint(counts.allocs, >, 2);
+	assert_uint_eq(counts.frees, counts.allocs);
+
+	// With a region of the estimated size only lzma_internal and
+	// the region itself are allocated.
+	counts.allocs = 0;
+	counts.frees = 0;
+	assert_lzma_ret(lzma_stream_arena(&strm,
+			lzma_easy_encoder_memusage(PRESET)), LZMA_OK);
+	encode_and_check(&strm);
+	assert_uint_eq(counts.allocs, 2);
+	assert_uint_eq(counts.frees, 2);
+
+	// A region that is too small falls back to the normal allocator.
+	// Everything is still freed by lzma_end().
+	counts.allocs = 0;
+	counts.frees = 0;
+	assert_lzma_ret(lzma_stream_arena(&strm, 1000), LZMA_OK);
+	encode_and_check(&strm);
+	assert_uint(counts.allocs, >, 2);
+	assert_uint_eq(counts.frees, counts.allocs);
+}
+
+
+static void
+test_arena_errors(void)
+{
+	lzma_stream strm = LZMA_STREAM_INIT;
+
+	assert_lzma_ret(lzma_stream_arena(NULL, 1000), LZMA_PROG_ERROR);
+	assert_lzma_ret(lzma_stream_arena(&strm, 0), LZMA_PROG_ERROR);
+	assert_lzma_ret(lzma_stream_arena(&strm, UINT64_MAX),
+			LZMA_PROG_ERROR);
+
+	// The stream already has a coder or an arena.
+	assert_lzma_ret(lzma_easy_encoder(&strm, PRESET, LZMA_CHECK_CRC32),
+			LZMA_OK);
+	assert_lzma_ret(lzma_stream_arena(&strm, 1000), LZMA_PROG_ERROR);
+	lzma_end(&strm);
+
+	assert_lzma_ret(lzma_stream_arena(&strm, 1000), LZMA_OK);
+	assert_lzma_ret(lzma_stream_arena(&strm, 1000), LZMA_PROG_ERROR);
+
+	// A stream with only an arena can be ended.
+	lzma_end(&strm);
+	assert_true(strm.internal == NULL);
+}
+
+
+extern int
+main(int argc, char **argv)
+{
+	tuktest_start(argc, argv);
+
+	require_lzma2();
+
+	tuktest_run(test_arena);
+	tuktest_run(test_arena_errors);
+
+	return tuktest_end();
+}
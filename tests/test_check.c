@@ -314,6 +314,104 @@ test_lzma_get_check_mt(void)
 }
 
 
+// Data for test_verify_only_mt()
+#define VERIFY_DATA_SIZE (300 << 10)
+#define VERIFY_BLOCK_SIZE (64 << 10)
+
+
+static lzma_ret
+verify_mt(const uint8_t *in, size_t in_size, uint32_t threads,
+		uint64_t memlimit_threading, uint64_t *progress_out)
+{
+	const lzma_mt options = {
+		.flags = LZMA_VERIFY_ONLY,
+		.threads = threads,
+		.memlimit_threading = memlimit_threading,
+		.memlimit_stop = UINT64_MAX,
+	};
+
+	lzma_stream strm = LZMA_STREAM_INIT;
+	assert_lzma_ret(lzma_stream_decoder_mt(&strm, &options), LZMA_OK);
+
+	// No output buffer is needed.
+	strm.next_in = in;
+	strm.avail_in = in_size;
+	strm.next_out = NULL;
+	strm.avail_out = 0;
+
+	lzma_ret ret;
+	do {
+		ret = lzma_code(&strm, LZMA_FINISH);
+	} while (ret == LZMA_OK);
+
+	assert_uint_eq(strm.total_out, 0);
+
+	uint64_t progress_in;
+	lzma_get_progress(&strm, &progress_in, progress_out);
+	lzma_end(&strm);
+	return ret;
+}
+
+
+static void
+test_verify_only_mt(void)
+{
+	uint8_t *data = tuktest_malloc(VERIFY_DATA_SIZE);
+	fill_letters(data, VERIFY_DATA_SIZE, 4);
+
+	// The threaded encoder stores the sizes in the Block Headers
+	// so that the Blocks can be decoded in parallel.
+	const lzma_mt enc_options = {
+		.threads = 2,
+		.block_size = VERIFY_BLOCK_SIZE,
+		.preset = 1,
+		.check = LZMA_CHECK_CRC32,
+	};
+
+	const size_t file_max = lzma_stream_buffer_bound(VERIFY_DATA_SIZE);
+	uint8_t *file = tuktest_malloc(file_max);
+
+	lzma_stream strm = LZMA_STREAM_INIT;
+	assert_lzma_ret(lzma_stream_encoder_mt(&strm, &enc_options), LZMA_OK);
+	strm.next_in = data;
+	strm.avail_in = VERIFY_DATA_SIZE;
+	strm.next_out = file;
+	strm.avail_out = file_max;
+	assert_lzma_ret(lzma_code(&strm, LZMA_FINISH), LZMA_STREAM_END);
+	const size_t file_size = (size_t)strm.total_out;
+	lzma_end(&strm);
+
+	// Threaded and direct mode
+	uint64_t progress_out;
+	assert_lzma_ret(verify_mt(file, file_size, 4, UINT64_MAX,
+			&progress_out), LZMA_STREAM_END);
+	assert_uint_eq(progress_out, VERIFY_DATA_SIZE);
+
+	assert_lzma_ret(verify_mt(file, file_size, 1, 0, &progress_out),
+			LZMA_STREAM_END);
+	assert_uint_eq(progress_out, VERIFY_DATA_SIZE);
+
+	// Truncated input
+	assert_lzma_ret(verify_mt(file, file_size - 20, 4, UINT64_MAX,
+			&progress_out), LZMA_BUF_ERROR);
+
+	// Corrupt data in the middle of the file
+	file[file_size / 2] ^= 0x40;
+	assert_lzma_ret(verify_mt(file, file_size, 4, UINT64_MAX,
+			&progress_out), LZMA_DATA_ERROR);
+	assert_lzma_ret(verify_mt(file, file_size, 1, 0, &progress_out),
+			LZMA_DATA_ERROR);
+
+	// The single-threaded decoder doesn't support the flag.
+	assert_lzma_ret(lzma_stream_decoder(&strm, UINT64_MAX,
+			LZMA_VERIFY_ONLY), LZMA_OPTIONS_ERROR);
+	lzma_end(&strm);
+
+	tuktest_free(file);
+	tuktest_free(data);
+}
+
+
 extern int
 main(int argc, char **argv)
 {
@@ -347,6 +445,7 @@ main(int argc, char **argv)
 	tuktest_run(test_lzma_check_size);
 	tuktest_run(test_lzma_get_check_st);
 	tuktest_run(test_lzma_get_check_mt);
+	tuktest_run(test_verify_only_mt);
 
 	return tuktest_end();
 }
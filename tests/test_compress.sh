@@ -114,11 +114,18 @@ test_xz -1
 test_xz -2
 test_xz -3
 test_xz -4
+test_xz --lzma2=dict=64KiB,nice=32,mode=ultrafast,mf=hs4
+test_xz --lzma2=dict=64KiB,nice=273,mode=ultrafast,mf=hc4
+test_xz --lzma2=dict=64KiB,nice=32,mode=fast,mf=hb4
+test_xz --lzma2=dict=64KiB,nice=64,mode=normal,mf=hb4,depth=3
+test_xz --lzma2=dict=64KiB,nice=64,mode=normal,mf=bt4,long=1
+test_xz --lzma2=dict=64KiB,nice=273,mode=ultrafast,mf=hs4,long=1
 
 for ARGS in \
 	--delta=dist=1 \
 	--delta=dist=4 \
 	--delta=dist=256 \
+	--dedup=window=1MiB,chunk=4KiB \
 	--x86 \
 	--powerpc \
 	--ia64 \
@@ -0,0 +1,284 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       test_dedup.c
+/// \brief      Tests the Dedup filter
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "tests.h"
+
+
+// The data is A B A where A and B are random. The second A is farther away
+// than the LZMA2 dictionary reaches but within the Dedup window.
+#define PART_SIZE (1 << 20)
+#define DATA_SIZE (3 * PART_SIZE)
+
+
+static uint8_t data[DATA_SIZE];
+static lzma_options_lzma opt_lzma;
+static lzma_options_dedup opt_dedup;
+
+static lzma_filter filters[3] = {
+	{ .id = LZMA_FILTER_DEDUP, .options = &opt_dedup },
+	{ .id = LZMA_FILTER_LZMA2, .options = &opt_lzma },
+	{ .id = LZMA_VLI_UNKNOWN, .options = NULL },
+};
+
+
+static void
+init(void)
+{
+	uint32_t seed = 1;
+	for (size_t i = 0; i < 2 * PART_SIZE; ++i)
+		data[i] = (uint8_t)test_rand(&seed);
+
+	memcpy(data + 2 * PART_SIZE, data, PART_SIZE);
+
+	assert_false(lzma_lzma_preset(&opt_lzma, 0));
+	opt_lzma.dict_size = 64 << 10;
+
+	memzero(&opt_dedup, sizeof(opt_dedup));
+	opt_dedup.window_size = 3 * PART_SIZE;
+	opt_dedup.chunk_size = LZMA_DEDUP_CHUNK_MIN;
+}
+
+
+static size_t
+encode(const lzma_filter *chain, uint8_t *out, size_t out_max)
+{
+	size_t out_pos = 0;
+	assert_lzma_ret(lzma_raw_buffer_encode(chain, NULL, data, DATA_SIZE,
+			out, &out_pos, out_max), LZMA_OK);
+	return out_pos;
+}
+
+
+static void
+test_dedup_round_trip(void)
+{
+	const size_t out_max = DATA_SIZE + DATA_SIZE / 8;
+	uint8_t *out = tuktest_malloc(out_max);
+
+	// Random data doesn't compress so the sizes show how much
+	// the Dedup filter removed.
+	const size_t plain_size = encode(filters + 1, out, out_max);
+	const size_t size = encode(filters, out, out_max);
+	assert_uint(size, <, plain_size - PART_SIZE + PART_SIZE / 8);
+
+	uint8_t *decoded = tuktest_malloc(DATA_SIZE);
+	size_t in_pos = 0;
+	size_t out_pos = 0;
+	assert_lzma_ret(lzma_raw_buffer_decode(filters, NULL,
+			out, &in_pos, size, decoded, &out_pos, DATA_SIZE),
+			LZMA_OK);
+	assert_uint_eq(in_pos, size);
+	assert_uint_eq(out_pos, DATA_SIZE);
+	assert_array_eq(decoded, data, DATA_SIZE);
+
+	tuktest_free(decoded);
+	tuktest_free(out);
+}
+
+
+static void
+test_dedup_small_buffers(void)
+{
+	const size_t out_max = DATA_SIZE + DATA_SIZE / 8;
+	uint8_t *out = tuktest_malloc(out_max);
+
+	// Encode with small output buffers and LZMA_SYNC_FLUSH after
+	// every 300 KiB. The records must not be split incorrectly.
+	lzma_stream strm = LZMA_STREAM_INIT;
+	assert_lzma_ret(lzma_raw_encoder(&strm, filters), LZMA_OK);
+
+	strm.next_in = data;
+	strm.next_out = out;
+
+	size_t in_end = 0;
+	lzma_ret ret;
+	do {
+		const size_t n = my_min(DATA_SIZE - in_end, 300 << 10);
+		strm.avail_in = n;
+		in_end += n;
+
+		const lzma_action action = in_end == DATA_SIZE
+				? LZMA_FINISH : LZMA_SYNC_FLUSH;
+		do {
+			strm.avail_out = my_min(out_max - strm.total_out,
+					1000);
+			ret = lzma_code(&strm, action);
+		} while (ret == LZMA_OK);
+
+		assert_lzma_ret(ret, LZMA_STREAM_END);
+	} while (in_end < DATA_SIZE);
+
+	const size_t size = (size_t)strm.total_out;
+
+	// Decode with small input and output buffers.
+	uint8_t *decoded = tuktest_malloc(DATA_SIZE);
+	assert_lzma_ret(lzma_raw_decoder(&strm, filters), LZMA_OK);
+
+	strm.next_in = out;
+	strm.next_out = decoded;
+
+	do {
+		strm.avail_in = my_min(size - strm.total_in, 777);
+		strm.avail_out = my_min(DATA_SIZE - strm.total_out, 555);
+		ret = lzma_code(&strm, LZMA_RUN);
+	} while (ret == LZMA_OK);
+
+	assert_lzma_ret(ret, LZMA_STREAM_END);
+	assert_uint_eq(strm.total_in, size);
+	assert_uint_eq(strm.total_out, DATA_SIZE);
+	assert_array_eq(decoded, data, DATA_SIZE);
+
+	lzma_end(&strm);
+	tuktest_free(decoded);
+	tuktest_free(out);
+}
+
+
+static void
+test_dedup_options(void)
+{
+	lzma_options_dedup opt = opt_dedup;
+
+	assert_uint(lzma_raw_encoder_memusage(filters), !=, UINT64_MAX);
+	assert_uint(lzma_raw_decoder_memusage(filters), >=,
+			4 * PART_SIZE);
+
+	// The chunk size must be a power of two.
+	filters[0].options = &opt;
+	opt.chunk_size = 5000;
+	assert_uint_eq(lzma_raw_encoder_memusage(filters), UINT64_MAX);
+
+	opt.chunk_size = LZMA_DEDUP_CHUNK_MAX * 2;
+	assert_uint_eq(lzma_raw_encoder_memusage(filters), UINT64_MAX);
+
+	opt.chunk_size = LZMA_DEDUP_CHUNK_DEFAULT;
+	opt.window_size = LZMA_DEDUP_WINDOW_MIN - 1;
+	assert_uint_eq(lzma_raw_encoder_memusage(filters), UINT64_MAX);
+	assert_uint_eq(lzma_raw_decoder_memusage(filters), UINT64_MAX);
+
+	lzma_stream strm = LZMA_STREAM_INIT;
+	assert_lzma_ret(lzma_raw_encoder(&strm, filters), LZMA_OPTIONS_ERROR);
+	filters[0].options = &opt_dedup;
+
+	// Dedup cannot be the last filter.
+	const lzma_filter last[2] = {
+		{ .id = LZMA_FILTER_DEDUP, .options = &opt_dedup },
+		{ .id = LZMA_VLI_UNKNOWN, .options = NULL },
+	};
+	assert_lzma_ret(lzma_raw_encoder(&strm, last), LZMA_OPTIONS_ERROR);
+	lzma_end(&strm);
+
+	// The window size is rounded up to a power of two.
+	uint32_t props_size;
+	assert_lzma_ret(lzma_properties_size(&props_size, filters), LZMA_OK);
+	assert_uint_eq(props_size, 1);
+
+	uint8_t props[1];
+	assert_lzma_ret(lzma_properties_encode(filters, props), LZMA_OK);
+	assert_uint_eq(props[0], 2);
+
+	lzma_filter decoded = { .id = LZMA_FILTER_DEDUP, .options = NULL };
+	assert_lzma_ret(lzma_properties_decode(&decoded, NULL, props, 1),
+			LZMA_OK);
+	const lzma_options_dedup *decoded_opt = decoded.options;
+	assert_uint_eq(decoded_opt->window_size, 4 * PART_SIZE);
+	assert_uint_eq(decoded_opt->chunk_size, 0);
+	free(decoded.options);
+
+	props[0] = 11;
+	assert_lzma_ret(lzma_properties_decode(&decoded, NULL, props, 1),
+			LZMA_OPTIONS_ERROR);
+}
+
+
+// Compresses the given records with LZMA2 and decodes them with
+// Dedup + LZMA2.
+static lzma_ret
+decode_records(const uint8_t *records, size_t records_size,
+		uint8_t *out, size_t *out_pos)
+{
+	uint8_t buf[256];
+	size_t buf_size = 0;
+	assert_lzma_ret(lzma_raw_buffer_encode(filters + 1, NULL,
+			records, records_size, buf, &buf_size, sizeof(buf)),
+			LZMA_OK);
+
+	size_t in_pos = 0;
+	*out_pos = 0;
+	return lzma_raw_buffer_decode(filters, NULL, buf, &in_pos, buf_size,
+			out, out_pos, 64);
+}
+
+
+static void
+test_dedup_decoder(void)
+{
+	uint8_t out[64];
+	size_t out_pos;
+
+	// A literal of 8 bytes and a reference to its first 4 bytes.
+	// The header is the size shifted left by one and the type
+	// in the lowest bit.
+	const uint8_t good[] = { 16, 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h',
+			9, 8 };
+	assert_lzma_ret(decode_records(good, sizeof(good), out, &out_pos),
+			LZMA_OK);
+	assert_uint_eq(out_pos, 12);
+	assert_array_eq(out, "abcdefghabcd", 12);
+
+	// Distance smaller than the size of the chunk
+	uint8_t bad[sizeof(good)];
+	memcpy(bad, good, sizeof(good));
+	bad[9] = 2 * 5 + 1;
+	bad[10] = 4;
+	assert_lzma_ret(decode_records(bad, sizeof(bad), out, &out_pos),
+			LZMA_DATA_ERROR);
+
+	// Distance past the beginning of the data
+	bad[9] = 2 * 4 + 1;
+	bad[10] = 9;
+	assert_lzma_ret(decode_records(bad, sizeof(bad), out, &out_pos),
+			LZMA_DATA_ERROR);
+
+	// Empty chunk
+	bad[9] = 1;
+	assert_lzma_ret(decode_records(bad, sizeof(bad), out, &out_pos),
+			LZMA_DATA_ERROR);
+
+	// Truncated record
+	assert_lzma_ret(decode_records(good, sizeof(good) - 1, out, &out_pos),
+			LZMA_DATA_ERROR);
+	assert_lzma_ret(decode_records(good, 5, out, &out_pos),
+			LZMA_DATA_ERROR);
+}
+
+
+extern int
+main(int argc, char **argv)
+{
+	tuktest_start(argc, argv);
+
+	require_lzma2();
+
+	if (!lzma_filter_encoder_is_supported(LZMA_FILTER_DEDUP)
+			|| !lzma_filter_decoder_is_supported(
+				LZMA_FILTER_DEDUP))
+		tuktest_early_skip("Dedup encoder and/or decoder "
+				"is disabled");
+
+	init();
+
+	tuktest_run(test_dedup_round_trip);
+	tuktest_run(test_dedup_small_buffers);
+	tuktest_run(test_dedup_options);
+	tuktest_run(test_dedup_decoder);
+
+	return tuktest_end();
+}
@@ -278,6 +278,40 @@ test_code(lzma_index *i)
 }
 
 
+static void
+test_hash_mismatch(void)
+{
+	// The totals match but the Blocks don't, so only
+	// the hash of the Records can catch this.
+	lzma_index *i = lzma_index_init(NULL);
+	expect(i != NULL);
+	expect(lzma_index_append(i, NULL, 1000, 555) == LZMA_OK);
+	expect(lzma_index_append(i, NULL, 2000, 777) == LZMA_OK);
+
+	uint8_t buf[64];
+	size_t size = 0;
+	succeed(lzma_index_buffer_encode(i, buf, &size, sizeof(buf)));
+	lzma_index_end(i, NULL);
+
+	lzma_index_hash *h = lzma_index_hash_init(NULL, NULL);
+	expect(h != NULL);
+	expect(lzma_index_hash_append(h, 1000, 777) == LZMA_OK);
+	expect(lzma_index_hash_append(h, 2000, 555) == LZMA_OK);
+
+	size_t pos = 0;
+	expect(lzma_index_hash_decode(h, buf, &pos, size) == LZMA_DATA_ERROR);
+
+	// The correct order is accepted.
+	h = lzma_index_hash_init(h, NULL);
+	expect(lzma_index_hash_append(h, 1000, 555) == LZMA_OK);
+	expect(lzma_index_hash_append(h, 2000, 777) == LZMA_OK);
+
+	pos = 0;
+	expect(lzma_index_hash_decode(h, buf, &pos, size) == LZMA_STREAM_END);
+	lzma_index_hash_end(h, NULL);
+}
+
+
 static void
 test_many(lzma_index *i)
 {
@@ -414,6 +448,33 @@ test_cat(void)
 }
 
 
+/// Check that lzma_index_iter_locate() finds every non-empty Block
+/// from its first and last uncompressed byte.
+static void
+test_locate_all(const lzma_index *i)
+{
+	lzma_index_iter r;
+	lzma_index_iter_init(&r, i);
+	lzma_index_iter l;
+	lzma_index_iter_init(&l, i);
+
+	while (!lzma_index_iter_next(&r, LZMA_INDEX_ITER_NONEMPTY_BLOCK)) {
+		expect(!lzma_index_iter_locate(&l,
+				r.block.uncompressed_file_offset));
+		expect(l.block.number_in_file == r.block.number_in_file);
+
+		expect(!lzma_index_iter_locate(&l,
+				r.block.uncompressed_file_offset
+				+ r.block.uncompressed_size - 1));
+		expect(l.block.number_in_file == r.block.number_in_file);
+		expect(l.block.compressed_file_offset
+				== r.block.compressed_file_offset);
+	}
+
+	expect(lzma_index_iter_locate(&l, lzma_index_uncompressed_size(i)));
+}
+
+
 static void
 test_locate(void)
 {
@@ -585,6 +646,111 @@ test_locate(void)
 			== LZMA_STREAM_HEADER_SIZE + group_multiple * 8);
 	expect(r.block.uncompressed_file_offset == 0);
 
+	// Search keys. See INDEX_KEY_INTERVAL in liblzma/common/index.c.
+	// Empty Blocks are put around the key boundaries. lzma_index_dup()
+	// puts all Records of a Stream into one group and lzma_index_cat()
+	// shrinks the last group of the destination.
+	lzma_index_end(i, NULL);
+	i = lzma_index_init(NULL);
+	expect(i != NULL);
+	for (n = 0; n < 3000; ++n)
+		expect(lzma_index_append(i, NULL, 16,
+				n % 32 >= 30 || n % 32 == 0 ? 0 : n) == LZMA_OK);
+
+	test_locate_all(i);
+
+	lzma_index *d = lzma_index_dup(i, NULL);
+	expect(d != NULL);
+	test_locate_all(d);
+
+	expect(lzma_index_cat(i, d, NULL) == LZMA_OK);
+	test_locate_all(i);
+
+	lzma_index_end(i, NULL);
+}
+
+
+static void
+test_export(void)
+{
+	// Three Streams: empty, small with Stream Padding, and big.
+	const lzma_stream_flags flags = {
+		.version = 0,
+		.backward_size = LZMA_VLI_UNKNOWN,
+		.check = LZMA_CHECK_CRC32,
+	};
+	lzma_index *i = create_empty();
+	expect(lzma_index_stream_flags(i, &flags) == LZMA_OK);
+
+	lzma_index *b = create_small();
+	expect(lzma_index_stream_flags(b, &flags) == LZMA_OK);
+	expect(lzma_index_stream_padding(b, 16) == LZMA_OK);
+	expect(lzma_index_cat(i, b, NULL) == LZMA_OK);
+
+	b = create_big();
+	expect(lzma_index_stream_flags(b, &flags) == LZMA_OK);
+	expect(lzma_index_cat(i, b, NULL) == LZMA_OK);
+
+	const size_t size = lzma_index_export_size(i);
+	expect(size == 24 + 3 * 32 + (SMALL_COUNT + BIG_COUNT) * 16 + 8);
+
+	uint8_t *buf = malloc(size + 1);
+	expect(buf != NULL);
+	size_t pos = 0;
+	expect(lzma_index_export(i, buf, &pos, size - 1) == LZMA_BUF_ERROR);
+	expect(pos == 0);
+	expect(lzma_index_export(i, buf, &pos, size) == LZMA_OK);
+	expect(pos == size);
+
+	// The first Stream Footer follows the header. The Stream is empty
+	// so its Index is eight bytes.
+	lzma_stream_flags footer;
+	expect(lzma_stream_footer_decode(&footer, buf + 24) == LZMA_OK);
+	expect(footer.backward_size == 8);
+
+	lzma_index *d;
+	uint64_t memlimit = MEMLIMIT;
+	pos = 0;
+	expect(lzma_index_import(&d, &memlimit, NULL, buf, &pos, size,
+			lzma_index_file_size(i)) == LZMA_OK);
+	expect(pos == size);
+	expect(is_equal(i, d));
+	expect(lzma_index_checks(d) == lzma_index_checks(i));
+	lzma_index_end(d, NULL);
+
+	// Errors
+	pos = 0;
+	expect(lzma_index_import(&d, &memlimit, NULL, buf, &pos, size,
+			lzma_index_file_size(i) + 4) == LZMA_DATA_ERROR);
+	expect(d == NULL);
+	expect(lzma_index_import(&d, &memlimit, NULL, buf, &pos, size - 1,
+			LZMA_VLI_UNKNOWN) == LZMA_DATA_ERROR);
+	expect(pos == 0);
+
+	memlimit = 1;
+	expect(lzma_index_import(&d, &memlimit, NULL, buf, &pos, size,
+			LZMA_VLI_UNKNOWN) == LZMA_MEMLIMIT_ERROR);
+	expect(memlimit == lzma_index_memusage(3, SMALL_COUNT + BIG_COUNT));
+
+	memlimit = MEMLIMIT;
+	for (size_t j = 0; j < size; j += 7) {
+		buf[j] ^= 0x10;
+		const lzma_ret ret = lzma_index_import(&d, &memlimit, NULL,
+				buf, &pos, size, LZMA_VLI_UNKNOWN);
+		expect(ret == (j < 6 ? LZMA_FORMAT_ERROR
+				: j < 8 ? LZMA_OPTIONS_ERROR
+				: LZMA_DATA_ERROR));
+		expect(d == NULL);
+		buf[j] ^= 0x10;
+	}
+
+	// The Stream Flags must be known.
+	lzma_index_end(i, NULL);
+	i = create_small();
+	pos = 0;
+	expect(lzma_index_export(i, buf, &pos, size) == LZMA_PROG_ERROR);
+
+	free(buf);
 	lzma_index_end(i, NULL);
 }
 
@@ -667,8 +833,12 @@ main(void)
 
 	test_cat();
 
+	test_hash_mismatch();
+
 	test_locate();
 
+	test_export();
+
 	test_corrupt();
 
 	// Test for the bug fix 21515d79d778b8730a434f151b07202d52a04611:
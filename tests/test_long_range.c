@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       test_long_range.c
+/// \brief      Tests the long-range match finder
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "tests.h"
+
+
+#define DICT_SIZE (4 << 20)
+#define PART_SIZE (512 << 10)
+
+// The run is longer than the dictionary so that the window is moved
+// while the match finder skips it.
+#define RUN_SIZE (2 * DICT_SIZE)
+
+#define DATA_SIZE (RUN_SIZE + 3 * PART_SIZE)
+
+
+static uint8_t data[DATA_SIZE];
+
+
+static size_t
+encode(lzma_match_finder mf)
+{
+	lzma_options_lzma opt;
+	assert_false(lzma_lzma_preset(&opt, 0));
+	opt.dict_size = DICT_SIZE;
+	opt.mf = mf;
+	opt.mode = LZMA_MODE_ULTRA_FAST;
+
+	const lzma_filter filters[2] = {
+		{ .id = LZMA_FILTER_LZMA2, .options = &opt },
+		{ .id = LZMA_VLI_UNKNOWN, .options = NULL },
+	};
+
+	const size_t out_max = DATA_SIZE + DATA_SIZE / 8;
+	uint8_t *out = tuktest_malloc(out_max);
+	size_t out_pos = 0;
+	assert_lzma_ret(lzma_raw_buffer_encode(filters, NULL,
+			data, DATA_SIZE, out, &out_pos, out_max), LZMA_OK);
+
+	// The long matches must decode correctly too.
+	uint8_t *decoded = tuktest_malloc(DATA_SIZE);
+	size_t in_pos = 0;
+	size_t decoded_pos = 0;
+	assert_lzma_ret(lzma_raw_buffer_decode(filters, NULL,
+			out, &in_pos, out_pos, decoded, &decoded_pos,
+			DATA_SIZE), LZMA_OK);
+	assert_uint_eq(decoded_pos, DATA_SIZE);
+	assert_array_eq(decoded, data, DATA_SIZE);
+
+	tuktest_free(decoded);
+	tuktest_free(out);
+	return out_pos;
+}
+
+
+// A long run of zeros is encoded without the match finder. The long-range
+// match finder must still find the repeated data that follows it.
+static void
+test_after_run(void)
+{
+	if (!lzma_mf_is_supported(LZMA_MF_HS4))
+		assert_skip("HS4 match finder is disabled");
+
+	// Before the run was skipped correctly, the sizes were the same.
+	const size_t plain_size = encode(LZMA_MF_HS4);
+	const size_t long_range_size = encode(
+			LZMA_MF_HS4 | LZMA_MF_LONG_RANGE);
+	assert_uint(long_range_size, <, plain_size - plain_size / 8);
+}
+
+
+extern int
+main(int argc, char **argv)
+{
+	tuktest_start(argc, argv);
+
+	require_lzma2();
+
+	// The data is a run of zeros followed by A B A where A and B are
+	// letters. Each four-letter string repeats so often that HS4 rarely
+	// finds the first copy of A when encoding the second one.
+	fill_letters(data + RUN_SIZE, 2 * PART_SIZE, 16);
+	memcpy(data + RUN_SIZE + 2 * PART_SIZE, data + RUN_SIZE, PART_SIZE);
+
+	tuktest_run(test_after_run);
+
+	return tuktest_end();
+}
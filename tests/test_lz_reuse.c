@@ -0,0 +1,157 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       test_lz_reuse.c
+/// \brief      Tests that a reused LZ encoder gives the same output as
+///             a fresh one
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "tests.h"
+
+
+#define DATA_SIZE (512 << 10)
+#define OUT_MAX (DATA_SIZE + DATA_SIZE / 8)
+
+
+static uint8_t data[DATA_SIZE];
+
+// Offset and size of a stream in data[]
+typedef struct {
+	size_t offset;
+	size_t size;
+} stream_range;
+
+// With a small dictionary the old hash table entries are skipped
+// when the encoder is reused. The big streams move the window.
+static const stream_range small_dict_streams[] = {
+	{ 0, 300 << 10 },
+	{ 1000, 100 },
+	{ 5000, 20 << 10 },
+	{ 100 << 10, DATA_SIZE - (100 << 10) },
+	{ 0, 0 },
+	{ 7, 3000 },
+	{ 50 << 10, 200 << 10 },
+};
+
+// With a big dictionary the entries of a stream of up to about 2 KiB are
+// cleared by rehashing it if the encoder was fresh or its hash table was
+// cleared. After a bigger stream they are skipped.
+static const stream_range big_dict_streams[] = {
+	{ 1000, 100 },
+	{ 7, 20 },
+	{ 3000, 100 },
+	{ 5000, 20 << 10 },
+	{ 2000, 100 },
+	{ 0, 300 << 10 },
+	{ 9, 1500 },
+};
+
+
+static size_t
+encode(lzma_stream *strm, const lzma_filter *filters,
+		const stream_range *stream, uint8_t *out)
+{
+	assert_lzma_ret(lzma_raw_encoder(strm, filters), LZMA_OK);
+
+	strm->next_in = data + stream->offset;
+	strm->avail_in = stream->size;
+	strm->next_out = out;
+	strm->avail_out = OUT_MAX;
+	assert_lzma_ret(lzma_code(strm, LZMA_FINISH), LZMA_STREAM_END);
+
+	return (size_t)strm->total_out;
+}
+
+
+static void
+test_reuse(lzma_match_finder mf, uint32_t dict_size,
+		const stream_range *streams, size_t stream_count)
+{
+	lzma_options_lzma opt;
+	assert_false(lzma_lzma_preset(&opt, 6));
+	opt.dict_size = dict_size;
+	opt.mf = mf;
+
+	const lzma_match_finder base = mf & ~LZMA_MF_LONG_RANGE;
+	if (base == LZMA_MF_HS4)
+		opt.mode = LZMA_MODE_ULTRA_FAST;
+	else if (base == LZMA_MF_HC3 || base == LZMA_MF_HC4
+			|| base == LZMA_MF_HB4)
+		opt.mode = LZMA_MODE_FAST;
+
+	const lzma_filter filters[2] = {
+		{ .id = LZMA_FILTER_LZMA2, .options = &opt },
+		{ .id = LZMA_VLI_UNKNOWN, .options = NULL },
+	};
+
+	uint8_t *reused_out = tuktest_malloc(OUT_MAX);
+	uint8_t *fresh_out = tuktest_malloc(OUT_MAX);
+
+	// The reused encoder isn't ended between the streams.
+	lzma_stream reused = LZMA_STREAM_INIT;
+
+	for (size_t i = 0; i < stream_count; ++i) {
+		const size_t reused_size = encode(&reused, filters,
+				&streams[i], reused_out);
+
+		lzma_stream fresh = LZMA_STREAM_INIT;
+		const size_t fresh_size = encode(&fresh, filters,
+				&streams[i], fresh_out);
+		lzma_end(&fresh);
+
+		assert_uint_eq(reused_size, fresh_size);
+		assert_array_eq(reused_out, fresh_out, fresh_size);
+	}
+
+	lzma_end(&reused);
+	tuktest_free(fresh_out);
+	tuktest_free(reused_out);
+}
+
+
+static void
+test_lz_reuse(void)
+{
+	static const lzma_match_finder mfs[] = {
+		LZMA_MF_HC3, LZMA_MF_HC4, LZMA_MF_BT2, LZMA_MF_BT3,
+		LZMA_MF_BT4, LZMA_MF_HS4, LZMA_MF_HB4,
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(mfs); ++i) {
+		if (!lzma_mf_is_supported(mfs[i]))
+			continue;
+
+		test_reuse(mfs[i], 64 << 10, small_dict_streams,
+				ARRAY_SIZE(small_dict_streams));
+		test_reuse(mfs[i] | LZMA_MF_LONG_RANGE, 64 << 10,
+				small_dict_streams,
+				ARRAY_SIZE(small_dict_streams));
+		test_reuse(mfs[i], 8 << 20, big_dict_streams,
+				ARRAY_SIZE(big_dict_streams));
+		test_reuse(mfs[i] | LZMA_MF_LONG_RANGE, 8 << 20,
+				big_dict_streams,
+				ARRAY_SIZE(big_dict_streams));
+	}
+}
+
+
+extern int
+main(int argc, char **argv)
+{
+	tuktest_start(argc, argv);
+
+	require_lzma2();
+
+	// Repeat some blocks of 16 KiB 40 KiB later to give the match
+	// finders long matches too.
+	fill_letters(data, DATA_SIZE, 16);
+	for (size_t i = 0; i + (56 << 10) <= DATA_SIZE; i += 128 << 10)
+		memcpy(data + i + (40 << 10), data + i, 16 << 10);
+
+	tuktest_run(test_lz_reuse);
+
+	return tuktest_end();
+}
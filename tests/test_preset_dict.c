@@ -0,0 +1,153 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       test_preset_dict.c
+/// \brief      Tests lzma_preset_dict_train() and raw LZMA2 with
+///             a preset dictionary
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "tests.h"
+
+
+#define SAMPLE_COUNT 200
+#define SAMPLE_SIZE 1500
+#define DICT_SIZE_MAX (16 << 10)
+
+
+static uint8_t samples[SAMPLE_COUNT * SAMPLE_SIZE];
+static size_t sample_sizes[SAMPLE_COUNT];
+
+
+// Records that share a lot of structure but have varying values.
+static size_t
+make_record(uint8_t *buf, size_t size, uint32_t seed)
+{
+	static const char *const fields[] = {
+		"\"timestamp\": ", "\"user_name\": ", "\"session_id\": ",
+		"\"http_status\": ", "\"request_path\": ",
+		"\"response_time_ms\": ", "\"user_agent\": ",
+	};
+
+	size_t pos = 0;
+	while (true) {
+		const char *f = fields[test_rand(&seed) % ARRAY_SIZE(fields)];
+		const size_t len = strlen(f);
+		if (pos + len + 8 > size)
+			break;
+
+		memcpy(buf + pos, f, len);
+		pos += len;
+
+		for (size_t i = 0; i < 6; ++i) {
+			buf[pos++] = (uint8_t)('0' + test_rand(&seed) % 10);
+		}
+
+		buf[pos++] = ',';
+		buf[pos++] = '\n';
+	}
+
+	return pos;
+}
+
+
+static size_t
+compress_size(const uint8_t *in, size_t in_size,
+		const uint8_t *dict, size_t dict_size)
+{
+	lzma_options_lzma opt;
+	assert_false(lzma_lzma_preset(&opt, 6));
+	opt.preset_dict = dict;
+	opt.preset_dict_size = (uint32_t)dict_size;
+
+	const lzma_filter filters[2] = {
+		{ .id = LZMA_FILTER_LZMA2, .options = &opt },
+		{ .id = LZMA_VLI_UNKNOWN, .options = NULL },
+	};
+
+	uint8_t out[2 * SAMPLE_SIZE];
+	size_t out_size = 0;
+	assert_lzma_ret(lzma_raw_buffer_encode(filters, NULL, in, in_size,
+			out, &out_size, sizeof(out)), LZMA_OK);
+
+	// The data must decode only with the same dictionary.
+	uint8_t decoded[SAMPLE_SIZE];
+	size_t in_pos = 0;
+	size_t decoded_size = 0;
+	assert_lzma_ret(lzma_raw_buffer_decode(filters, NULL,
+			out, &in_pos, out_size,
+			decoded, &decoded_size, sizeof(decoded)), LZMA_OK);
+	assert_uint_eq(decoded_size, in_size);
+	assert_array_eq(decoded, in, in_size);
+
+	return out_size;
+}
+
+
+static void
+test_train(void)
+{
+	size_t total = 0;
+	for (size_t i = 0; i < SAMPLE_COUNT; ++i) {
+		sample_sizes[i] = make_record(samples + total, SAMPLE_SIZE,
+				(uint32_t)i);
+		total += sample_sizes[i];
+	}
+
+	uint8_t *dict = tuktest_malloc(DICT_SIZE_MAX);
+	size_t dict_size = 0;
+	assert_lzma_ret(lzma_preset_dict_train(NULL, samples, sample_sizes,
+			SAMPLE_COUNT, dict, &dict_size, DICT_SIZE_MAX),
+			LZMA_OK);
+	assert_uint(dict_size, >, 0);
+	assert_uint(dict_size, <=, DICT_SIZE_MAX);
+
+	// A record that wasn't among the samples must compress better
+	// with the dictionary than without.
+	uint8_t record[SAMPLE_SIZE];
+	const size_t record_size = make_record(record, sizeof(record),
+			SAMPLE_COUNT);
+	assert_uint(compress_size(record, record_size, dict, dict_size), <,
+			compress_size(record, record_size, NULL, 0));
+
+	// If all samples fit, they are used as is.
+	assert_lzma_ret(lzma_preset_dict_train(NULL, samples, sample_sizes,
+			2, dict, &dict_size, DICT_SIZE_MAX), LZMA_OK);
+	assert_uint_eq(dict_size, sample_sizes[0] + sample_sizes[1]);
+	assert_array_eq(dict, samples, dict_size);
+
+	tuktest_free(dict);
+}
+
+
+static void
+test_train_errors(void)
+{
+	uint8_t dict[16];
+	size_t dict_size;
+
+	assert_lzma_ret(lzma_preset_dict_train(NULL, samples, sample_sizes,
+			0, dict, &dict_size, sizeof(dict)), LZMA_PROG_ERROR);
+	assert_lzma_ret(lzma_preset_dict_train(NULL, NULL, sample_sizes,
+			1, dict, &dict_size, sizeof(dict)), LZMA_PROG_ERROR);
+	assert_lzma_ret(lzma_preset_dict_train(NULL, samples, sample_sizes,
+			1, dict, &dict_size, 0), LZMA_PROG_ERROR);
+	assert_lzma_ret(lzma_preset_dict_train(NULL, samples, sample_sizes,
+			1, dict, NULL, sizeof(dict)), LZMA_PROG_ERROR);
+}
+
+
+extern int
+main(int argc, char **argv)
+{
+	tuktest_start(argc, argv);
+
+	require_lzma2();
+
+	tuktest_run(test_train);
+	tuktest_run(test_train_errors);
+
+	return tuktest_end();
+}
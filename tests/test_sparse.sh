@@ -0,0 +1,101 @@
+#!/bin/sh
+
+###############################################################################
+#
+# Tests compressing sparse files and creating them with --sparse-min
+#
+# This file has been put into the public domain.
+# You can do whatever you want with this file.
+#
+###############################################################################
+
+# If xz wasn't built, this test is skipped.
+if test -x ../src/xz/xz ; then
+	:
+else
+	(exit 77)
+	exit 77
+fi
+
+XZ="../src/xz/xz --threads=1"
+
+# Kibibytes of disk space used by a file
+used_kib() {
+	du -k "$1" | sed 's/[^0-9].*//'
+}
+
+SPARSE=tmp_sparse
+rm -f "$SPARSE" "$SPARSE.xz" "$SPARSE.orig"
+trap 'rm -f "$SPARSE" "$SPARSE.xz" "$SPARSE.orig"' 0
+
+# Create a 4 MiB file that has a little data at the beginning and after
+# the first two mebibytes. The rest are holes.
+cp "$srcdir/compress_prepared_bcj_x86" "$SPARSE"
+dd if=/dev/null of="$SPARSE" bs=1024 seek=2048 2> /dev/null
+cat "$srcdir/compress_prepared_bcj_x86" >> "$SPARSE"
+dd if=/dev/null of="$SPARSE" bs=1024 seek=4096 2> /dev/null
+
+# If the file system doesn't support holes, this test is skipped.
+if test "$(used_kib "$SPARSE")" -ge 1024 ; then
+	echo "The file system doesn't support sparse files, skipping this test."
+	(exit 77)
+	exit 77
+fi
+
+# Keep a copy of the original to compare against.
+cp "$SPARSE" "$SPARSE.orig"
+
+# The holes of the input are skipped without reading them if
+# SEEK_DATA and SEEK_HOLE are supported. They must still be
+# compressed as zeros.
+if $XZ -k "$SPARSE" ; then
+	:
+else
+	echo "Compressing the sparse file failed"
+	(exit 1)
+	exit 1
+fi
+
+# Decompress with the given options and check that the output matches
+# the original and is sparse ($1 = yes) or not ($1 = no).
+test_sparse() {
+	EXPECTED=$1
+	shift
+
+	rm -f "$SPARSE"
+	if $XZ -dk "$@" "$SPARSE.xz" ; then
+		:
+	else
+		echo "Decompressing failed: $*"
+		(exit 1)
+		exit 1
+	fi
+
+	if cmp "$SPARSE" "$SPARSE.orig" ; then
+		:
+	else
+		echo "Decompressed file does not match the original: $*"
+		(exit 1)
+		exit 1
+	fi
+
+	if test "$(used_kib "$SPARSE")" -lt 1024 ; then
+		IS_SPARSE=yes
+	else
+		IS_SPARSE=no
+	fi
+
+	if test "$IS_SPARSE" != "$EXPECTED" ; then
+		echo "Expected sparse=$EXPECTED but got $IS_SPARSE: $*"
+		(exit 1)
+		exit 1
+	fi
+}
+
+test_sparse yes
+test_sparse yes --sparse-min=1MiB
+test_sparse no --sparse-min=3MiB
+test_sparse no --no-sparse
+
+(exit 0)
+exit 0
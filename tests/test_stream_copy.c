@@ -0,0 +1,286 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       test_stream_copy.c
+/// \brief      Tests lzma_stream_copy()
+///
+/// A copied encoder or decoder must produce exactly the same output as
+/// the original would have produced from the same point onwards.
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "tests.h"
+
+
+#define PREFIX_SIZE (48 << 10)
+#define RECORD_SIZE (16 << 10)
+#define OUT_SIZE (256 << 10)
+
+
+// Compressible but not trivially so: words picked with a simple LCG.
+static uint8_t prefix[PREFIX_SIZE];
+static uint8_t record[2][RECORD_SIZE];
+
+
+static void
+fill_text(uint8_t *buf, size_t size, uint32_t seed)
+{
+	static const char *const words[] = {
+		"lorem ", "ipsum ", "dolor ", "sit ", "amet, ",
+		"consectetur ", "adipiscing ", "elit. ", "\n",
+	};
+
+	size_t pos = 0;
+	while (pos < size) {
+		const char *w = words[test_rand(&seed) % ARRAY_SIZE(words)];
+		while (*w != '\0' && pos < size)
+			buf[pos++] = (uint8_t)(*w++);
+	}
+}
+
+
+// Run the coder until it has consumed all input and, when action is
+// LZMA_FINISH, returned LZMA_STREAM_END. Output space is given in small
+// chunks to leave pending output inside the coder at copy time.
+static void
+code_all(lzma_stream *strm, const uint8_t *in, size_t in_size,
+		lzma_action action, uint8_t *out, size_t *out_pos)
+{
+	strm->next_in = in;
+	strm->avail_in = in_size;
+
+	while (true) {
+		strm->next_out = out + *out_pos;
+		strm->avail_out = my_min(OUT_SIZE - *out_pos, 333);
+
+		const lzma_ret ret = lzma_code(strm, action);
+		*out_pos = (size_t)(strm->next_out - out);
+
+		if (ret == LZMA_STREAM_END) {
+			assert_uint_eq(action, LZMA_FINISH);
+			break;
+		}
+
+		assert_lzma_ret(ret, LZMA_OK);
+
+		if (action == LZMA_RUN && strm->avail_in == 0
+				&& strm->avail_out != 0)
+			break;
+	}
+
+	assert_uint_eq(strm->avail_in, 0);
+}
+
+
+// Encode prefix[] with a fresh copy of the given encoder, copy the stream,
+// and finish the two with different records. Both results must match
+// what an encoder that was never copied produces.
+static void
+test_encoder(lzma_ret (*init)(lzma_stream *strm, const void *arg),
+		const void *arg)
+{
+	uint8_t *out[2];
+	size_t out_pos[2];
+	for (unsigned i = 0; i < 2; ++i) {
+		out[i] = tuktest_malloc(OUT_SIZE);
+		out_pos[i] = 0;
+	}
+
+	lzma_stream strm[2] = { LZMA_STREAM_INIT, LZMA_STREAM_INIT };
+	assert_lzma_ret(init(&strm[0], arg), LZMA_OK);
+	code_all(&strm[0], prefix, sizeof(prefix), LZMA_RUN,
+			out[0], &out_pos[0]);
+
+	assert_lzma_ret(lzma_stream_copy(&strm[0], &strm[1]), LZMA_OK);
+	assert_uint_eq(strm[1].total_in, strm[0].total_in);
+	assert_uint_eq(strm[1].total_out, strm[0].total_out);
+	memcpy(out[1], out[0], out_pos[0]);
+	out_pos[1] = out_pos[0];
+
+	for (unsigned i = 0; i < 2; ++i)
+		code_all(&strm[i], record[i], RECORD_SIZE, LZMA_FINISH,
+				out[i], &out_pos[i]);
+
+	uint8_t *ref = tuktest_malloc(OUT_SIZE);
+	for (unsigned i = 0; i < 2; ++i) {
+		lzma_end(&strm[i]);
+
+		lzma_stream ref_strm = LZMA_STREAM_INIT;
+		size_t ref_pos = 0;
+		assert_lzma_ret(init(&ref_strm, arg), LZMA_OK);
+		code_all(&ref_strm, prefix, sizeof(prefix), LZMA_RUN,
+				ref, &ref_pos);
+		code_all(&ref_strm, record[i], RECORD_SIZE, LZMA_FINISH,
+				ref, &ref_pos);
+		lzma_end(&ref_strm);
+
+		assert_uint_eq(out_pos[i], ref_pos);
+		assert_array_eq(out[i], ref, ref_pos);
+	}
+
+	tuktest_free(ref);
+	tuktest_free(out[0]);
+	tuktest_free(out[1]);
+}
+
+
+static lzma_ret
+init_raw(lzma_stream *strm, const void *arg)
+{
+	return lzma_raw_encoder(strm, arg);
+}
+
+
+static lzma_ret
+init_stream(lzma_stream *strm, const void *arg)
+{
+	return lzma_stream_encoder(strm, arg, LZMA_CHECK_CRC64);
+}
+
+
+static void
+test_copy_raw_lzma2(void)
+{
+	static const lzma_match_finder mfs[] = {
+		LZMA_MF_HC3, LZMA_MF_HC4, LZMA_MF_BT2, LZMA_MF_BT3,
+		LZMA_MF_BT4, LZMA_MF_HS4, LZMA_MF_HB4,
+		LZMA_MF_BT4 | LZMA_MF_LONG_RANGE,
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(mfs); ++i) {
+		if (!lzma_mf_is_supported(mfs[i]))
+			continue;
+
+		lzma_options_lzma opt;
+		assert_false(lzma_lzma_preset(&opt, 6));
+		opt.dict_size = 1 << 20;
+		opt.mf = mfs[i];
+		if (mfs[i] == LZMA_MF_HS4)
+			opt.mode = LZMA_MODE_ULTRA_FAST;
+		else if (mfs[i] == LZMA_MF_HB4)
+			opt.mode = LZMA_MODE_FAST;
+
+		const lzma_filter filters[2] = {
+			{ .id = LZMA_FILTER_LZMA2, .options = &opt },
+			{ .id = LZMA_VLI_UNKNOWN, .options = NULL },
+		};
+
+		test_encoder(&init_raw, filters);
+	}
+}
+
+
+static void
+test_copy_filter_chain(void)
+{
+	lzma_options_lzma opt;
+	assert_false(lzma_lzma_preset(&opt, 1));
+
+	lzma_options_delta delta = {
+		.type = LZMA_DELTA_TYPE_BYTE,
+		.dist = 4,
+	};
+
+	lzma_filter filters[3] = {
+		{ .id = LZMA_FILTER_X86, .options = NULL },
+		{ .id = LZMA_FILTER_LZMA2, .options = &opt },
+		{ .id = LZMA_VLI_UNKNOWN, .options = NULL },
+	};
+
+	if (lzma_filter_encoder_is_supported(LZMA_FILTER_X86))
+		test_encoder(&init_raw, filters);
+
+	filters[0].id = LZMA_FILTER_DELTA;
+	filters[0].options = &delta;
+	if (lzma_filter_encoder_is_supported(LZMA_FILTER_DELTA))
+		test_encoder(&init_raw, filters);
+
+	filters[0].id = LZMA_FILTER_LZMA2;
+	filters[0].options = &opt;
+	filters[1].id = LZMA_VLI_UNKNOWN;
+	test_encoder(&init_stream, filters);
+}
+
+
+// Decode a .xz file half way, copy the decoder, and check that both
+// the original and the copy decompress the rest correctly.
+static void
+test_copy_decoder(void)
+{
+	const size_t in_size = sizeof(prefix) + RECORD_SIZE;
+	uint8_t *in = tuktest_malloc(in_size);
+	memcpy(in, prefix, sizeof(prefix));
+	memcpy(in + sizeof(prefix), record[0], RECORD_SIZE);
+
+	uint8_t *xz = tuktest_malloc(OUT_SIZE);
+	size_t xz_size = 0;
+	assert_lzma_ret(lzma_easy_buffer_encode(6, LZMA_CHECK_CRC32, NULL,
+			in, in_size, xz, &xz_size, OUT_SIZE), LZMA_OK);
+
+	uint8_t *out[2];
+	size_t out_pos[2] = { 0, 0 };
+	out[0] = tuktest_malloc(OUT_SIZE);
+	out[1] = tuktest_malloc(OUT_SIZE);
+
+	lzma_stream strm[2] = { LZMA_STREAM_INIT, LZMA_STREAM_INIT };
+	assert_lzma_ret(lzma_stream_decoder(&strm[0], UINT64_MAX, 0),
+			LZMA_OK);
+
+	const size_t half = xz_size / 2;
+	code_all(&strm[0], xz, half, LZMA_RUN, out[0], &out_pos[0]);
+
+	assert_lzma_ret(lzma_stream_copy(&strm[0], &strm[1]), LZMA_OK);
+	memcpy(out[1], out[0], out_pos[0]);
+	out_pos[1] = out_pos[0];
+
+	for (unsigned i = 0; i < 2; ++i) {
+		code_all(&strm[i], xz + half, xz_size - half, LZMA_FINISH,
+				out[i], &out_pos[i]);
+		lzma_end(&strm[i]);
+
+		assert_uint_eq(out_pos[i], in_size);
+		assert_array_eq(out[i], in, in_size);
+	}
+
+	tuktest_free(out[0]);
+	tuktest_free(out[1]);
+	tuktest_free(xz);
+	tuktest_free(in);
+}
+
+
+static void
+test_copy_errors(void)
+{
+	lzma_stream strm = LZMA_STREAM_INIT;
+	lzma_stream dest = LZMA_STREAM_INIT;
+
+	assert_lzma_ret(lzma_stream_copy(NULL, &dest), LZMA_PROG_ERROR);
+	assert_lzma_ret(lzma_stream_copy(&strm, NULL), LZMA_PROG_ERROR);
+	assert_lzma_ret(lzma_stream_copy(&strm, &strm), LZMA_PROG_ERROR);
+
+	// A stream that hasn't been initialized has nothing to copy.
+	assert_lzma_ret(lzma_stream_copy(&strm, &dest), LZMA_PROG_ERROR);
+}
+
+
+extern int
+main(int argc, char **argv)
+{
+	tuktest_start(argc, argv);
+
+	require_lzma2();
+
+	fill_text(prefix, sizeof(prefix), 1);
+	fill_text(record[0], RECORD_SIZE, 2);
+	fill_text(record[1], RECORD_SIZE, 3);
+
+	tuktest_run(test_copy_raw_lzma2);
+	tuktest_run(test_copy_filter_chain);
+	tuktest_run(test_copy_decoder);
+	tuktest_run(test_copy_errors);
+
+	return tuktest_end();
+}
@@ -0,0 +1,377 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       test_stream_decoder_mt.c
+/// \brief      Tests lzma_stream_decoder_mt_unordered() and lzma_get_stats()
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "tests.h"
+#include "mythread.h"
+
+
+#define DATA_SIZE (400 << 10)
+#define BLOCK_SIZE (32 << 10)
+
+// The file of test_slow_block() has SLOW_BLOCKS Blocks of SLOW_BLOCK_SIZE
+// bytes. It is decoded with SLOW_THREADS threads.
+#define SLOW_BLOCK_SIZE (4 << 10)
+#define SLOW_BLOCKS 24
+#define SLOW_THREADS 2
+
+// The first Stream is made with the threaded encoder and is decoded in
+// threaded mode. The second Stream has no sizes in the Block Headers
+// and is decoded in direct mode.
+#define SPLIT (300 << 10)
+
+
+static uint8_t data[DATA_SIZE];
+static uint8_t *file;
+static size_t file_size;
+
+// Statistics of the threaded encoder from make_file()
+static lzma_stats encoder_stats;
+
+// Filled by the callback. The Blocks don't overlap so the worker threads
+// write to different locations.
+static uint8_t decoded[DATA_SIZE];
+static bool seen[DATA_SIZE];
+
+
+static void
+write_cb(void *opaque, uint64_t uncompressed_offset,
+		const uint8_t *buf, size_t size)
+{
+	assert_true(opaque == data);
+	assert_uint(size, >, 0);
+	assert_uint(uncompressed_offset, <=, DATA_SIZE - size);
+
+	memcpy(decoded + uncompressed_offset, buf, size);
+	memset(seen + uncompressed_offset, true, size);
+}
+
+
+static void
+make_file(void)
+{
+	fill_letters(data, DATA_SIZE, 4);
+
+	const size_t file_max = 2 * lzma_stream_buffer_bound(DATA_SIZE);
+	file = tuktest_malloc(file_max);
+
+	const lzma_mt options = {
+		.threads = 2,
+		.block_size = BLOCK_SIZE,
+		.preset = 1,
+		.check = LZMA_CHECK_CRC32,
+	};
+
+	lzma_stream strm = LZMA_STREAM_INIT;
+	assert_lzma_ret(lzma_stream_encoder_mt(&strm, &options), LZMA_OK);
+	strm.next_in = data;
+	strm.avail_in = SPLIT;
+	strm.next_out = file;
+	strm.avail_out = file_max;
+	assert_lzma_ret(lzma_code(&strm, LZMA_FINISH), LZMA_STREAM_END);
+	file_size = (size_t)strm.total_out;
+	lzma_get_stats(&strm, &encoder_stats);
+	lzma_end(&strm);
+
+	assert_lzma_ret(lzma_easy_buffer_encode(1, LZMA_CHECK_CRC32, NULL,
+			data + SPLIT, DATA_SIZE - SPLIT,
+			file, &file_size, file_max), LZMA_OK);
+}
+
+
+static lzma_ret
+decode_unordered(size_t in_size)
+{
+	memzero(decoded, sizeof(decoded));
+	memzero(seen, sizeof(seen));
+
+	const lzma_mt options = {
+		.flags = LZMA_CONCATENATED,
+		.threads = 4,
+		.memlimit_threading = UINT64_MAX,
+		.memlimit_stop = UINT64_MAX,
+	};
+
+	const lzma_unordered_output output = {
+		.write = &write_cb,
+		.opaque = data,
+	};
+
+	lzma_stream strm = LZMA_STREAM_INIT;
+	assert_lzma_ret(lzma_stream_decoder_mt_unordered(
+			&strm, &options, &output), LZMA_OK);
+
+	strm.next_in = file;
+	strm.avail_in = in_size;
+
+	lzma_ret ret;
+	do {
+		ret = lzma_code(&strm, LZMA_FINISH);
+	} while (ret == LZMA_OK);
+
+	assert_uint_eq(strm.total_out, 0);
+
+	// lzma_end() waits for the worker threads so that the callback
+	// isn't called after this function has returned.
+	lzma_end(&strm);
+	return ret;
+}
+
+
+static void
+test_unordered(void)
+{
+	make_file();
+
+	assert_lzma_ret(decode_unordered(file_size), LZMA_STREAM_END);
+	assert_array_eq(decoded, data, DATA_SIZE);
+
+	for (size_t i = 0; i < DATA_SIZE; ++i)
+		assert_true(seen[i]);
+
+	// Truncated input
+	assert_lzma_ret(decode_unordered(file_size - 1), LZMA_BUF_ERROR);
+
+	// Corrupt data in the first Stream
+	file[SPLIT / 16] ^= 0x10;
+	assert_lzma_ret(decode_unordered(file_size), LZMA_DATA_ERROR);
+	file[SPLIT / 16] ^= 0x10;
+}
+
+
+static void
+test_unordered_errors(void)
+{
+	const lzma_mt options = {
+		.threads = 2,
+		.memlimit_threading = UINT64_MAX,
+		.memlimit_stop = UINT64_MAX,
+	};
+
+	lzma_unordered_output output = {
+		.write = NULL,
+		.opaque = NULL,
+	};
+
+	lzma_stream strm = LZMA_STREAM_INIT;
+	assert_lzma_ret(lzma_stream_decoder_mt_unordered(
+			&strm, &options, NULL), LZMA_PROG_ERROR);
+	assert_lzma_ret(lzma_stream_decoder_mt_unordered(
+			&strm, &options, &output), LZMA_PROG_ERROR);
+
+	output.write = &write_cb;
+	lzma_mt bad_options = options;
+	bad_options.threads = 0;
+	assert_lzma_ret(lzma_stream_decoder_mt_unordered(
+			&strm, &bad_options, &output), LZMA_OPTIONS_ERROR);
+
+	lzma_end(&strm);
+}
+
+
+#ifdef MYTHREAD_ENABLED
+static mythread_mutex slow_mutex;
+static mythread_cond slow_cond;
+
+// Bytes written from the Blocks after the first one
+static size_t slow_later_bytes;
+
+// Value of slow_later_bytes when the first Block continued
+static size_t slow_later_bytes_seen;
+
+
+static void
+slow_write_cb(void *opaque, uint64_t uncompressed_offset,
+		const uint8_t *buf, size_t size)
+{
+	(void)opaque;
+	(void)buf;
+
+	mythread_sync(slow_mutex) {
+		if (uncompressed_offset >= SLOW_BLOCK_SIZE) {
+			slow_later_bytes += size;
+			mythread_cond_signal(&slow_cond);
+
+		} else if (uncompressed_offset == 0) {
+			// Stall the first Block until all the later Blocks
+			// have been decoded. Give up after ten seconds so
+			// that a failure doesn't hang the test.
+			const size_t later_size
+				= (SLOW_BLOCKS - 1) * SLOW_BLOCK_SIZE;
+			mythread_condtime wait_abs;
+			mythread_condtime_set(&wait_abs, &slow_cond, 10000);
+			while (slow_later_bytes < later_size
+					&& mythread_cond_timedwait(&slow_cond,
+						&slow_mutex, &wait_abs) == 0) ;
+
+			slow_later_bytes_seen = slow_later_bytes;
+		}
+	}
+}
+#endif
+
+
+// A slow Block must not stop the Blocks after it from being decoded.
+// Only a few more Blocks than there are threads fit in the output queue
+// at a time, so the unordered decoder must release the finished Blocks
+// out of order.
+static void
+test_slow_block(void)
+{
+#ifndef MYTHREAD_ENABLED
+	assert_skip("Threading support is disabled");
+#else
+	const size_t in_size = SLOW_BLOCKS * SLOW_BLOCK_SIZE;
+	const size_t out_max = lzma_stream_buffer_bound(in_size);
+	uint8_t *out = tuktest_malloc(out_max);
+
+	const lzma_mt encoder_options = {
+		.threads = SLOW_THREADS,
+		.block_size = SLOW_BLOCK_SIZE,
+		.preset = 1,
+		.check = LZMA_CHECK_CRC32,
+	};
+
+	lzma_stream strm = LZMA_STREAM_INIT;
+	assert_lzma_ret(lzma_stream_encoder_mt(&strm, &encoder_options),
+			LZMA_OK);
+	strm.next_in = data;
+	strm.avail_in = in_size;
+	strm.next_out = out;
+	strm.avail_out = out_max;
+	assert_lzma_ret(lzma_code(&strm, LZMA_FINISH), LZMA_STREAM_END);
+	const size_t out_size = (size_t)strm.total_out;
+
+	const lzma_mt decoder_options = {
+		.threads = SLOW_THREADS,
+		.memlimit_threading = UINT64_MAX,
+		.memlimit_stop = UINT64_MAX,
+	};
+
+	const lzma_unordered_output output = {
+		.write = &slow_write_cb,
+		.opaque = NULL,
+	};
+
+	assert_false(mythread_mutex_init(&slow_mutex));
+	assert_false(mythread_cond_init(&slow_cond));
+	slow_later_bytes = 0;
+	slow_later_bytes_seen = 0;
+
+	assert_lzma_ret(lzma_stream_decoder_mt_unordered(
+			&strm, &decoder_options, &output), LZMA_OK);
+	strm.next_in = out;
+	strm.avail_in = out_size;
+
+	lzma_ret ret;
+	do {
+		ret = lzma_code(&strm, LZMA_FINISH);
+	} while (ret == LZMA_OK);
+
+	lzma_end(&strm);
+	mythread_cond_destroy(&slow_cond);
+	mythread_mutex_destroy(&slow_mutex);
+	tuktest_free(out);
+
+	assert_lzma_ret(ret, LZMA_STREAM_END);
+	assert_uint_eq(slow_later_bytes_seen,
+			(SLOW_BLOCKS - 1) * SLOW_BLOCK_SIZE);
+#endif
+}
+
+
+// Decode the whole file with the given decoder and check its statistics.
+static void
+check_decoder_stats(lzma_stream *strm, bool ignore_check)
+{
+	uint8_t *out = tuktest_malloc(DATA_SIZE);
+	strm->next_in = file;
+	strm->avail_in = file_size;
+	strm->next_out = out;
+	strm->avail_out = DATA_SIZE;
+
+	lzma_ret ret;
+	do {
+		ret = lzma_code(strm, LZMA_FINISH);
+	} while (ret == LZMA_OK);
+
+	assert_lzma_ret(ret, LZMA_STREAM_END);
+	assert_array_eq(out, data, DATA_SIZE);
+
+	lzma_stats stats;
+	lzma_get_stats(strm, &stats);
+
+	// Ten Blocks in the first Stream and one in the second
+	assert_uint_eq(stats.blocks, SPLIT / BLOCK_SIZE + 1 + 1);
+	assert_uint_eq(stats.check_bytes[LZMA_CHECK_CRC32],
+			ignore_check ? 0 : DATA_SIZE);
+	assert_uint(stats.memusage_peak, >=, lzma_memusage(strm));
+	assert_uint_eq(stats.reserved_int1, 0);
+
+	lzma_end(strm);
+	tuktest_free(out);
+}
+
+
+static void
+test_stats(void)
+{
+	// The file from test_unordered() was freed when it finished.
+	make_file();
+
+	assert_uint_eq(encoder_stats.blocks, SPLIT / BLOCK_SIZE + 1);
+	assert_uint_eq(encoder_stats.check_bytes[LZMA_CHECK_CRC32], SPLIT);
+	assert_uint_eq(encoder_stats.check_bytes[LZMA_CHECK_CRC64], 0);
+
+	lzma_stream strm = LZMA_STREAM_INIT;
+
+	// Not initialized
+	lzma_stats stats;
+	memset(&stats, 0xFF, sizeof(stats));
+	lzma_get_stats(&strm, &stats);
+	assert_uint_eq(stats.blocks, 0);
+	assert_uint_eq(stats.memusage_peak, 0);
+
+	assert_lzma_ret(lzma_stream_decoder(&strm, UINT64_MAX,
+			LZMA_CONCATENATED), LZMA_OK);
+	check_decoder_stats(&strm, false);
+
+	assert_lzma_ret(lzma_auto_decoder(&strm, UINT64_MAX,
+			LZMA_CONCATENATED | LZMA_IGNORE_CHECK), LZMA_OK);
+	check_decoder_stats(&strm, true);
+
+	lzma_mt options = {
+		.flags = LZMA_CONCATENATED,
+		.threads = 4,
+		.memlimit_threading = UINT64_MAX,
+		.memlimit_stop = UINT64_MAX,
+	};
+	assert_lzma_ret(lzma_stream_decoder_mt(&strm, &options), LZMA_OK);
+	check_decoder_stats(&strm, false);
+
+	options.flags |= LZMA_IGNORE_CHECK;
+	assert_lzma_ret(lzma_stream_decoder_mt(&strm, &options), LZMA_OK);
+	check_decoder_stats(&strm, true);
+}
+
+
+extern int
+main(int argc, char **argv)
+{
+	tuktest_start(argc, argv);
+
+	require_lzma2();
+
+	tuktest_run(test_unordered);
+	tuktest_run(test_unordered_errors);
+	tuktest_run(test_slow_block);
+	tuktest_run(test_stats);
+
+	return tuktest_end();
+}
@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       test_stream_encoder_mt.c
+/// \brief      Tests that the threaded encoder reuses the Block encoders
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "tests.h"
+
+
+#define DATA_SIZE (1 << 20)
+#define BLOCK_SIZE (16 << 10)
+
+// Allocations at least this big are made by the LZ encoder. The buffers
+// of the output queue are about BLOCK_SIZE bytes.
+#define BIG_ALLOC (256 << 10)
+
+
+static uint8_t data[DATA_SIZE];
+
+
+// Encode the first size bytes of data and decode the result back.
+// Return the number of big allocations made by the encoder.
+static size_t
+encode(uint32_t threads, size_t size)
+{
+	const lzma_mt options = {
+		.threads = threads,
+		.block_size = BLOCK_SIZE,
+		.preset = 1,
+		.check = LZMA_CHECK_CRC32,
+	};
+
+	const size_t file_max = lzma_stream_buffer_bound(size);
+	uint8_t *file = tuktest_malloc(file_max);
+
+	alloc_counts counts = { .big_size = BIG_ALLOC };
+	const lzma_allocator allocator = counting_allocator(&counts);
+
+	lzma_stream strm = LZMA_STREAM_INIT;
+	strm.allocator = &allocator;
+	assert_lzma_ret(lzma_stream_encoder_mt(&strm, &options), LZMA_OK);
+
+	strm.next_in = data;
+	strm.avail_in = size;
+	strm.next_out = file;
+	strm.avail_out = file_max;
+
+	lzma_ret ret;
+	do {
+		ret = lzma_code(&strm, LZMA_FINISH);
+	} while (ret == LZMA_OK);
+
+	assert_lzma_ret(ret, LZMA_STREAM_END);
+	const size_t file_size = (size_t)strm.total_out;
+	lzma_end(&strm);
+
+	assert_xz_decodes_to(file, file_size, data, size);
+	tuktest_free(file);
+
+	return counts.big_allocs;
+}
+
+
+static void
+test_block_encoder_reuse(void)
+{
+	fill_letters(data, DATA_SIZE, 8);
+
+	// The LZ encoder of one Block
+	const size_t per_thread = encode(1, BLOCK_SIZE);
+	assert_uint(per_thread, >, 0);
+
+	// Every thread allocates its encoder only for its first Block.
+	// It is reset for the rest of the Blocks.
+	assert_uint_eq(encode(1, DATA_SIZE), per_thread);
+	assert_uint(encode(3, DATA_SIZE), <=, 3 * per_thread);
+}
+
+
+extern int
+main(int argc, char **argv)
+{
+	tuktest_start(argc, argv);
+
+	require_lzma2();
+
+	tuktest_run(test_block_encoder_reuse);
+
+	return tuktest_end();
+}
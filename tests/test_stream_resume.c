@@ -0,0 +1,258 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+/// \file       test_stream_resume.c
+/// \brief      Tests lzma_stream_decoder_resume() and LZMA_FULL_FLUSH
+///             with the Stream decoder
+///
+/// The decoder is stopped at every Block and Stream boundary. Decoding
+/// is then resumed from each of those positions with a new decoder,
+/// which must produce the rest of the original data.
+//
+//  This file has been put into the public domain.
+//  You can do whatever you want with this file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "tests.h"
+
+
+#define DATA_SIZE (40 << 10)
+#define BLOCK_SIZE (7 << 10)
+#define FILE_SIZE_MAX (2 * DATA_SIZE)
+#define STREAM_PADDING 8
+#define POSITIONS_MAX 32
+
+
+static uint8_t data[DATA_SIZE];
+static uint8_t file[FILE_SIZE_MAX];
+static size_t file_size;
+
+// Where the second Stream begins
+static size_t second_stream;
+
+static lzma_stream_position positions[POSITIONS_MAX];
+static size_t positions_count;
+
+
+static void
+fill_data(void)
+{
+	fill_letters(data, DATA_SIZE, 8);
+}
+
+
+// Encode data[begin, end) as one Stream with a Block per BLOCK_SIZE bytes.
+static void
+encode_stream(size_t begin, size_t end, lzma_check check)
+{
+	lzma_stream strm = LZMA_STREAM_INIT;
+	assert_lzma_ret(lzma_easy_encoder(&strm, 1, check), LZMA_OK);
+
+	strm.next_out = file + file_size;
+	strm.avail_out = FILE_SIZE_MAX - file_size;
+
+	for (size_t pos = begin; pos < end; pos += BLOCK_SIZE) {
+		strm.next_in = data + pos;
+		strm.avail_in = my_min(BLOCK_SIZE, end - pos);
+		assert_lzma_ret(lzma_code(&strm, LZMA_FULL_FLUSH),
+				LZMA_STREAM_END);
+	}
+
+	assert_lzma_ret(lzma_code(&strm, LZMA_FINISH), LZMA_STREAM_END);
+	file_size = (size_t)(strm.next_out - file);
+	lzma_end(&strm);
+}
+
+
+static void
+make_file(void)
+{
+	fill_data();
+
+	file_size = 0;
+	encode_stream(0, DATA_SIZE / 2, LZMA_CHECK_CRC32);
+
+	memzero(file + file_size, STREAM_PADDING);
+	file_size += STREAM_PADDING;
+	second_stream = file_size;
+
+	encode_stream(DATA_SIZE / 2, DATA_SIZE, LZMA_CHECK_CRC64);
+}
+
+
+// Decode the whole file with LZMA_FULL_FLUSH giving the input in small
+// pieces and store the position at every stop.
+static void
+test_full_flush(void)
+{
+	make_file();
+
+	lzma_stream strm = LZMA_STREAM_INIT;
+	lzma_stream_position position = LZMA_STREAM_POSITION_INIT;
+	assert_lzma_ret(lzma_stream_decoder_resume(&strm, UINT64_MAX,
+			LZMA_CONCATENATED, &position), LZMA_OK);
+
+	uint8_t *out = tuktest_malloc(DATA_SIZE);
+	strm.next_in = file;
+	strm.next_out = out;
+	strm.avail_out = DATA_SIZE;
+
+	positions_count = 0;
+	size_t in_end = 0;
+
+	while (true) {
+		// Add a little more input on every call.
+		if (in_end < file_size) {
+			in_end = my_min(in_end + 1000, file_size);
+			strm.avail_in = in_end - (size_t)(strm.next_in - file);
+		}
+
+		const lzma_action action = in_end == file_size
+				&& positions_count > 0
+				&& positions[positions_count - 1].in_offset
+					== file_size
+				? LZMA_FINISH : LZMA_FULL_FLUSH;
+		const lzma_ret ret = lzma_code(&strm, action);
+
+		if (ret == LZMA_STREAM_END && action == LZMA_FINISH)
+			break;
+
+		if (ret == LZMA_STREAM_END) {
+			// The decoder stops exactly at the boundary.
+			assert_uint_eq(position.in_offset, strm.total_in);
+			assert_uint_eq(position.out_offset, strm.total_out);
+			assert_uint(positions_count, <, POSITIONS_MAX);
+			positions[positions_count++] = position;
+		} else {
+			assert_lzma_ret(ret, LZMA_OK);
+		}
+	}
+
+	lzma_end(&strm);
+
+	assert_uint_eq(strm.total_out, DATA_SIZE);
+	assert_array_eq(out, data, DATA_SIZE);
+
+	// Three Blocks in each Stream and the ends of the two Streams
+	assert_uint_eq(positions_count, 3 + 1 + 3 + 1);
+	assert_uint_eq(positions[0].block_count, 1);
+	assert_uint_eq(positions[0].stream_flags.check, LZMA_CHECK_CRC32);
+	assert_uint_eq(positions[3].block_count, LZMA_VLI_UNKNOWN);
+	assert_uint_eq(positions[3].in_offset,
+			second_stream - STREAM_PADDING);
+	assert_uint_eq(positions[4].block_count, 1);
+	assert_uint_eq(positions[4].stream_flags.check, LZMA_CHECK_CRC64);
+	assert_uint_eq(positions[7].in_offset, file_size);
+
+	tuktest_free(out);
+}
+
+
+static lzma_ret
+decode_from(lzma_stream_position *position, size_t *out_size, uint8_t *out)
+{
+	lzma_stream strm = LZMA_STREAM_INIT;
+	assert_lzma_ret(lzma_stream_decoder_resume(&strm, UINT64_MAX,
+			LZMA_CONCATENATED, position), LZMA_OK);
+
+	strm.next_in = file + position->in_offset;
+	strm.avail_in = file_size - position->in_offset;
+	strm.next_out = out;
+	strm.avail_out = DATA_SIZE;
+
+	const lzma_ret ret = lzma_code(&strm, LZMA_FINISH);
+	*out_size = (size_t)(strm.next_out - out);
+	lzma_end(&strm);
+	return ret;
+}
+
+
+static void
+test_resume(void)
+{
+	if (positions_count == 0)
+		assert_skip("test_full_flush failed");
+
+	uint8_t *out = tuktest_malloc(DATA_SIZE);
+
+	for (size_t i = 0; i < positions_count; ++i) {
+		lzma_stream_position position = positions[i];
+		size_t out_size;
+		assert_lzma_ret(decode_from(&position, &out_size, out),
+				LZMA_STREAM_END);
+
+		assert_uint_eq(position.in_offset, file_size);
+		assert_uint_eq(position.out_offset, DATA_SIZE);
+		assert_uint_eq(out_size, DATA_SIZE - positions[i].out_offset);
+		assert_array_eq(out, data + positions[i].out_offset, out_size);
+	}
+
+	// A Block count that doesn't match the Index is detected.
+	lzma_stream_position position = positions[1];
+	++position.block_count;
+	size_t out_size;
+	assert_lzma_ret(decode_from(&position, &out_size, out),
+			LZMA_DATA_ERROR);
+
+	// The Blocks after the resume point are compared against the Index.
+	// Change the Uncompressed Size of the last Record of the first
+	// Stream. Its CRC32 must be fixed to not hit that check first.
+	const size_t index_end = positions[3].in_offset
+			- LZMA_STREAM_HEADER_SIZE;
+	uint8_t *crc = file + index_end - 4;
+	size_t index_pos = positions[2].in_offset;
+	assert_uint_eq(file[index_pos], 0x00);
+
+	uint8_t saved[8];
+	memcpy(saved, crc - 4, sizeof(saved));
+
+	// The Record ends just before the Index Padding.
+	size_t rec = index_end - 4;
+	while (file[rec - 1] == 0x00)
+		--rec;
+
+	++file[rec - 1];
+	write32le(crc, lzma_crc32(file + index_pos, (size_t)(crc - file)
+			- index_pos, 0));
+
+	position = positions[1];
+	assert_lzma_ret(decode_from(&position, &out_size, out),
+			LZMA_DATA_ERROR);
+
+	memcpy(crc - 4, saved, sizeof(saved));
+
+	// Invalid positions
+	lzma_stream strm = LZMA_STREAM_INIT;
+	position = positions[0];
+	position.in_offset += 1;
+	assert_lzma_ret(lzma_stream_decoder_resume(&strm, UINT64_MAX, 0,
+			&position), LZMA_PROG_ERROR);
+
+	position = positions[0];
+	position.stream_flags.version = 1;
+	assert_lzma_ret(lzma_stream_decoder_resume(&strm, UINT64_MAX, 0,
+			&position), LZMA_OPTIONS_ERROR);
+
+	assert_lzma_ret(lzma_stream_decoder_resume(&strm, UINT64_MAX, 0,
+			NULL), LZMA_PROG_ERROR);
+
+	lzma_end(&strm);
+	tuktest_free(out);
+}
+
+
+extern int
+main(int argc, char **argv)
+{
+	tuktest_start(argc, argv);
+
+	require_lzma2();
+
+	if (!lzma_check_is_supported(LZMA_CHECK_CRC64))
+		tuktest_early_skip("CRC64 is disabled");
+
+	tuktest_run(test_full_flush);
+	tuktest_run(test_resume);
+
+	return tuktest_end();
+}
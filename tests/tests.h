@@ -138,4 +138,107 @@ decoder_loop(lzma_stream *strm, uint8_t *in, size_t in_size)
 			LZMA_STREAM_END, LZMA_RUN);
 }
 
+
+/// Advance the linear congruential generator that the tests use for
+/// reproducible pseudorandom data and return the high 16 bits of it.
+static inline uint32_t
+test_rand(uint32_t *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 16;
+}
+
+
+/// Fill buf with pseudorandom letters from the first letters letters of
+/// the alphabet. The data is the same on every call.
+static inline void
+fill_letters(uint8_t *buf, size_t size, unsigned letters)
+{
+	uint32_t seed = 1;
+	for (size_t i = 0; i < size; ++i)
+		buf[i] = (uint8_t)('a' + test_rand(&seed) % letters);
+}
+
+
+/// Skip the whole test program if the LZMA2 encoder or decoder is missing.
+static inline void
+require_lzma2(void)
+{
+	if (!lzma_filter_encoder_is_supported(LZMA_FILTER_LZMA2)
+			|| !lzma_filter_decoder_is_supported(
+				LZMA_FILTER_LZMA2))
+		tuktest_early_skip("LZMA2 encoder and/or decoder "
+				"is disabled");
+}
+
+
+/// Decode the .xz file with lzma_stream_buffer_decode() and check that
+/// the result is the expected data.
+static inline void
+assert_xz_decodes_to(const uint8_t *file, size_t file_size,
+		const uint8_t *expected, size_t expected_size)
+{
+	// One extra byte catches output that is too long.
+	uint8_t *out = tuktest_malloc(expected_size + 1);
+	uint64_t memlimit = UINT64_MAX;
+	size_t in_pos = 0;
+	size_t out_pos = 0;
+	assert_lzma_ret(lzma_stream_buffer_decode(&memlimit, 0, NULL,
+			file, &in_pos, file_size,
+			out, &out_pos, expected_size + 1), LZMA_OK);
+	assert_uint_eq(in_pos, file_size);
+	assert_uint_eq(out_pos, expected_size);
+	assert_array_eq(out, expected, expected_size);
+	tuktest_free(out);
+}
+
+
+/// Statistics of counting_allocator(). The opaque pointer of
+/// the allocator points to this.
+typedef struct {
+	/// Allocations of at least this many bytes are counted in
+	/// big_allocs too.
+	size_t big_size;
+
+	size_t allocs;
+	size_t big_allocs;
+
+	/// Calls to free() with a non-NULL pointer
+	size_t frees;
+} alloc_counts;
+
+
+static inline void *
+counting_alloc(void *opaque, size_t nmemb, size_t size)
+{
+	alloc_counts *counts = opaque;
+	++counts->allocs;
+	if (counts->big_size != 0 && nmemb * size >= counts->big_size)
+		++counts->big_allocs;
+
+	return malloc(nmemb * size);
+}
+
+
+static inline void
+counting_free(void *opaque, void *ptr)
+{
+	alloc_counts *counts = opaque;
+	if (ptr != NULL)
+		++counts->frees;
+
+	free(ptr);
+}
+
+
+/// Returns an allocator that counts the calls in *counts
+static inline lzma_allocator
+counting_allocator(alloc_counts *counts)
+{
+	const lzma_allocator allocator = {
+		&counting_alloc, &counting_free, counts
+	};
+	return allocator;
+}
+
 #endif